@@ -0,0 +1,44 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define COAP_PATH_LEN 64
+#define COAP_OVERHEAD_MAX (4 + 2 + 2 * COAP_PATH_LEN + 3 + 1) //Header, token, Uri-Path, Content-Format, payload marker
+#define COAP_PAYLOAD_MAX 1024   //RFC 7252 4.6, keeps a datagram clear of IP fragmentation
+#define COAP_INFLIGHT_MAX 8     //Confirmable messages waiting for their ACK
+#define COAP_INFLIGHT_LEN 448   //Largest confirmable message
+#define COAP_FORMAT_NONE 0xFFFF //No Content-Format option
+#define COAP_FORMAT_CBOR 60
+
+typedef void (*coap_client_message_cb)(const uint8_t *payload, size_t len);
+
+typedef struct {
+    const char *host;
+    const char *port;
+    uint16_t content_format;            //Content-Format of every POST, COAP_FORMAT_NONE to leave it out
+    coap_client_message_cb on_message;  //Response payloads and server pushes, called from the client task
+} coap_client_config;
+
+typedef struct {
+    uint32_t sent_non;
+    uint32_t sent_con;
+    uint32_t acked;
+    uint32_t retransmitted;     //Confirmable messages sent again after an ACK timeout
+    uint32_t lost;              //Confirmable messages given up after COAP_MAX_RETRANSMIT
+    uint32_t reset;             //Confirmable messages the server answered with RST
+    uint32_t received;          //Payloads delivered to on_message
+} coap_client_stats;
+
+/*
+ * Minimal CoAP (RFC 7252) client over one UDP socket, POST only. Non-confirmable messages are written
+ * and forgotten, there is no handshake and nothing to keep alive. Confirmable messages go through a
+ * fixed in-flight table and are retransmitted with exponential backoff until ACKed or given up; as
+ * NSTART is 1 only the oldest one is outstanding at a time, the rest wait their turn. A client task
+ * reads ACKs, responses and server pushes and runs the retransmit timers. The config struct is copied,
+ * its strings must outlive the client.
+ */
+esp_err_t coap_client_start(const coap_client_config *config);
+esp_err_t coap_client_post(const char *path, const void *payload, size_t len, bool confirmable);
+void coap_client_get_stats(coap_client_stats *stats);
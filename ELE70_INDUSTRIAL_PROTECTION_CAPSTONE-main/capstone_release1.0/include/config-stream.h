@@ -0,0 +1,32 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define CONFIG_STREAM_PATH_LEN 64
+#define CONFIG_STREAM_LINE_MAX 64  //Longer lines are dropped
+
+typedef void (*config_stream_cb)(const char *line, size_t len);
+
+typedef struct {
+    const char *host;
+    const char *port;
+    const char *path;               //GET target, e.g. "/config?device=<mac>"
+    uint16_t idle_timeout_s;        //Reconnect if the server sends nothing for this long
+    config_stream_cb on_line;       //Called from the stream task for every non-empty line pushed, without its newline
+} config_stream_config;
+
+typedef struct {
+    uint32_t connects;      //Streams opened with a 200 response
+    uint32_t failures;      //Connects, requests or streams that failed or ended
+    uint32_t lines;         //Lines delivered to on_line
+} config_stream_stats;
+
+/*
+ * Downstream config channel: one long-lived GET whose chunked response stays open, the server
+ * writing a config line such as "#<profile>\n" whenever something changes and an empty line as a
+ * heartbeat well inside idle_timeout_s. A task owns the socket, parses the stream as it arrives and
+ * reconnects with backoff whenever it ends. The config struct is copied, its strings must outlive the stream.
+ */
+esp_err_t config_stream_start(const config_stream_config *config);
+void config_stream_get_stats(config_stream_stats *stats);
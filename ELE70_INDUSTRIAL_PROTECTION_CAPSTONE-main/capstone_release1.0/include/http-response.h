@@ -0,0 +1,43 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HTTP_RESP_LINE_MAX 128 //Longer status/header lines are truncated, only their start is inspected
+
+typedef enum {
+    HTTP_RESP_STATUS,       //Status line
+    HTTP_RESP_HEADER,       //Header lines up to the blank line
+    HTTP_RESP_BODY,         //Identity body, Content-Length or until EOF
+    HTTP_RESP_CHUNK_SIZE,   //Chunk size line
+    HTTP_RESP_CHUNK_DATA,   //Chunk payload
+    HTTP_RESP_CHUNK_END,    //CRLF closing a chunk
+    HTTP_RESP_TRAILER,      //Trailer lines after the last chunk
+    HTTP_RESP_DONE,
+    HTTP_RESP_ERROR,
+} http_resp_state;
+
+/**
+ * Incremental HTTP/1.x response parser. Bytes are fed as they arrive off the socket in pieces of
+ * any size; only the current header line is buffered, never the body. The body is scanned for the
+ * collector's "#<profile>" directive as it streams past. A long-lived body such as a config stream
+ * sets on_body after init to see the body itself, framing removed, as it arrives.
+ */
+typedef struct {
+    http_resp_state state;
+    int status;                 //Status code, 0 until the status line is parsed
+    bool keep_alive;            //Connection may carry another request once done
+    bool chunked;
+    int64_t content_length;     //-1 if not given
+    uint64_t remaining;         //Bytes left in the identity body or current chunk
+    int profile;                //Value of the first "#<digits>" in the body, -1 if none
+    uint8_t directive;          //Directive scanner state
+    void (*on_body)(const char *data, size_t len);  //Optional, body bytes as they are parsed
+    char line[HTTP_RESP_LINE_MAX];
+    size_t line_len;
+} http_response;
+
+void http_response_init(http_response *resp);
+int http_response_feed(http_response *resp, const char *data, size_t len);
+int http_response_finish(http_response *resp);
+bool http_response_done(const http_response *resp);
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define LATENCY_HIST_BUCKETS 24 //Bucket 0 counts 0 us, bucket i counts [2^(i-1), 2^i) us, the last one everything above
+
+/**
+ * Log2 histogram of durations in microseconds. Recording is a couple of relaxed atomic adds, so
+ * any task or timer callback may record while another takes a snapshot.
+ */
+typedef struct {
+    _Atomic uint32_t buckets[LATENCY_HIST_BUCKETS];
+    _Atomic uint32_t count;
+    _Atomic uint32_t max_us;
+} latency_hist;
+
+typedef struct {
+    uint32_t buckets[LATENCY_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+} latency_hist_snapshot;
+
+void latency_hist_reset(latency_hist *hist);
+void latency_hist_record(latency_hist *hist, uint32_t us);
+void latency_hist_snapshot_get(latency_hist *hist, latency_hist_snapshot *snap);
+uint32_t latency_hist_percentile(const latency_hist_snapshot *snap, uint32_t percent);
+uint32_t latency_hist_bucket_upper(int bucket);
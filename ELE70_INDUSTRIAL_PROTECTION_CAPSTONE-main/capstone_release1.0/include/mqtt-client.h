@@ -0,0 +1,45 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifndef MQTT_PACKET_MAX
+#define MQTT_PACKET_MAX 3072    //Largest QoS 0 PUBLISH, fixed header and topic included
+#endif
+#define MQTT_INFLIGHT_MAX 8     //Unacknowledged QoS 1 publishes held for redelivery
+#define MQTT_INFLIGHT_LEN 384   //Largest QoS 1 PUBLISH
+#define MQTT_TOPIC_LEN 64
+
+typedef void (*mqtt_client_message_cb)(const char *topic, size_t topic_len, const uint8_t *payload, size_t len);
+
+typedef struct {
+    const char *host;
+    const char *port;
+    const char *client_id;          //Names the persistent session, must be stable across reboots
+    uint16_t keepalive_s;
+    const char *subscribe;          //Topic filter subscribed at QoS 1 on every connect, may be NULL
+    mqtt_client_message_cb on_message;  //Called from the client task
+} mqtt_client_config;
+
+typedef struct {
+    uint32_t connects;
+    uint32_t published_qos0;
+    uint32_t published_qos1;
+    uint32_t acked;             //PUBACKs received for QoS 1 publishes
+    uint32_t redelivered;       //QoS 1 publishes sent again after a reconnect
+    uint32_t received;          //Messages delivered on the subscription
+} mqtt_client_stats;
+
+/*
+ * Minimal MQTT 3.1.1 client over one persistent TCP session (clean session off), so the broker
+ * keeps the subscription and queued config messages while the node is away. A client task owns
+ * the socket: it connects with backoff, reads acknowledgements and subscribed messages, and
+ * keeps the session alive with PINGREQ. Publishing never waits for the broker: QoS 0 is written
+ * and forgotten, QoS 1 is also kept in a fixed in-flight table until its PUBACK and redelivered
+ * on the next connect. The config struct is copied, its strings must outlive the client.
+ */
+esp_err_t mqtt_client_start(const mqtt_client_config *config);
+esp_err_t mqtt_client_publish(const char *topic, const void *payload, size_t len, int qos);
+bool mqtt_client_connected(void);
+void mqtt_client_get_stats(mqtt_client_stats *stats);
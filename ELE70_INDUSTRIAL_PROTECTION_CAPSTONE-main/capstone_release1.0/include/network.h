@@ -1,9 +1,37 @@
+#pragma once
+#include <stdbool.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "lwip/err.h"
+#include "sensor-i2c.h"
+#include "payload.h"
+
+#define TX_BATCH_MAX 16 //Max samples handed to network_transmit at once
+#define NETWORK_STATS_SOURCES 4 //Stats sources besides the pipeline stages
+#define NETWORK_STATS_GROUP_MAX 512 //Longest stats group any source may write, fits every transport
+
+typedef struct {
+    int count;
+    sensor_struct samples[TX_BATCH_MAX];
+} sensor_batch;
+
+/**
+ * Writes group number group of a stats snapshot as form fields, starting with its own
+ * "<kind>=<name>" field and without a leading '&', and returns true; returns false without writing
+ * once group is past the source's last one. A group is never split across messages, so it must
+ * stay within NETWORK_STATS_GROUP_MAX. Called from the transmitter task
+ */
+typedef bool (*network_stats_source)(payload_writer *w, int group);
 
-TaskHandle_t transmitTaskHandle;
-int configProfile;
 esp_err_t network_connect(void);
-void http_tx_task(void *pvParameters);
+esp_err_t network_transmit(const sensor_struct *samples, int count);
+esp_err_t http_transmit(const sensor_struct *samples, int count);
+bool network_is_up(void);
+void network_watch_config(void);
+int network_take_profile(void);
+int64_t network_last_write_us(void);
+void network_watch_stats(void);
+bool network_take_stats_request(void);
+esp_err_t network_transmit_stats(void);
+esp_err_t network_add_stats_source(network_stats_source source);
 
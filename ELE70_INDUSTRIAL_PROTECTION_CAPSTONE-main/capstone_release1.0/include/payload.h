@@ -0,0 +1,46 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sensor-i2c.h"
+
+#define PAYLOAD_INT_MAX_DIGITS 20 //"-9223372036854775808"
+#define PAYLOAD_CBOR_VERSION 5
+#define PAYLOAD_DEVICE_ID_LEN 6 //Station MAC
+
+/**
+ * Append-only writer over a fixed buffer, nothing is allocated. An append that doesn't fit sets
+ * overflow and is dropped, so a batch of appends can be checked once at the end.
+ */
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} payload_writer;
+
+void payload_init(payload_writer *w, char *buf, size_t size);
+void payload_append_mem(payload_writer *w, const void *data, size_t len);
+void payload_append_str(payload_writer *w, const char *str);
+void payload_append_int(payload_writer *w, int64_t value);
+void payload_append_fixed(payload_writer *w, int32_t value, int frac_bits, int decimals);
+void payload_append_field(payload_writer *w, const char *name, int64_t value);
+void payload_rewind(payload_writer *w, size_t len);
+size_t payload_format_int(char *out, int64_t value);
+
+/*
+ * Compact binary batch, RFC 8949 CBOR:
+ *   [version, h'<device id>', base_ms, utc_ms, [[sensor_id, dt_ms, value], ...]]
+ * base_ms is the first sample's monotonic timestamp in ms, dt_ms each sample's offset from it.
+ * utc_ms is UTC (ms since 1970) at base_ms, 0 if the node's clock wasn't synchronized. A reading
+ * below 256.0 within a minute of the first takes 6-8 bytes, a larger one 2 more. A window summary appends its statistics to the same array:
+ *   [sensor_id, dt_ms, last, count, min, max, mean, stddev]
+ * Either form carries one more element, the sensor flags (SENSOR_FLAG_*), when any are set.
+ * Readings and statistics are sent as raw sensor_value integers (Q23.8, divide by 256). The
+ * collector's reference decoder lives with its tests, test/test_payload_cbor/cbor-decode.c.
+ */
+void payload_cbor_uint(payload_writer *w, uint64_t value);
+void payload_cbor_int(payload_writer *w, int64_t value);
+void payload_cbor_array(payload_writer *w, size_t count);
+void payload_cbor_bytes(payload_writer *w, const void *data, size_t len);
+void payload_cbor_encode_batch(payload_writer *w, const uint8_t *device_id, int64_t utc_ms, const sensor_struct *samples, int count);
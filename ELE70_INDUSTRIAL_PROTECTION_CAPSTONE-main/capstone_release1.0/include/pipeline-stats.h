@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+#include "latency-hist.h"
+#include "payload.h"
+
+#define PIPELINE_STATS_NAME_LEN 17      //Longest stage name
+#define PIPELINE_STATS_HIST_LEN (5 * (5 + PAYLOAD_INT_MAX_DIGITS) + 9 + LATENCY_HIST_BUCKETS * 11)
+#define PIPELINE_STATS_STAGE_LEN (6 + PIPELINE_STATS_NAME_LEN + PIPELINE_STATS_HIST_LEN)
+
+typedef enum {
+    PIPELINE_SAMPLE_TO_ENQUEUE,     //Window's last reading to its summary entering the sample ring
+    PIPELINE_ENQUEUE_TO_TX,         //Sample ring to the transmitter taking it into a batch
+    PIPELINE_CONNECT,               //Address lookup and TCP connect of a new HTTP connection
+    PIPELINE_WRITE,                 //Handing one request or publish to the socket
+    PIPELINE_RESPONSE,              //End of an HTTP write to its response parsed
+    PIPELINE_STAGES,
+} pipeline_stage;
+
+/*
+ * Where the time goes between a sensor read and the collector's answer, one log2 histogram per stage.
+ * Probes are a timer read and a few relaxed atomic adds, so they stay on in production and any task
+ * may record while another exports. A stage a transport doesn't have simply stays empty.
+ */
+void pipeline_stats_record(pipeline_stage stage, int64_t start_us, int64_t end_us);
+void pipeline_stats_get(pipeline_stage stage, latency_hist_snapshot *snap);
+const char *pipeline_stats_name(pipeline_stage stage);
+bool pipeline_stats_encode(payload_writer *w, int group);
+void pipeline_stats_encode_hist(payload_writer *w, const latency_hist_snapshot *snap);
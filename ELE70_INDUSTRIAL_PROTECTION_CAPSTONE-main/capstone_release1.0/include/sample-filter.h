@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sensor-i2c.h"
+
+#define SAMPLE_FILTER_CHANNELS 32   //Channels are registry indices
+#define SAMPLE_FILTER_STAGES 4      //Stages per chain
+#define SAMPLE_FILTER_MEDIAN_MAX 9  //Widest running median
+
+typedef enum {
+    FILTER_MEDIAN,      //Running median over the last param readings (odd, up to SAMPLE_FILTER_MEDIAN_MAX)
+    FILTER_IIR,         //First order low pass, y += (x - y) / 2^param
+    FILTER_DECIMATE,    //Averages param readings into one, the other param - 1 produce no output
+} sample_filter_kind;
+
+typedef struct {
+    sample_filter_kind kind;
+    uint8_t param;
+} sample_filter_stage;
+
+/*
+ * Per-sensor noise rejection applied to each reading before it joins the transmit window. A chain
+ * runs its stages in order on sensor_value fixed point; all state is preallocated per channel.
+ * Chains are configured before the sampler starts, after that only the sampler task may touch them.
+ */
+esp_err_t sample_filter_configure(int channel, const sample_filter_stage *stages, int count);
+void sample_filter_reset(int channel);
+bool sample_filter_apply(int channel, sensor_value *value);
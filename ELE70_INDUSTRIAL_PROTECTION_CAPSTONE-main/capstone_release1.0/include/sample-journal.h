@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "sensor-i2c.h"
+
+#define JOURNAL_PARTITION_LABEL "journal"
+#define JOURNAL_CHUNK_RECORDS 16 //Records buffered in RAM per flash write
+
+typedef struct {
+    uint32_t capacity_bytes;
+    uint32_t used_bytes;
+    uint32_t pending;           //Samples waiting to be drained, flash and RAM buffer
+    uint32_t appended;
+    uint32_t drained;
+    uint32_t dropped;           //Undrained samples lost to the journal wrapping
+    uint32_t sectors_erased;
+    uint32_t drain_samples_per_s; //Over the current (or last) drain session
+} sample_journal_stats;
+
+/*
+ * Append-only journal of samples on the "journal" data partition. Only the transmitter task
+ * may append, read or consume; sample_journal_get_stats() may be called from anywhere.
+ */
+esp_err_t sample_journal_init(void);
+esp_err_t sample_journal_append(const sensor_struct *sample);
+esp_err_t sample_journal_flush(void);
+int sample_journal_read(sensor_struct *samples, int max);
+esp_err_t sample_journal_consume(int count);
+uint32_t sample_journal_pending(void);
+void sample_journal_get_stats(sample_journal_stats *stats);
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sensor-i2c.h"
+
+#define SAMPLE_REPORT_CHANNELS 32 //Channels are registry indices
+
+/**
+ * Report-by-exception settings of one sensor. With both thresholds 0 every window is sent,
+ * otherwise a window is only sent when its last, min or max reading moved past a threshold
+ * from the last value sent, or the heartbeat expired. A window reaching past an alarm limit is
+ * always sent, flagged SENSOR_FLAG_ALARM, and the reading that first crosses one closes its window
+ * early.
+ */
+typedef struct {
+    sensor_value abs;       //Absolute deadband, fixed point like the readings, 0 disables
+    uint32_t permille;      //Deadband in thousandths of the last value sent, 0 disables
+    uint32_t heartbeat_ms;  //Send at least this often regardless, 0 never forces a send
+    bool alarm;             //Alarm limits below are in use
+    sensor_value alarm_low;
+    sensor_value alarm_high;
+} sample_deadband;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t suppressed;
+    uint32_t alarms;
+} sample_report_stats;
+
+/*
+ * Decided in the sampler as each transmit window closes, so a suppressed window never reaches the
+ * sample ring; alarm limits are also checked on every reading as it is filtered. Any task may
+ * configure a channel; the first call must come before the sampler starts. A change is handed over
+ * through a changed mask and the sampler copies it in on its next decision for that channel. Only
+ * the sampler task may call sample_report_due() and sample_report_alarm_crossed().
+ */
+esp_err_t sample_report_configure(int channel, const sample_deadband *deadband);
+void sample_report_get_config(int channel, sample_deadband *deadband);
+bool sample_report_due(int channel, sensor_struct *sample);
+bool sample_report_alarm_crossed(int channel, sensor_value value);
+void sample_report_get_stats(int channel, sample_report_stats *stats);
@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "sensor-i2c.h"
+
+#define SAMPLE_RING_LEN 64 //Slots, must be a power of two
+#ifndef SAMPLE_RING_CACHE_LINE
+#define SAMPLE_RING_CACHE_LINE 32 //ESP32 cache line, keeps producer and consumer indices apart
+#endif
+
+typedef enum {
+    RING_DROP_OLDEST,   //Producer overwrites the oldest unread sample
+    RING_DROP_NEWEST,   //Producer discards the sample it is pushing
+    RING_BLOCK,         //Producer waits up to block_ticks for space, then drops the newest
+} ring_overflow_policy;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t popped;
+    uint32_t dropped_oldest;
+    uint32_t dropped_newest;
+    uint32_t blocked;
+    uint32_t high_water;
+} sample_ring_stats;
+
+typedef struct {
+    sensor_struct sample;
+    int64_t queued_us;      //esp_timer_get_time() when pushed
+} sample_ring_slot;
+
+/**
+ * Single-producer/single-consumer ring of timestamped samples. The producer (CORE 1 sampler) only
+ * writes head, the consumer (CORE 0 transmitter) only writes tail, except that RING_DROP_OLDEST
+ * lets the producer advance tail with a compare-and-swap.
+ */
+typedef struct {
+    _Atomic uint32_t head __attribute__((aligned(SAMPLE_RING_CACHE_LINE)));
+    _Atomic uint32_t pushed;
+    _Atomic uint32_t dropped_oldest;
+    _Atomic uint32_t dropped_newest;
+    _Atomic uint32_t blocked;
+    _Atomic uint32_t high_water;
+    _Atomic uint32_t tail __attribute__((aligned(SAMPLE_RING_CACHE_LINE)));
+    _Atomic uint32_t popped;
+    ring_overflow_policy policy __attribute__((aligned(SAMPLE_RING_CACHE_LINE)));
+    TickType_t block_ticks;
+    sample_ring_slot slots[SAMPLE_RING_LEN] __attribute__((aligned(SAMPLE_RING_CACHE_LINE)));
+} sample_ring;
+
+void sample_ring_init(sample_ring *ring, ring_overflow_policy policy, TickType_t block_ticks);
+bool sample_ring_push(sample_ring *ring, const sensor_struct *sample);
+bool sample_ring_pop(sample_ring *ring, sensor_struct *sample, int64_t *queued_us);
+uint32_t sample_ring_count(sample_ring *ring);
+void sample_ring_get_stats(sample_ring *ring, sample_ring_stats *stats);
@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "latency-hist.h"
+
+#define SAMPLE_SCHED_CHANNELS 32 //Channels are indexed 0..SAMPLE_SCHED_CHANNELS-1, due sets are bit masks
+
+typedef struct {
+    int64_t period_us;          //0 while the channel is stopped
+    uint32_t releases;
+    uint32_t overruns;          //Deadlines skipped because the previous release ran past them
+    latency_hist_snapshot jitter;   //Wake-up time minus deadline
+    latency_hist_snapshot read;     //Bus time of each release, shared by every channel
+} sample_sched_stats;
+
+/*
+ * Absolute-deadline sampling scheduler for the CORE 1 sampler. Each channel is released on
+ * multiples of its own period counted from one common epoch, so channels whose periods divide
+ * each other fall due together and share a bus session, and nothing drifts with read time.
+ * A single one-shot esp_timer is armed for the earliest deadline and wakes the sampler through
+ * a task notification, which other tasks may also give to wake the sampler early. Only the task
+ * that called sample_sched_init() may wait on it or change periods.
+ */
+esp_err_t sample_sched_init(void);
+esp_err_t sample_sched_set_period(int channel, int64_t period_us);
+uint32_t sample_sched_wait(void);
+void sample_sched_read_done(uint32_t read_us);
+void sample_sched_get_stats(int channel, sample_sched_stats *stats);
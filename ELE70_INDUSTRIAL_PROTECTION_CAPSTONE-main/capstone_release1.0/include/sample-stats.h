@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "sensor-i2c.h"
+
+/**
+ * Running statistics of one sensor over one transmit window. Each reading updates count, min,
+ * max, last value and the Welford mean and sum of squared deviations in O(1), no readings are
+ * kept. Owned by the sampler task.
+ */
+typedef struct {
+    uint32_t count;
+    int id;
+    sensor_value min;
+    sensor_value max;
+    sensor_value last;
+    int64_t last_us;    //Timestamp of the last reading
+    float mean;         //In sensor_value units
+    float m2;           //Sum of squared deviations from the running mean
+} sample_window;
+
+void sample_window_reset(sample_window *window);
+void sample_window_add(sample_window *window, const sensor_struct *sample);
+bool sample_window_close(sample_window *window, sensor_struct *summary);
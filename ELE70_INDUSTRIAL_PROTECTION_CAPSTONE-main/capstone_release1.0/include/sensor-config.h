@@ -0,0 +1,35 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sample-report.h"
+
+#define SENSOR_CONFIG_NAMESPACE "sensor_cfg"   //NVS namespace, "rate<id>" and "db<id>" blobs
+#define SENSOR_CONFIG_SAMPLE_MS_MAX 3600000
+#define SENSOR_CONFIG_TX_MS_MAX 86400000
+#define SENSOR_CONFIG_BATCH_MAX 16
+#define SENSOR_CONFIG_LINE_MAX 96
+
+typedef struct {
+    uint32_t sample_ms;     //Sample period, 0 keeps the driver's. Never faster than the driver's period
+    uint32_t tx_ms;         //Window length, a summary is closed and reported this often. 0 follows the profile
+    uint32_t batch;         //Windows queued before the transmitter is woken, 0 or 1 sends each. Alarms never wait
+} sensor_rate;
+
+/*
+ * Server-settable per-sensor rates and deadbands, persisted in NVS and keyed by the collector's
+ * sensor id so they survive a change of board table. Any task may set them; the sampler takes the
+ * set of changed registry indices on its next wake and applies them. Text form, one per line:
+ *   rate <sensor_id> <sample_ms> <tx_ms> <batch>
+ *   deadband <sensor_id> <abs> <permille> <heartbeat_ms> [<alarm_low> <alarm_high>]
+ * abs and the alarm limits are decimals in the sensor's unit, e.g. "deadband 2 0.5 0 60000 0 40".
+ * All zeros without alarm limits returns a sensor to its defaults.
+ */
+esp_err_t sensor_config_load(void);
+esp_err_t sensor_config_set(int id, const sensor_rate *rate);
+void sensor_config_get(int index, sensor_rate *rate);
+esp_err_t sensor_config_set_deadband(int id, const sample_deadband *deadband);
+bool sensor_config_get_deadband(int index, sample_deadband *deadband);
+uint32_t sensor_config_take_changed(void);
+int sensor_config_parse(const char *text, size_t len, int *id, sensor_rate *rate);
+int sensor_config_parse_deadband(const char *text, size_t len, int *id, sample_deadband *deadband);
@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+#define SENSOR_HOTPLUG_DEBOUNCE_MS 50 //An enable pin must be quiet this long before its level counts
+
+typedef struct {
+    uint32_t edges;         //Enable pin edges seen by the ISR
+    uint32_t edges_lost;    //Edges dropped on a full queue, harmless since levels are re-read after debounce
+    uint32_t plugged;
+    uint32_t unplugged;
+    uint32_t bounces;       //Debounce windows that settled back on the level already registered
+} sensor_hotplug_stats;
+
+/*
+ * Enable-pin hot-plug. The ISR only posts the edge to a static queue; a worker task debounces it
+ * and publishes the wanted set of sensors, and the sampler task attaches or detaches registry
+ * slots in sensor_hotplug_apply(). Nothing is allocated after start.
+ */
+esp_err_t sensor_hotplug_start(void);
+void sensor_hotplug_apply(void);
+void sensor_hotplug_get_stats(sensor_hotplug_stats *stats);
@@ -1,8 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+//Readings are signed Q23.8 fixed point in the sensor's unit (lux, degrees C), e.g. -3.5 is -896
+typedef int32_t sensor_value;
+#define SENSOR_VALUE_FRAC_BITS 8
+#define SENSOR_VALUE_ONE (1 << SENSOR_VALUE_FRAC_BITS)
+
+#define SENSOR_FLAG_ALARM (1u << 0) //Outside the sensor's alarm limits, transports deliver it reliably
+
 typedef struct {
 	int id;
-    int value;
+    sensor_value value;     //Reading, for a window summary the window's last reading
+    int64_t timestamp;      //esp_timer_get_time() when read, us since boot
+    uint32_t count;         //Readings summarized, 0 for a plain reading (min..stddev unused)
+    sensor_value min;
+    sensor_value max;
+    sensor_value mean;
+    sensor_value stddev;    //Sample standard deviation over the window
+    uint32_t flags;         //SENSOR_FLAG_*
 } sensor_struct;
 
-void sensor_i2c_init(void);
-uint16_t light_read(void);
-uint16_t temp_read(void);
\ No newline at end of file
+#ifndef SENSOR_I2C_CHANNELS
+#define SENSOR_I2C_CHANNELS 32  //Register reads the bus layer can hold, masks are uint32_t
+#endif
+#define SENSOR_I2C_READ_MAX 4   //Bytes per register read
+#define SENSOR_I2C_MASK(channel) (1u << (channel))
+
+//Per-channel bus health. A channel is quarantined after repeated failures and only probed again
+//once its backoff expires, so it can't stall reads of the other channels
+typedef struct {
+    uint32_t reads;
+    uint32_t errors;
+    uint32_t timeouts;
+    uint32_t consecutive;   //Failures since the last good read
+    uint32_t quarantines;
+    bool quarantined;
+} sensor_i2c_health;
+
+/*
+ * Bus layer: each channel is one register read (address, register, length) with its own
+ * pre-built command link. Once the sampler task runs, only it may add, write or read channels.
+ */
+esp_err_t sensor_i2c_init(void);
+esp_err_t sensor_i2c_add(int channel, uint8_t addr, uint8_t reg, size_t len);
+esp_err_t sensor_i2c_write(int channel, uint8_t reg, const uint8_t *data, size_t len);
+uint32_t sensor_i2c_read_batch(uint32_t mask);
+const uint8_t *sensor_i2c_raw(int channel);
+void sensor_i2c_get_health(int channel, sensor_i2c_health *health);
+uint32_t sensor_i2c_bus_recoveries(void);
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sensor-i2c.h"
+
+#ifndef SENSOR_REGISTRY_MAX
+#define SENSOR_REGISTRY_MAX 32  //Sensors per node, a sensor's index is also its scheduler and bus channel
+#endif
+
+typedef struct sensor_desc sensor_desc;
+
+/**
+ * Per sensor type operations. Sensors with read == NULL are register reads on the shared I2C bus:
+ * the registry claims bus channel <index> for (addr, reg, len) and reads them in batched sessions.
+ * Anything else supplies its own read, which fills raw[] with up to SENSOR_I2C_READ_MAX bytes.
+ */
+typedef struct {
+    const char *name;
+    uint8_t reg;                                                //Register read each sample, bus sensors only
+    uint8_t len;                                                //Bytes read from it
+    int64_t period_us;                                          //Default sample period, also the fastest the device is read
+    esp_err_t (*init)(sensor_desc *sensor);                     //Configures the device, may be NULL
+    esp_err_t (*read)(sensor_desc *sensor, uint8_t *raw);       //NULL for batched bus sensors
+    esp_err_t (*convert)(const sensor_desc *sensor, const uint8_t *raw, sensor_value *value);   //Fails on an impossible code
+} sensor_driver;
+
+//One sensor socket of the board. Descriptors sit in one contiguous, statically allocated array in index
+//order; hot-plug attaches and detaches them, nothing is ever allocated
+struct sensor_desc {
+    const sensor_driver *driver;    //NULL for a pin with no reader yet, it is never sampled
+    int id;                         //sensor_id reported to the collector
+    int index;
+    int en_pin;                     //Enable pin, high while the sensor is plugged in
+    int64_t period_us;              //Current sample period, the driver's unless a rate was configured
+    uint8_t addr;
+    bool present;                   //Attached, owned by the sampler task
+};
+
+extern const sensor_driver sensor_veml7700;
+extern const sensor_driver sensor_ntc_adc;
+
+esp_err_t sensor_registry_add(const sensor_driver *driver, int id, uint8_t addr, int en_pin);
+esp_err_t sensor_registry_attach(int index);
+void sensor_registry_detach(int index);
+int sensor_registry_count(void);
+sensor_desc *sensor_registry_get(int index);
+uint32_t sensor_registry_read(uint32_t due, sensor_struct *samples);
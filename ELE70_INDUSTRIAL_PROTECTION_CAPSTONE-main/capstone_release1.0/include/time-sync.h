@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "payload.h"
+
+#define TIME_SYNC_PROBES 4              //Requests per sync, the one with the shortest round trip is used
+#define TIME_SYNC_TIMEOUT_MS 1000       //Per request
+#define TIME_SYNC_RETRY_MIN_S 2         //Backoff while no sync has succeeded, doubling up to interval_s
+#define TIME_SYNC_DRIFT_MIN_S 60        //Syncs closer than this don't update the drift estimate
+#define TIME_SYNC_DRIFT_MAX_PPB 500000  //A larger apparent drift is a step of the server's clock
+
+typedef struct {
+    const char *host;
+    const char *port;               //"123" for a real NTP server
+    uint32_t interval_s;            //Between syncs once the first one succeeded
+} time_sync_config;
+
+typedef struct {
+    uint32_t syncs;
+    uint32_t failures;              //Syncs where no probe got a valid reply
+    bool synced;
+    int64_t offset_us;              //UTC minus esp_timer_get_time() at the last sync
+    int32_t drift_ppb;              //How much slower esp_timer runs than UTC, negative if faster
+    uint32_t rtt_us;                //Round trip of the probe the last sync used, twice the worst offset error
+    int64_t last_sync_us;           //esp_timer_get_time() of the last sync
+} time_sync_stats;
+
+typedef struct {
+    int64_t offset_us;              //UTC minus local time at local_us
+    int64_t local_us;               //esp_timer_get_time() the offset was measured at
+    int32_t drift_ppb;
+} time_sync_model;
+
+/*
+ * SNTP (RFC 4330) client mapping the monotonic esp_timer_get_time() clock onto UTC. Samples keep
+ * their monotonic timestamps; the mapping is applied when a batch is serialized, so a clock step
+ * never reorders readings. A task syncs at startup and every interval_s after, each sync keeping
+ * the fastest of TIME_SYNC_PROBES round trips, and estimates the drift of the local oscillator
+ * from successive offsets. Conversions are safe from any task and return 0 until the first sync.
+ * The config struct is copied, its strings must outlive the client. The model and NTP timestamp
+ * conversions are the pure arithmetic underneath, callable without a running client.
+ */
+esp_err_t time_sync_start(const time_sync_config *config);
+bool time_sync_valid(void);
+int64_t time_sync_utc_us(int64_t mono_us);
+int64_t time_sync_mono_us(int64_t utc_us);
+void time_sync_get_stats(time_sync_stats *stats);
+bool time_sync_encode_stats(payload_writer *w, int group);
+int64_t time_sync_model_utc_us(const time_sync_model *model, int64_t mono_us);
+int64_t time_sync_model_mono_us(const time_sync_model *model, int64_t utc_us);
+int64_t time_sync_ntp_to_utc_us(const uint8_t *ts);
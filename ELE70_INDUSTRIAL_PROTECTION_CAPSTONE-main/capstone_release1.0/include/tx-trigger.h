@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+#include "latency-hist.h"
+
+#define TX_TRIGGER_TARGET_US 10000 //Trigger to socket write budget, slower ones are counted
+
+typedef enum {
+    TX_TRIGGER_WINDOW,      //A sensor's transmit deadline passed with its batch queued
+    TX_TRIGGER_ALARM,       //A window reached an alarm limit
+    TX_TRIGGER_PROFILE,     //The server changed the profile, every window was flushed
+    TX_TRIGGER_KINDS,
+} tx_trigger_kind;
+
+typedef struct {
+    uint32_t triggers;              //Events that woke the transmitter
+    uint32_t written;               //...whose data reached a socket write
+    uint32_t journaled;             //...whose data went to the journal instead
+    uint32_t over_target;           //Written later than TX_TRIGGER_TARGET_US
+    latency_hist_snapshot latency;  //Trigger to the start of the socket write
+} tx_trigger_stats;
+
+/*
+ * Latency of the event-driven transmit path, per kind of event. The sampler marks an event right
+ * before it notifies the transmitter, stamped with when it happened if that is earlier: an alarm
+ * with the sample time of the reading that raised it. The transmitter reports when the write
+ * carrying the live batch started, or that the batch was journaled. Events marked before one write are served by it
+ * together, each measured from the first of its kind. Mark from one task, serve from one task.
+ */
+void tx_trigger_mark(tx_trigger_kind kind);
+void tx_trigger_mark_at(tx_trigger_kind kind, int64_t at_us);
+void tx_trigger_served(int64_t write_us);
+void tx_trigger_get_stats(tx_trigger_kind kind, tx_trigger_stats *stats);
@@ -0,0 +1,16 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+uint32_t esp_log_timestamp(void);
+
+#define ESP_LOG_NATIVE(letter, tag, format, ...) \
+    fprintf(stderr, letter " (%u) %s: " format "\n", (unsigned)esp_log_timestamp(), tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_NATIVE("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_NATIVE("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_NATIVE("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do { (void)(tag); } while(0)
+#define ESP_LOGV(tag, format, ...) do { (void)(tag); } while(0)
+#define ESP_DRAM_LOGE(tag, format, ...) ESP_LOGE(tag, format, ##__VA_ARGS__)
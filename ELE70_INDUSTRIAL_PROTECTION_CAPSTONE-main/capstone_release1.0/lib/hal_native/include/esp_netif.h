@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+typedef struct esp_netif_obj esp_netif_t;
+
+typedef struct {
+    uint32_t addr;
+} esp_ip4_addr_t;
+
+typedef struct {
+    esp_ip4_addr_t ip;
+    esp_ip4_addr_t netmask;
+    esp_ip4_addr_t gw;
+} esp_netif_ip_info_t;
+
+typedef struct {
+    const char *if_key;
+} esp_netif_config_t;
+
+typedef struct {
+    int if_index;
+    esp_netif_t *esp_netif;
+    esp_netif_ip_info_t ip_info;
+    bool ip_changed;
+} ip_event_got_ip_t;
+
+typedef enum {
+    IP_EVENT_STA_GOT_IP,
+    IP_EVENT_STA_LOST_IP,
+} ip_event_t;
+
+ESP_EVENT_DECLARE_BASE(IP_EVENT);
+
+//Defines
+#define ESP_NETIF_DEFAULT_WIFI_STA()    { .if_key = "WIFI_STA_DEF" }
+#define IPSTR "%d.%d.%d.%d"
+#define esp_ip4_addr1_16(ipaddr) ((uint16_t)(((ipaddr)->addr) & 0xFF))
+#define esp_ip4_addr2_16(ipaddr) ((uint16_t)((((ipaddr)->addr) >> 8) & 0xFF))
+#define esp_ip4_addr3_16(ipaddr) ((uint16_t)((((ipaddr)->addr) >> 16) & 0xFF))
+#define esp_ip4_addr4_16(ipaddr) ((uint16_t)((((ipaddr)->addr) >> 24) & 0xFF))
+#define IP2STR(ipaddr) esp_ip4_addr1_16(ipaddr), esp_ip4_addr2_16(ipaddr), esp_ip4_addr3_16(ipaddr), esp_ip4_addr4_16(ipaddr)
+
+esp_err_t esp_netif_init(void);
+esp_netif_t *esp_netif_new(const esp_netif_config_t *esp_netif_config);
+void esp_netif_destroy(esp_netif_t *esp_netif);
+esp_netif_t *esp_netif_create_default_wifi_sta(void);
@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_attr.h"
+#include "esp_idf_version.h"
+#include "sdkconfig.h"
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+    ESP_MAC_WIFI_SOFTAP,
+    ESP_MAC_BT,
+    ESP_MAC_ETH,
+} esp_mac_type_t;
+
+typedef void (*shutdown_handler_t)(void);
+
+void esp_restart(void);
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac);
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type);
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle);
+uint32_t esp_random(void);
@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "esp_attr.h"
+#include "sdkconfig.h"
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+//Defines
+#define configTICK_RATE_HZ          CONFIG_FREERTOS_HZ
+#define configMAX_PRIORITIES        25
+#define configASSERT(x)             assert(x)
+#define portMAX_DELAY               ((TickType_t) 0xffffffffUL)
+#define portTICK_PERIOD_MS          ((TickType_t) 1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS            portTICK_PERIOD_MS
+#define portNUM_PROCESSORS          2
+#define pdMS_TO_TICKS(xTimeInMs)    ((TickType_t)(((TickType_t)(xTimeInMs) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+#define pdTICKS_TO_MS(xTicks)       ((TickType_t)(((uint64_t)(xTicks) * 1000U) / configTICK_RATE_HZ))
+#define pdFALSE                     ((BaseType_t) 0)
+#define pdTRUE                      ((BaseType_t) 1)
+#define pdPASS                      (pdTRUE)
+#define pdFAIL                      (pdFALSE)
+#define errQUEUE_EMPTY              ((BaseType_t) 0)
+#define errQUEUE_FULL               ((BaseType_t) 0)
+#define tskNO_AFFINITY              0x7FFFFFFF
+#define PRIVILEGED_FUNCTION
+
+//Storage for the *CreateStatic() calls, the host port keeps its own bookkeeping and ignores it
+typedef struct xSTATIC_QUEUE {
+    void *pvDummy[10];
+} StaticQueue_t;
+
+//Critical sections: a single process-wide lock stands in for the port spinlocks
+typedef struct {
+    uint32_t owner;
+    uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { .owner = 0, .count = 0 }
+
+void vPortEnterCritical(portMUX_TYPE *mux);
+void vPortExitCritical(portMUX_TYPE *mux);
+BaseType_t xPortGetCoreID(void);
+BaseType_t xPortInIsrContext(void);
+
+#define portENTER_CRITICAL(mux)         vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux)          vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux)     vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux)      vPortExitCritical(mux)
+#define taskENTER_CRITICAL(mux)         vPortEnterCritical(mux)
+#define taskEXIT_CRITICAL(mux)          vPortExitCritical(mux)
+#define portYIELD_FROM_ISR(...)         do { } while(0)
+#define portYIELD()                     sched_yield()
+#define portNOP()                       do { } while(0)
+
+int sched_yield(void);
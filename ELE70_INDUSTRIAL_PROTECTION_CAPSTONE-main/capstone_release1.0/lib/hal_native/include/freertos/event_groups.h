@@ -0,0 +1,24 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef struct EventGroupDef_t *EventGroupHandle_t;
+typedef TickType_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+void vEventGroupDelete(EventGroupHandle_t xEventGroup);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToWaitFor,
+                                const BaseType_t xClearOnExit, const BaseType_t xWaitForAllBits,
+                                TickType_t xTicksToWait);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToClear);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t xEventGroup);
+
+//Defines
+#define xEventGroupSetBitsFromISR(xEventGroup, uxBitsToSet, pxHigherPriorityTaskWoken) \
+    ((void)(pxHigherPriorityTaskWoken), (BaseType_t)(xEventGroupSetBits((xEventGroup), (uxBitsToSet)), pdPASS))
+#define xEventGroupClearBitsFromISR(xEventGroup, uxBitsToClear) \
+    ((BaseType_t)(xEventGroupClearBits((xEventGroup), (uxBitsToClear)), pdPASS))
+
+#ifndef BIT
+#define BIT(nr) (1UL << (nr))
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+QueueHandle_t xQueueCreateMutex(void);
+QueueHandle_t xQueueCreateCountingSemaphore(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount);
+BaseType_t xQueueSemaphoreTake(QueueHandle_t xQueue, TickType_t xTicksToWait);
+
+//Defines
+#define xSemaphoreCreateMutex()             xQueueCreateMutex()
+#define xSemaphoreCreateBinary()            xQueueCreateCountingSemaphore(1, 0)
+#define xSemaphoreCreateCounting(max, init) xQueueCreateCountingSemaphore((max), (init))
+#define xSemaphoreTake(xSemaphore, xBlockTime) xQueueSemaphoreTake((xSemaphore), (xBlockTime))
+#define xSemaphoreGive(xSemaphore)          xQueueGenericSend((xSemaphore), NULL, 0, queueSEND_TO_BACK)
+#define xSemaphoreGiveFromISR(xSemaphore, pxHigherPriorityTaskWoken) \
+    ((void)(pxHigherPriorityTaskWoken), xQueueGenericSend((xSemaphore), NULL, 0, queueSEND_TO_BACK))
+#define vSemaphoreDelete(xSemaphore)        vQueueDelete((xSemaphore))
@@ -0,0 +1,9 @@
+#pragma once
+
+typedef signed char err_t;
+
+//Defines
+#define ERR_OK      0
+#define ERR_MEM     -1
+#define ERR_TIMEOUT -3
+#define ERR_VAL     -6
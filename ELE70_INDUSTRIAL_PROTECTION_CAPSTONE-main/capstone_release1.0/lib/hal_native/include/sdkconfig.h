@@ -0,0 +1,9 @@
+#pragma once
+
+//Defines (mirrors the esp32dev sdkconfig values the application depends on)
+#define CONFIG_IDF_TARGET "linux"
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_LWIP_MAX_SOCKETS 10
+#define CONFIG_LWIP_SNTP_UPDATE_DELAY 3600000
+#define CONFIG_ESP_TIMER_TASK_STACK_SIZE 3584
@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/*
+ * Simulation controls for the native build. Everything here is host-only: the firmware never
+ * calls it, the native entry point and benchmark harnesses do.
+ */
+
+//Simulated I2C target: byte-wise register access, index counts bytes since the register pointer was set
+typedef struct sim_i2c_device {
+    uint8_t addr;
+    const char *name;
+    uint8_t (*read_byte)(struct sim_i2c_device *dev, uint8_t reg, size_t index);
+    void (*write_byte)(struct sim_i2c_device *dev, uint8_t reg, size_t index, uint8_t value);
+    void *ctx;
+    bool stuck;     //Holds SDA low permanently, nothing on the bus gets through
+    bool hang;      //Latches SDA low whenever addressed, until the master clocks 9 SCL pulses
+    struct sim_i2c_device *next;
+} sim_i2c_device_t;
+
+//Enable pins
+void sim_gpio_set_level(int gpio_num, int level);
+void sim_gpio_set_output_hook(void (*hook)(int gpio_num, int level));
+
+//I2C bus
+esp_err_t sim_i2c_attach(sim_i2c_device_t *dev);
+void sim_i2c_set_stuck(uint8_t addr, bool stuck);
+void sim_i2c_set_hang(uint8_t addr, bool hang);
+uint32_t sim_i2c_transaction_count(void);
+uint32_t sim_i2c_bus_clear_count(void);
+void sim_i2c_line_write(int gpio_num, int level);   //gpio_sim -> bus, SCL/SDA driven as GPIOs
+int sim_i2c_line_level(int gpio_num);               //bus -> gpio_sim, 0 while a device holds the line
+
+//Wi-Fi station: link drops post WIFI_EVENT_STA_DISCONNECTED, restores post IP_EVENT_STA_GOT_IP
+void sim_wifi_set_link(bool up);
+
+//Sensor models (VEML7700 at 0x10, NTC ADC at 0x50)
+void sim_devices_init(void);
+void sim_light_set_lux(double lux);
+void sim_temp_set_celsius(double celsius);
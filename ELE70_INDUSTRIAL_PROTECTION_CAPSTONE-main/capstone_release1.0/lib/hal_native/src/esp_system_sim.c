@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include "esp_system.h"
+#include "esp_rom_sys.h"
+
+/*
+ * Chip services: restart exits the process, heap figures come from glibc and the base MAC can
+ * be overridden with SIM_MAC (aa:bb:cc:dd:ee:ff) to run several simulated nodes side by side.
+ */
+
+//Private Variables
+static shutdown_handler_t s_shutdown_handlers[4];
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+
+void esp_restart(void)
+{
+    for (int i = 0; i < 4; i++) {
+        if (s_shutdown_handlers[i] != NULL) {
+            s_shutdown_handlers[i]();
+        }
+    }
+    exit(0);
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    struct mallinfo2 info = mallinfo2();
+    return (uint32_t)info.fordblks;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return esp_get_free_heap_size();
+}
+
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac)
+{
+    static const uint8_t fallback[6] = { 0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01 };
+    const char *env = getenv("SIM_MAC");
+    unsigned int b[6];
+    if (mac == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (env != NULL && sscanf(env, "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) == 6) {
+        for (int i = 0; i < 6; i++) {
+            mac[i] = (uint8_t)b[i];
+        }
+    } else {
+        memcpy(mac, fallback, sizeof(fallback));
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type)
+{
+    esp_err_t ret = esp_efuse_mac_get_default(mac);
+    if (ret == ESP_OK) {
+        mac[5] += (uint8_t)type;
+    }
+    return ret;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    usleep(us);
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle)
+{
+    for (int i = 0; i < 4; i++) {
+        if (s_shutdown_handlers[i] == NULL) {
+            s_shutdown_handlers[i] = handle;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+/**
+ * @brief The hardware RNG, taken from the kernel
+ */
+uint32_t esp_random(void)
+{
+    uint32_t value = 0;
+    getrandom(&value, sizeof(value), 0);
+    return value;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        default: return "UNKNOWN ERROR";
+    }
+}
@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "esp_timer.h"
+#include "esp_log.h"
+
+/*
+ * esp_timer on CLOCK_MONOTONIC. Like the ESP_TIMER_TASK dispatch method on target, every
+ * callback runs serially on one dispatch thread, so a slow callback delays the others.
+ */
+
+//Private Types
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+    int64_t alarm;
+    uint64_t period;
+    bool armed;
+    struct esp_timer *next;
+};
+
+//Private Variables
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond;
+static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+static pthread_t s_dispatch_thread;
+static struct esp_timer *s_timers;
+static int64_t s_epoch_us;
+
+//Private Function Declarations
+static void timer_service_init(void);
+static void *timer_dispatch(void *arg);
+static int64_t monotonic_us(void);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_once(&s_once, timer_service_init);
+    struct esp_timer *t = calloc(1, sizeof(*t));
+    if (t == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    t->callback = create_args->callback;
+    t->arg = create_args->arg;
+    t->name = create_args->name;
+    pthread_mutex_lock(&s_lock);
+    t->next = s_timers;
+    s_timers = t;
+    pthread_mutex_unlock(&s_lock);
+    *out_handle = t;
+    return ESP_OK;
+}
+
+static esp_err_t timer_arm(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period)
+{
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    if (timer->armed) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->alarm = esp_timer_get_time() + (int64_t)timeout_us;
+    timer->period = period;
+    timer->armed = true;
+    pthread_cond_signal(&s_cond);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_arm(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    return timer_arm(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    esp_err_t ret = ESP_OK;
+    pthread_mutex_lock(&s_lock);
+    if (!timer->armed) {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    struct esp_timer **pp;
+    pthread_mutex_lock(&s_lock);
+    if (timer->armed) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (pp = &s_timers; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == timer) {
+            *pp = timer->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    free(timer);
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    pthread_once(&s_once, timer_service_init);
+    return monotonic_us() - s_epoch_us;
+}
+
+int64_t esp_timer_get_next_alarm(void)
+{
+    int64_t next = INT64_MAX;
+    pthread_mutex_lock(&s_lock);
+    for (struct esp_timer *t = s_timers; t != NULL; t = t->next) {
+        if (t->armed && t->alarm < next) {
+            next = t->alarm;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return next;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    bool armed;
+    pthread_mutex_lock(&s_lock);
+    armed = timer->armed;
+    pthread_mutex_unlock(&s_lock);
+    return armed;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+static void timer_service_init(void)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    s_epoch_us = monotonic_us();
+    pthread_create(&s_dispatch_thread, NULL, timer_dispatch, NULL);
+    pthread_detach(s_dispatch_thread);
+}
+
+/**
+ * @brief Dispatch thread: sleeps until the earliest armed alarm, then runs its callback unlocked
+ */
+static void *timer_dispatch(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&s_lock);
+    for (;;) {
+        struct esp_timer *due = NULL;
+        for (struct esp_timer *t = s_timers; t != NULL; t = t->next) {
+            if (t->armed && (due == NULL || t->alarm < due->alarm)) {
+                due = t;
+            }
+        }
+        if (due == NULL) {
+            pthread_cond_wait(&s_cond, &s_lock);
+            continue;
+        }
+        int64_t now = monotonic_us() - s_epoch_us;
+        if (due->alarm > now) {
+            int64_t abs_us = due->alarm + s_epoch_us;
+            struct timespec ts = {
+                .tv_sec = abs_us / 1000000,
+                .tv_nsec = (abs_us % 1000000) * 1000,
+            };
+            pthread_cond_timedwait(&s_cond, &s_lock, &ts);
+            continue;
+        }
+        if (due->period > 0) {
+            due->alarm += (int64_t)due->period;
+            if (due->alarm < now) {
+                due->alarm = now + (int64_t)due->period;
+            }
+        } else {
+            due->armed = false;
+        }
+        esp_timer_cb_t cb = due->callback;
+        void *cb_arg = due->arg;
+        pthread_mutex_unlock(&s_lock);
+        cb(cb_arg);
+        pthread_mutex_lock(&s_lock);
+    }
+    return NULL;
+}
+
+static int64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
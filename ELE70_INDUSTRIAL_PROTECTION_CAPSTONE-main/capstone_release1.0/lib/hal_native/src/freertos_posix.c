@@ -0,0 +1,658 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+/*
+ * FreeRTOS API on top of POSIX threads. Every task is a detached pthread, so both "cores" run
+ * truly in parallel like the dual-core ESP32; priorities and core affinity are recorded but not
+ * enforced. Blocking calls map onto condition variables timed against CLOCK_MONOTONIC.
+ */
+
+//Private Types
+struct tskTaskControlBlock {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    TaskFunction_t code;
+    void *param;
+    char name[16];
+    UBaseType_t priority;
+    BaseType_t core;
+    uint32_t notify_value;
+    int notify_pending;
+    int suspended;
+};
+
+struct QueueDefinition {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *storage;
+    int owns_storage;
+};
+
+struct EventGroupDef_t {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+//Private Variables
+static pthread_mutex_t s_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static __thread struct tskTaskControlBlock *s_current;
+static struct timespec s_epoch;
+static pthread_once_t s_epoch_once = PTHREAD_ONCE_INIT;
+
+//Private Function Declarations
+static void epoch_init(void);
+static void *task_trampoline(void *arg);
+static struct tskTaskControlBlock *current_task(void);
+static void deadline_from_ticks(struct timespec *ts, TickType_t ticks);
+static int wait_until(pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *deadline, TickType_t ticks);
+static void sleep_us(uint64_t us);
+static void cond_init(pthread_cond_t *cond);
+
+//****************************************************************************
+//Port
+//****************************************************************************
+
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    pthread_mutex_lock(&s_critical);
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    pthread_mutex_unlock(&s_critical);
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    struct tskTaskControlBlock *tcb = s_current;
+    return (tcb != NULL && tcb->core != tskNO_AFFINITY) ? tcb->core : 0;
+}
+
+BaseType_t xPortInIsrContext(void)
+{
+    return pdFALSE;
+}
+
+//****************************************************************************
+//Tasks
+//****************************************************************************
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+                                   void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pvCreatedTask,
+                                   BaseType_t xCoreID)
+{
+    pthread_attr_t attr;
+    struct tskTaskControlBlock *tcb = calloc(1, sizeof(*tcb));
+    if (tcb == NULL) {
+        return pdFAIL;
+    }
+    pthread_once(&s_epoch_once, epoch_init);
+    pthread_mutex_init(&tcb->lock, NULL);
+    cond_init(&tcb->cond);
+    tcb->code = pvTaskCode;
+    tcb->param = pvParameters;
+    tcb->priority = uxPriority;
+    tcb->core = xCoreID;
+    snprintf(tcb->name, sizeof(tcb->name), "%s", pcName ? pcName : "");
+    if (pvCreatedTask != NULL) {
+        *pvCreatedTask = tcb;
+    }
+
+    //Host stacks are far larger than the ESP32 budgets, keep glibc's default floor
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (usStackDepth < 65536) {
+        usStackDepth = 65536;
+    }
+    pthread_attr_setstacksize(&attr, usStackDepth);
+    if (pthread_create(&tcb->thread, &attr, task_trampoline, tcb) != 0) {
+        pthread_attr_destroy(&attr);
+        free(tcb);
+        return pdFAIL;
+    }
+    pthread_attr_destroy(&attr);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+                       void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pvCreatedTask)
+{
+    return xTaskCreatePinnedToCore(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority,
+                                   pvCreatedTask, tskNO_AFFINITY);
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t pvTaskCode, const char *pcName, uint32_t ulStackDepth,
+                                           void *pvParameters, UBaseType_t uxPriority, StackType_t *pxStackBuffer,
+                                           void *pxTaskBuffer, BaseType_t xCoreID)
+{
+    TaskHandle_t handle = NULL;
+    (void)pxStackBuffer;
+    (void)pxTaskBuffer;
+    xTaskCreatePinnedToCore(pvTaskCode, pcName, ulStackDepth * sizeof(StackType_t), pvParameters,
+                            uxPriority, &handle, xCoreID);
+    return handle;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    if (xTaskToDelete == NULL || xTaskToDelete == s_current) {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(xTaskToDelete->thread);
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+    struct tskTaskControlBlock *tcb = current_task();
+    sleep_us((uint64_t)xTicksToDelay * 1000000ULL / configTICK_RATE_HZ);
+
+    //Suspension requested from another task takes effect at the next blocking call
+    pthread_mutex_lock(&tcb->lock);
+    while (tcb->suspended) {
+        pthread_cond_wait(&tcb->cond, &tcb->lock);
+    }
+    pthread_mutex_unlock(&tcb->lock);
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *pxPreviousWakeTime, TickType_t xTimeIncrement)
+{
+    TickType_t now = xTaskGetTickCount();
+    TickType_t wake = *pxPreviousWakeTime + xTimeIncrement;
+    BaseType_t delayed = pdFALSE;
+
+    if ((int32_t)(wake - now) > 0) {
+        vTaskDelay(wake - now);
+        delayed = pdTRUE;
+    }
+    *pxPreviousWakeTime = wake;
+    return delayed;
+}
+
+void vTaskDelayUntil(TickType_t *pxPreviousWakeTime, TickType_t xTimeIncrement)
+{
+    (void)xTaskDelayUntil(pxPreviousWakeTime, xTimeIncrement);
+}
+
+void vTaskSuspend(TaskHandle_t xTaskToSuspend)
+{
+    struct tskTaskControlBlock *tcb = xTaskToSuspend ? xTaskToSuspend : current_task();
+    pthread_mutex_lock(&tcb->lock);
+    tcb->suspended = 1;
+    if (tcb == s_current) {
+        while (tcb->suspended) {
+            pthread_cond_wait(&tcb->cond, &tcb->lock);
+        }
+    }
+    pthread_mutex_unlock(&tcb->lock);
+}
+
+void vTaskResume(TaskHandle_t xTaskToResume)
+{
+    if (xTaskToResume == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&xTaskToResume->lock);
+    xTaskToResume->suspended = 0;
+    pthread_cond_broadcast(&xTaskToResume->cond);
+    pthread_mutex_unlock(&xTaskToResume->lock);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec now;
+    pthread_once(&s_epoch_once, epoch_init);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t us = (int64_t)(now.tv_sec - s_epoch.tv_sec) * 1000000LL
+               + ((int64_t)now.tv_nsec - s_epoch.tv_nsec) / 1000;
+    return (TickType_t)((uint64_t)us * configTICK_RATE_HZ / 1000000ULL);
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return xTaskGetTickCount();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current_task();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask)
+{
+    (void)xTask;
+    return 0;
+}
+
+char *pcTaskGetName(TaskHandle_t xTaskToQuery)
+{
+    struct tskTaskControlBlock *tcb = xTaskToQuery ? xTaskToQuery : current_task();
+    return tcb->name;
+}
+
+//****************************************************************************
+//Task notifications
+//****************************************************************************
+
+BaseType_t xTaskGenericNotify(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction,
+                              uint32_t *pulPreviousNotificationValue)
+{
+    BaseType_t ret = pdPASS;
+    if (xTaskToNotify == NULL) {
+        return pdFAIL;
+    }
+    pthread_mutex_lock(&xTaskToNotify->lock);
+    if (pulPreviousNotificationValue != NULL) {
+        *pulPreviousNotificationValue = xTaskToNotify->notify_value;
+    }
+    switch (eAction) {
+        case eSetBits:
+            xTaskToNotify->notify_value |= ulValue;
+            break;
+        case eIncrement:
+            xTaskToNotify->notify_value++;
+            break;
+        case eSetValueWithOverwrite:
+            xTaskToNotify->notify_value = ulValue;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (xTaskToNotify->notify_pending) {
+                ret = pdFAIL;
+            } else {
+                xTaskToNotify->notify_value = ulValue;
+            }
+            break;
+        default:
+            break;
+    }
+    xTaskToNotify->notify_pending = 1;
+    pthread_cond_broadcast(&xTaskToNotify->cond);
+    pthread_mutex_unlock(&xTaskToNotify->lock);
+    return ret;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit,
+                           uint32_t *pulNotificationValue, TickType_t xTicksToWait)
+{
+    struct tskTaskControlBlock *tcb = current_task();
+    struct timespec deadline;
+    BaseType_t ret = pdFALSE;
+
+    deadline_from_ticks(&deadline, xTicksToWait);
+    pthread_mutex_lock(&tcb->lock);
+    if (!tcb->notify_pending) {
+        tcb->notify_value &= ~ulBitsToClearOnEntry;
+    }
+    while (!tcb->notify_pending) {
+        if (wait_until(&tcb->cond, &tcb->lock, &deadline, xTicksToWait) != 0) {
+            break;
+        }
+    }
+    if (pulNotificationValue != NULL) {
+        *pulNotificationValue = tcb->notify_value;
+    }
+    if (tcb->notify_pending) {
+        tcb->notify_value &= ~ulBitsToClearOnExit;
+        tcb->notify_pending = 0;
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&tcb->lock);
+    return ret;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+    struct tskTaskControlBlock *tcb = current_task();
+    struct timespec deadline;
+    uint32_t value;
+
+    deadline_from_ticks(&deadline, xTicksToWait);
+    pthread_mutex_lock(&tcb->lock);
+    while (tcb->notify_value == 0) {
+        if (wait_until(&tcb->cond, &tcb->lock, &deadline, xTicksToWait) != 0) {
+            break;
+        }
+    }
+    value = tcb->notify_value;
+    if (value != 0) {
+        tcb->notify_value = xClearCountOnExit ? 0 : value - 1;
+    }
+    tcb->notify_pending = 0;
+    pthread_mutex_unlock(&tcb->lock);
+    return value;
+}
+
+//****************************************************************************
+//Queues and semaphores
+//****************************************************************************
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    struct QueueDefinition *q = calloc(1, sizeof(*q));
+    if (q == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    cond_init(&q->not_empty);
+    cond_init(&q->not_full);
+    q->length = uxQueueLength;
+    q->item_size = uxItemSize;
+    if (uxItemSize > 0) {
+        q->storage = calloc(uxQueueLength, uxItemSize);
+        q->owns_storage = 1;
+    }
+    return q;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t uxQueueLength, UBaseType_t uxItemSize,
+                                 uint8_t *pucQueueStorageBuffer, StaticQueue_t *pxQueueBuffer)
+{
+    struct QueueDefinition *q = xQueueCreate(uxQueueLength, 0);
+    (void)pxQueueBuffer;
+    if (q != NULL) {
+        q->item_size = uxItemSize;
+        q->storage = pucQueueStorageBuffer;
+    }
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    if (xQueue == NULL) {
+        return;
+    }
+    if (xQueue->owns_storage) {
+        free(xQueue->storage);
+    }
+    free(xQueue);
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait, BaseType_t xCopyPosition)
+{
+    struct timespec deadline;
+    UBaseType_t slot;
+
+    deadline_from_ticks(&deadline, xTicksToWait);
+    pthread_mutex_lock(&xQueue->lock);
+    while (xQueue->count == xQueue->length) {
+        if (wait_until(&xQueue->not_full, &xQueue->lock, &deadline, xTicksToWait) != 0) {
+            pthread_mutex_unlock(&xQueue->lock);
+            return errQUEUE_FULL;
+        }
+    }
+    if (xCopyPosition == queueSEND_TO_FRONT) {
+        xQueue->head = (xQueue->head + xQueue->length - 1) % xQueue->length;
+        slot = xQueue->head;
+    } else {
+        slot = (xQueue->head + xQueue->count) % xQueue->length;
+    }
+    if (xQueue->item_size > 0 && pvItemToQueue != NULL) {
+        memcpy(xQueue->storage + slot * xQueue->item_size, pvItemToQueue, xQueue->item_size);
+    }
+    xQueue->count++;
+    pthread_cond_signal(&xQueue->not_empty);
+    pthread_mutex_unlock(&xQueue->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t xQueue, const void *pvItemToQueue)
+{
+    pthread_mutex_lock(&xQueue->lock);
+    xQueue->count = 0;
+    xQueue->head = 0;
+    pthread_mutex_unlock(&xQueue->lock);
+    return xQueueGenericSend(xQueue, pvItemToQueue, 0, queueSEND_TO_BACK);
+}
+
+static BaseType_t queue_take(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait, int peek)
+{
+    struct timespec deadline;
+
+    deadline_from_ticks(&deadline, xTicksToWait);
+    pthread_mutex_lock(&xQueue->lock);
+    while (xQueue->count == 0) {
+        if (wait_until(&xQueue->not_empty, &xQueue->lock, &deadline, xTicksToWait) != 0) {
+            pthread_mutex_unlock(&xQueue->lock);
+            return errQUEUE_EMPTY;
+        }
+    }
+    if (xQueue->item_size > 0 && pvBuffer != NULL) {
+        memcpy(pvBuffer, xQueue->storage + xQueue->head * xQueue->item_size, xQueue->item_size);
+    }
+    if (!peek) {
+        xQueue->head = (xQueue->head + 1) % xQueue->length;
+        xQueue->count--;
+        pthread_cond_signal(&xQueue->not_full);
+    }
+    pthread_mutex_unlock(&xQueue->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    return queue_take(xQueue, pvBuffer, xTicksToWait, 0);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    return queue_take(xQueue, pvBuffer, xTicksToWait, 1);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+    UBaseType_t count;
+    pthread_mutex_lock(&xQueue->lock);
+    count = xQueue->count;
+    pthread_mutex_unlock(&xQueue->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t xQueue)
+{
+    return xQueue->length - uxQueueMessagesWaiting(xQueue);
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue)
+{
+    pthread_mutex_lock(&xQueue->lock);
+    xQueue->count = 0;
+    xQueue->head = 0;
+    pthread_cond_broadcast(&xQueue->not_full);
+    pthread_mutex_unlock(&xQueue->lock);
+    return pdPASS;
+}
+
+QueueHandle_t xQueueCreateMutex(void)
+{
+    return xQueueCreateCountingSemaphore(1, 1);
+}
+
+QueueHandle_t xQueueCreateCountingSemaphore(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount)
+{
+    struct QueueDefinition *q = xQueueCreate(uxMaxCount, 0);
+    if (q != NULL) {
+        q->count = uxInitialCount;
+    }
+    return q;
+}
+
+BaseType_t xQueueSemaphoreTake(QueueHandle_t xQueue, TickType_t xTicksToWait)
+{
+    return queue_take(xQueue, NULL, xTicksToWait, 0);
+}
+
+//****************************************************************************
+//Event groups
+//****************************************************************************
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct EventGroupDef_t *eg = calloc(1, sizeof(*eg));
+    if (eg != NULL) {
+        pthread_mutex_init(&eg->lock, NULL);
+        cond_init(&eg->cond);
+    }
+    return eg;
+}
+
+void vEventGroupDelete(EventGroupHandle_t xEventGroup)
+{
+    free(xEventGroup);
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToWaitFor,
+                                const BaseType_t xClearOnExit, const BaseType_t xWaitForAllBits,
+                                TickType_t xTicksToWait)
+{
+    struct timespec deadline;
+    EventBits_t bits;
+
+    deadline_from_ticks(&deadline, xTicksToWait);
+    pthread_mutex_lock(&xEventGroup->lock);
+    for (;;) {
+        bits = xEventGroup->bits;
+        int satisfied = xWaitForAllBits ? ((bits & uxBitsToWaitFor) == uxBitsToWaitFor)
+                                        : ((bits & uxBitsToWaitFor) != 0);
+        if (satisfied) {
+            if (xClearOnExit) {
+                xEventGroup->bits &= ~uxBitsToWaitFor;
+            }
+            break;
+        }
+        if (wait_until(&xEventGroup->cond, &xEventGroup->lock, &deadline, xTicksToWait) != 0) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet)
+{
+    EventBits_t bits;
+    pthread_mutex_lock(&xEventGroup->lock);
+    xEventGroup->bits |= uxBitsToSet;
+    bits = xEventGroup->bits;
+    pthread_cond_broadcast(&xEventGroup->cond);
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToClear)
+{
+    EventBits_t bits;
+    pthread_mutex_lock(&xEventGroup->lock);
+    bits = xEventGroup->bits;
+    xEventGroup->bits &= ~uxBitsToClear;
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t xEventGroup)
+{
+    EventBits_t bits;
+    pthread_mutex_lock(&xEventGroup->lock);
+    bits = xEventGroup->bits;
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+static void epoch_init(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &s_epoch);
+}
+
+static void *task_trampoline(void *arg)
+{
+    struct tskTaskControlBlock *tcb = arg;
+    s_current = tcb;
+    tcb->code(tcb->param);
+    return NULL;
+}
+
+/**
+ * @brief Returns the calling task, adopting foreign threads (main, timer dispatch) on first use
+ */
+static struct tskTaskControlBlock *current_task(void)
+{
+    if (s_current == NULL) {
+        struct tskTaskControlBlock *tcb = calloc(1, sizeof(*tcb));
+        pthread_mutex_init(&tcb->lock, NULL);
+        cond_init(&tcb->cond);
+        tcb->thread = pthread_self();
+        tcb->core = tskNO_AFFINITY;
+        snprintf(tcb->name, sizeof(tcb->name), "native");
+        s_current = tcb;
+    }
+    return s_current;
+}
+
+static void deadline_from_ticks(struct timespec *ts, TickType_t ticks)
+{
+    uint64_t ns;
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    if (ticks == portMAX_DELAY) {
+        return;
+    }
+    ns = (uint64_t)ticks * (1000000000ULL / configTICK_RATE_HZ) + (uint64_t)ts->tv_nsec;
+    ts->tv_sec += ns / 1000000000ULL;
+    ts->tv_nsec = ns % 1000000000ULL;
+}
+
+/**
+ * @brief Initializes a condition variable timed against CLOCK_MONOTONIC
+ */
+static void cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/**
+ * @brief Waits on a condition variable until the deadline; returns non-zero on timeout
+ */
+static int wait_until(pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *deadline, TickType_t ticks)
+{
+    if (ticks == 0) {
+        return ETIMEDOUT;
+    }
+    if (ticks == portMAX_DELAY) {
+        return pthread_cond_wait(cond, lock);
+    }
+    return pthread_cond_timedwait(cond, lock, deadline) == ETIMEDOUT ? ETIMEDOUT : 0;
+}
+
+static void sleep_us(uint64_t us)
+{
+    struct timespec ts = {
+        .tv_sec = us / 1000000ULL,
+        .tv_nsec = (us % 1000000ULL) * 1000ULL,
+    };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
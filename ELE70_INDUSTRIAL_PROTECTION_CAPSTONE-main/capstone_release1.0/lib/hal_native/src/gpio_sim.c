@@ -0,0 +1,224 @@
+#include <string.h>
+#include <pthread.h>
+#include "driver/gpio.h"
+#include "sim.h"
+
+/*
+ * Simulated GPIO matrix. Inputs are driven by sim_gpio_set_level(), which runs the registered
+ * ISR inline on the calling thread when the configured edge matches. The I2C pins are wired
+ * through to the simulated bus so a manual bus clear can be bit-banged on them.
+ */
+
+//Private Types
+typedef struct {
+    int level;
+    gpio_mode_t mode;
+    gpio_int_type_t intr_type;
+    bool intr_enabled;
+    gpio_isr_t isr;
+    void *isr_arg;
+} sim_pin_t;
+
+//Private Variables
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_pin_t s_pins[GPIO_NUM_MAX];
+static bool s_isr_service;
+static void (*s_output_hook)(int gpio_num, int level);
+
+//Private Function Declarations
+static bool pin_valid(gpio_num_t gpio_num);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+
+esp_err_t gpio_config(const gpio_config_t *pGPIOConfig)
+{
+    for (int pin = 0; pin < GPIO_NUM_MAX; pin++) {
+        if (pGPIOConfig->pin_bit_mask & (1ULL << pin)) {
+            gpio_set_direction(pin, pGPIOConfig->mode);
+            gpio_set_intr_type(pin, pGPIOConfig->intr_type);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    if (!pin_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    s_pins[gpio_num].mode = GPIO_MODE_DISABLE;
+    s_pins[gpio_num].intr_type = GPIO_INTR_DISABLE;
+    s_pins[gpio_num].intr_enabled = false;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    if (!pin_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull)
+{
+    (void)pull;
+    return pin_valid(gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (!pin_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].intr_type = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num)
+{
+    if (!pin_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].intr_enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num)
+{
+    if (!pin_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].intr_enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    (void)intr_alloc_flags;
+    if (s_isr_service) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_isr_service = true;
+    return ESP_OK;
+}
+
+void gpio_uninstall_isr_service(void)
+{
+    s_isr_service = false;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (!pin_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_isr_service) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pthread_mutex_lock(&s_lock);
+    s_pins[gpio_num].isr = isr_handler;
+    s_pins[gpio_num].isr_arg = args;
+    s_pins[gpio_num].intr_enabled = true;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if (!pin_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    s_pins[gpio_num].isr = NULL;
+    s_pins[gpio_num].isr_arg = NULL;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    void (*hook)(int, int);
+    if (!pin_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    s_pins[gpio_num].level = level ? 1 : 0;
+    hook = s_output_hook;
+    pthread_mutex_unlock(&s_lock);
+    sim_i2c_line_write(gpio_num, level ? 1 : 0);
+    if (hook != NULL) {
+        hook(gpio_num, level ? 1 : 0);
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    int level;
+    if (!pin_valid(gpio_num)) {
+        return 0;
+    }
+    pthread_mutex_lock(&s_lock);
+    level = s_pins[gpio_num].level;
+    pthread_mutex_unlock(&s_lock);
+    return level & sim_i2c_line_level(gpio_num);
+}
+
+//****************************************************************************
+//Simulation controls
+//****************************************************************************
+
+/**
+ * @brief Drives an input pin as external hardware would, firing its ISR on a matching edge
+ */
+void sim_gpio_set_level(int gpio_num, int level)
+{
+    gpio_isr_t isr = NULL;
+    void *arg = NULL;
+    if (!pin_valid(gpio_num)) {
+        return;
+    }
+    level = level ? 1 : 0;
+    pthread_mutex_lock(&s_lock);
+    sim_pin_t *pin = &s_pins[gpio_num];
+    int previous = pin->level;
+    pin->level = level;
+    if (pin->intr_enabled && pin->isr != NULL && s_isr_service) {
+        bool rising = (previous == 0 && level == 1);
+        bool falling = (previous == 1 && level == 0);
+        if ((pin->intr_type == GPIO_INTR_POSEDGE && rising) ||
+            (pin->intr_type == GPIO_INTR_NEGEDGE && falling) ||
+            (pin->intr_type == GPIO_INTR_ANYEDGE && (rising || falling)) ||
+            (pin->intr_type == GPIO_INTR_HIGH_LEVEL && level == 1) ||
+            (pin->intr_type == GPIO_INTR_LOW_LEVEL && level == 0)) {
+            isr = pin->isr;
+            arg = pin->isr_arg;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    if (isr != NULL) {
+        isr(arg);
+    }
+}
+
+void sim_gpio_set_output_hook(void (*hook)(int gpio_num, int level))
+{
+    pthread_mutex_lock(&s_lock);
+    s_output_hook = hook;
+    pthread_mutex_unlock(&s_lock);
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+static bool pin_valid(gpio_num_t gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
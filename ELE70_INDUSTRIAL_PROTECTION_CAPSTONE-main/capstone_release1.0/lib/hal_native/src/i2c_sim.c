@@ -0,0 +1,405 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "driver/i2c.h"
+#include "freertos/task.h"
+#include "sim.h"
+
+/*
+ * Simulated I2C master. Command links record the same start/write/read/stop sequence the
+ * ESP-IDF driver would queue; i2c_master_cmd_begin() replays it against the attached models.
+ * A device marked stuck holds SDA low, so every transaction on the bus times out. A device marked
+ * hang does the same once it is addressed, and lets go after 9 SCL pulses bit-banged on the pin
+ * given to i2c_param_config(), the standard bus clear.
+ */
+
+//Private Types
+typedef enum {
+    OP_START,
+    OP_WRITE_BYTE,
+    OP_WRITE,
+    OP_READ,
+    OP_STOP,
+} op_type_t;
+
+typedef struct {
+    op_type_t type;
+    uint8_t byte;
+    bool ack_en;
+    i2c_ack_type_t ack;
+    const uint8_t *wr;
+    uint8_t *rd;
+    size_t len;
+} i2c_op_t;
+
+typedef struct {
+    i2c_op_t *ops;
+    size_t count;
+    size_t capacity;
+    bool is_static;
+} i2c_link_t;
+
+//Private Variables
+static pthread_mutex_t s_bus_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_i2c_device_t *s_devices;
+static bool s_installed[I2C_NUM_MAX];
+static int s_sda_io[I2C_NUM_MAX] = { -1, -1 };
+static int s_scl_io[I2C_NUM_MAX] = { -1, -1 };
+static uint32_t s_transactions;
+static bool s_latched;          //A hung device is holding SDA low
+static int s_scl_level = 1;
+static int s_clear_pulses;
+static uint32_t s_bus_clears;
+
+//Private Function Declarations
+static esp_err_t link_push(i2c_cmd_handle_t cmd_handle, const i2c_op_t *op);
+static sim_i2c_device_t *device_find(uint8_t addr);
+static bool bus_stuck(void);
+static bool pin_is(const int *pins, int gpio_num);
+static esp_err_t bus_write(sim_i2c_device_t *dev, bool *have_reg, uint8_t *reg, size_t *index, uint8_t value);
+
+//****************************************************************************
+//Driver
+//****************************************************************************
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf)
+{
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX || i2c_conf == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_bus_lock);
+    s_sda_io[i2c_num] = i2c_conf->sda_io_num;
+    s_scl_io[i2c_num] = i2c_conf->scl_io_num;
+    pthread_mutex_unlock(&s_bus_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags)
+{
+    (void)mode;
+    (void)slv_rx_buf_len;
+    (void)slv_tx_buf_len;
+    (void)intr_alloc_flags;
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_installed[i2c_num]) {
+        return ESP_FAIL;
+    }
+    s_installed[i2c_num] = true;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num)
+{
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX || !s_installed[i2c_num]) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_installed[i2c_num] = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_set_timeout(i2c_port_t i2c_num, int timeout)
+{
+    (void)timeout;
+    return (i2c_num >= 0 && i2c_num < I2C_NUM_MAX) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+//****************************************************************************
+//Command links
+//****************************************************************************
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    return calloc(1, sizeof(i2c_link_t));
+}
+
+/**
+ * @brief Lays the link out in the caller's buffer. The firmware only aligns it for the 32-bit
+ *  target, so the start is rounded up to what the host's pointers need
+ */
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size)
+{
+    size_t skip = buffer != NULL ? (size_t)(-(uintptr_t)buffer & (_Alignof(i2c_link_t) - 1)) : 0;
+    if (buffer == NULL || size < skip + sizeof(i2c_link_t) + sizeof(i2c_op_t)) {
+        return NULL;
+    }
+    buffer += skip;
+    size -= skip;
+    i2c_link_t *link = (i2c_link_t *)buffer;
+    memset(link, 0, sizeof(*link));
+    link->ops = (i2c_op_t *)(buffer + sizeof(i2c_link_t));
+    link->capacity = (size - sizeof(i2c_link_t)) / sizeof(i2c_op_t);
+    link->is_static = true;
+    return link;
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle)
+{
+    i2c_link_t *link = cmd_handle;
+    if (link == NULL || link->is_static) {
+        return;
+    }
+    free(link->ops);
+    free(link);
+}
+
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd_handle)
+{
+    (void)cmd_handle;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle)
+{
+    i2c_op_t op = { .type = OP_START };
+    return link_push(cmd_handle, &op);
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en)
+{
+    i2c_op_t op = { .type = OP_WRITE_BYTE, .byte = data, .ack_en = ack_en, .len = 1 };
+    return link_push(cmd_handle, &op);
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en)
+{
+    i2c_op_t op = { .type = OP_WRITE, .wr = data, .ack_en = ack_en, .len = data_len };
+    return link_push(cmd_handle, &op);
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, i2c_ack_type_t ack)
+{
+    i2c_op_t op = { .type = OP_READ, .rd = data, .ack = ack, .len = 1 };
+    return link_push(cmd_handle, &op);
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, i2c_ack_type_t ack)
+{
+    i2c_op_t op = { .type = OP_READ, .rd = data, .ack = ack, .len = data_len };
+    return link_push(cmd_handle, &op);
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle)
+{
+    i2c_op_t op = { .type = OP_STOP };
+    return link_push(cmd_handle, &op);
+}
+
+/**
+ * @brief Replays a command link against the simulated bus. Addressing a missing device with
+ * ack checking enabled fails like a NACK; a stuck bus burns the whole timeout.
+ */
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait)
+{
+    i2c_link_t *link = cmd_handle;
+    sim_i2c_device_t *dev = NULL;
+    bool expect_addr = false, reading = false, have_reg = false;
+    uint8_t reg = 0;
+    size_t index = 0;
+    esp_err_t ret = ESP_OK;
+
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX || link == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_installed[i2c_num]) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    pthread_mutex_lock(&s_bus_lock);
+    s_transactions++;
+    if (bus_stuck() || s_latched) {
+        pthread_mutex_unlock(&s_bus_lock);
+        vTaskDelay(ticks_to_wait == portMAX_DELAY ? pdMS_TO_TICKS(1000) : ticks_to_wait);
+        return ESP_ERR_TIMEOUT;
+    }
+    for (size_t i = 0; i < link->count && ret == ESP_OK; i++) {
+        const i2c_op_t *op = &link->ops[i];
+        switch (op->type) {
+            case OP_START:
+                expect_addr = true;
+                index = 0;
+                break;
+            case OP_WRITE_BYTE:
+            case OP_WRITE:
+                for (size_t b = 0; b < op->len && ret == ESP_OK; b++) {
+                    uint8_t value = (op->type == OP_WRITE_BYTE) ? op->byte : op->wr[b];
+                    if (expect_addr) {
+                        expect_addr = false;
+                        dev = device_find(value >> 1);
+                        reading = (value & 1) == I2C_MASTER_READ;
+                        if (!reading) {
+                            have_reg = false;
+                        }
+                        if (dev == NULL && op->ack_en) {
+                            ret = ESP_FAIL;
+                        } else if (dev != NULL && dev->hang) {
+                            s_latched = true;
+                            s_clear_pulses = 0;
+                            ret = ESP_ERR_TIMEOUT;
+                        }
+                    } else if (dev != NULL && !reading) {
+                        ret = bus_write(dev, &have_reg, &reg, &index, value);
+                    }
+                }
+                break;
+            case OP_READ:
+                for (size_t b = 0; b < op->len; b++) {
+                    op->rd[b] = (dev != NULL && reading) ? dev->read_byte(dev, reg, index++) : 0xFF;
+                }
+                break;
+            case OP_STOP:
+                dev = NULL;
+                break;
+        }
+    }
+    pthread_mutex_unlock(&s_bus_lock);
+    if (ret == ESP_ERR_TIMEOUT) {
+        vTaskDelay(ticks_to_wait == portMAX_DELAY ? pdMS_TO_TICKS(1000) : ticks_to_wait);
+    }
+    return ret;
+}
+
+//****************************************************************************
+//Simulation controls
+//****************************************************************************
+
+esp_err_t sim_i2c_attach(sim_i2c_device_t *dev)
+{
+    if (dev == NULL || dev->read_byte == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_bus_lock);
+    dev->next = s_devices;
+    s_devices = dev;
+    pthread_mutex_unlock(&s_bus_lock);
+    return ESP_OK;
+}
+
+void sim_i2c_set_stuck(uint8_t addr, bool stuck)
+{
+    pthread_mutex_lock(&s_bus_lock);
+    sim_i2c_device_t *dev = device_find(addr);
+    if (dev != NULL) {
+        dev->stuck = stuck;
+    }
+    pthread_mutex_unlock(&s_bus_lock);
+}
+
+void sim_i2c_set_hang(uint8_t addr, bool hang)
+{
+    pthread_mutex_lock(&s_bus_lock);
+    sim_i2c_device_t *dev = device_find(addr);
+    if (dev != NULL) {
+        dev->hang = hang;
+    }
+    pthread_mutex_unlock(&s_bus_lock);
+}
+
+uint32_t sim_i2c_transaction_count(void)
+{
+    return s_transactions;
+}
+
+uint32_t sim_i2c_bus_clear_count(void)
+{
+    return s_bus_clears;
+}
+
+/**
+ * @brief Counts SCL rising edges while a hung device holds SDA, the 9th releases it
+ */
+void sim_i2c_line_write(int gpio_num, int level)
+{
+    pthread_mutex_lock(&s_bus_lock);
+    if (pin_is(s_scl_io, gpio_num)) {
+        if (s_latched && s_scl_level == 0 && level == 1 && ++s_clear_pulses >= 9) {
+            s_latched = false;
+            s_bus_clears++;
+        }
+        s_scl_level = level;
+    }
+    pthread_mutex_unlock(&s_bus_lock);
+}
+
+int sim_i2c_line_level(int gpio_num)
+{
+    int level = 1;
+    pthread_mutex_lock(&s_bus_lock);
+    if (pin_is(s_sda_io, gpio_num) && (s_latched || bus_stuck())) {
+        level = 0;
+    }
+    pthread_mutex_unlock(&s_bus_lock);
+    return level;
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+static esp_err_t link_push(i2c_cmd_handle_t cmd_handle, const i2c_op_t *op)
+{
+    i2c_link_t *link = cmd_handle;
+    if (link == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (link->count == link->capacity) {
+        if (link->is_static) {
+            return ESP_ERR_NO_MEM;
+        }
+        size_t capacity = link->capacity ? link->capacity * 2 : 8;
+        i2c_op_t *ops = realloc(link->ops, capacity * sizeof(*ops));
+        if (ops == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        link->ops = ops;
+        link->capacity = capacity;
+    }
+    link->ops[link->count++] = *op;
+    return ESP_OK;
+}
+
+static sim_i2c_device_t *device_find(uint8_t addr)
+{
+    for (sim_i2c_device_t *dev = s_devices; dev != NULL; dev = dev->next) {
+        if (dev->addr == addr) {
+            return dev;
+        }
+    }
+    return NULL;
+}
+
+static bool bus_stuck(void)
+{
+    for (sim_i2c_device_t *dev = s_devices; dev != NULL; dev = dev->next) {
+        if (dev->stuck) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool pin_is(const int *pins, int gpio_num)
+{
+    for (int i = 0; i < I2C_NUM_MAX; i++) {
+        if (pins[i] >= 0 && pins[i] == gpio_num) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief First byte after a write address selects the register, following bytes are data
+ */
+static esp_err_t bus_write(sim_i2c_device_t *dev, bool *have_reg, uint8_t *reg, size_t *index, uint8_t value)
+{
+    if (!*have_reg) {
+        *reg = value;
+        *have_reg = true;
+        *index = 0;
+    } else if (dev->write_byte != NULL) {
+        dev->write_byte(dev, *reg, (*index)++, value);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "nvs_flash.h"
+#include "nvs.h"
+
+/*
+ * Key/value NVS held in RAM. When SIM_NVS_FILE is set the store is loaded at nvs_flash_init()
+ * and rewritten on every nvs_commit(), so settings survive a restart of the native binary.
+ */
+
+//Defines
+#define NVS_KEY_MAX         16
+#define NVS_ENTRIES_MAX     128
+#define NVS_HANDLES_MAX     16
+
+//Private Types
+typedef struct {
+    char ns[NVS_KEY_MAX];
+    char key[NVS_KEY_MAX];
+    uint32_t length;
+    uint8_t *value;
+} nvs_entry_t;
+
+typedef struct {
+    char ns[NVS_KEY_MAX];
+    nvs_open_mode_t mode;
+    int used;
+} nvs_open_t;
+
+//Private Variables
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static nvs_entry_t s_entries[NVS_ENTRIES_MAX];
+static nvs_open_t s_handles[NVS_HANDLES_MAX];
+
+//Private Function Declarations
+static nvs_entry_t *entry_find(const char *ns, const char *key, int create);
+static esp_err_t entry_set(nvs_handle_t handle, const char *key, const void *value, size_t length);
+static esp_err_t entry_get(nvs_handle_t handle, const char *key, void *out, size_t *length, int exact);
+static void store_load(void);
+static void store_save(void);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+
+esp_err_t nvs_flash_init(void)
+{
+    store_load();
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < NVS_ENTRIES_MAX; i++) {
+        free(s_entries[i].value);
+    }
+    memset(s_entries, 0, sizeof(s_entries));
+    pthread_mutex_unlock(&s_lock);
+    store_save();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (name == NULL || strlen(name) >= NVS_KEY_MAX || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < NVS_HANDLES_MAX; i++) {
+        if (!s_handles[i].used) {
+            snprintf(s_handles[i].ns, NVS_KEY_MAX, "%s", name);
+            s_handles[i].mode = open_mode;
+            s_handles[i].used = 1;
+            *out_handle = (nvs_handle_t)(i + 1);
+            pthread_mutex_unlock(&s_lock);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    if (handle >= 1 && handle <= NVS_HANDLES_MAX) {
+        s_handles[handle - 1].used = 0;
+    }
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    store_save();
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    if (handle < 1 || handle > NVS_HANDLES_MAX || !s_handles[handle - 1].used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    nvs_entry_t *entry = entry_find(s_handles[handle - 1].ns, key, 0);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    free(entry->value);
+    memset(entry, 0, sizeof(*entry));
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return entry_set(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+    size_t length = sizeof(*out_value);
+    return entry_get(handle, key, out_value, &length, 1);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return entry_set(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    size_t length = sizeof(*out_value);
+    return entry_get(handle, key, out_value, &length, 1);
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char *key, int32_t value)
+{
+    return entry_set(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char *key, int32_t *out_value)
+{
+    size_t length = sizeof(*out_value);
+    return entry_get(handle, key, out_value, &length, 1);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return entry_set(handle, key, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return entry_get(handle, key, out_value, length, 0);
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+static nvs_entry_t *entry_find(const char *ns, const char *key, int create)
+{
+    nvs_entry_t *free_slot = NULL;
+    for (int i = 0; i < NVS_ENTRIES_MAX; i++) {
+        nvs_entry_t *entry = &s_entries[i];
+        if (entry->key[0] == '\0') {
+            if (free_slot == NULL) {
+                free_slot = entry;
+            }
+        } else if (strcmp(entry->ns, ns) == 0 && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+    }
+    if (create && free_slot != NULL) {
+        snprintf(free_slot->ns, NVS_KEY_MAX, "%s", ns);
+        snprintf(free_slot->key, NVS_KEY_MAX, "%s", key);
+        return free_slot;
+    }
+    return NULL;
+}
+
+static esp_err_t entry_set(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    if (handle < 1 || handle > NVS_HANDLES_MAX || !s_handles[handle - 1].used ||
+        key == NULL || strlen(key) >= NVS_KEY_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_handles[handle - 1].mode == NVS_READONLY) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint8_t *copy = malloc(length ? length : 1);
+    if (copy == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, value, length);
+    pthread_mutex_lock(&s_lock);
+    nvs_entry_t *entry = entry_find(s_handles[handle - 1].ns, key, 1);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&s_lock);
+        free(copy);
+        return ESP_ERR_NVS_NO_FREE_PAGES;
+    }
+    free(entry->value);
+    entry->value = copy;
+    entry->length = (uint32_t)length;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+static esp_err_t entry_get(nvs_handle_t handle, const char *key, void *out, size_t *length, int exact)
+{
+    esp_err_t ret = ESP_OK;
+    if (handle < 1 || handle > NVS_HANDLES_MAX || !s_handles[handle - 1].used || key == NULL || length == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    nvs_entry_t *entry = entry_find(s_handles[handle - 1].ns, key, 0);
+    if (entry == NULL) {
+        ret = ESP_ERR_NVS_NOT_FOUND;
+    } else if (out == NULL) {
+        *length = entry->length;
+    } else if ((exact && *length != entry->length) || *length < entry->length) {
+        ret = ESP_ERR_INVALID_SIZE;
+    } else {
+        memcpy(out, entry->value, entry->length);
+        *length = entry->length;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+static void store_load(void)
+{
+    const char *path = getenv("SIM_NVS_FILE");
+    FILE *f = path ? fopen(path, "rb") : NULL;
+    if (f == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < NVS_ENTRIES_MAX; i++) {
+        nvs_entry_t *entry = &s_entries[i];
+        if (fread(entry->ns, NVS_KEY_MAX, 1, f) != 1 || fread(entry->key, NVS_KEY_MAX, 1, f) != 1 ||
+            fread(&entry->length, sizeof(entry->length), 1, f) != 1) {
+            memset(entry, 0, sizeof(*entry));
+            break;
+        }
+        entry->value = malloc(entry->length ? entry->length : 1);
+        if (entry->length > 0 && fread(entry->value, entry->length, 1, f) != 1) {
+            free(entry->value);
+            memset(entry, 0, sizeof(*entry));
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    fclose(f);
+}
+
+static void store_save(void)
+{
+    const char *path = getenv("SIM_NVS_FILE");
+    FILE *f = path ? fopen(path, "wb") : NULL;
+    if (f == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < NVS_ENTRIES_MAX; i++) {
+        nvs_entry_t *entry = &s_entries[i];
+        if (entry->key[0] == '\0') {
+            continue;
+        }
+        fwrite(entry->ns, NVS_KEY_MAX, 1, f);
+        fwrite(entry->key, NVS_KEY_MAX, 1, f);
+        fwrite(&entry->length, sizeof(entry->length), 1, f);
+        fwrite(entry->value, entry->length, 1, f);
+    }
+    pthread_mutex_unlock(&s_lock);
+    fclose(f);
+}
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "esp_partition.h"
+
+/*
+ * Data partitions backed by host memory with NOR flash semantics: erase sets whole sectors to
+ * 0xFF and writes can only clear bits. SIM_FLASH_FILE persists the image between runs and
+ * SIM_JOURNAL_KB resizes the journal partition.
+ */
+
+//Defines
+#define SIM_JOURNAL_DEFAULT_KB  256
+#define SIM_PARTITIONS          2
+
+//Private Variables
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+static esp_partition_t s_partitions[SIM_PARTITIONS] = {
+    { .type = ESP_PARTITION_TYPE_DATA, .subtype = ESP_PARTITION_SUBTYPE_DATA_NVS,
+      .address = 0x9000, .size = 0x6000, .label = "nvs" },
+    { .type = ESP_PARTITION_TYPE_DATA, .subtype = (esp_partition_subtype_t)0x40,
+      .address = 0x110000, .size = SIM_JOURNAL_DEFAULT_KB * 1024, .label = "journal" },
+};
+static uint8_t *s_images[SIM_PARTITIONS];
+
+//Private Function Declarations
+static void flash_init(void);
+static int partition_index(const esp_partition_t *partition);
+static void flash_sync(int index);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+    pthread_once(&s_once, flash_init);
+    for (int i = 0; i < SIM_PARTITIONS; i++) {
+        const esp_partition_t *p = &s_partitions[i];
+        if (p->type == type && (subtype == ESP_PARTITION_SUBTYPE_ANY || p->subtype == subtype) &&
+            (label == NULL || strcmp(p->label, label) == 0)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    int i = partition_index(partition);
+    if (i < 0 || dst == NULL || src_offset + size > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    memcpy(dst, s_images[i] + src_offset, size);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    int i = partition_index(partition);
+    const uint8_t *in = src;
+    if (i < 0 || src == NULL || dst_offset + size > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    for (size_t b = 0; b < size; b++) {
+        s_images[i][dst_offset + b] &= in[b];
+    }
+    pthread_mutex_unlock(&s_lock);
+    flash_sync(i);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    int i = partition_index(partition);
+    if (i < 0 || offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0 ||
+        offset + size > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    memset(s_images[i] + offset, 0xFF, size);
+    pthread_mutex_unlock(&s_lock);
+    flash_sync(i);
+    return ESP_OK;
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+static void flash_init(void)
+{
+    const char *kb = getenv("SIM_JOURNAL_KB");
+    const char *path = getenv("SIM_FLASH_FILE");
+    if (kb != NULL && atoi(kb) > 0) {
+        s_partitions[1].size = (uint32_t)atoi(kb) * 1024;
+    }
+    for (int i = 0; i < SIM_PARTITIONS; i++) {
+        s_images[i] = malloc(s_partitions[i].size);
+        memset(s_images[i], 0xFF, s_partitions[i].size);
+    }
+    FILE *f = path ? fopen(path, "rb") : NULL;
+    if (f != NULL) {
+        for (int i = 0; i < SIM_PARTITIONS; i++) {
+            if (fread(s_images[i], s_partitions[i].size, 1, f) != 1) {
+                break;
+            }
+        }
+        fclose(f);
+    }
+}
+
+static int partition_index(const esp_partition_t *partition)
+{
+    for (int i = 0; i < SIM_PARTITIONS; i++) {
+        if (partition == &s_partitions[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void flash_sync(int index)
+{
+    const char *path = getenv("SIM_FLASH_FILE");
+    FILE *f = path ? fopen(path, "wb") : NULL;
+    (void)index;
+    if (f == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < SIM_PARTITIONS; i++) {
+        fwrite(s_images[i], s_partitions[i].size, 1, f);
+    }
+    pthread_mutex_unlock(&s_lock);
+    fclose(f);
+}
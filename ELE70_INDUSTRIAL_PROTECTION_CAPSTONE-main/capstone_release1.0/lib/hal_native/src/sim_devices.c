@@ -0,0 +1,129 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "sim.h"
+
+/*
+ * Register models for the two sensors on the capstone board.
+ *  - VEML7700 (0x10): 16-bit little-endian registers, ALS counts at 0x04 scale by 1.8432 lux
+ *  - NTC ADC  (0x50): 8-bit code split across two nibbles, as assembled by ntc_adc_convert()
+ * Both follow a slow sinusoid plus uniform noise unless pinned with the sim_*_set_* calls.
+ */
+
+//Defines
+#define VEML_ADDR           0x10
+#define VEML_REG_ALS        0x04
+#define VEML_LUX_PER_COUNT  1.8432
+#define NTC_ADDR            0x50
+#define NTC_SERIES_K        2560000.0
+#define NTC_OFFSET          18056.0
+#define NTC_SLOPE           443.7
+
+//Private Types
+typedef struct {
+    uint16_t regs[8];
+    double pinned;
+    bool is_pinned;
+} veml_state_t;
+
+typedef struct {
+    double pinned;
+    bool is_pinned;
+} ntc_state_t;
+
+//Private Variables
+static veml_state_t s_veml;
+static ntc_state_t s_ntc;
+
+//Private Function Declarations
+static uint8_t veml_read_byte(sim_i2c_device_t *dev, uint8_t reg, size_t index);
+static void veml_write_byte(sim_i2c_device_t *dev, uint8_t reg, size_t index, uint8_t value);
+static uint8_t ntc_read_byte(sim_i2c_device_t *dev, uint8_t reg, size_t index);
+static double noise(double amplitude);
+
+static sim_i2c_device_t s_veml_dev = {
+    .addr = VEML_ADDR,
+    .name = "VEML7700",
+    .read_byte = veml_read_byte,
+    .write_byte = veml_write_byte,
+    .ctx = &s_veml,
+};
+
+static sim_i2c_device_t s_ntc_dev = {
+    .addr = NTC_ADDR,
+    .name = "NTCALUG02A103G",
+    .read_byte = ntc_read_byte,
+    .ctx = &s_ntc,
+};
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+
+void sim_devices_init(void)
+{
+    sim_i2c_attach(&s_veml_dev);
+    sim_i2c_attach(&s_ntc_dev);
+}
+
+void sim_light_set_lux(double lux)
+{
+    s_veml.pinned = lux;
+    s_veml.is_pinned = true;
+}
+
+void sim_temp_set_celsius(double celsius)
+{
+    s_ntc.pinned = celsius;
+    s_ntc.is_pinned = true;
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+static uint8_t veml_read_byte(sim_i2c_device_t *dev, uint8_t reg, size_t index)
+{
+    veml_state_t *veml = dev->ctx;
+    uint16_t value;
+    if (reg == VEML_REG_ALS) {
+        double t = esp_timer_get_time() / 1e6;
+        double lux = veml->is_pinned ? veml->pinned : 300.0 + 50.0 * sin(t / 60.0) + noise(5.0);
+        double counts = lux / VEML_LUX_PER_COUNT;
+        value = counts < 0 ? 0 : (counts > 65535 ? 65535 : (uint16_t)counts);
+    } else {
+        value = veml->regs[reg & 0x7];
+    }
+    return (index & 1) ? (uint8_t)(value >> 8) : (uint8_t)(value & 0xFF);
+}
+
+static void veml_write_byte(sim_i2c_device_t *dev, uint8_t reg, size_t index, uint8_t value)
+{
+    veml_state_t *veml = dev->ctx;
+    uint16_t *r = &veml->regs[reg & 0x7];
+    if (index & 1) {
+        *r = (uint16_t)((*r & 0x00FF) | (value << 8));
+    } else {
+        *r = (uint16_t)((*r & 0xFF00) | value);
+    }
+}
+
+/**
+ * @brief Inverts the firmware's conversion so the reported code maps back to the model temperature
+ */
+static uint8_t ntc_read_byte(sim_i2c_device_t *dev, uint8_t reg, size_t index)
+{
+    ntc_state_t *ntc = dev->ctx;
+    double t = esp_timer_get_time() / 1e6;
+    double celsius = ntc->is_pinned ? ntc->pinned : 22.0 + 3.0 * sin(t / 120.0) + noise(0.2);
+    double code = NTC_SERIES_K / (NTC_OFFSET + (30.0 - celsius) * NTC_SLOPE);
+    uint8_t adc = code < 1 ? 1 : (code > 255 ? 255 : (uint8_t)lround(code));
+    (void)reg;
+    return (index & 1) ? (uint8_t)((adc & 0x0F) << 4) : (uint8_t)(adc >> 4);
+}
+
+static double noise(double amplitude)
+{
+    return amplitude * ((double)rand() / RAND_MAX * 2.0 - 1.0);
+}
@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+
+/*
+ * Native entry point: attaches the sensor models, drives the enable pins listed in SIM_GPIO_HIGH
+ * (comma separated, e.g. "25,26"), then hands over to app_main() exactly as the ESP-IDF startup
+ * code does. SIM_RUN_SECONDS bounds the run for perf/valgrind sessions. SIM_I2C_HANG lists device
+ * addresses (e.g. "0x10") that hang the bus whenever addressed, to exercise bus recovery.
+ * Unit tests under test/ bring their own main(), so it is left out of a `pio test` build.
+ */
+
+#ifndef PIO_UNIT_TESTING
+void app_main(void);
+
+int main(void)
+{
+    const char *pins = getenv("SIM_GPIO_HIGH");
+    const char *run = getenv("SIM_RUN_SECONDS");
+    const char *hang = getenv("SIM_I2C_HANG");
+
+    sim_devices_init();
+    if (pins != NULL) {
+        char list[128];
+        snprintf(list, sizeof(list), "%s", pins);
+        for (char *tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ",")) {
+            sim_gpio_set_level(atoi(tok), 1);
+        }
+    }
+
+    if (hang != NULL) {
+        char list[128];
+        snprintf(list, sizeof(list), "%s", hang);
+        for (char *tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ",")) {
+            sim_i2c_set_hang((uint8_t)strtol(tok, NULL, 0), true);
+        }
+    }
+
+    app_main();
+
+    if (run != NULL && atoi(run) > 0) {
+        sleep((unsigned)atoi(run));
+        return 0;
+    }
+    for (;;) {
+        pause();
+    }
+}
+#endif
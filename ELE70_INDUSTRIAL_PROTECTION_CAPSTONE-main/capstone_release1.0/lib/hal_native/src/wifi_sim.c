@@ -0,0 +1,295 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "esp_wifi_default.h"
+#include "sim.h"
+
+/*
+ * Default event loop plus a Wi-Fi station that "associates" instantly and is handed the
+ * loopback address, so sockets opened by the firmware reach collectors on the host.
+ */
+
+//Private Types
+typedef struct handler_node {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+    struct handler_node *next;
+} handler_node_t;
+
+typedef struct event_node {
+    esp_event_base_t base;
+    int32_t id;
+    void *data;
+    struct event_node *next;
+} event_node_t;
+
+struct esp_netif_obj {
+    esp_netif_config_t config;
+};
+
+//Private Variables
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static handler_node_t *s_handlers;
+static event_node_t *s_events_head;
+static event_node_t *s_events_tail;
+static bool s_loop_created;
+static bool s_wifi_started;
+static bool s_link_up = true;
+
+//Private Function Declarations
+static void *event_loop(void *arg);
+static void post_got_ip(void);
+
+//****************************************************************************
+//Event loop
+//****************************************************************************
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    pthread_t thread;
+    if (s_loop_created) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_loop_created = true;
+    pthread_create(&thread, NULL, event_loop, NULL);
+    pthread_detach(thread);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+                                     esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    handler_node_t *node = calloc(1, sizeof(*node));
+    if (node == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    node->base = event_base;
+    node->id = event_id;
+    node->handler = event_handler;
+    node->arg = event_handler_arg;
+    pthread_mutex_lock(&s_lock);
+    node->next = s_handlers;
+    s_handlers = node;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id,
+                                       esp_event_handler_t event_handler)
+{
+    pthread_mutex_lock(&s_lock);
+    for (handler_node_t **pp = &s_handlers; *pp != NULL; pp = &(*pp)->next) {
+        handler_node_t *node = *pp;
+        if (node->base == event_base && node->id == event_id && node->handler == event_handler) {
+            *pp = node->next;
+            free(node);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, const void *event_data,
+                         size_t event_data_size, TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait;
+    event_node_t *ev = calloc(1, sizeof(*ev));
+    if (ev == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ev->base = event_base;
+    ev->id = event_id;
+    if (event_data_size > 0) {
+        ev->data = malloc(event_data_size);
+        memcpy(ev->data, event_data, event_data_size);
+    }
+    pthread_mutex_lock(&s_lock);
+    if (s_events_tail != NULL) {
+        s_events_tail->next = ev;
+    } else {
+        s_events_head = ev;
+    }
+    s_events_tail = ev;
+    pthread_cond_signal(&s_cond);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+//****************************************************************************
+//Netif and Wi-Fi station
+//****************************************************************************
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_new(const esp_netif_config_t *esp_netif_config)
+{
+    esp_netif_t *netif = calloc(1, sizeof(*netif));
+    if (netif != NULL && esp_netif_config != NULL) {
+        netif->config = *esp_netif_config;
+    }
+    return netif;
+}
+
+void esp_netif_destroy(esp_netif_t *esp_netif)
+{
+    free(esp_netif);
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    esp_netif_config_t config = ESP_NETIF_DEFAULT_WIFI_STA();
+    return esp_netif_new(&config);
+}
+
+esp_err_t esp_netif_attach_wifi_station(esp_netif_t *esp_netif)
+{
+    return esp_netif != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_wifi_set_default_wifi_sta_handlers(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_clear_default_wifi_driver_and_handlers(void *esp_netif)
+{
+    (void)esp_netif;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    return config != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_wifi_deinit(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage)
+{
+    (void)storage;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    (void)mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    (void)interface;
+    return conf != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    (void)type;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    s_wifi_started = true;
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0, 0);
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+    s_wifi_started = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    if (!s_wifi_started) {
+        return ESP_ERR_WIFI_NOT_STARTED;
+    }
+    if (s_link_up) {
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, NULL, 0, 0);
+        post_got_ip();
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, NULL, 0, 0);
+}
+
+//****************************************************************************
+//Simulation controls
+//****************************************************************************
+
+void sim_wifi_set_link(bool up)
+{
+    bool was_up = s_link_up;
+    s_link_up = up;
+    if (!s_wifi_started || was_up == up) {
+        return;
+    }
+    if (up) {
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, NULL, 0, 0);
+        post_got_ip();
+    } else {
+        esp_event_post(IP_EVENT, IP_EVENT_STA_LOST_IP, NULL, 0, 0);
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, NULL, 0, 0);
+    }
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+static void *event_loop(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&s_lock);
+    for (;;) {
+        while (s_events_head == NULL) {
+            pthread_cond_wait(&s_cond, &s_lock);
+        }
+        event_node_t *ev = s_events_head;
+        s_events_head = ev->next;
+        if (s_events_head == NULL) {
+            s_events_tail = NULL;
+        }
+        for (handler_node_t *node = s_handlers; node != NULL; node = node->next) {
+            if ((node->base == ESP_EVENT_ANY_BASE || node->base == ev->base) &&
+                (node->id == ESP_EVENT_ANY_ID || node->id == ev->id)) {
+                esp_event_handler_t handler = node->handler;
+                void *handler_arg = node->arg;
+                pthread_mutex_unlock(&s_lock);
+                handler(handler_arg, ev->base, ev->id, ev->data);
+                pthread_mutex_lock(&s_lock);
+            }
+        }
+        free(ev->data);
+        free(ev);
+    }
+    return NULL;
+}
+
+static void post_got_ip(void)
+{
+    ip_event_got_ip_t event = { 0 };
+    event.ip_info.ip.addr = htonl(INADDR_LOOPBACK);
+    event.ip_info.netmask.addr = htonl(0xFF000000);
+    esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof(event), 0);
+}
@@ -0,0 +1,433 @@
+#include <string.h>
+#include <errno.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include <lwip/netdb.h>
+#include "coap-client.h"
+
+//Defines
+#define COAP_VERSION         1
+#define COAP_TYPE_CON        0
+#define COAP_TYPE_NON        1
+#define COAP_TYPE_ACK        2
+#define COAP_TYPE_RST        3
+#define COAP_CODE_EMPTY      0x00
+#define COAP_CODE_POST       0x02
+#define COAP_OPTION_URI_PATH 11
+#define COAP_OPTION_CONTENT_FORMAT 12
+#define COAP_PAYLOAD_MARKER  0xFF
+#define COAP_TOKEN_LEN       2      //The message id, responses are not matched on it
+#define COAP_ACK_TIMEOUT_MS  2000   //RFC 7252 4.8 transmission parameters
+#define COAP_ACK_RANDOM_MS   1000   //ACK_RANDOM_FACTOR 1.5
+#define COAP_MAX_RETRANSMIT  4
+#define COAP_SEEN_MAX        8      //Message ids of recent server messages, to drop duplicates
+#define COAP_RX_BUF_LEN      512
+#define COAP_TICK_MS         100    //Read timeout, the resolution of the retransmit timers
+#define COAP_BACKOFF_MIN_MS  1000
+#define COAP_BACKOFF_MAX_MS  60000
+#define COAP_TASK_STACK      4096
+#define COAP_TASK_PRIORITY   5
+
+typedef struct {
+    uint32_t seq;       //Order of posting, 0 while the slot is free
+    bool active;        //Sent and waiting for its ACK, at most one slot at a time
+    uint8_t retries;
+    uint16_t mid;
+    uint16_t len;
+    uint32_t timeout_ms;
+    int64_t deadline_ms;
+    uint8_t packet[COAP_INFLIGHT_LEN];
+} inflight_slot;
+
+//Private Variables
+static coap_client_config s_config;
+static SemaphoreHandle_t s_lock;        //Socket writes, in-flight table, message ids and stats
+static int s_sock = -1;                 //Opened only by the client task, connected to the server
+static uint16_t s_next_mid;
+static uint32_t s_next_seq = 1;
+static inflight_slot s_inflight[COAP_INFLIGHT_MAX];
+static uint16_t s_seen[COAP_SEEN_MAX];
+static int s_seen_head;
+static uint8_t s_tx_buf[COAP_OVERHEAD_MAX + COAP_PAYLOAD_MAX];
+static uint8_t s_rx_buf[COAP_RX_BUF_LEN];
+static coap_client_stats s_stats;
+
+//Public Function Declarations
+esp_err_t coap_client_start(const coap_client_config *config);
+esp_err_t coap_client_post(const char *path, const void *payload, size_t len, bool confirmable);
+void coap_client_get_stats(coap_client_stats *stats);
+
+//Private Function Declarations
+static void client_task(void *pvParameters);
+static int socket_open(void);
+static void handle_message(const uint8_t *buf, size_t len);
+static void run_timers_locked(int64_t now_ms);
+static void activate_next_locked(int64_t now_ms);
+static int build_message(uint8_t *buf, size_t size, int type, uint16_t mid, const char *path, const void *payload, size_t len);
+static size_t put_option(uint8_t *buf, unsigned delta, const void *value, size_t len);
+static int64_t now_ms(void);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Starts the client task, which opens the socket in the background
+ */
+esp_err_t coap_client_start(const coap_client_config *config)
+{
+    if (s_lock != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config->host == NULL || config->port == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_config = *config;
+    s_next_mid = (uint16_t)esp_random();
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreatePinnedToCore(client_task, "coap_client", COAP_TASK_STACK, NULL, COAP_TASK_PRIORITY, NULL, 0) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief POSTs payload to path without waiting for the server. Non-confirmable fails only if the datagram
+ *  can't be handed to the stack. Confirmable claims an in-flight slot (ESP_ERR_NO_MEM if none is free)
+ *  and then counts as delivered: it is sent as soon as it is the oldest one and retransmitted until ACKed
+ */
+esp_err_t coap_client_post(const char *path, const void *payload, size_t len, bool confirmable)
+{
+    esp_err_t err = ESP_OK;
+
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (!confirmable) {
+        int n = build_message(s_tx_buf, sizeof(s_tx_buf), COAP_TYPE_NON, s_next_mid, path, payload, len);
+        if (n < 0) {
+            err = ESP_ERR_INVALID_SIZE;
+        } else if (s_sock < 0 || send(s_sock, s_tx_buf, (size_t)n, 0) != n) {
+            err = ESP_FAIL;
+        } else {
+            s_next_mid++;
+            s_stats.sent_non++;
+        }
+    } else {
+        inflight_slot *slot = NULL;
+        for (int i = 0; i < COAP_INFLIGHT_MAX && slot == NULL; i++) {
+            slot = (s_inflight[i].seq == 0) ? &s_inflight[i] : NULL;
+        }
+        int n = -1;
+        if (slot != NULL) {
+            n = build_message(slot->packet, sizeof(slot->packet), COAP_TYPE_CON, s_next_mid, path, payload, len);
+        }
+        if (slot == NULL) {
+            err = ESP_ERR_NO_MEM;
+        } else if (n < 0) {
+            err = ESP_ERR_INVALID_SIZE;
+        } else {
+            slot->seq = s_next_seq++;
+            slot->active = false;
+            slot->mid = s_next_mid++;
+            slot->len = (uint16_t)n;
+            s_stats.sent_con++;
+            activate_next_locked(now_ms());
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void coap_client_get_stats(coap_client_stats *stats)
+{
+    if (s_lock == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_lock);
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+/**
+ * @brief Opens the socket with exponential backoff, then reads datagrams a tick at a time and runs the
+ *  retransmit timers between them
+ */
+static void client_task(void *pvParameters)
+{
+    uint32_t backoff_ms = COAP_BACKOFF_MIN_MS;
+
+    while (s_sock < 0) {
+        int s = socket_open();
+        if (s >= 0) {
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            s_sock = s;
+            activate_next_locked(now_ms());
+            xSemaphoreGive(s_lock);
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(backoff_ms));
+        backoff_ms = (backoff_ms * 2 > COAP_BACKOFF_MAX_MS) ? COAP_BACKOFF_MAX_MS : backoff_ms * 2;
+    }
+
+    while (1) {
+        //An ICMP unreachable also surfaces here as an error, the timers keep retrying regardless
+        int r = recv(s_sock, s_rx_buf, sizeof(s_rx_buf), 0);
+        if (r > 0) {
+            handle_message(s_rx_buf, (size_t)r);
+        }
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        run_timers_locked(now_ms());
+        xSemaphoreGive(s_lock);
+    }
+}
+
+/**
+ * @brief Resolves the server and connects a UDP socket to it, so only its datagrams are read
+ */
+static int socket_open(void)
+{
+    const struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_DGRAM,
+    };
+    struct addrinfo *res;
+
+    if (getaddrinfo(s_config.host, s_config.port, &hints, &res) != 0 || res == NULL) {
+        return -1;
+    }
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+    int r = connect(s, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (r != 0) {
+        close(s);
+        return -1;
+    }
+
+    struct timeval timeout = {
+        .tv_sec = 0,
+        .tv_usec = COAP_TICK_MS * 1000,
+    };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return s;
+}
+
+/**
+ * @brief ACK or RST settles the outstanding confirmable message. A confirmable message from the server is
+ *  ACKed, even when it is a duplicate whose earlier ACK was lost. Payloads of piggybacked responses and
+ *  new server messages go to the callback
+ */
+static void handle_message(const uint8_t *buf, size_t len)
+{
+    const uint8_t *payload = NULL;
+    size_t payload_len = 0;
+    bool deliver = false;
+
+    if (len < 4 || (buf[0] >> 6) != COAP_VERSION) {
+        return;
+    }
+    int type = (buf[0] >> 4) & 0x3;
+    size_t p = 4 + (buf[0] & 0xF);
+    uint8_t code = buf[1];
+    uint16_t mid = (uint16_t)(buf[2] << 8 | buf[3]);
+
+    if ((buf[0] & 0xF) > 8 || p > len) {
+        return;
+    }
+    //Skip the options, only the payload is of interest
+    while (p < len && buf[p] != COAP_PAYLOAD_MARKER) {
+        uint8_t delta = buf[p] >> 4;
+        size_t opt_len = buf[p] & 0xF;
+        size_t q = p + 1 + ((delta == 13) ? 1 : (delta == 14) ? 2 : 0);
+        size_t ext = (opt_len == 13) ? 1 : (opt_len == 14) ? 2 : 0;
+        if (delta == 15 || opt_len == 15 || q + ext > len) {
+            return;
+        }
+        if (opt_len == 13) {
+            opt_len = 13 + buf[q];
+        } else if (opt_len == 14) {
+            opt_len = 269 + (size_t)(buf[q] << 8 | buf[q + 1]);
+        }
+        p = q + ext + opt_len;
+    }
+    if (p + 1 < len) {
+        payload = &buf[p + 1];
+        payload_len = len - p - 1;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (type == COAP_TYPE_ACK || type == COAP_TYPE_RST) {
+        for (int i = 0; i < COAP_INFLIGHT_MAX; i++) {
+            inflight_slot *slot = &s_inflight[i];
+            if (slot->active && slot->mid == mid) {
+                slot->seq = 0;
+                slot->active = false;
+                if (type == COAP_TYPE_ACK) {
+                    s_stats.acked++;
+                    deliver = (code != COAP_CODE_EMPTY);
+                } else {
+                    s_stats.reset++;
+                    ESP_LOGW("coap-client", "server reset message %u", (unsigned)mid);
+                }
+                activate_next_locked(now_ms());
+            }
+        }
+    } else {
+        bool seen = false;
+        for (int i = 0; i < COAP_SEEN_MAX; i++) {
+            seen |= (s_seen[i] == mid);
+        }
+        if (!seen) {
+            s_seen[s_seen_head] = mid;
+            s_seen_head = (s_seen_head + 1) % COAP_SEEN_MAX;
+        }
+        if (type == COAP_TYPE_CON) {
+            const uint8_t ack[4] = {COAP_VERSION << 6 | COAP_TYPE_ACK << 4, COAP_CODE_EMPTY, buf[2], buf[3]};
+            send(s_sock, ack, sizeof(ack), 0);
+        }
+        deliver = !seen;
+    }
+    deliver = deliver && payload_len > 0;
+    s_stats.received += deliver ? 1 : 0;
+    xSemaphoreGive(s_lock);
+
+    if (deliver && s_config.on_message != NULL) {
+        s_config.on_message(payload, payload_len);
+    }
+}
+
+/**
+ * @brief Retransmits the outstanding confirmable message once its timeout expires, doubling the timeout
+ *  each time, and gives it up after COAP_MAX_RETRANSMIT retransmissions (about 45 s)
+ */
+static void run_timers_locked(int64_t now)
+{
+    for (int i = 0; i < COAP_INFLIGHT_MAX; i++) {
+        inflight_slot *slot = &s_inflight[i];
+        if (!slot->active || now < slot->deadline_ms) {
+            continue;
+        }
+        if (slot->retries >= COAP_MAX_RETRANSMIT) {
+            ESP_LOGW("coap-client", "message %u not acknowledged, giving up", (unsigned)slot->mid);
+            slot->seq = 0;
+            slot->active = false;
+            s_stats.lost++;
+            continue;
+        }
+        slot->retries++;
+        slot->timeout_ms *= 2;
+        slot->deadline_ms = now + slot->timeout_ms;
+        send(s_sock, slot->packet, slot->len, 0);
+        s_stats.retransmitted++;
+    }
+    activate_next_locked(now);
+}
+
+/**
+ * @brief NSTART is 1: if no confirmable message is outstanding, sends the oldest waiting one with a
+ *  randomised initial timeout
+ */
+static void activate_next_locked(int64_t now)
+{
+    inflight_slot *next = NULL;
+
+    if (s_sock < 0) {
+        return;
+    }
+    for (int i = 0; i < COAP_INFLIGHT_MAX; i++) {
+        inflight_slot *slot = &s_inflight[i];
+        if (slot->active) {
+            return;
+        }
+        if (slot->seq != 0 && (next == NULL || slot->seq < next->seq)) {
+            next = slot;
+        }
+    }
+    if (next == NULL) {
+        return;
+    }
+    next->active = true;
+    next->retries = 0;
+    next->timeout_ms = COAP_ACK_TIMEOUT_MS + esp_random() % (COAP_ACK_RANDOM_MS + 1);
+    next->deadline_ms = now + next->timeout_ms;
+    send(s_sock, next->packet, next->len, 0);
+}
+
+/**
+ * @brief Lays out a POST in buf: header, token, one Uri-Path option per path segment, Content-Format and
+ *  the payload. Returns its length or -1 if it doesn't fit
+ */
+static int build_message(uint8_t *buf, size_t size, int type, uint16_t mid, const char *path, const void *payload, size_t len)
+{
+    size_t path_len = strlen(path);
+    size_t n = 0;
+    unsigned last = 0;
+
+    if (path_len > COAP_PATH_LEN || COAP_OVERHEAD_MAX + len > size) {
+        return -1;
+    }
+    buf[n++] = (uint8_t)(COAP_VERSION << 6 | type << 4 | COAP_TOKEN_LEN);
+    buf[n++] = COAP_CODE_POST;
+    buf[n++] = (uint8_t)(mid >> 8);
+    buf[n++] = (uint8_t)mid;
+    buf[n++] = (uint8_t)(mid >> 8);
+    buf[n++] = (uint8_t)mid;
+    for (const char *seg = path; *seg != '\0'; ) {
+        size_t seg_len = strcspn(seg, "/");
+        if (seg_len > 0) {
+            n += put_option(&buf[n], COAP_OPTION_URI_PATH - last, seg, seg_len);
+            last = COAP_OPTION_URI_PATH;
+        }
+        seg += seg_len + (seg[seg_len] == '/' ? 1 : 0);
+    }
+    if (s_config.content_format != COAP_FORMAT_NONE) {
+        uint8_t format[2] = {(uint8_t)(s_config.content_format >> 8), (uint8_t)s_config.content_format};
+        size_t skip = (format[0] == 0) ? (format[1] == 0 ? 2 : 1) : 0;
+        n += put_option(&buf[n], COAP_OPTION_CONTENT_FORMAT - last, &format[skip], sizeof(format) - skip);
+    }
+    if (len > 0) {
+        buf[n++] = COAP_PAYLOAD_MARKER;
+        memcpy(&buf[n], payload, len);
+    }
+    return (int)(n + len);
+}
+
+/**
+ * @brief One option, delta and length below 269 so at most one extension byte each
+ */
+static size_t put_option(uint8_t *buf, unsigned delta, const void *value, size_t len)
+{
+    size_t n = 1;
+
+    buf[0] = (uint8_t)((delta < 13 ? delta : 13) << 4 | (len < 13 ? len : 13));
+    if (delta >= 13) {
+        buf[n++] = (uint8_t)(delta - 13);
+    }
+    if (len >= 13) {
+        buf[n++] = (uint8_t)(len - 13);
+    }
+    memcpy(&buf[n], value, len);
+    return n + len;
+}
+
+static int64_t now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
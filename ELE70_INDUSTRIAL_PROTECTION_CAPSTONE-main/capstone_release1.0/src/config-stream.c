@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include <lwip/netdb.h>
+#include "http-response.h"
+#include "config-stream.h"
+
+//Defines
+#define STREAM_REQUEST_LEN 256
+#define STREAM_RX_BUF_LEN 256
+#define STREAM_CONNECT_TIMEOUT_MS 3000
+#define STREAM_BACKOFF_MIN_MS 1000
+#define STREAM_BACKOFF_MAX_MS 60000
+#define STREAM_TASK_STACK 4096
+#define STREAM_TASK_PRIORITY 5
+
+//Private Variables
+static config_stream_config s_config;
+static bool s_started;
+static char s_request[STREAM_REQUEST_LEN];
+static char s_rx_buf[STREAM_RX_BUF_LEN];
+static http_response s_resp;
+static char s_line[CONFIG_STREAM_LINE_MAX];
+static size_t s_line_len;
+static bool s_line_long;        //Current line overran s_line and is dropped
+static _Atomic uint32_t s_connects, s_failures, s_lines;
+
+//Public Function Declarations
+esp_err_t config_stream_start(const config_stream_config *config);
+void config_stream_get_stats(config_stream_stats *stats);
+
+//Private Function Declarations
+static void stream_task(void *pvParameters);
+static int stream_run(int s);
+static int socket_connect(void);
+static void on_body(const char *data, size_t len);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Starts the stream task, which connects in the background and keeps reconnecting
+ */
+esp_err_t config_stream_start(const config_stream_config *config)
+{
+    if (s_started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config->path == NULL || config->on_line == NULL || config->idle_timeout_s == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int n = snprintf(s_request, sizeof(s_request), "GET %s HTTP/1.1\r\n"
+        "Host: %s:%s\r\n"
+        "User-Agent: esp-idf/1.0 esp32\r\n"
+        "Accept: text/plain\r\n"
+        "Cache-Control: no-cache\r\n"
+        "\r\n", config->path, config->host, config->port);
+    if (n < 0 || n >= (int)sizeof(s_request)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_config = *config;
+    if (xTaskCreatePinnedToCore(stream_task, "config_stream", STREAM_TASK_STACK, NULL, STREAM_TASK_PRIORITY, NULL, 0) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_started = true;
+    return ESP_OK;
+}
+
+void config_stream_get_stats(config_stream_stats *stats)
+{
+    stats->connects = atomic_load(&s_connects);
+    stats->failures = atomic_load(&s_failures);
+    stats->lines = atomic_load(&s_lines);
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+/**
+ * @brief Opens the stream and follows it until it ends, then waits out an exponential backoff. The
+ *  backoff starts over once a stream has been accepted, so a server restart is picked up quickly
+ */
+static void stream_task(void *pvParameters)
+{
+    uint32_t backoff_ms = STREAM_BACKOFF_MIN_MS;
+
+    while (1) {
+        int s = socket_connect();
+        if (s >= 0) {
+            if (stream_run(s) > 0) {
+                backoff_ms = STREAM_BACKOFF_MIN_MS;
+            }
+            close(s);
+        }
+        atomic_fetch_add(&s_failures, 1);
+        vTaskDelay(pdMS_TO_TICKS(backoff_ms));
+        backoff_ms = (backoff_ms * 2 > STREAM_BACKOFF_MAX_MS) ? STREAM_BACKOFF_MAX_MS : backoff_ms * 2;
+    }
+}
+
+/**
+ * @brief Sends the GET and feeds the response through the parser as it arrives, each line reaching
+ *  on_line the moment its newline does. Returns 1 if the server accepted the stream
+ *  before it ended, 0 if not
+ */
+static int stream_run(int s)
+{
+    size_t len = strlen(s_request);
+    bool accepted = false;
+
+    if (write(s, s_request, len) != (int)len) {
+        return 0;
+    }
+    http_response_init(&s_resp);
+    s_resp.on_body = on_body;
+    s_line_len = 0;
+    s_line_long = false;
+    while (!http_response_done(&s_resp)) {
+        int r = read(s, s_rx_buf, sizeof(s_rx_buf));
+        if (r <= 0) {
+            if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                ESP_LOGW("config-stream", "no heartbeat for %us, reconnecting", (unsigned)s_config.idle_timeout_s);
+            }
+            break;
+        }
+        if (http_response_feed(&s_resp, s_rx_buf, (size_t)r) < 0) {
+            break;
+        }
+        if (!accepted && s_resp.state > HTTP_RESP_HEADER) {
+            accepted = (s_resp.status == 200);
+            if (!accepted) {
+                ESP_LOGW("config-stream", "server answered %d", s_resp.status);
+                break;
+            }
+            atomic_fetch_add(&s_connects, 1);
+        }
+    }
+    return accepted ? 1 : 0;
+}
+
+/**
+ * @brief Resolves and connects without blocking past STREAM_CONNECT_TIMEOUT_MS. Reads then time out
+ *  after idle_timeout_s, which is how a silently dead stream is noticed
+ */
+static int socket_connect(void)
+{
+    const struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res;
+
+    if (getaddrinfo(s_config.host, s_config.port, &hints, &res) != 0 || res == NULL) {
+        return -1;
+    }
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+    int flags = fcntl(s, F_GETFL, 0);
+    fcntl(s, F_SETFL, flags | O_NONBLOCK);
+    int r = connect(s, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (r != 0 && errno == EINPROGRESS) {
+        fd_set wfds;
+        struct timeval tv = {
+            .tv_sec = STREAM_CONNECT_TIMEOUT_MS / 1000,
+            .tv_usec = (STREAM_CONNECT_TIMEOUT_MS % 1000) * 1000,
+        };
+        int so_error = 0;
+        socklen_t len = sizeof(so_error);
+
+        FD_ZERO(&wfds);
+        FD_SET(s, &wfds);
+        r = -1;
+        if (select(s + 1, NULL, &wfds, NULL, &tv) == 1 &&
+            getsockopt(s, SOL_SOCKET, SO_ERROR, &so_error, &len) == 0 && so_error == 0) {
+            r = 0;
+        }
+    }
+    fcntl(s, F_SETFL, flags);
+    if (r != 0) {
+        close(s);
+        return -1;
+    }
+
+    struct timeval timeout = {
+        .tv_sec = s_config.idle_timeout_s,
+    };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return s;
+}
+
+/**
+ * @brief Splits the body into lines. Only a stream the server accepted carries config, an error page
+ *  may contain anything
+ */
+static void on_body(const char *data, size_t len)
+{
+    if (s_resp.status != 200) {
+        return;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (c != '\n') {
+            if (s_line_len < sizeof(s_line) && c != '\r') {
+                s_line[s_line_len++] = c;
+            } else if (c != '\r') {
+                s_line_long = true;
+            }
+            continue;
+        }
+        if (s_line_len > 0 && !s_line_long) {
+            atomic_fetch_add(&s_lines, 1);
+            s_config.on_line(s_line, s_line_len);
+        }
+        s_line_len = 0;
+        s_line_long = false;
+    }
+}
@@ -0,0 +1,313 @@
+#include <string.h>
+#include <strings.h>
+#include "http-response.h"
+
+//Defines
+#define CHUNK_SIZE_MAX (1ULL << 48)
+
+enum {
+    DIRECTIVE_SEEK,     //Looking for '#'
+    DIRECTIVE_MARK,     //Saw '#', waiting for the first digit
+    DIRECTIVE_DIGITS,   //Accumulating digits
+    DIRECTIVE_DONE,
+};
+
+//Public Function Declarations
+void http_response_init(http_response *resp);
+int http_response_feed(http_response *resp, const char *data, size_t len);
+int http_response_finish(http_response *resp);
+bool http_response_done(const http_response *resp);
+
+//Private Function Declarations
+static int process_line(http_response *resp);
+static int parse_status(http_response *resp);
+static int parse_header(http_response *resp);
+static int parse_chunk_size(http_response *resp);
+static void headers_done(http_response *resp);
+static const char* header_value(const char *line, const char *name);
+static void scan_directive(http_response *resp, const char *data, size_t len);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Resets the parser to expect a new response
+ */
+void http_response_init(http_response *resp)
+{
+    memset(resp, 0, sizeof(*resp));
+    resp->state = HTTP_RESP_STATUS;
+    resp->content_length = -1;
+    resp->profile = -1;
+    resp->directive = DIRECTIVE_SEEK;
+}
+
+/**
+ * @brief Consumes up to len bytes of the response. Stops at the end of the response, so a return
+ *  value below len means the rest belongs to whatever follows. Returns -1 on a malformed response
+ */
+int http_response_feed(http_response *resp, const char *data, size_t len)
+{
+    size_t i = 0;
+
+    while (i < len && resp->state != HTTP_RESP_DONE && resp->state != HTTP_RESP_ERROR) {
+        if (resp->state == HTTP_RESP_BODY || resp->state == HTTP_RESP_CHUNK_DATA) {
+            size_t n = len - i;
+            if (resp->remaining < n) {
+                n = (size_t)resp->remaining;
+            }
+            scan_directive(resp, data + i, n);
+            if (resp->on_body != NULL) {
+                resp->on_body(data + i, n);
+            }
+            i += n;
+            if (resp->state == HTTP_RESP_BODY && resp->content_length < 0) {
+                continue; //Body runs to EOF
+            }
+            resp->remaining -= n;
+            if (resp->remaining == 0) {
+                resp->state = (resp->state == HTTP_RESP_BODY) ? HTTP_RESP_DONE : HTTP_RESP_CHUNK_END;
+            }
+            continue;
+        }
+
+        char c = data[i++];
+        if (c == '\n') {
+            resp->line[resp->line_len] = '\0';
+            if (process_line(resp) != 0) {
+                resp->state = HTTP_RESP_ERROR;
+            }
+            resp->line_len = 0;
+        } else if (c != '\r' && resp->line_len < HTTP_RESP_LINE_MAX - 1) {
+            resp->line[resp->line_len++] = c;
+        }
+    }
+    return (resp->state == HTTP_RESP_ERROR) ? -1 : (int)i;
+}
+
+/**
+ * @brief Signals EOF from the server. Only a body without Content-Length may end this way
+ */
+int http_response_finish(http_response *resp)
+{
+    if (resp->state == HTTP_RESP_BODY && resp->content_length < 0) {
+        resp->state = HTTP_RESP_DONE;
+    }
+    if (resp->state != HTTP_RESP_DONE) {
+        resp->state = HTTP_RESP_ERROR;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief True once the complete response has been consumed
+ */
+bool http_response_done(const http_response *resp)
+{
+    return resp->state == HTTP_RESP_DONE;
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+/**
+ * @brief Handles one complete line, CR already stripped and NUL terminated
+ */
+static int process_line(http_response *resp)
+{
+    switch (resp->state) {
+        case HTTP_RESP_STATUS:
+            return parse_status(resp);
+        case HTTP_RESP_HEADER:
+            if (resp->line_len == 0) {
+                headers_done(resp);
+                return 0;
+            }
+            return parse_header(resp);
+        case HTTP_RESP_CHUNK_SIZE:
+            return parse_chunk_size(resp);
+        case HTTP_RESP_CHUNK_END:
+            resp->state = HTTP_RESP_CHUNK_SIZE;
+            return (resp->line_len == 0) ? 0 : -1;
+        case HTTP_RESP_TRAILER:
+            if (resp->line_len == 0) {
+                resp->state = HTTP_RESP_DONE;
+            }
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/**
+ * @brief "HTTP/1.x SSS reason". HTTP/1.1 defaults to keep-alive, HTTP/1.0 to close
+ */
+static int parse_status(http_response *resp)
+{
+    const char *l = resp->line;
+
+    if (resp->line_len < 12 || strncmp(l, "HTTP/1.", 7) != 0 || l[8] != ' ') {
+        return -1;
+    }
+    for (int i = 9; i < 12; i++) {
+        if (l[i] < '0' || l[i] > '9') {
+            return -1;
+        }
+    }
+    resp->status = (l[9] - '0') * 100 + (l[10] - '0') * 10 + (l[11] - '0');
+    resp->keep_alive = (l[7] != '0');
+    resp->chunked = false;
+    resp->content_length = -1;
+    resp->state = HTTP_RESP_HEADER;
+    return 0;
+}
+
+/**
+ * @brief Picks out the framing and connection headers, everything else is ignored
+ */
+static int parse_header(http_response *resp)
+{
+    const char *v;
+
+    if ((v = header_value(resp->line, "Content-Length")) != NULL) {
+        int64_t cl = 0;
+        if (*v == '\0') {
+            return -1;
+        }
+        for (; *v >= '0' && *v <= '9'; v++) {
+            if (cl > (INT64_MAX - 9) / 10) {
+                return -1;
+            }
+            cl = cl * 10 + (*v - '0');
+        }
+        if (*v != '\0' && *v != ' ' && *v != '\t') {
+            return -1;
+        }
+        resp->content_length = cl;
+    } else if ((v = header_value(resp->line, "Transfer-Encoding")) != NULL) {
+        size_t n = strlen(v);
+        while (n > 0 && (v[n - 1] == ' ' || v[n - 1] == '\t')) {
+            n--;
+        }
+        //Chunked framing applies only when it is the final coding
+        resp->chunked = (n >= 7 && strncasecmp(v + n - 7, "chunked", 7) == 0);
+    } else if ((v = header_value(resp->line, "Connection")) != NULL) {
+        if (strncasecmp(v, "close", 5) == 0) {
+            resp->keep_alive = false;
+        } else if (strncasecmp(v, "keep-alive", 10) == 0) {
+            resp->keep_alive = true;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Hex chunk size, optionally followed by ";extensions". Size 0 is the last chunk
+ */
+static int parse_chunk_size(http_response *resp)
+{
+    const char *l = resp->line;
+    uint64_t size = 0;
+    int digits = 0;
+
+    for (;; l++, digits++) {
+        int d;
+        if (*l >= '0' && *l <= '9') {
+            d = *l - '0';
+        } else if (*l >= 'a' && *l <= 'f') {
+            d = *l - 'a' + 10;
+        } else if (*l >= 'A' && *l <= 'F') {
+            d = *l - 'A' + 10;
+        } else {
+            break;
+        }
+        size = size * 16 + d;
+        if (size >= CHUNK_SIZE_MAX) {
+            return -1;
+        }
+    }
+    if (digits == 0 || (*l != '\0' && *l != ';' && *l != ' ' && *l != '\t')) {
+        return -1;
+    }
+    if (size == 0) {
+        resp->state = HTTP_RESP_TRAILER;
+    } else {
+        resp->remaining = size;
+        resp->state = HTTP_RESP_CHUNK_DATA;
+    }
+    return 0;
+}
+
+/**
+ * @brief Chooses body framing once the blank line after the headers arrives
+ */
+static void headers_done(http_response *resp)
+{
+    if (resp->status / 100 == 1) {
+        resp->state = HTTP_RESP_STATUS; //Interim response, the real one follows
+    } else if (resp->status == 204 || resp->status == 304) {
+        resp->state = HTTP_RESP_DONE;
+    } else if (resp->chunked) {
+        resp->state = HTTP_RESP_CHUNK_SIZE;
+    } else if (resp->content_length >= 0) {
+        resp->remaining = (uint64_t)resp->content_length;
+        resp->state = (resp->remaining == 0) ? HTTP_RESP_DONE : HTTP_RESP_BODY;
+    } else {
+        resp->keep_alive = false; //Body is delimited by the server closing
+        resp->remaining = UINT64_MAX;
+        resp->state = HTTP_RESP_BODY;
+    }
+}
+
+/**
+ * @brief Returns the value of a header line if its name matches case-insensitively, else NULL
+ */
+static const char* header_value(const char *line, const char *name)
+{
+    size_t n = strlen(name);
+
+    if (strncasecmp(line, name, n) != 0 || line[n] != ':') {
+        return NULL;
+    }
+    line += n + 1;
+    while (*line == ' ' || *line == '\t') {
+        line++;
+    }
+    return line;
+}
+
+/**
+ * @brief Picks the profile directive out of the body, it may be split across reads
+ */
+static void scan_directive(http_response *resp, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && resp->directive != DIRECTIVE_DONE; i++) {
+        char c = data[i];
+        bool digit = (c >= '0' && c <= '9');
+
+        switch (resp->directive) {
+            case DIRECTIVE_SEEK:
+                if (c == '#') {
+                    resp->directive = DIRECTIVE_MARK;
+                }
+                break;
+            case DIRECTIVE_MARK:
+                if (digit) {
+                    resp->profile = c - '0';
+                    resp->directive = DIRECTIVE_DIGITS;
+                } else if (c != '#') {
+                    resp->directive = DIRECTIVE_SEEK;
+                }
+                break;
+            case DIRECTIVE_DIGITS:
+                if (digit && resp->profile < 100000) {
+                    resp->profile = resp->profile * 10 + (c - '0');
+                } else {
+                    resp->directive = DIRECTIVE_DONE;
+                }
+                break;
+        }
+    }
+}
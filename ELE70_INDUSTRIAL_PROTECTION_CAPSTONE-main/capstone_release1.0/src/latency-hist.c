@@ -0,0 +1,99 @@
+#include <string.h>
+#include "latency-hist.h"
+
+//Public Function Declarations
+void latency_hist_reset(latency_hist *hist);
+void latency_hist_record(latency_hist *hist, uint32_t us);
+void latency_hist_snapshot_get(latency_hist *hist, latency_hist_snapshot *snap);
+uint32_t latency_hist_percentile(const latency_hist_snapshot *snap, uint32_t percent);
+uint32_t latency_hist_bucket_upper(int bucket);
+
+//Private Function Declarations
+static int bucket_of(uint32_t us);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Clears every bucket, only safe while nothing is recording
+ */
+void latency_hist_reset(latency_hist *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+}
+
+/**
+ * @brief Counts one duration
+ */
+void latency_hist_record(latency_hist *hist, uint32_t us)
+{
+    atomic_fetch_add_explicit(&hist->buckets[bucket_of(us)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+
+    uint32_t max = atomic_load_explicit(&hist->max_us, memory_order_relaxed);
+    while (us > max && !atomic_compare_exchange_weak_explicit(&hist->max_us, &max, us,
+                                                              memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+/**
+ * @brief Copies the counters out. Buckets are read one at a time, so a snapshot taken while
+ *  recording may be off by the few samples recorded during the copy
+ */
+void latency_hist_snapshot_get(latency_hist *hist, latency_hist_snapshot *snap)
+{
+    snap->count = 0;
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        snap->buckets[i] = atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+        snap->count += snap->buckets[i];
+    }
+    snap->max_us = atomic_load_explicit(&hist->max_us, memory_order_relaxed);
+}
+
+/**
+ * @brief Upper bound of the bucket holding the given percentile, 0 for an empty histogram
+ */
+uint32_t latency_hist_percentile(const latency_hist_snapshot *snap, uint32_t percent)
+{
+    uint64_t target = ((uint64_t)snap->count * percent + 99) / 100;
+    uint64_t seen = 0;
+
+    if (snap->count == 0) {
+        return 0;
+    }
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += snap->buckets[i];
+        if (seen >= target && seen > 0) {
+            uint32_t upper = latency_hist_bucket_upper(i);
+            return upper < snap->max_us ? upper : snap->max_us;
+        }
+    }
+    return snap->max_us;
+}
+
+/**
+ * @brief Largest value counted by a bucket, UINT32_MAX for the last one
+ */
+uint32_t latency_hist_bucket_upper(int bucket)
+{
+    if (bucket <= 0) {
+        return 0;
+    }
+    if (bucket >= LATENCY_HIST_BUCKETS - 1) {
+        return UINT32_MAX;
+    }
+    return (1u << bucket) - 1;
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+static int bucket_of(uint32_t us)
+{
+    if (us == 0) {
+        return 0;
+    }
+    int bucket = 32 - __builtin_clz(us);
+    return bucket < LATENCY_HIST_BUCKETS ? bucket : LATENCY_HIST_BUCKETS - 1;
+}
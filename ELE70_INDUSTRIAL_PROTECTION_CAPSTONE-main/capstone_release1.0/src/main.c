@@ -1,4 +1,3 @@
-#include <string.h>
 #include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -19,22 +18,74 @@
 #include "esp_timer.h"
 #include "network.h"
 #include "sensor-i2c.h"
+#include "sensor-registry.h"
+#include "sensor-hotplug.h"
+#include "sample-ring.h"
+#include "sample-journal.h"
+#include "sample-sched.h"
+#include "sample-stats.h"
+#include "sample-report.h"
+#include "sample-filter.h"
+#include "sensor-config.h"
+#include "tx-trigger.h"
+#include "pipeline-stats.h"
 
 //Defines
-#define CONFIG1 1000000
+#define CONFIG1 1000000 //Transmit period of profile 1, for every sensor without its own tx_ms
 #define CONFIG2 5000000
 #define CONFIG3 10000000
 #define LIGHT_EN 25
 #define TEMP_EN 26
 #define GAS_EN 27
+#define SAMPLE_RING_POLICY RING_DROP_OLDEST
+#define SAMPLE_RING_BLOCK_TICKS 10
+#define JOURNAL_DRAIN_INTERVAL_MS 250 //One backlog batch per interval, live telemetry goes first
+#define STATS_FIELD_LEN (16 + PAYLOAD_INT_MAX_DIGITS) //"&<name>=<int>", names up to 14 characters
+
+_Static_assert(SENSOR_REGISTRY_MAX <= SAMPLE_REPORT_CHANNELS, "every sensor needs a deadband");
+_Static_assert(SENSOR_REGISTRY_MAX <= SAMPLE_FILTER_CHANNELS, "every sensor needs a filter chain");
+_Static_assert(SENSOR_CONFIG_BATCH_MAX <= SAMPLE_RING_LEN, "a sensor's batch must fit the sample ring");
+_Static_assert(9 + 6 * STATS_FIELD_LEN <= NETWORK_STATS_GROUP_MAX, "ring stats must fit one stats group");
+_Static_assert(13 + 8 * STATS_FIELD_LEN <= NETWORK_STATS_GROUP_MAX, "journal stats must fit one stats group");
+_Static_assert(12 + 5 * STATS_FIELD_LEN <= NETWORK_STATS_GROUP_MAX, "hotplug stats must fit one stats group");
+_Static_assert(8 + PIPELINE_STATS_HIST_LEN <= NETWORK_STATS_GROUP_MAX, "read stats must fit one stats group");
+_Static_assert(15 + 7 * STATS_FIELD_LEN <= NETWORK_STATS_GROUP_MAX, "trigger stats must fit one stats group");
+_Static_assert(7 + PAYLOAD_INT_MAX_DIGITS + 9 * STATS_FIELD_LEN <= NETWORK_STATS_GROUP_MAX, "sensor stats must fit one stats group");
+
+typedef struct {
+    int64_t period_us;      //Window length
+    int64_t next_us;        //Next window close, a multiple of period_us
+    uint32_t batch;         //Windows queued before the transmitter is woken
+    uint32_t pending;       //Windows queued since it was last woken
+} sensor_tx;
+
+typedef enum {
+    STATS_RING,
+    STATS_JOURNAL,
+    STATS_HOTPLUG,
+    STATS_READ,
+    STATS_TRIGGERS,         //One group per tx_trigger_kind from here on
+    STATS_SENSORS = STATS_TRIGGERS + TX_TRIGGER_KINDS,  //One group per registry index from here on
+} stats_group;
 
 //Private Variables
-static sensor_struct *light;
-static sensor_struct *temp;
-static sensor_struct *gas;
-static esp_timer_handle_t periodic_timer;
-static int tx_flag = 0;
-static int profile_flag = 0;
+static sample_ring sample_buffer;
+static TaskHandle_t transmit_task;
+static sensor_tx s_tx[SENSOR_REGISTRY_MAX];     //Per registry index, owned by CORE 1
+static int64_t s_profile_tx_us = CONFIG1;
+//Collector names of the trigger stats groups
+static const char *const s_trigger_names[TX_TRIGGER_KINDS] = {
+    [TX_TRIGGER_WINDOW] = "window",
+    [TX_TRIGGER_ALARM] = "alarm",
+    [TX_TRIGGER_PROFILE] = "profile",
+};
+
+//Report by exception, per registry index unless the server sets a deadband: light on a 5% change,
+//temperature on 1 degree, both at least once a minute. Temperature outside 0..40 C is an alarm
+static const sample_deadband s_report_defaults[SENSOR_REGISTRY_MAX] = {
+    { .permille = 50, .heartbeat_ms = 60000 },
+    { .abs = SENSOR_VALUE_ONE, .heartbeat_ms = 60000, .alarm = true, .alarm_low = 0, .alarm_high = 40 * SENSOR_VALUE_ONE },
+};
 
 //Public Functions
 void app_main(void);
@@ -42,13 +93,20 @@ void app_main(void);
 //Private Functions
 static void main_task_core0(void *pvParameters);
 static void main_task_core1(void *pvParameters);
-static void hw_en_pins_init();
-static void timer_init();
-static void periodic_timer_callback(void* arg);
-static void change_profile();
-static void IRAM_ATTR light_isr_handler(void*par);
-static void IRAM_ATTR temp_isr_handler(void*par);
-static void IRAM_ATTR gas_isr_handler(void*par);
+static void change_profile(int profile);
+static void apply_rate(int index);
+static void apply_deadband(int index);
+static void close_windows(sample_window *windows, bool flush, uint32_t alarmed);
+static void transmit_live(sensor_batch *batch);
+static void journal_drain(sensor_batch *batch);
+static bool encode_stats(payload_writer *w, int group);
+static void encode_ring_stats(payload_writer *w);
+static void encode_journal_stats(payload_writer *w);
+static void encode_hotplug_stats(payload_writer *w);
+static void encode_read_stats(payload_writer *w);
+static void encode_trigger_stats(payload_writer *w, tx_trigger_kind kind);
+static void encode_sensor_stats(payload_writer *w, int index);
+
 
 //****************************************************************************
 //Public Functions
@@ -63,30 +121,29 @@ void app_main(void)
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
-    hw_en_pins_init();
-    if (gpio_get_level(LIGHT_EN) == 1){
-        light = (sensor_struct *) malloc(sizeof(sensor_struct));
-        light->id = 1;
-        light->value = 0;
+    //Board table: driver, collector sensor_id, I2C address, enable pin
+    sensor_registry_add(&sensor_veml7700, 1, 0x10, LIGHT_EN);
+    sensor_registry_add(&sensor_ntc_adc, 2, 0x50, TEMP_EN);
+    sensor_registry_add(NULL, 3, 0x00, GAS_EN); //No gas reader yet, only its pin is tracked
+    sensor_config_load(); //Rates the server set before the last reboot
 
+    //Filters: light is smoothed at its 10 Hz integration rate, temperature is oversampled at 10 Hz and
+    //median filtered against single bad codes, then decimated to 1 Hz
+    sample_filter_configure(0, (const sample_filter_stage[]){ {FILTER_IIR, 2} }, 1);
+    sample_filter_configure(1, (const sample_filter_stage[]){ {FILTER_MEDIAN, 5}, {FILTER_DECIMATE, 10} }, 2);
+    for (int i = 0; i < sensor_registry_count(); i++){
+        apply_deadband(i);
     }
-    if (gpio_get_level(TEMP_EN) == 1){
-        temp = (sensor_struct *) malloc(sizeof(sensor_struct));
-        temp->id = 2;
-        temp->value = 0;
-    }
-    if (gpio_get_level(GAS_EN) == 1){
-        gas = (sensor_struct *) malloc(sizeof(sensor_struct));
-        gas->id = 3;
-        gas->value = 0;
-    }
+
+    sample_ring_init(&sample_buffer, SAMPLE_RING_POLICY, SAMPLE_RING_BLOCK_TICKS);
+    ESP_ERROR_CHECK(network_add_stats_source(encode_stats));
+    sample_journal_init(); //Without the partition samples are simply not journaled
     sensor_i2c_init();
-    timer_init();
 
     ESP_ERROR_CHECK(network_connect());
 
+    xTaskCreatePinnedToCore(main_task_core0, "main_task_core0", 4096, NULL, 5, &transmit_task, 0);
     xTaskCreatePinnedToCore(main_task_core1, "main_task_core1", 4096, NULL, 5, NULL, 1);
-    xTaskCreatePinnedToCore(main_task_core0, "main_task_core0", 4096, NULL, 5, &transmitTaskHandle, 0);
 }
 
 //****************************************************************************
@@ -94,164 +151,391 @@ void app_main(void)
 //****************************************************************************
 
 /**
- * @brief This is the main routine ran on CORE 0 (Set affinity to CORE 0), which schedules packet transmission
- * based on status of its transmission request flag
+ * @brief This is the main routine ran on CORE 0 (Set affinity to CORE 0), the long-lived
+ * transmitter. Sleeps until CORE 1 signals a transmit is due, then drains the sample ring in
+ * requests of up to TX_BATCH_MAX samples. Nothing is polled: the notification carries every window,
+ * alarm and profile trigger, and tx-trigger measures each one up to the socket write. Samples that
+ * can't be delivered go to the flash journal, which is drained back one batch per
+ * JOURNAL_DRAIN_INTERVAL_MS once the link returns. A stats request from the server is answered
+ * after the live samples it woke up next to
  */
 static void main_task_core0(void *pvParameters)
 {
-    int counter = 0;
+    static sensor_batch batch;
+    TickType_t last_drain = xTaskGetTickCount();
+    network_watch_stats();
     while(1){
-        counter++;
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-        if (tx_flag == 1){
-            tx_flag = 0;
-            if (gpio_get_level(LIGHT_EN) == 1){
-                xTaskCreatePinnedToCore(http_tx_task, "http_tx_task", 2048, light, 10, NULL, 0);
-                vTaskDelay(10);
-            }
-            if (gpio_get_level(TEMP_EN) == 1){
-                xTaskCreatePinnedToCore(http_tx_task, "http_tx_task", 2048, temp, 10, NULL, 0);
-                vTaskDelay(10);
+        TickType_t wait = sample_journal_pending() > 0 ? pdMS_TO_TICKS(JOURNAL_DRAIN_INTERVAL_MS) : portMAX_DELAY;
+        if (ulTaskNotifyTake(pdTRUE, wait) > 0){
+            transmit_live(&batch);
+            if (network_is_up() && network_take_stats_request()){
+                network_transmit_stats();
             }
         }
+        if (sample_journal_pending() > 0 && network_is_up() &&
+            xTaskGetTickCount() - last_drain >= pdMS_TO_TICKS(JOURNAL_DRAIN_INTERVAL_MS)){
+            last_drain = xTaskGetTickCount();
+            journal_drain(&batch);
+        }
     }
 }
 
 /**
- * @brief This is the main routine ran on CORE 1 (Set affinity to CORE 1), which polls sensors at a set interval
- * and parses received HTTP messages for configuration profile changes
+ * @brief This is the main routine ran on CORE 1 (Set affinity to CORE 1), which samples each
+ * registered sensor on its own absolute deadlines, runs every reading through that sensor's filter
+ * chain and folds what comes out into its transmit window. Each sensor closes its window on its own
+ * transmit period; a summary that clears its deadband goes into the sample ring, and the
+ * transmitter is woken once a sensor has queued its batch, or at once when a reading crosses an
+ * alarm limit. Sampling faster than a sensor transmits costs no upload volume and a steady sensor
+ * costs nothing but its heartbeat. One scheduler timer serves every rate: a window closes on the
+ * first release at or after its deadline, as transmit periods are never shorter than sample
+ * periods. Profile, rate and deadband changes pushed by the server wake it through the same task
+ * notification and are applied at once. Scheduler channels, filters, windows, deadbands and rates
+ * are registry indices
  */
 static void main_task_core1(void *pvParameters)
 {
+    static sensor_struct samples[SENSOR_REGISTRY_MAX];
+    static sample_window windows[SENSOR_REGISTRY_MAX];
+    ESP_ERROR_CHECK(sample_sched_init());
+    ESP_ERROR_CHECK(sensor_hotplug_start());
+    network_watch_config();
+    for (int i = 0; i < sensor_registry_count(); i++){
+        apply_rate(i);
+    }
     while(1){
-        vTaskDelay(1000 / portTICK_PERIOD_MS);//Set polling interval
-        if (gpio_get_level(LIGHT_EN) == 1){
-            light->value = light_read();
+        sensor_hotplug_apply();//Attach/detach sensors whose enable pin settled since the last wake
+        uint32_t due = sample_sched_wait();//Sensors due now, deadlines don't drift with read time
+        int64_t read_start = esp_timer_get_time();
+        uint32_t fresh = sensor_registry_read(due, samples);//Bounded bus sessions, one sample per sensor read
+        sample_sched_read_done((uint32_t)(esp_timer_get_time() - read_start));
+        uint32_t alarmed = 0;//Sensors whose reading just crossed an alarm limit
+        for (int i = 0; fresh != 0; i++, fresh >>= 1){
+            if ((fresh & 1) && sample_filter_apply(i, &samples[i].value)){
+                sample_window_add(&windows[i], &samples[i]);
+                if (sample_report_alarm_crossed(i, samples[i].value)){
+                    alarmed |= 1u << i;
+                }
+            }
         }
-        if (gpio_get_level(TEMP_EN) == 1){
-            temp->value = temp_read();
+        int profile = network_take_profile();
+        if (profile >= 0){
+            change_profile(profile);
         }
-        if (profile_flag != configProfile){
-            change_profile();
+        uint32_t changed = sensor_config_take_changed();
+        for (int i = 0; changed != 0; i++, changed >>= 1){
+            if (changed & 1){
+                apply_rate(i);
+                apply_deadband(i);
+            }
         }
+        close_windows(windows, profile >= 0, alarmed);
     }
 }
 
 /**
- * @brief Configures the GPIO pins for sensor enable detection
- */
-static void hw_en_pins_init(){
-    gpio_reset_pin(LIGHT_EN);
-    gpio_reset_pin(TEMP_EN);
-    gpio_reset_pin(GAS_EN);
-
-    gpio_set_direction(LIGHT_EN, GPIO_MODE_INPUT);
-    gpio_set_direction(TEMP_EN, GPIO_MODE_INPUT);
-    gpio_set_direction(GAS_EN, GPIO_MODE_INPUT);
-
-    gpio_intr_enable(LIGHT_EN);
-    gpio_intr_enable(TEMP_EN);
-    gpio_intr_enable(GAS_EN);
-
-    gpio_set_pull_mode(LIGHT_EN, GPIO_PULLDOWN_ONLY);
-    gpio_set_pull_mode(TEMP_EN, GPIO_PULLDOWN_ONLY);
-    gpio_set_pull_mode(GAS_EN, GPIO_PULLDOWN_ONLY);
-
-    gpio_set_intr_type(LIGHT_EN, GPIO_INTR_ANYEDGE);
-    gpio_set_intr_type(TEMP_EN, GPIO_INTR_ANYEDGE);
-    gpio_set_intr_type(GAS_EN, GPIO_INTR_ANYEDGE);
-
-    gpio_install_isr_service (7);
-    gpio_isr_handler_add(LIGHT_EN, light_isr_handler, NULL);
-    gpio_isr_handler_add(TEMP_EN, temp_isr_handler, NULL);
-    gpio_isr_handler_add(GAS_EN, gas_isr_handler, NULL);
-}
-
-/**
- * @brief Initialize periodic timer to signal and scheduled HTTP transmits
- */
-static void timer_init(){
-
-    const esp_timer_create_args_t periodic_timer_args = {
-            .callback = &periodic_timer_callback,
-            .name = "periodic"
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &periodic_timer));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, 1000000));
-}
-
-/**
- * @brief Timer interrupt callback: Set transmission flag to make HTTP call
- */
-static void periodic_timer_callback(void* arg){
-    tx_flag = 1;
-}
-
-/**
- * @brief Sets transmission to make HTTP call to update most recent sensor values, then restarts timer 
- * with new periodic interval determined by configuration profile selected
+ * @brief Sets the transmit period of every sensor that follows the profile. The windows are then flushed
+ * to make an HTTP call with the most recent sensor values
  */
-static void change_profile(){
-    tx_flag = 1;
-    ESP_ERROR_CHECK(esp_timer_stop(periodic_timer));
-    switch(configProfile)
+static void change_profile(int profile){
+    switch(profile)
     {
         case 1:
-            ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, CONFIG1));
+            s_profile_tx_us = CONFIG1;
             break;
         case 2:
-            ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, CONFIG2));
+            s_profile_tx_us = CONFIG2;
             break;
         case 3:
-            ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, CONFIG3));
+            s_profile_tx_us = CONFIG3;
             break;
         default:
-            ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, CONFIG2));
+            s_profile_tx_us = CONFIG2;
+    }
+    for (int i = 0; i < sensor_registry_count(); i++){
+        apply_rate(i);
     }
-    profile_flag = configProfile;
 }
 
 /**
- * @brief ISR routine for light sensor enable pin edge trigger, positive edge will register sensor
- * negative edge will deregister sensor (To be implemented)
+ * @brief Applies a sensor's configured rate, defaults filled in: its driver's period (which is also the
+ * fastest it can be read), the profile's transmit period and a batch of one window. A transmit period
+ * shorter than the sample period is stretched to it
  */
-static void IRAM_ATTR light_isr_handler(void*par){
-    if(gpio_get_level(LIGHT_EN)==1){//posedge transition
-        light = (sensor_struct *) malloc(sizeof(sensor_struct));
-        light->id = 1;
-        light->value = 0;
+static void apply_rate(int index){
+    sensor_desc *sensor = sensor_registry_get(index);
+    sensor_tx *tx = &s_tx[index];
+    sensor_rate rate;
+
+    sensor_config_get(index, &rate);
+    int64_t fastest = (sensor->driver != NULL) ? sensor->driver->period_us : 0;
+    int64_t sample_us = MAX((int64_t)rate.sample_ms * 1000, fastest);
+    if (sample_us != sensor->period_us){
+        sensor->period_us = sample_us;
+        if (sensor->present){
+            sample_sched_set_period(index, sample_us);
+        }
     }
-    else{
-        //free(light);
+    int64_t tx_us = MAX(rate.tx_ms > 0 ? (int64_t)rate.tx_ms * 1000 : s_profile_tx_us, sample_us);
+    if (tx_us != tx->period_us){
+        tx->period_us = tx_us;
+        tx->next_us = (esp_timer_get_time() / tx_us + 1) * tx_us;
     }
+    tx->batch = MAX(rate.batch, 1);
 }
 
 /**
- * @brief ISR routine for temperature sensor enable pin edge trigger, positive edge will register sensor
- * negative edge will deregister sensor (To be implemented)
+ * @brief Hands a sensor's report by exception settings to sample-report: the deadband the server set,
+ * else the board default
  */
-static void IRAM_ATTR temp_isr_handler(void*par){
-    if(gpio_get_level(TEMP_EN)==1){//posedge transition
-        temp = (sensor_struct *) malloc(sizeof(sensor_struct));
-        temp->id = 2;
-        temp->value = 0;
+static void apply_deadband(int index){
+    sample_deadband deadband = s_report_defaults[index];
+
+    sensor_config_get_deadband(index, &deadband);
+    if (sample_report_configure(index, &deadband) != ESP_OK){
+        ESP_LOGW("main", "sensor %d deadband rejected", sensor_registry_get(index)->id);
     }
-    else{
-        //free(temp);
+}
+
+/**
+ * @brief Closes every window whose transmit deadline has passed (all of them when flushing) and
+ * queues the summaries that are due. A sensor in alarmed has its window closed early, on the
+ * reading that crossed the limit, and keeps its deadline. The transmitter is woken when a sensor
+ * has queued its batch or raised an alarm, and then takes what every other sensor has queued along
+ * with it
+ */
+static void close_windows(sample_window *windows, bool flush, uint32_t alarmed){
+    int64_t now = esp_timer_get_time();
+    int64_t alarm_us = INT64_MAX;   //Sample time of the earliest reading that raised an alarm
+    bool window = false;
+
+    for (int i = 0; i < sensor_registry_count(); i++){
+        sensor_tx *tx = &s_tx[i];
+        sensor_struct summary;
+        if (!flush && !(alarmed & (1u << i)) && now < tx->next_us){
+            continue;
+        }
+        if (now >= tx->next_us){
+            tx->next_us += ((now - tx->next_us) / tx->period_us + 1) * tx->period_us;
+        }
+        if (sample_window_close(&windows[i], &summary) && sample_report_due(i, &summary)){
+            sample_ring_push(&sample_buffer, &summary);
+            pipeline_stats_record(PIPELINE_SAMPLE_TO_ENQUEUE, summary.timestamp, now);
+            tx->pending++;
+            if (summary.flags & SENSOR_FLAG_ALARM){
+                alarm_us = MIN(alarm_us, summary.timestamp);
+            }
+            window |= tx->pending >= tx->batch;
+        }
+    }
+    bool alarm = alarm_us != INT64_MAX;
+    if (!flush && !alarm && !window){
+        return;
+    }
+    uint32_t held = 0;
+    for (int i = 0; i < sensor_registry_count(); i++){
+        held += s_tx[i].pending;
+        s_tx[i].pending = 0;
+    }
+    if (held > 0){
+        if (flush){
+            tx_trigger_mark(TX_TRIGGER_PROFILE);
+        }
+        if (alarm){
+            tx_trigger_mark_at(TX_TRIGGER_ALARM, alarm_us);
+        }
+        if (window){
+            tx_trigger_mark(TX_TRIGGER_WINDOW);
+        }
+        xTaskNotifyGive(transmit_task);
     }
 }
 
 /**
- * @brief ISR routine for gas sensor enable pin edge trigger, positive edge will register sensor
- * negative edge will deregister sensor (To be implemented)
+ * @brief Sends everything in the sample ring, journaling any batch the collector didn't accept.
+ * Each batch serves the triggers marked before it was written, and each sample records how long it
+ * waited in the ring
  */
-static void IRAM_ATTR gas_isr_handler(void*par){
-    if(gpio_get_level(GAS_EN)==1){//posedge transition
-        gas = (sensor_struct *) malloc(sizeof(sensor_struct));
-        gas->id = 3;
-        gas->value = 0;
+static void transmit_live(sensor_batch *batch){
+    int64_t queued_us;
+
+    do {
+        int64_t taken_us = esp_timer_get_time();
+        batch->count = 0;
+        while (batch->count < TX_BATCH_MAX && sample_ring_pop(&sample_buffer, &batch->samples[batch->count], &queued_us)){
+            pipeline_stats_record(PIPELINE_ENQUEUE_TO_TX, queued_us, taken_us);
+            batch->count++;
+        }
+        if (batch->count == 0){
+            break;
+        }
+        bool sent = network_is_up() && network_transmit(batch->samples, batch->count) == ESP_OK;
+        if (!sent){
+            for (int i = 0; i < batch->count; i++){
+                sample_journal_append(&batch->samples[i]);
+            }
+        }
+        tx_trigger_served(sent ? network_last_write_us() : -1);
+    } while (batch->count == TX_BATCH_MAX);
+}
+
+/**
+ * @brief Uploads the oldest journaled batch, it is only consumed once the collector accepted it
+ */
+static void journal_drain(sensor_batch *batch){
+    batch->count = sample_journal_read(batch->samples, TX_BATCH_MAX);
+    if (batch->count > 0 && network_transmit(batch->samples, batch->count) == ESP_OK){
+        sample_journal_consume(batch->count);
     }
-    else{
-        //free(gas);
+}
+
+/**
+ * @brief Stats source (network_stats_source) for the sampler side: the live sample ring, the flash
+ *  journal, the enable pins, the scheduler's bus time, the transmit latency of each kind of trigger,
+ *  then one group per registered sensor
+ */
+static bool encode_stats(payload_writer *w, int group)
+{
+    switch (group) {
+    case STATS_RING:
+        encode_ring_stats(w);
+        break;
+    case STATS_JOURNAL:
+        encode_journal_stats(w);
+        break;
+    case STATS_HOTPLUG:
+        encode_hotplug_stats(w);
+        break;
+    case STATS_READ:
+        encode_read_stats(w);
+        break;
+    default:
+        if (group < STATS_SENSORS) {
+            encode_trigger_stats(w, (tx_trigger_kind)(group - STATS_TRIGGERS));
+            break;
+        }
+        if (group - STATS_SENSORS >= sensor_registry_count()) {
+            return false;
+        }
+        encode_sensor_stats(w, group - STATS_SENSORS);
     }
-}
\ No newline at end of file
+    return true;
+}
+
+/**
+ * @brief Where SAMPLE_RING_POLICY drops or blocks once the transmitter falls behind:
+ *   ring=live&pushed=<n>&popped=<n>&dropped_oldest=<n>&dropped_newest=<n>&blocked=<n>
+ *   &high_water=<n>
+ */
+static void encode_ring_stats(payload_writer *w)
+{
+    sample_ring_stats ring;
+
+    sample_ring_get_stats(&sample_buffer, &ring);
+    payload_append_str(w, "ring=live");
+    payload_append_field(w, "pushed", ring.pushed);
+    payload_append_field(w, "popped", ring.popped);
+    payload_append_field(w, "dropped_oldest", ring.dropped_oldest);
+    payload_append_field(w, "dropped_newest", ring.dropped_newest);
+    payload_append_field(w, "blocked", ring.blocked);
+    payload_append_field(w, "high_water", ring.high_water);
+}
+
+/**
+ * @brief What couldn't be delivered and how fast the backlog drains, all zero without the partition:
+ *   journal=flash&capacity=<bytes>&used=<bytes>&pending=<n>&appended=<n>&drained=<n>&dropped=<n>
+ *   &erased=<sectors>&drain_per_s=<n>
+ */
+static void encode_journal_stats(payload_writer *w)
+{
+    sample_journal_stats journal;
+
+    sample_journal_get_stats(&journal);
+    payload_append_str(w, "journal=flash");
+    payload_append_field(w, "capacity", journal.capacity_bytes);
+    payload_append_field(w, "used", journal.used_bytes);
+    payload_append_field(w, "pending", journal.pending);
+    payload_append_field(w, "appended", journal.appended);
+    payload_append_field(w, "drained", journal.drained);
+    payload_append_field(w, "dropped", journal.dropped);
+    payload_append_field(w, "erased", journal.sectors_erased);
+    payload_append_field(w, "drain_per_s", journal.drain_samples_per_s);
+}
+
+/**
+ * @brief Enable pin activity seen by sensor-hotplug:
+ *   hotplug=pins&edges=<n>&edges_lost=<n>&plugged=<n>&unplugged=<n>&bounces=<n>
+ */
+static void encode_hotplug_stats(payload_writer *w)
+{
+    sensor_hotplug_stats hotplug;
+
+    sensor_hotplug_get_stats(&hotplug);
+    payload_append_str(w, "hotplug=pins");
+    payload_append_field(w, "edges", hotplug.edges);
+    payload_append_field(w, "edges_lost", hotplug.edges_lost);
+    payload_append_field(w, "plugged", hotplug.plugged);
+    payload_append_field(w, "unplugged", hotplug.unplugged);
+    payload_append_field(w, "bounces", hotplug.bounces);
+}
+
+/**
+ * @brief Bus time of each scheduler release, shared by every sensor read in it:
+ *   read=bus&n=<count>&p50=<us>&p90=<us>&p99=<us>&max=<us>&buckets=<b0>,<b1>,...
+ */
+static void encode_read_stats(payload_writer *w)
+{
+    sample_sched_stats sched;
+
+    sample_sched_get_stats(0, &sched);
+    payload_append_str(w, "read=bus");
+    pipeline_stats_encode_hist(w, &sched.read);
+}
+
+/**
+ * @brief How long one kind of event waited for the socket write that carried its data:
+ *   trigger=<window|alarm|profile>&triggers=<n>&written=<n>&journaled=<n>&over_target=<n>
+ *   &latency_p50=<us>&latency_p99=<us>&latency_max=<us>
+ *  over_target counts writes later than TX_TRIGGER_TARGET_US
+ */
+static void encode_trigger_stats(payload_writer *w, tx_trigger_kind kind)
+{
+    tx_trigger_stats trigger;
+
+    tx_trigger_get_stats(kind, &trigger);
+    payload_append_str(w, "trigger=");
+    payload_append_str(w, s_trigger_names[kind]);
+    payload_append_field(w, "triggers", trigger.triggers);
+    payload_append_field(w, "written", trigger.written);
+    payload_append_field(w, "journaled", trigger.journaled);
+    payload_append_field(w, "over_target", trigger.over_target);
+    payload_append_field(w, "latency_p50", latency_hist_percentile(&trigger.latency, 50));
+    payload_append_field(w, "latency_p99", latency_hist_percentile(&trigger.latency, 99));
+    payload_append_field(w, "latency_max", trigger.latency.max_us);
+}
+
+/**
+ * @brief One sensor's scheduling and report by exception, by its collector sensor_id:
+ *   sensor=<id>&period_us=<us>&releases=<n>&overruns=<n>&jitter_p50=<us>&jitter_p99=<us>
+ *   &jitter_max=<us>&sent=<n>&suppressed=<n>&alarms=<n>
+ *  period_us is 0 while the sensor is detached
+ */
+static void encode_sensor_stats(payload_writer *w, int index)
+{
+    sample_sched_stats sched;
+    sample_report_stats report;
+
+    sample_sched_get_stats(index, &sched);
+    sample_report_get_stats(index, &report);
+    payload_append_str(w, "sensor=");
+    payload_append_int(w, sensor_registry_get(index)->id);
+    payload_append_field(w, "period_us", sched.period_us);
+    payload_append_field(w, "releases", sched.releases);
+    payload_append_field(w, "overruns", sched.overruns);
+    payload_append_field(w, "jitter_p50", latency_hist_percentile(&sched.jitter, 50));
+    payload_append_field(w, "jitter_p99", latency_hist_percentile(&sched.jitter, 99));
+    payload_append_field(w, "jitter_max", sched.jitter.max_us);
+    payload_append_field(w, "sent", report.sent);
+    payload_append_field(w, "suppressed", report.suppressed);
+    payload_append_field(w, "alarms", report.alarms);
+}
@@ -0,0 +1,513 @@
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include <lwip/netdb.h>
+#include "mqtt-client.h"
+
+//Defines
+#define MQTT_CONNECT         0x10
+#define MQTT_CONNACK         0x20
+#define MQTT_PUBLISH         0x30
+#define MQTT_PUBACK          0x40
+#define MQTT_SUBSCRIBE       0x82
+#define MQTT_SUBACK          0x90
+#define MQTT_PINGREQ         0xC0
+#define MQTT_PINGRESP        0xD0
+#define MQTT_PUBLISH_DUP     0x08
+#define MQTT_RX_BUF_LEN      512
+#define MQTT_CONNECT_TIMEOUT_MS 3000
+#define MQTT_BACKOFF_MIN_MS  1000
+#define MQTT_BACKOFF_MAX_MS  60000
+#define MQTT_TASK_STACK      4096
+#define MQTT_TASK_PRIORITY   5
+
+typedef struct {
+    uint16_t id;        //Packet identifier, 0 while the slot is free
+    uint16_t len;
+    uint8_t packet[MQTT_INFLIGHT_LEN];
+} inflight_slot;
+
+//Private Variables
+static mqtt_client_config s_config;
+static SemaphoreHandle_t s_lock;        //Socket writes, in-flight table and s_connected
+static int s_sock = -1;                 //Opened and closed only by the client task
+static bool s_connected;                //CONNACK accepted on s_sock
+static uint16_t s_next_id = 1;
+static inflight_slot s_inflight[MQTT_INFLIGHT_MAX];
+static uint8_t s_tx_buf[MQTT_PACKET_MAX];
+static uint8_t s_rx_buf[MQTT_RX_BUF_LEN];
+static mqtt_client_stats s_stats;
+
+//Public Function Declarations
+esp_err_t mqtt_client_start(const mqtt_client_config *config);
+esp_err_t mqtt_client_publish(const char *topic, const void *payload, size_t len, int qos);
+bool mqtt_client_connected(void);
+void mqtt_client_get_stats(mqtt_client_stats *stats);
+
+//Private Function Declarations
+static void client_task(void *pvParameters);
+static esp_err_t session_open(void);
+static void session_close(void);
+static int socket_connect(void);
+static int read_packet(uint8_t *type, size_t *len);
+static int read_exact(uint8_t *buf, size_t len);
+static int send_locked(const uint8_t *buf, size_t len);
+static size_t put_header(uint8_t *buf, uint8_t type, size_t remaining);
+static size_t put_string(uint8_t *buf, const char *str, size_t len);
+static int build_publish(uint8_t *buf, size_t size, const char *topic, const void *payload, size_t len, int qos, uint16_t id);
+static void handle_publish(uint8_t flags, const uint8_t *body, size_t len);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Starts the client task, which connects in the background and keeps reconnecting
+ */
+esp_err_t mqtt_client_start(const mqtt_client_config *config)
+{
+    if (s_lock != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config->client_id == NULL || config->client_id[0] == '\0' || config->keepalive_s == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_config = *config;
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreatePinnedToCore(client_task, "mqtt_client", MQTT_TASK_STACK, NULL, MQTT_TASK_PRIORITY, NULL, 0) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Writes one PUBLISH without waiting for the broker. QoS 0 fails if the session is down. QoS 1
+ *  claims an in-flight slot first (ESP_ERR_NO_MEM if none is free) and then counts as delivered: a
+ *  write lost with the connection is redelivered on the next connect
+ */
+esp_err_t mqtt_client_publish(const char *topic, const void *payload, size_t len, int qos)
+{
+    esp_err_t err = ESP_OK;
+
+    if (s_lock == NULL || qos < 0 || qos > 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (qos == 0) {
+        int n = build_publish(s_tx_buf, sizeof(s_tx_buf), topic, payload, len, 0, 0);
+        if (n < 0) {
+            err = ESP_ERR_INVALID_SIZE;
+        } else if (!s_connected || send_locked(s_tx_buf, (size_t)n) != 0) {
+            err = ESP_FAIL;
+        } else {
+            s_stats.published_qos0++;
+        }
+    } else {
+        inflight_slot *slot = NULL;
+        for (int i = 0; i < MQTT_INFLIGHT_MAX && slot == NULL; i++) {
+            slot = (s_inflight[i].id == 0) ? &s_inflight[i] : NULL;
+        }
+        int n = -1;
+        if (slot != NULL) {
+            n = build_publish(slot->packet, sizeof(slot->packet), topic, payload, len, 1, s_next_id);
+        }
+        if (slot == NULL) {
+            err = ESP_ERR_NO_MEM;
+        } else if (n < 0) {
+            err = ESP_ERR_INVALID_SIZE;
+        } else {
+            slot->id = s_next_id;
+            slot->len = (uint16_t)n;
+            s_next_id = (s_next_id == UINT16_MAX) ? 1 : s_next_id + 1;
+            s_stats.published_qos1++;
+            if (s_connected) {
+                send_locked(slot->packet, slot->len);
+            }
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+/**
+ * @brief True while a session is established with the broker
+ */
+bool mqtt_client_connected(void)
+{
+    bool connected;
+
+    if (s_lock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    connected = s_connected;
+    xSemaphoreGive(s_lock);
+    return connected;
+}
+
+void mqtt_client_get_stats(mqtt_client_stats *stats)
+{
+    if (s_lock == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_lock);
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+/**
+ * @brief Owns the socket: opens the session with exponential backoff, then dispatches incoming packets.
+ *  A read that times out after half the keep-alive sends PINGREQ; a second one with no reply in
+ *  between drops the connection
+ */
+static void client_task(void *pvParameters)
+{
+    uint32_t backoff_ms = MQTT_BACKOFF_MIN_MS;
+    bool ping_outstanding = false;
+
+    while (1) {
+        if (s_sock < 0) {
+            if (session_open() != ESP_OK) {
+                session_close();
+                vTaskDelay(pdMS_TO_TICKS(backoff_ms));
+                backoff_ms = (backoff_ms * 2 > MQTT_BACKOFF_MAX_MS) ? MQTT_BACKOFF_MAX_MS : backoff_ms * 2;
+                continue;
+            }
+            backoff_ms = MQTT_BACKOFF_MIN_MS;
+            ping_outstanding = false;
+        }
+
+        uint8_t type;
+        size_t len;
+        int r = read_packet(&type, &len);
+        if (r == 1) {
+            const uint8_t ping[2] = {MQTT_PINGREQ, 0};
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            r = ping_outstanding ? -1 : send_locked(ping, sizeof(ping));
+            xSemaphoreGive(s_lock);
+            ping_outstanding = true;
+            if (r == 0) {
+                continue;
+            }
+        }
+        if (r < 0) {
+            ESP_LOGW("mqtt-client", "connection lost");
+            session_close();
+            continue;
+        }
+        ping_outstanding = false;
+
+        switch (type & 0xF0) {
+            case MQTT_PUBACK:
+                if (len >= 2) {
+                    uint16_t id = (uint16_t)(s_rx_buf[0] << 8 | s_rx_buf[1]);
+                    xSemaphoreTake(s_lock, portMAX_DELAY);
+                    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+                        if (s_inflight[i].id == id) {
+                            s_inflight[i].id = 0;
+                            s_stats.acked++;
+                        }
+                    }
+                    xSemaphoreGive(s_lock);
+                }
+                break;
+            case MQTT_PUBLISH:
+                handle_publish(type & 0x0F, s_rx_buf, len);
+                break;
+            default:    //SUBACK, PINGRESP
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Connects, sends CONNECT and waits for CONNACK, then subscribes and redelivers every unacknowledged
+ *  QoS 1 publish with DUP set. Publishing is open again once this returns ESP_OK
+ */
+static esp_err_t session_open(void)
+{
+    uint8_t *p = s_rx_buf;
+    size_t id_len = strlen(s_config.client_id);
+    uint8_t type;
+    size_t len;
+
+    s_sock = socket_connect();
+    if (s_sock < 0) {
+        return ESP_FAIL;
+    }
+
+    //CONNECT: protocol "MQTT" level 4, clean session off, keep-alive, client identifier
+    if (10 + 2 + id_len + 5 > sizeof(s_rx_buf)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    p += put_header(p, MQTT_CONNECT, 10 + 2 + id_len);
+    p += put_string(p, "MQTT", 4);
+    *p++ = 4;
+    *p++ = 0x00;
+    *p++ = (uint8_t)(s_config.keepalive_s >> 8);
+    *p++ = (uint8_t)s_config.keepalive_s;
+    p += put_string(p, s_config.client_id, id_len);
+    if (write(s_sock, s_rx_buf, (size_t)(p - s_rx_buf)) != p - s_rx_buf) {
+        return ESP_FAIL;
+    }
+    if (read_packet(&type, &len) != 0 || (type & 0xF0) != MQTT_CONNACK || len < 2 || s_rx_buf[1] != 0) {
+        ESP_LOGW("mqtt-client", "broker refused the session");
+        return ESP_FAIL;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int r = 0;
+    if (s_config.subscribe != NULL) {
+        size_t topic_len = strlen(s_config.subscribe);
+        uint8_t sub[5 + 2 + 2 + MQTT_TOPIC_LEN + 1];
+        if (topic_len > MQTT_TOPIC_LEN) {
+            r = -1;
+        } else {
+            uint8_t *q = sub;
+            q += put_header(q, MQTT_SUBSCRIBE, 2 + 2 + topic_len + 1);
+            *q++ = 0;
+            *q++ = 1;   //SUBSCRIBE uses packet id 1, publishes never wait on it
+            q += put_string(q, s_config.subscribe, topic_len);
+            *q++ = 1;   //Requested QoS
+            r = send_locked(sub, (size_t)(q - sub));
+        }
+    }
+    for (int i = 0; i < MQTT_INFLIGHT_MAX && r == 0; i++) {
+        if (s_inflight[i].id != 0) {
+            s_inflight[i].packet[0] |= MQTT_PUBLISH_DUP;
+            r = send_locked(s_inflight[i].packet, s_inflight[i].len);
+            s_stats.redelivered++;
+        }
+    }
+    s_connected = (r == 0);
+    s_stats.connects += s_connected ? 1 : 0;
+    xSemaphoreGive(s_lock);
+    return s_connected ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief Drops the connection, in-flight QoS 1 publishes stay queued for the next session
+ */
+static void session_close(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_connected = false;
+    if (s_sock >= 0) {
+        close(s_sock);
+        s_sock = -1;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+/**
+ * @brief Resolves and connects without blocking past MQTT_CONNECT_TIMEOUT_MS. Reads then time out after
+ *  half the keep-alive so the client task can ping
+ */
+static int socket_connect(void)
+{
+    const struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res;
+
+    if (getaddrinfo(s_config.host, s_config.port, &hints, &res) != 0 || res == NULL) {
+        return -1;
+    }
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+    int flags = fcntl(s, F_GETFL, 0);
+    fcntl(s, F_SETFL, flags | O_NONBLOCK);
+    int r = connect(s, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (r != 0 && errno == EINPROGRESS) {
+        fd_set wfds;
+        struct timeval tv = {
+            .tv_sec = MQTT_CONNECT_TIMEOUT_MS / 1000,
+            .tv_usec = (MQTT_CONNECT_TIMEOUT_MS % 1000) * 1000,
+        };
+        int so_error = 0;
+        socklen_t len = sizeof(so_error);
+
+        FD_ZERO(&wfds);
+        FD_SET(s, &wfds);
+        r = -1;
+        if (select(s + 1, NULL, &wfds, NULL, &tv) == 1 &&
+            getsockopt(s, SOL_SOCKET, SO_ERROR, &so_error, &len) == 0 && so_error == 0) {
+            r = 0;
+        }
+    }
+    fcntl(s, F_SETFL, flags);
+    if (r != 0) {
+        close(s);
+        return -1;
+    }
+
+    struct timeval timeout = {
+        .tv_sec = s_config.keepalive_s / 2 > 0 ? s_config.keepalive_s / 2 : 1,
+    };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    int nodelay = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    return s;
+}
+
+/**
+ * @brief Reads one packet's fixed header and as much of its body as fits s_rx_buf, skipping the rest.
+ *  Returns 0 with the packet in s_rx_buf, 1 if the read timed out before a packet started, -1 on error
+ */
+static int read_packet(uint8_t *type, size_t *len)
+{
+    uint8_t byte;
+    size_t remaining = 0;
+
+    int r = recv(s_sock, type, 1, 0);
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 1;
+    }
+    if (r != 1) {
+        return -1;
+    }
+    for (int shift = 0; ; shift += 7) {
+        if (shift > 21 || read_exact(&byte, 1) != 0) {
+            return -1;
+        }
+        remaining |= (size_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    *len = remaining < sizeof(s_rx_buf) ? remaining : sizeof(s_rx_buf);
+    if (read_exact(s_rx_buf, *len) != 0) {
+        return -1;
+    }
+    for (size_t skip = remaining - *len; skip > 0; ) {
+        size_t n = skip < sizeof(byte) ? skip : sizeof(byte);
+        if (read_exact(&byte, n) != 0) {
+            return -1;
+        }
+        skip -= n;
+    }
+    return 0;
+}
+
+static int read_exact(uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        int r = recv(s_sock, buf, len, 0);
+        if (r <= 0) {
+            return -1;
+        }
+        buf += r;
+        len -= (size_t)r;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes a whole packet with s_lock held. On failure the socket is shut down so the client task
+ *  notices, closes it and reconnects
+ */
+static int send_locked(const uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        int r = send(s_sock, buf, len, 0);
+        if (r <= 0) {
+            s_connected = false;
+            shutdown(s_sock, SHUT_RDWR);
+            return -1;
+        }
+        buf += r;
+        len -= (size_t)r;
+    }
+    return 0;
+}
+
+/**
+ * @brief Fixed header: packet type byte and the variable-length remaining length
+ */
+static size_t put_header(uint8_t *buf, uint8_t type, size_t remaining)
+{
+    size_t n = 0;
+
+    buf[n++] = type;
+    do {
+        uint8_t byte = remaining & 0x7F;
+        remaining >>= 7;
+        buf[n++] = byte | (remaining > 0 ? 0x80 : 0);
+    } while (remaining > 0);
+    return n;
+}
+
+static size_t put_string(uint8_t *buf, const char *str, size_t len)
+{
+    buf[0] = (uint8_t)(len >> 8);
+    buf[1] = (uint8_t)len;
+    memcpy(buf + 2, str, len);
+    return len + 2;
+}
+
+/**
+ * @brief Lays out a PUBLISH in buf, returning its length or -1 if it doesn't fit
+ */
+static int build_publish(uint8_t *buf, size_t size, const char *topic, const void *payload, size_t len, int qos, uint16_t id)
+{
+    size_t topic_len = strlen(topic);
+    size_t remaining = 2 + topic_len + (qos > 0 ? 2 : 0) + len;
+
+    if (topic_len > MQTT_TOPIC_LEN || 5 + remaining > size) {
+        return -1;
+    }
+    size_t n = put_header(buf, (uint8_t)(MQTT_PUBLISH | qos << 1), remaining);
+    n += put_string(buf + n, topic, topic_len);
+    if (qos > 0) {
+        buf[n++] = (uint8_t)(id >> 8);
+        buf[n++] = (uint8_t)id;
+    }
+    memcpy(buf + n, payload, len);
+    return (int)(n + len);
+}
+
+/**
+ * @brief Delivers a subscribed message to the callback, acknowledging it first if it came at QoS 1
+ */
+static void handle_publish(uint8_t flags, const uint8_t *body, size_t len)
+{
+    int qos = (flags >> 1) & 0x3;
+    size_t topic_len, n;
+
+    if (len < 2) {
+        return;
+    }
+    topic_len = (size_t)(body[0] << 8 | body[1]);
+    n = 2 + topic_len + (qos > 0 ? 2 : 0);
+    if (n > len) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (qos > 0 && s_connected) {
+        const uint8_t ack[4] = {MQTT_PUBACK, 2, body[n - 2], body[n - 1]};
+        send_locked(ack, sizeof(ack));
+    }
+    s_stats.received++;
+    xSemaphoreGive(s_lock);
+    if (s_config.on_message != NULL) {
+        s_config.on_message((const char *)body + 2, topic_len, body + n, len - n);
+    }
+}
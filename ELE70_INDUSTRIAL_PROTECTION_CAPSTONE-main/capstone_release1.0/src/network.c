@@ -1,12 +1,17 @@
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/param.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_netif.h"
 #include "lwip/err.h"
 #include "lwip/sockets.h"
@@ -14,37 +19,179 @@
 #include <lwip/netdb.h>
 #include "esp_wifi_default.h"
 #include "lwip/dns.h"
+#include "network.h"
 #include "sensor-i2c.h"
+#include "payload.h"
+#include "http-response.h"
+#include "mqtt-client.h"
+#include "coap-client.h"
+#include "config-stream.h"
+#include "sensor-config.h"
+#include "time-sync.h"
+#include "pipeline-stats.h"
 
 //Defines
+#ifndef WEB_SERVER
 #define WEB_SERVER "192.168.2.77"
+#endif
+#ifndef WEB_PORT
 #define WEB_PORT "80"
-#define WEB_PATH "/?sensor_id=1&measurement=100"
+#endif
 #define NETWORK_ID ""
 #define NETWORK_PW ""
 #define GOT_IPV4_BIT BIT(0)
 #define GOT_IPV6_BIT BIT(1)
 #define CONFIG_EXAMPLE_CONNECT_WIFI 1
 #define CONNECTED_BITS (GOT_IPV4_BIT)
+#define RECV_BUF_SIZE 512
+#define RECV_TIMEOUT_S 5
+#define CONNECT_TIMEOUT_MS 3000
+#define PAYLOAD_HEADER_LEN 200
+#define PAYLOAD_DECIMALS 2 //Form values are decimals, Q23.8 resolves 0.004
+#define PAYLOAD_BATCH_LEN 80 //"count=<int>&base_ms=<int>&utc_ms=<int>" worst case
+#define PAYLOAD_SAMPLE_LEN 179 //"&sensor_id=<int>&dt_ms=<int>&measurement=<dec>&n=<int>&min=<dec>&max=<dec>&mean=<dec>&std=<dec>&alarm=1" worst case
+#define PAYLOAD_BODY_LEN (PAYLOAD_BATCH_LEN + PAYLOAD_SAMPLE_LEN * TX_BATCH_MAX)
+//A form batch is count, base_ms and utc_ms, then each sample's sensor_id, dt_ms, measurement and window
+//stats (PAYLOAD_SAMPLE_LEN). It replaces the baseline's GET /?sensor_id=<id>&measurement=<value> per
+//reading, so the collector needs a matching change before it can parse it
+#define PAYLOAD_FORMAT_FORM 0 //application/x-www-form-urlencoded POST, one per batch
+#define PAYLOAD_FORMAT_CBOR 1 //application/cbor batch, see payload.h
+#ifndef PAYLOAD_FORMAT
+#define PAYLOAD_FORMAT PAYLOAD_FORMAT_FORM
+#endif
+#define NETWORK_TRANSPORT_HTTP 0 //POST per batch over one keep-alive connection, profile from the reply
+#define NETWORK_TRANSPORT_MQTT 1 //Publishes over one persistent MQTT session, profile from the config topic
+#define NETWORK_TRANSPORT_COAP 2 //CoAP POSTs in UDP datagrams, no connection at all, profile from the responses
+#ifndef NETWORK_TRANSPORT
+#define NETWORK_TRANSPORT NETWORK_TRANSPORT_HTTP
+#endif
+#ifndef MQTT_BROKER
+#define MQTT_BROKER WEB_SERVER
+#endif
+#ifndef MQTT_PORT
+#define MQTT_PORT "1883"
+#endif
+#define MQTT_KEEPALIVE_S 60
+#define MQTT_TOPIC_ROOT "capstone/" //capstone/<mac>/telemetry (QoS 0), .../alarm (QoS 1), .../stats (QoS 0), .../config (subscribed)
+#ifndef COAP_SERVER
+#define COAP_SERVER WEB_SERVER
+#endif
+#ifndef COAP_PORT
+#define COAP_PORT "5683"
+#endif
+#define COAP_PATH_ROOT "capstone/" //capstone/<mac>/telemetry (non-confirmable), .../alarm (confirmable), .../stats (non-confirmable)
+#ifndef CONFIG_STREAM
+#define CONFIG_STREAM 0 //HTTP transport only: hold a pushed config stream open next to the uploads. Off until the collector serves /config
+#endif
+#define CONFIG_STREAM_PATH "/config?device=" //Followed by the station MAC
+#define CONFIG_STREAM_IDLE_S 90 //The collector heartbeats the stream every 30 s
+#ifndef SNTP_SERVER
+#define SNTP_SERVER "pool.ntp.org"
+#endif
+#ifndef SNTP_PORT
+#define SNTP_PORT "123"
+#endif
+#define SNTP_INTERVAL_S 3600 //Drift of a 40 ppm crystal stays below 150 ms per interval even uncorrected
+#define STATS_PATH "/stats" //HTTP target of stats snapshots, always form bodies
 
-//Public Variables
-TaskHandle_t transmitTaskHandle = NULL;
-int configProfile = 1;
+#if NETWORK_TRANSPORT == NETWORK_TRANSPORT_MQTT
+_Static_assert(5 + 2 + MQTT_TOPIC_LEN + PAYLOAD_BODY_LEN <= MQTT_PACKET_MAX, "a full telemetry batch must fit one PUBLISH");
+_Static_assert(5 + 2 + MQTT_TOPIC_LEN + 2 + PAYLOAD_BATCH_LEN + PAYLOAD_SAMPLE_LEN <= MQTT_INFLIGHT_LEN, "an alarm must fit an in-flight slot");
+#elif NETWORK_TRANSPORT == NETWORK_TRANSPORT_COAP
+_Static_assert(COAP_OVERHEAD_MAX + PAYLOAD_BATCH_LEN + PAYLOAD_SAMPLE_LEN <= COAP_INFLIGHT_LEN, "an alarm must fit an in-flight slot");
+_Static_assert(PAYLOAD_BATCH_LEN + PAYLOAD_SAMPLE_LEN <= COAP_PAYLOAD_MAX, "a single sample must fit a datagram");
+_Static_assert(NETWORK_STATS_GROUP_MAX <= COAP_PAYLOAD_MAX, "a stats group must fit a datagram");
+#endif
+_Static_assert(NETWORK_STATS_GROUP_MAX <= PAYLOAD_BODY_LEN, "a stats group must fit the body buffer");
+_Static_assert(PIPELINE_STATS_STAGE_LEN <= NETWORK_STATS_GROUP_MAX, "a stage histogram is one stats group");
 
 //Private Variables
 static EventGroupHandle_t s_connect_event_group;
 static esp_ip4_addr_t s_ip_addr;
 static const char *s_connection_name;
 static esp_netif_t *s_example_esp_netif = NULL;
+static SemaphoreHandle_t s_conn_lock;
+static struct sockaddr_in s_server_addr;
+static bool s_server_resolved = false;
+static int s_sock = -1;
+static char s_recv_buf[RECV_BUF_SIZE];
+static http_response s_resp;
+static char s_tx_buf[PAYLOAD_HEADER_LEN + PAYLOAD_BODY_LEN];
+static uint8_t s_device_id[PAYLOAD_DEVICE_ID_LEN];
+static int64_t s_write_us = -1;             //Socket write of the last network_transmit, transmitter task only
+static TaskHandle_t s_config_task;          //Woken on every profile or rate change
+static _Atomic int s_profile = -1;          //Last profile the server sent
+static _Atomic int s_profile_pending = -1;  //Changed profile not yet taken by s_config_task
+static TaskHandle_t s_stats_task;           //Woken when the server asks for a stats snapshot
+static _Atomic bool s_stats_requested;
+static network_stats_source s_stats_sources[1 + NETWORK_STATS_SOURCES] = { pipeline_stats_encode };
+static int s_stats_source_count = 1;        //Set before the transmitter task starts
+#if NETWORK_TRANSPORT == NETWORK_TRANSPORT_HTTP && CONFIG_STREAM
+static char s_stream_path[CONFIG_STREAM_PATH_LEN];
+#endif
+#if NETWORK_TRANSPORT == NETWORK_TRANSPORT_MQTT
+static char s_client_id[32];
+static char s_topic_telemetry[MQTT_TOPIC_LEN + 1];
+static char s_topic_alarm[MQTT_TOPIC_LEN + 1];
+static char s_topic_config[MQTT_TOPIC_LEN + 1];
+static char s_topic_stats[MQTT_TOPIC_LEN + 1];
+static sensor_struct s_telemetry[TX_BATCH_MAX];
+#elif NETWORK_TRANSPORT == NETWORK_TRANSPORT_COAP
+static char s_path_telemetry[COAP_PATH_LEN + 1];
+static char s_path_alarm[COAP_PATH_LEN + 1];
+static char s_path_stats[COAP_PATH_LEN + 1];
+static sensor_struct s_telemetry[TX_BATCH_MAX];
+#endif
 
 //Public Function Declarations
 esp_err_t network_connect(void);
-void http_tx_task(void *pvParameters);
+esp_err_t network_transmit(const sensor_struct *samples, int count);
+esp_err_t http_transmit(const sensor_struct *samples, int count);
+bool network_is_up(void);
+void network_watch_config(void);
+int network_take_profile(void);
+int64_t network_last_write_us(void);
+void network_watch_stats(void);
+bool network_take_stats_request(void);
+esp_err_t network_transmit_stats(void);
+esp_err_t network_add_stats_source(network_stats_source source);
 
 //Private Function Declarations
 static void start(void);
 static void on_got_ip(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
-static char* construct_payload(int id, int value);
+static void on_wifi_disconnect(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
+static int construct_payload(const sensor_struct *samples, int count, const char **payload);
+static int construct_request(const char *path, const char *content_type, const payload_writer *body, const char **payload);
+static void construct_body(payload_writer *body, const sensor_struct *samples, int count);
+static bool http_exchange(const char *payload, int payload_len);
+static void stats_body_init(payload_writer *body);
+static esp_err_t stats_send(const payload_writer *body);
+static bool encode_link_stats(payload_writer *w, int group);
+#if NETWORK_TRANSPORT == NETWORK_TRANSPORT_MQTT
+static esp_err_t mqtt_start(void);
+static esp_err_t mqtt_transmit(const sensor_struct *samples, int count);
+static esp_err_t mqtt_publish_body(const char *topic, const payload_writer *body, int qos);
+static void on_config(const char *topic, size_t topic_len, const uint8_t *payload, size_t len);
+#elif NETWORK_TRANSPORT == NETWORK_TRANSPORT_COAP
+static esp_err_t coap_start(void);
+static esp_err_t coap_transmit(const sensor_struct *samples, int count);
+static esp_err_t coap_post_body(const char *path, const payload_writer *body, bool confirmable);
+static void on_response(const uint8_t *payload, size_t len);
+#endif
+#if NETWORK_TRANSPORT == NETWORK_TRANSPORT_HTTP && CONFIG_STREAM
+static esp_err_t stream_start(void);
+static void on_stream_line(const char *line, size_t len);
+#endif
+#if NETWORK_TRANSPORT != NETWORK_TRANSPORT_HTTP || CONFIG_STREAM
+static void apply_config(const uint8_t *payload, size_t len);
+#endif
+static void profile_received(int profile);
+static void config_changed(void);
+static esp_err_t conn_resolve(void);
+static int conn_acquire(void);
+static int conn_connect(int s);
+static void conn_close(void);
+static int conn_read_response(int s, http_response *resp);
 
 //****************************************************************************
 //Public Functions
@@ -58,68 +205,190 @@ esp_err_t network_connect()
         return ESP_ERR_INVALID_STATE;
     }
     s_connect_event_group = xEventGroupCreate();
+    s_conn_lock = xSemaphoreCreateMutex();
+    ESP_ERROR_CHECK(esp_read_mac(s_device_id, ESP_MAC_WIFI_STA));
+    ESP_ERROR_CHECK(network_add_stats_source(encode_link_stats));
+    ESP_ERROR_CHECK(network_add_stats_source(time_sync_encode_stats));
     start();
-    xEventGroupWaitBits(s_connect_event_group, CONNECTED_BITS, true, true, portMAX_DELAY);
+    xEventGroupWaitBits(s_connect_event_group, CONNECTED_BITS, false, true, portMAX_DELAY);
+
+    //Samples still flow unsynced, their batches just carry no UTC mapping
+    const time_sync_config sync = {
+        .host = SNTP_SERVER,
+        .port = SNTP_PORT,
+        .interval_s = SNTP_INTERVAL_S,
+    };
+    if (time_sync_start(&sync) != ESP_OK) {
+        ESP_LOGW("network", "time sync not started");
+    }
+#if NETWORK_TRANSPORT == NETWORK_TRANSPORT_MQTT
+    return mqtt_start();
+#elif NETWORK_TRANSPORT == NETWORK_TRANSPORT_COAP
+    return coap_start();
+#elif CONFIG_STREAM
+    return stream_start();
+#else
     return ESP_OK;
+#endif
+}
+
+/**
+ * @brief True while the station holds an IP address
+ */
+bool network_is_up(void)
+{
+    return s_connect_event_group != NULL &&
+        (xEventGroupGetBits(s_connect_event_group) & CONNECTED_BITS) == CONNECTED_BITS;
 }
 
 
 /**
- * @brief Task creates a socket and makes a HTTP call with the payload passed as pvParameters,
- *  and then retrieves configuration profile data
+ * @brief Binds the calling task as the one woken (xTaskNotifyGive) whenever the server changes the
+ *  profile or a sensor rate. A change that arrived before this stays pending for the first
+ *  network_take_profile() or sensor_config_take_changed()
  */
-void http_tx_task(void *pvParameters)
+void network_watch_config(void)
 {
-    //Block parent task
-    vTaskSuspend(transmitTaskHandle);
+    s_config_task = xTaskGetCurrentTaskHandle();
+}
 
-    //Construct payload
-    sensor_struct dataOut = *(sensor_struct *) pvParameters;
-    char *payload = construct_payload(dataOut.id, dataOut.value);
+/**
+ * @brief Returns the profile the server changed to since the last call, or -1 if it didn't
+ */
+int network_take_profile(void)
+{
+    return atomic_exchange(&s_profile_pending, -1);
+}
 
-    //HTTP call
-    const struct addrinfo hints = {
-        .ai_family = AF_INET,
-        .ai_socktype = SOCK_STREAM,
-    };
+/**
+ * @brief When the last network_transmit() started the socket write that carried its batch, in
+ *  esp_timer_get_time() time, or -1 if it never got that far. Transmitter task only
+ */
+int64_t network_last_write_us(void)
+{
+    return s_write_us;
+}
 
-    struct addrinfo *res;
-    struct in_addr *addr;
-    int s, r;
-    char recv_buf[100];
+/**
+ * @brief Makes the calling task the one woken (xTaskNotifyGive) when the server asks for a stats
+ *  snapshot, it then answers with network_transmit_stats()
+ */
+void network_watch_stats(void)
+{
+    s_stats_task = xTaskGetCurrentTaskHandle();
+}
 
-    getaddrinfo(WEB_SERVER, WEB_PORT, &hints, &res);
-    addr = &((struct sockaddr_in *)res->ai_addr)->sin_addr;
+/**
+ * @brief Whether the server asked for a stats snapshot since the last call
+ */
+bool network_take_stats_request(void)
+{
+    return atomic_exchange(&s_stats_requested, false);
+}
 
-    s = socket(res->ai_family, res->ai_socktype, 0);
-    connect(s, res->ai_addr, res->ai_addrlen);
-    freeaddrinfo(res);
-        
-    write(s, payload, strlen(payload));
+/**
+ * @brief Sends a stats snapshot as form text: every group of the pipeline stage histograms
+ *  (pipeline_stats_encode()), then of each source added with network_add_stats_source(), the
+ *  transport's own (encode_link_stats()) among them, joined with '&'. Groups are packed into as few
+ *  messages as fit, a group that no longer fits starts the next: POSTs to STATS_PATH over HTTP,
+ *  QoS 0 publishes on .../stats over MQTT, non-confirmable POSTs to .../stats of at most
+ *  COAP_PAYLOAD_MAX over CoAP. Stops at the first message that fails. Called from the transmitter
+ *  task
+ */
+esp_err_t network_transmit_stats(void)
+{
+    payload_writer body;
+    esp_err_t err = ESP_OK;
 
-    struct timeval receiving_timeout;
-    receiving_timeout.tv_sec = 5;
-    receiving_timeout.tv_usec = 0;
-    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &receiving_timeout, sizeof(receiving_timeout));
+    xSemaphoreTake(s_conn_lock, portMAX_DELAY);
+    stats_body_init(&body);
+    for (int s = 0; s < s_stats_source_count && err == ESP_OK; s++) {
+        for (int group = 0; err == ESP_OK; group++) {
+            size_t mark = body.len;
+            if (mark > 0) {
+                payload_append_str(&body, "&");
+            }
+            if (!s_stats_sources[s](&body, group)) {
+                payload_rewind(&body, mark);
+                break;
+            }
+            if (body.overflow && mark > 0) {
+                payload_rewind(&body, mark);
+                err = stats_send(&body);
+                stats_body_init(&body);
+                s_stats_sources[s](&body, group);
+            }
+            if (body.overflow) {
+                ESP_LOGW("network", "stats group %d of source %d outgrows a message", group, s);
+                payload_rewind(&body, 0);
+            }
+        }
+    }
+    if (err == ESP_OK && body.len > 0) {
+        err = stats_send(&body);
+    }
+    xSemaphoreGive(s_conn_lock);
+    return err;
+}
+
+/**
+ * @brief Adds a source to every later stats snapshot, after the ones added before it. Call before
+ *  the transmitter task starts. ESP_ERR_NO_MEM once NETWORK_STATS_SOURCES are added
+ */
+esp_err_t network_add_stats_source(network_stats_source source)
+{
+    if (s_stats_source_count >= 1 + NETWORK_STATS_SOURCES) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_stats_sources[s_stats_source_count++] = source;
+    return ESP_OK;
+}
 
-    do {
-        bzero(recv_buf, sizeof(recv_buf));
-        r = read(s, recv_buf, sizeof(recv_buf)-1);
-    } while(r == sizeof(recv_buf)-1);
+/**
+ * @brief Hands a batch to the configured transport. ESP_OK means the collector has it (or, for MQTT
+ *  alarms, that the session will keep redelivering it), anything else should be journaled
+ */
+esp_err_t network_transmit(const sensor_struct *samples, int count)
+{
+    s_write_us = -1;
+#if NETWORK_TRANSPORT == NETWORK_TRANSPORT_MQTT
+    return mqtt_transmit(samples, count);
+#elif NETWORK_TRANSPORT == NETWORK_TRANSPORT_COAP
+    return coap_transmit(samples, count);
+#else
+    return http_transmit(samples, count);
+#endif
+}
 
-    close(s);
+/**
+ * @brief Makes one HTTP call carrying count samples over the persistent keep-alive connection,
+ *  and then retrieves configuration profile data. Called from the transmitter task
+ */
+esp_err_t http_transmit(const sensor_struct *samples, int count)
+{
+    if (count <= 0 || count > TX_BATCH_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    //Retreive config profile response
-    char *ch = "#";
-    char *ret;
-    ret = (char *)memmem(recv_buf, sizeof(recv_buf), ch, 1) + 1;
-    configProfile = atoi(ret);
+    //Construct payload into s_tx_buf, guarded by the connection lock
+    xSemaphoreTake(s_conn_lock, portMAX_DELAY);
+    const char *payload;
+    int payload_len = construct_payload(samples, count, &payload);
+    if (payload_len < 0) {
+        xSemaphoreGive(s_conn_lock);
+        return ESP_ERR_INVALID_SIZE;
+    }
 
-    //Return   
-    free(payload);
-    vTaskResume(transmitTaskHandle);
-    vTaskDelete(NULL); 
-}       
+    //HTTP call, then retreive config profile response
+    bool accepted = http_exchange(payload, payload_len);
+    if (accepted && s_resp.profile >= 0) {
+        profile_received(s_resp.profile);
+    }
+    xSemaphoreGive(s_conn_lock);
+
+    //Return
+    return accepted ? ESP_OK : ESP_FAIL;
+}
 
 //****************************************************************************
 //Private Functions
@@ -145,6 +414,7 @@ static void start()
     s_example_esp_netif = netif;
 
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &on_got_ip, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &on_wifi_disconnect, NULL));
 
     ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_FLASH));
     wifi_config_t wifi_config = {
@@ -168,31 +438,663 @@ static void on_got_ip(void *arg, esp_event_base_t event_base,
     xEventGroupSetBits(s_connect_event_group, GOT_IPV4_BIT);
 }
 
+/**
+ * @brief Marks the link down so samples go to the journal, and keeps retrying the access point
+ */
+static void on_wifi_disconnect(void *arg, esp_event_base_t event_base,
+                               int32_t event_id, void *event_data)
+{
+    xEventGroupClearBits(s_connect_event_group, GOT_IPV4_BIT);
+    esp_wifi_connect();
+}
+
+
+/**
+ * @brief Structures an HTTP call carrying a batch of samples into s_tx_buf without allocating
+ *  -packet format is hard coded for what our software expects in an HTTP call:
+ *   POST / with a form body "count=N&sensor_id=..&measurement=..&sensor_id=..&measurement=.."
+ *   listing every sample in order, a sensor may appear more than once. A window summary follows its
+ *   measurement (the window's last reading) with "&n=..&min=..&max=..&mean=..&std=..". Readings and
+ *   statistics are signed decimals with PAYLOAD_DECIMALS places, e.g. "measurement=-3.50", and an alarm
+ *   ends with "&alarm=1". With PAYLOAD_FORMAT set to
+ *   PAYLOAD_FORMAT_CBOR the body is instead the binary batch from payload_cbor_encode_batch()
+ *  -the body is written first at PAYLOAD_HEADER_LEN, then the headers are placed directly in front
+ *   of it once Content-Length is known. Returns the request length, or -1 if it doesn't fit
+ */
+static int construct_payload(const sensor_struct *samples, int count, const char **payload){
+
+    payload_writer body;
+
+    payload_init(&body, s_tx_buf + PAYLOAD_HEADER_LEN, PAYLOAD_BODY_LEN);
+    construct_body(&body, samples, count);
+#if PAYLOAD_FORMAT == PAYLOAD_FORMAT_CBOR
+    return construct_request("/", "application/cbor", &body, payload);
+#else
+    return construct_request("/", "application/x-www-form-urlencoded", &body, payload);
+#endif
+}
 
 /**
- * @brief Structures an HTTP call
- *  -packet format is hard coded for what our software expects in an HTTP call
+ * @brief Places the headers of a POST to path directly in front of a body already written at
+ *  s_tx_buf + PAYLOAD_HEADER_LEN. Returns the request length, or -1 if it doesn't fit
  */
-static char* construct_payload(int id, int value){
+static int construct_request(const char *path, const char *content_type, const payload_writer *body, const char **payload){
 
-    char *payload = malloc(150);
-    char *id_str = malloc(12);
-    char *val_str = malloc(12);
-    sprintf(id_str,"%d", id);
-    sprintf(val_str,"%d", value);
+    payload_writer head;
+    char header[PAYLOAD_HEADER_LEN];
 
-    payload[0] = '\0';
-    strcat(payload,"GET /?sensor_id=");
-    strcat(payload, id_str);
-    strcat(payload,"&measurement=");
-    strcat(payload,val_str);
-    strcat(payload," HTTP/1.0\r\n"
+    payload_init(&head, header, sizeof(header));
+    payload_append_str(&head, "POST ");
+    payload_append_str(&head, path);
+    payload_append_str(&head, " HTTP/1.1\r\n"
     "Host: "WEB_SERVER":"WEB_PORT"\r\n"
     "User-Agent: esp-idf/1.0 esp32\r\n"
-    "\r\n");
+    "Connection: keep-alive\r\n"
+    "Content-Type: ");
+    payload_append_str(&head, content_type);
+    payload_append_str(&head, "\r\nContent-Length: ");
+    payload_append_int(&head, body->len);
+    payload_append_str(&head, "\r\n\r\n");
+
+    if (body->overflow || head.overflow){
+        return -1;
+    }
+    char *start = s_tx_buf + PAYLOAD_HEADER_LEN - head.len;
+    memcpy(start, header, head.len);
+    *payload = start;
+    return (int)(head.len + body->len);
+}
+
+/**
+ * @brief Encodes a batch in PAYLOAD_FORMAT, shared by every transport. Sample times go out as
+ *  monotonic ms relative to the first sample (base_ms); utc_ms is UTC at base_ms, or 0 while the
+ *  clock isn't synchronized
+ */
+static void construct_body(payload_writer *body, const sensor_struct *samples, int count)
+{
+    int64_t utc_ms = count > 0 ? time_sync_utc_us(samples[0].timestamp) / 1000 : 0;
+#if PAYLOAD_FORMAT == PAYLOAD_FORMAT_CBOR
+    payload_cbor_encode_batch(body, s_device_id, utc_ms, samples, count);
+#else
+    int64_t base_ms = count > 0 ? samples[0].timestamp / 1000 : 0;
+    payload_append_str(body, "count=");
+    payload_append_int(body, count);
+    payload_append_str(body, "&base_ms=");
+    payload_append_int(body, base_ms);
+    payload_append_str(body, "&utc_ms=");
+    payload_append_int(body, utc_ms);
+    for (int i = 0; i < count; i++){
+        payload_append_str(body, "&sensor_id=");
+        payload_append_int(body, samples[i].id);
+        payload_append_str(body, "&dt_ms=");
+        payload_append_int(body, samples[i].timestamp / 1000 - base_ms);
+        payload_append_str(body, "&measurement=");
+        payload_append_fixed(body, samples[i].value, SENSOR_VALUE_FRAC_BITS, PAYLOAD_DECIMALS);
+        if (samples[i].count > 0){
+            payload_append_str(body, "&n=");
+            payload_append_int(body, samples[i].count);
+            payload_append_str(body, "&min=");
+            payload_append_fixed(body, samples[i].min, SENSOR_VALUE_FRAC_BITS, PAYLOAD_DECIMALS);
+            payload_append_str(body, "&max=");
+            payload_append_fixed(body, samples[i].max, SENSOR_VALUE_FRAC_BITS, PAYLOAD_DECIMALS);
+            payload_append_str(body, "&mean=");
+            payload_append_fixed(body, samples[i].mean, SENSOR_VALUE_FRAC_BITS, PAYLOAD_DECIMALS);
+            payload_append_str(body, "&std=");
+            payload_append_fixed(body, samples[i].stddev, SENSOR_VALUE_FRAC_BITS, PAYLOAD_DECIMALS);
+        }
+        if (samples[i].flags & SENSOR_FLAG_ALARM){
+            payload_append_str(body, "&alarm=1");
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Sends a request from s_tx_buf over the keep-alive connection and reads its response into
+ *  s_resp, retried once on a fresh socket if the server dropped an idle keep-alive connection.
+ *  Caller holds the connection lock. Returns true on a 2xx response
+ */
+static bool http_exchange(const char *payload, int payload_len)
+{
+    int s, r = -1;
+    bool reused;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        reused = (s_sock >= 0);
+        s = conn_acquire();
+        if (s < 0) {
+            break;
+        }
+        s_write_us = esp_timer_get_time();
+        bool written = (write(s, payload, payload_len) == payload_len);
+        int64_t written_us = esp_timer_get_time();
+        pipeline_stats_record(PIPELINE_WRITE, s_write_us, written_us);
+        if (written) {
+            r = conn_read_response(s, &s_resp);
+            if (r >= 0) {
+                pipeline_stats_record(PIPELINE_RESPONSE, written_us, esp_timer_get_time());
+                break;
+            }
+        }
+        conn_close();
+        if (!reused) {
+            break;
+        }
+    }
+    return r == 0 && s_resp.status / 100 == 2;
+}
+
+/**
+ * @brief Points body at the transmit buffer, sized to the stats one message of the transport
+ *  carries
+ */
+static void stats_body_init(payload_writer *body)
+{
+#if NETWORK_TRANSPORT == NETWORK_TRANSPORT_MQTT
+    payload_init(body, s_tx_buf, PAYLOAD_BODY_LEN);
+#elif NETWORK_TRANSPORT == NETWORK_TRANSPORT_COAP
+    payload_init(body, s_tx_buf, COAP_PAYLOAD_MAX);
+#else
+    payload_init(body, s_tx_buf + PAYLOAD_HEADER_LEN, PAYLOAD_BODY_LEN);
+#endif
+}
+
+/**
+ * @brief Sends one stats message holding body, s_conn_lock held
+ */
+static esp_err_t stats_send(const payload_writer *body)
+{
+#if NETWORK_TRANSPORT == NETWORK_TRANSPORT_MQTT
+    return mqtt_publish_body(s_topic_stats, body, 0);
+#elif NETWORK_TRANSPORT == NETWORK_TRANSPORT_COAP
+    return coap_post_body(s_path_stats, body, false);
+#else
+    const char *payload;
+    int payload_len = construct_request(STATS_PATH, "application/x-www-form-urlencoded", body, &payload);
+    return (payload_len < 0) ? ESP_ERR_INVALID_SIZE : (http_exchange(payload, payload_len) ? ESP_OK : ESP_FAIL);
+#endif
+}
+
+/**
+ * @brief Stats source (network_stats_source) for the transport's own client, one group:
+ *   mqtt=client&connects=<n>&published_qos0=<n>&published_qos1=<n>&acked=<n>&redelivered=<n>
+ *   &received=<n>
+ *   coap=client&sent_non=<n>&sent_con=<n>&acked=<n>&retransmitted=<n>&lost=<n>&reset=<n>
+ *   &received=<n>
+ *   config=stream&connects=<n>&failures=<n>&lines=<n>
+ *  HTTP without CONFIG_STREAM has no client to report
+ */
+static bool encode_link_stats(payload_writer *w, int group)
+{
+#if NETWORK_TRANSPORT == NETWORK_TRANSPORT_MQTT
+    mqtt_client_stats mqtt;
+
+    if (group > 0) {
+        return false;
+    }
+    mqtt_client_get_stats(&mqtt);
+    payload_append_str(w, "mqtt=client");
+    payload_append_field(w, "connects", mqtt.connects);
+    payload_append_field(w, "published_qos0", mqtt.published_qos0);
+    payload_append_field(w, "published_qos1", mqtt.published_qos1);
+    payload_append_field(w, "acked", mqtt.acked);
+    payload_append_field(w, "redelivered", mqtt.redelivered);
+    payload_append_field(w, "received", mqtt.received);
+    return true;
+#elif NETWORK_TRANSPORT == NETWORK_TRANSPORT_COAP
+    coap_client_stats coap;
+
+    if (group > 0) {
+        return false;
+    }
+    coap_client_get_stats(&coap);
+    payload_append_str(w, "coap=client");
+    payload_append_field(w, "sent_non", coap.sent_non);
+    payload_append_field(w, "sent_con", coap.sent_con);
+    payload_append_field(w, "acked", coap.acked);
+    payload_append_field(w, "retransmitted", coap.retransmitted);
+    payload_append_field(w, "lost", coap.lost);
+    payload_append_field(w, "reset", coap.reset);
+    payload_append_field(w, "received", coap.received);
+    return true;
+#elif CONFIG_STREAM
+    config_stream_stats stream;
+
+    if (group > 0) {
+        return false;
+    }
+    config_stream_get_stats(&stream);
+    payload_append_str(w, "config=stream");
+    payload_append_field(w, "connects", stream.connects);
+    payload_append_field(w, "failures", stream.failures);
+    payload_append_field(w, "lines", stream.lines);
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if NETWORK_TRANSPORT == NETWORK_TRANSPORT_MQTT
+/**
+ * @brief Names the session and topics after the station MAC and starts the MQTT client
+ */
+static esp_err_t mqtt_start(void)
+{
+    char mac[2 * PAYLOAD_DEVICE_ID_LEN + 1];
+
+    for (int i = 0; i < PAYLOAD_DEVICE_ID_LEN; i++){
+        snprintf(&mac[2 * i], 3, "%02x", s_device_id[i]);
+    }
+    snprintf(s_client_id, sizeof(s_client_id), "capstone-%s", mac);
+    snprintf(s_topic_telemetry, sizeof(s_topic_telemetry), MQTT_TOPIC_ROOT "%s/telemetry", mac);
+    snprintf(s_topic_alarm, sizeof(s_topic_alarm), MQTT_TOPIC_ROOT "%s/alarm", mac);
+    snprintf(s_topic_config, sizeof(s_topic_config), MQTT_TOPIC_ROOT "%s/config", mac);
+    snprintf(s_topic_stats, sizeof(s_topic_stats), MQTT_TOPIC_ROOT "%s/stats", mac);
+
+    const mqtt_client_config config = {
+        .host = MQTT_BROKER,
+        .port = MQTT_PORT,
+        .client_id = s_client_id,
+        .keepalive_s = MQTT_KEEPALIVE_S,
+        .subscribe = s_topic_config,
+        .on_message = on_config,
+    };
+    return mqtt_client_start(&config);
+}
+
+/**
+ * @brief Publishes a batch without waiting on the broker: each alarm on its own at QoS 1, everything else
+ *  as one QoS 0 telemetry message. Alarms already taken into the session stay there if the telemetry
+ *  publish fails, so a journaled batch may deliver an alarm twice
+ */
+static esp_err_t mqtt_transmit(const sensor_struct *samples, int count)
+{
+    payload_writer body;
+    esp_err_t err = ESP_OK;
+    int plain = 0;
+
+    if (count <= 0 || count > TX_BATCH_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(s_conn_lock, portMAX_DELAY);
+    s_write_us = esp_timer_get_time(); //Publishes go straight to the socket
+    for (int i = 0; i < count; i++){
+        if (!(samples[i].flags & SENSOR_FLAG_ALARM)){
+            s_telemetry[plain++] = samples[i];
+            continue;
+        }
+        payload_init(&body, s_tx_buf, sizeof(s_tx_buf));
+        construct_body(&body, &samples[i], 1);
+        esp_err_t r = mqtt_publish_body(s_topic_alarm, &body, 1);
+        err = (err == ESP_OK) ? r : err;
+    }
+    if (plain > 0){
+        payload_init(&body, s_tx_buf, sizeof(s_tx_buf));
+        construct_body(&body, s_telemetry, plain);
+        esp_err_t r = mqtt_publish_body(s_topic_telemetry, &body, 0);
+        err = (err == ESP_OK) ? r : err;
+    }
+    xSemaphoreGive(s_conn_lock);
+    return err;
+}
+
+/**
+ * @brief Publishes a body the caller built, timing the hand-off to the socket. Caller holds the connection lock
+ */
+static esp_err_t mqtt_publish_body(const char *topic, const payload_writer *body, int qos)
+{
+    if (body->overflow) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = mqtt_client_publish(topic, body->buf, body->len, qos);
+    pipeline_stats_record(PIPELINE_WRITE, start, esp_timer_get_time());
+    return err;
+}
+
+/**
+ * @brief Config topic: carries the same config lines as the HTTP config stream
+ */
+static void on_config(const char *topic, size_t topic_len, const uint8_t *payload, size_t len)
+{
+    apply_config(payload, len);
+}
+#elif NETWORK_TRANSPORT == NETWORK_TRANSPORT_COAP
+/**
+ * @brief Names the resources after the station MAC and starts the CoAP client
+ */
+static esp_err_t coap_start(void)
+{
+    char mac[2 * PAYLOAD_DEVICE_ID_LEN + 1];
+
+    for (int i = 0; i < PAYLOAD_DEVICE_ID_LEN; i++){
+        snprintf(&mac[2 * i], 3, "%02x", s_device_id[i]);
+    }
+    snprintf(s_path_telemetry, sizeof(s_path_telemetry), COAP_PATH_ROOT "%s/telemetry", mac);
+    snprintf(s_path_alarm, sizeof(s_path_alarm), COAP_PATH_ROOT "%s/alarm", mac);
+    snprintf(s_path_stats, sizeof(s_path_stats), COAP_PATH_ROOT "%s/stats", mac);
+
+    const coap_client_config config = {
+        .host = COAP_SERVER,
+        .port = COAP_PORT,
+#if PAYLOAD_FORMAT == PAYLOAD_FORMAT_CBOR
+        .content_format = COAP_FORMAT_CBOR,
+#else
+        .content_format = COAP_FORMAT_NONE,
+#endif
+        .on_message = on_response,
+    };
+    return coap_client_start(&config);
+}
+
+/**
+ * @brief Sends each alarm as its own confirmable POST and packs everything else into as few
+ *  non-confirmable datagrams as COAP_PAYLOAD_MAX allows, one per batch when it fits. Nothing waits for
+ *  the server, so a lost telemetry datagram is simply lost; alarms are retransmitted by the client
+ */
+static esp_err_t coap_transmit(const sensor_struct *samples, int count)
+{
+    payload_writer body;
+    esp_err_t err = ESP_OK;
+    int plain = 0;
+
+    if (count <= 0 || count > TX_BATCH_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(s_conn_lock, portMAX_DELAY);
+    s_write_us = esp_timer_get_time(); //Datagrams go straight to the socket, unless a CON waits its turn
+    for (int i = 0; i < count; i++){
+        if (!(samples[i].flags & SENSOR_FLAG_ALARM)){
+            s_telemetry[plain++] = samples[i];
+            continue;
+        }
+        payload_init(&body, s_tx_buf, COAP_PAYLOAD_MAX);
+        construct_body(&body, &samples[i], 1);
+        esp_err_t r = coap_post_body(s_path_alarm, &body, true);
+        err = (err == ESP_OK) ? r : err;
+    }
+    for (int start = 0; start < plain; ){
+        //Measure the rest in the full buffer, then shrink the run until it fits a datagram
+        int n = plain - start;
+        while (1){
+            payload_init(&body, s_tx_buf, sizeof(s_tx_buf));
+            construct_body(&body, &s_telemetry[start], n);
+            if (body.overflow || body.len <= COAP_PAYLOAD_MAX || n == 1){
+                break;
+            }
+            int fit = (int)((size_t)n * COAP_PAYLOAD_MAX / body.len);
+            n = (fit < n) ? (fit > 0 ? fit : 1) : n - 1;
+        }
+        esp_err_t r = coap_post_body(s_path_telemetry, &body, false);
+        err = (err == ESP_OK) ? r : err;
+        start += n;
+    }
+    xSemaphoreGive(s_conn_lock);
+    return err;
+}
+
+/**
+ * @brief Posts a body the caller built if it fits a datagram, timing the hand-off to the socket.
+ *  Caller holds the connection lock
+ */
+static esp_err_t coap_post_body(const char *path, const payload_writer *body, bool confirmable)
+{
+    if (body->overflow || body->len > COAP_PAYLOAD_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = coap_client_post(path, body->buf, body->len, confirmable);
+    pipeline_stats_record(PIPELINE_WRITE, start, esp_timer_get_time());
+    return err;
+}
+
+/**
+ * @brief Responses carry the same config lines as the HTTP config stream
+ */
+static void on_response(const uint8_t *payload, size_t len)
+{
+    apply_config(payload, len);
+}
+#endif
+
+#if NETWORK_TRANSPORT == NETWORK_TRANSPORT_HTTP && CONFIG_STREAM
+/**
+ * @brief Opens the pushed config stream for this device next to the upload connection
+ */
+static esp_err_t stream_start(void)
+{
+    int n = snprintf(s_stream_path, sizeof(s_stream_path), CONFIG_STREAM_PATH);
+
+    for (int i = 0; i < PAYLOAD_DEVICE_ID_LEN; i++){
+        n += snprintf(&s_stream_path[n], sizeof(s_stream_path) - n, "%02x", s_device_id[i]);
+    }
+    const config_stream_config config = {
+        .host = WEB_SERVER,
+        .port = WEB_PORT,
+        .path = s_stream_path,
+        .idle_timeout_s = CONFIG_STREAM_IDLE_S,
+        .on_line = on_stream_line,
+    };
+    return config_stream_start(&config);
+}
+
+static void on_stream_line(const char *line, size_t len)
+{
+    apply_config((const uint8_t *)line, len);
+}
+#endif
+
+#if NETWORK_TRANSPORT != NETWORK_TRANSPORT_HTTP || CONFIG_STREAM
+/**
+ * @brief Applies a message pushed or returned by the server, line by line: a sensor rate
+ *  ("rate <sensor_id> <sample_ms> <tx_ms> <batch>") or deadband ("deadband <sensor_id> <abs>
+ *  <permille> <heartbeat_ms> [<alarm_low> <alarm_high>]"), both stored by sensor-config and taken
+ *  up by the sampler, "stats" to request a stats snapshot, or else the first "#<profile>" in the line
+ */
+static void apply_config(const uint8_t *payload, size_t len)
+{
+    for (size_t start = 0, end; start < len; start = end + 1){
+        int id, profile = -1;
+        sensor_rate rate;
+        sample_deadband deadband;
+
+        for (end = start; end < len && payload[end] != '\n'; end++){
+        }
+        if (sensor_config_parse((const char *)&payload[start], end - start, &id, &rate) == 0){
+            esp_err_t err = sensor_config_set(id, &rate);
+            if (err == ESP_OK){
+                config_changed();
+            } else {
+                ESP_LOGW("network", "rate for sensor %d rejected: %s", id, esp_err_to_name(err));
+            }
+            continue;
+        }
+        if (sensor_config_parse_deadband((const char *)&payload[start], end - start, &id, &deadband) == 0){
+            esp_err_t err = sensor_config_set_deadband(id, &deadband);
+            if (err == ESP_OK){
+                config_changed();
+            } else {
+                ESP_LOGW("network", "deadband for sensor %d rejected: %s", id, esp_err_to_name(err));
+            }
+            continue;
+        }
+        if (end - start == 5 && memcmp(&payload[start], "stats", 5) == 0){
+            atomic_store(&s_stats_requested, true);
+            if (s_stats_task != NULL){
+                xTaskNotifyGive(s_stats_task);
+            }
+            continue;
+        }
+        for (size_t i = start; i < end; i++){
+            if (payload[i] == '#' && i + 1 < end && payload[i + 1] >= '0' && payload[i + 1] <= '9'){
+                profile = 0;
+                for (i++; i < end && payload[i] >= '0' && payload[i] <= '9' && profile < 100000; i++){
+                    profile = profile * 10 + (payload[i] - '0');
+                }
+                break;
+            }
+        }
+        if (profile >= 0){
+            profile_received(profile);
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Every transport lands here with the profile the server asked for. A change is handed to the
+ *  watching task and wakes it; the same profile repeated in every reply costs nothing
+ */
+static void profile_received(int profile)
+{
+    if (atomic_exchange(&s_profile, profile) == profile){
+        return;
+    }
+    atomic_store(&s_profile_pending, profile);
+    config_changed();
+}
 
-    free(id_str);
-    free(val_str);
+static void config_changed(void)
+{
+    if (s_config_task != NULL){
+        xTaskNotifyGive(s_config_task);
+    }
+}
 
-    return payload;
-}
\ No newline at end of file
+/**
+ * @brief Resolves WEB_SERVER once and caches the address for every later reconnect
+ */
+static esp_err_t conn_resolve(void)
+{
+    const struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res;
+
+    if (s_server_resolved) {
+        return ESP_OK;
+    }
+    if (getaddrinfo(WEB_SERVER, WEB_PORT, &hints, &res) != 0 || res == NULL) {
+        return ESP_FAIL;
+    }
+    memcpy(&s_server_addr, res->ai_addr, sizeof(s_server_addr));
+    freeaddrinfo(res);
+    s_server_resolved = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief Returns the open keep-alive socket, connecting first if there is none.
+ *  A failed connect drops the cached address so the next attempt resolves again
+ */
+static int conn_acquire(void)
+{
+    if (s_sock >= 0) {
+        return s_sock;
+    }
+    int64_t start = esp_timer_get_time();
+    if (conn_resolve() != ESP_OK) {
+        return -1;
+    }
+
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s < 0) {
+        return -1;
+    }
+    if (conn_connect(s) != 0) {
+        close(s);
+        s_server_resolved = false;
+        return -1;
+    }
+    pipeline_stats_record(PIPELINE_CONNECT, start, esp_timer_get_time());
+
+    struct timeval receiving_timeout;
+    receiving_timeout.tv_sec = RECV_TIMEOUT_S;
+    receiving_timeout.tv_usec = 0;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &receiving_timeout, sizeof(receiving_timeout));
+
+    //Requests are single small writes, don't let Nagle hold them back waiting for the previous ACK
+    int nodelay = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    s_sock = s;
+    return s;
+}
+
+/**
+ * @brief Connects without blocking past CONNECT_TIMEOUT_MS, an unreachable server must not stall
+ *  the transmitter for the full TCP SYN retry sequence
+ */
+static int conn_connect(int s)
+{
+    int flags = fcntl(s, F_GETFL, 0);
+    fcntl(s, F_SETFL, flags | O_NONBLOCK);
+
+    int r = connect(s, (struct sockaddr *)&s_server_addr, sizeof(s_server_addr));
+    if (r != 0 && errno == EINPROGRESS) {
+        fd_set wfds;
+        struct timeval tv = {
+            .tv_sec = CONNECT_TIMEOUT_MS / 1000,
+            .tv_usec = (CONNECT_TIMEOUT_MS % 1000) * 1000,
+        };
+        int so_error = 0;
+        socklen_t len = sizeof(so_error);
+
+        FD_ZERO(&wfds);
+        FD_SET(s, &wfds);
+        r = -1;
+        if (select(s + 1, NULL, &wfds, NULL, &tv) == 1 &&
+            getsockopt(s, SOL_SOCKET, SO_ERROR, &so_error, &len) == 0 && so_error == 0) {
+            r = 0;
+        }
+    }
+    fcntl(s, F_SETFL, flags);
+    return r;
+}
+
+/**
+ * @brief Closes the keep-alive socket, the next transmit reconnects
+ */
+static void conn_close(void)
+{
+    if (s_sock >= 0) {
+        close(s_sock);
+        s_sock = -1;
+    }
+}
+
+/**
+ * @brief Reads exactly one HTTP response so the socket can be reused for the next request, feeding
+ *  it through the streaming parser a read at a time. The socket is closed unless the response
+ *  allows keep-alive. Returns 0 once the response is complete, or -1 on socket or parse error
+ */
+static int conn_read_response(int s, http_response *resp)
+{
+    bool trailing = false;
+
+    http_response_init(resp);
+    while (!http_response_done(resp)) {
+        int r = read(s, s_recv_buf, sizeof(s_recv_buf));
+        if (r < 0) {
+            return -1;
+        }
+        if (r == 0) {
+            if (http_response_finish(resp) != 0) {
+                return -1;
+            }
+            break;
+        }
+        int used = http_response_feed(resp, s_recv_buf, r);
+        if (used < 0) {
+            return -1;
+        }
+        trailing = (used < r);
+    }
+
+    //Bytes past the response mean the stream is out of step with our requests
+    if (!resp->keep_alive || trailing) {
+        conn_close();
+    }
+    return 0;
+}
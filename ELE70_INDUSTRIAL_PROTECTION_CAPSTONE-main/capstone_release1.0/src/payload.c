@@ -0,0 +1,244 @@
+#include <string.h>
+#include "payload.h"
+
+//Defines
+#define CBOR_UINT   0
+#define CBOR_NINT   1
+#define CBOR_BYTES  2
+#define CBOR_ARRAY  4
+
+//Public Function Declarations
+void payload_init(payload_writer *w, char *buf, size_t size);
+void payload_append_mem(payload_writer *w, const void *data, size_t len);
+void payload_append_str(payload_writer *w, const char *str);
+void payload_append_int(payload_writer *w, int64_t value);
+void payload_append_fixed(payload_writer *w, int32_t value, int frac_bits, int decimals);
+void payload_append_field(payload_writer *w, const char *name, int64_t value);
+void payload_rewind(payload_writer *w, size_t len);
+size_t payload_format_int(char *out, int64_t value);
+void payload_cbor_uint(payload_writer *w, uint64_t value);
+void payload_cbor_int(payload_writer *w, int64_t value);
+void payload_cbor_array(payload_writer *w, size_t count);
+void payload_cbor_bytes(payload_writer *w, const void *data, size_t len);
+void payload_cbor_encode_batch(payload_writer *w, const uint8_t *device_id, int64_t utc_ms, const sensor_struct *samples, int count);
+
+//Private Function Declarations
+static void cbor_head(payload_writer *w, uint8_t major, uint64_t value);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Points the writer at an empty buffer
+ */
+void payload_init(payload_writer *w, char *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->overflow = false;
+}
+
+/**
+ * @brief Appends len bytes, or flags overflow and leaves the buffer untouched
+ */
+void payload_append_mem(payload_writer *w, const void *data, size_t len)
+{
+    if (w->overflow || len > w->size - w->len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+/**
+ * @brief Appends a string without its terminator
+ */
+void payload_append_str(payload_writer *w, const char *str)
+{
+    payload_append_mem(w, str, strlen(str));
+}
+
+/**
+ * @brief Appends a signed decimal integer
+ */
+void payload_append_int(payload_writer *w, int64_t value)
+{
+    char digits[PAYLOAD_INT_MAX_DIGITS];
+    payload_append_mem(w, digits, payload_format_int(digits, value));
+}
+
+/**
+ * @brief Appends a signed fixed-point value with frac_bits fraction bits as a decimal rounded to
+ *  decimals places (at most 9), e.g. -896 with 8 bits and 2 places is "-3.50"
+ */
+void payload_append_fixed(payload_writer *w, int32_t value, int frac_bits, int decimals)
+{
+    uint64_t scale = 1, u = value < 0 ? 0 - (uint64_t)(int64_t)value : (uint64_t)value;
+    char digits[PAYLOAD_INT_MAX_DIGITS];
+
+    for (int i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    u = (u * scale + (1ull << frac_bits >> 1)) >> frac_bits;
+    if (value < 0 && u != 0) {
+        payload_append_mem(w, "-", 1);
+    }
+    payload_append_int(w, (int64_t)(u / scale));
+    if (decimals > 0) {
+        size_t n = payload_format_int(digits, (int64_t)(u % scale + scale));
+        digits[0] = '.';    //Leading 1 of the padding becomes the point
+        payload_append_mem(w, digits, n);
+    }
+}
+
+/**
+ * @brief Appends one integer form field, "&<name>=<value>"
+ */
+void payload_append_field(payload_writer *w, const char *name, int64_t value)
+{
+    payload_append_str(w, "&");
+    payload_append_str(w, name);
+    payload_append_str(w, "=");
+    payload_append_int(w, value);
+}
+
+/**
+ * @brief Cuts the writer back to its first len bytes and clears overflow, so a group of appends
+ *  that didn't fit can be undone whole from a length taken before it
+ */
+void payload_rewind(payload_writer *w, size_t len)
+{
+    if (len < w->len) {
+        w->len = len;
+    }
+    w->overflow = false;
+}
+
+/**
+ * @brief Formats value in decimal into out (at least PAYLOAD_INT_MAX_DIGITS bytes, not terminated)
+ *  and returns the number of characters written
+ */
+size_t payload_format_int(char *out, int64_t value)
+{
+    char tmp[PAYLOAD_INT_MAX_DIGITS];
+    size_t n = 0, len = 0;
+    uint64_t u = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+
+    do {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (value < 0) {
+        out[len++] = '-';
+    }
+    while (n > 0) {
+        out[len++] = tmp[--n];
+    }
+    return len;
+}
+
+/**
+ * @brief Appends a CBOR unsigned integer
+ */
+void payload_cbor_uint(payload_writer *w, uint64_t value)
+{
+    cbor_head(w, CBOR_UINT, value);
+}
+
+/**
+ * @brief Appends a CBOR integer, negative values use major type 1
+ */
+void payload_cbor_int(payload_writer *w, int64_t value)
+{
+    if (value < 0) {
+        cbor_head(w, CBOR_NINT, (uint64_t)(-1 - value));
+    } else {
+        cbor_head(w, CBOR_UINT, (uint64_t)value);
+    }
+}
+
+/**
+ * @brief Opens a CBOR array, the next count items are its elements
+ */
+void payload_cbor_array(payload_writer *w, size_t count)
+{
+    cbor_head(w, CBOR_ARRAY, count);
+}
+
+/**
+ * @brief Appends a CBOR byte string
+ */
+void payload_cbor_bytes(payload_writer *w, const void *data, size_t len)
+{
+    cbor_head(w, CBOR_BYTES, len);
+    payload_append_mem(w, data, len);
+}
+
+/**
+ * @brief Encodes a batch of samples from one device in the compact binary format. utc_ms maps the
+ *  first sample's timestamp to UTC, 0 when unknown
+ */
+void payload_cbor_encode_batch(payload_writer *w, const uint8_t *device_id, int64_t utc_ms, const sensor_struct *samples, int count)
+{
+    int64_t base_ms = count > 0 ? samples[0].timestamp / 1000 : 0;
+
+    payload_cbor_array(w, 5);
+    payload_cbor_uint(w, PAYLOAD_CBOR_VERSION);
+    payload_cbor_bytes(w, device_id, PAYLOAD_DEVICE_ID_LEN);
+    payload_cbor_int(w, base_ms);
+    payload_cbor_int(w, utc_ms);
+    payload_cbor_array(w, count);
+    for (int i = 0; i < count; i++) {
+        const sensor_struct *s = &samples[i];
+        payload_cbor_array(w, (s->count > 0 ? 8 : 3) + (s->flags != 0 ? 1 : 0));
+        payload_cbor_int(w, s->id);
+        payload_cbor_int(w, s->timestamp / 1000 - base_ms);
+        payload_cbor_int(w, s->value);
+        if (s->count > 0) {
+            payload_cbor_uint(w, s->count);
+            payload_cbor_int(w, s->min);
+            payload_cbor_int(w, s->max);
+            payload_cbor_int(w, s->mean);
+            payload_cbor_int(w, s->stddev);
+        }
+        if (s->flags != 0) {
+            payload_cbor_uint(w, s->flags);
+        }
+    }
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+/**
+ * @brief Writes a CBOR item head using the shortest argument encoding
+ */
+static void cbor_head(payload_writer *w, uint8_t major, uint64_t value)
+{
+    uint8_t head[9];
+    size_t n;
+
+    if (value < 24) {
+        head[0] = (uint8_t)(major << 5 | value);
+        n = 0;
+    } else if (value <= UINT8_MAX) {
+        head[0] = (uint8_t)(major << 5 | 24);
+        n = 1;
+    } else if (value <= UINT16_MAX) {
+        head[0] = (uint8_t)(major << 5 | 25);
+        n = 2;
+    } else if (value <= UINT32_MAX) {
+        head[0] = (uint8_t)(major << 5 | 26);
+        n = 4;
+    } else {
+        head[0] = (uint8_t)(major << 5 | 27);
+        n = 8;
+    }
+    for (size_t i = 0; i < n; i++) {
+        head[n - i] = (uint8_t)(value >> (8 * i));
+    }
+    payload_append_mem(w, head, n + 1);
+}
@@ -0,0 +1,86 @@
+#include "pipeline-stats.h"
+
+//Private Variables
+static latency_hist s_stages[PIPELINE_STAGES];
+static const char *const s_names[PIPELINE_STAGES] = {
+    [PIPELINE_SAMPLE_TO_ENQUEUE] = "sample_to_enqueue",
+    [PIPELINE_ENQUEUE_TO_TX] = "enqueue_to_tx",
+    [PIPELINE_CONNECT] = "connect",
+    [PIPELINE_WRITE] = "write",
+    [PIPELINE_RESPONSE] = "response",
+};
+
+//Public Function Declarations
+void pipeline_stats_record(pipeline_stage stage, int64_t start_us, int64_t end_us);
+void pipeline_stats_get(pipeline_stage stage, latency_hist_snapshot *snap);
+const char *pipeline_stats_name(pipeline_stage stage);
+bool pipeline_stats_encode(payload_writer *w, int group);
+void pipeline_stats_encode_hist(payload_writer *w, const latency_hist_snapshot *snap);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Counts one pass through a stage. A clock read that went backwards counts as 0 us
+ */
+void pipeline_stats_record(pipeline_stage stage, int64_t start_us, int64_t end_us)
+{
+    int64_t us = end_us - start_us;
+
+    latency_hist_record(&s_stages[stage], us <= 0 ? 0 : (us > UINT32_MAX ? UINT32_MAX : (uint32_t)us));
+}
+
+void pipeline_stats_get(pipeline_stage stage, latency_hist_snapshot *snap)
+{
+    latency_hist_snapshot_get(&s_stages[stage], snap);
+}
+
+const char *pipeline_stats_name(pipeline_stage stage)
+{
+    return s_names[stage];
+}
+
+/**
+ * @brief Stats source (network_stats_source) writing stage group's histogram as one form group,
+ *  stage=<name> followed by pipeline_stats_encode_hist(). Returns false once group is past the last
+ *  stage
+ */
+bool pipeline_stats_encode(payload_writer *w, int group)
+{
+    latency_hist_snapshot snap;
+
+    if (group >= PIPELINE_STAGES) {
+        return false;
+    }
+    pipeline_stats_get(group, &snap);
+    payload_append_str(w, "stage=");
+    payload_append_str(w, s_names[group]);
+    pipeline_stats_encode_hist(w, &snap);
+    return true;
+}
+
+/**
+ * @brief Appends a histogram as form fields, at most PIPELINE_STATS_HIST_LEN:
+ *   &n=<count>&p50=<us>&p90=<us>&p99=<us>&max=<us>&buckets=<b0>,<b1>,...
+ *  Percentiles are bucket upper bounds (see latency_hist_percentile()), buckets stop at the last
+ *  non-empty one
+ */
+void pipeline_stats_encode_hist(payload_writer *w, const latency_hist_snapshot *snap)
+{
+    payload_append_field(w, "n", snap->count);
+    payload_append_field(w, "p50", latency_hist_percentile(snap, 50));
+    payload_append_field(w, "p90", latency_hist_percentile(snap, 90));
+    payload_append_field(w, "p99", latency_hist_percentile(snap, 99));
+    payload_append_field(w, "max", snap->max_us);
+    payload_append_str(w, "&buckets=");
+    int last = LATENCY_HIST_BUCKETS - 1;
+    while (last > 0 && snap->buckets[last] == 0) {
+        last--;
+    }
+    for (int b = 0; b <= last; b++) {
+        if (b > 0) {
+            payload_append_str(w, ",");
+        }
+        payload_append_int(w, snap->buckets[b]);
+    }
+}
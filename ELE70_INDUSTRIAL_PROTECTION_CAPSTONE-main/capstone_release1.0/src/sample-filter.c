@@ -0,0 +1,173 @@
+#include <string.h>
+#include "sample-filter.h"
+
+//Defines
+#define FILTER_IIR_SHIFT_MAX 16
+
+typedef struct {
+    sample_filter_stage config;
+    uint8_t fill;       //Median: readings held. IIR: primed. Decimate: readings summed
+    uint8_t head;       //Median: next slot of history to overwrite, the oldest once full
+    sensor_value history[SAMPLE_FILTER_MEDIAN_MAX];    //Median: readings in arrival order
+    sensor_value sorted[SAMPLE_FILTER_MEDIAN_MAX];     //Median: the same readings in ascending order
+    int64_t acc;        //IIR: output scaled by 2^param. Decimate: running sum
+} filter_stage;
+
+typedef struct {
+    int count;
+    filter_stage stages[SAMPLE_FILTER_STAGES];
+} filter_chain;
+
+//Private Variables
+static filter_chain s_chains[SAMPLE_FILTER_CHANNELS];
+
+//Public Function Declarations
+esp_err_t sample_filter_configure(int channel, const sample_filter_stage *stages, int count);
+void sample_filter_reset(int channel);
+bool sample_filter_apply(int channel, sensor_value *value);
+
+//Private Function Declarations
+static sensor_value median_push(filter_stage *stage, sensor_value x);
+static sensor_value iir_push(filter_stage *stage, sensor_value x);
+static bool decimate_push(filter_stage *stage, sensor_value *x);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Replaces a channel's chain and clears its state. count 0 passes readings through untouched.
+ *  A median must be odd so it has a middle reading
+ */
+esp_err_t sample_filter_configure(int channel, const sample_filter_stage *stages, int count)
+{
+    if (channel < 0 || channel >= SAMPLE_FILTER_CHANNELS || count < 0 || count > SAMPLE_FILTER_STAGES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < count; i++) {
+        const sample_filter_stage *stage = &stages[i];
+        if ((stage->kind == FILTER_MEDIAN && ((stage->param & 1) == 0 || stage->param > SAMPLE_FILTER_MEDIAN_MAX)) ||
+            (stage->kind == FILTER_IIR && stage->param > FILTER_IIR_SHIFT_MAX) ||
+            (stage->kind == FILTER_DECIMATE && stage->param < 1) ||
+            stage->kind > FILTER_DECIMATE) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    filter_chain *chain = &s_chains[channel];
+    memset(chain, 0, sizeof(*chain));
+    for (int i = 0; i < count; i++) {
+        chain->stages[i].config = stages[i];
+    }
+    chain->count = count;
+    return ESP_OK;
+}
+
+/**
+ * @brief Forgets a channel's history, e.g. when its sensor is plugged in again
+ */
+void sample_filter_reset(int channel)
+{
+    if (channel < 0 || channel >= SAMPLE_FILTER_CHANNELS) {
+        return;
+    }
+    filter_chain *chain = &s_chains[channel];
+    for (int i = 0; i < chain->count; i++) {
+        filter_stage *stage = &chain->stages[i];
+        stage->fill = 0;
+        stage->head = 0;
+        stage->acc = 0;
+    }
+}
+
+/**
+ * @brief Runs one reading through the channel's chain in place. Returns false if a decimation stage
+ *  absorbed it, in which case there is no output this time
+ */
+bool sample_filter_apply(int channel, sensor_value *value)
+{
+    if (channel < 0 || channel >= SAMPLE_FILTER_CHANNELS) {
+        return true;
+    }
+    filter_chain *chain = &s_chains[channel];
+    for (int i = 0; i < chain->count; i++) {
+        filter_stage *stage = &chain->stages[i];
+        switch (stage->config.kind) {
+            case FILTER_MEDIAN:
+                *value = median_push(stage, *value);
+                break;
+            case FILTER_IIR:
+                *value = iir_push(stage, *value);
+                break;
+            case FILTER_DECIMATE:
+                if (!decimate_push(stage, value)) {
+                    return false;
+                }
+                break;
+        }
+    }
+    return true;
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+/**
+ * @brief Drops the oldest reading from the sorted window and inserts the new one, O(width). Until the
+ *  window fills the median of what it holds is used
+ */
+static sensor_value median_push(filter_stage *stage, sensor_value x)
+{
+    uint8_t width = stage->config.param;
+    int i;
+
+    if (stage->fill == width) {
+        sensor_value old = stage->history[stage->head];
+        for (i = 0; stage->sorted[i] != old; i++) {
+        }
+        memmove(&stage->sorted[i], &stage->sorted[i + 1], (size_t)(stage->fill - 1 - i) * sizeof(sensor_value));
+        stage->fill--;
+    }
+    stage->history[stage->head] = x;
+    stage->head = (uint8_t)((stage->head + 1) % width);
+    for (i = stage->fill; i > 0 && stage->sorted[i - 1] > x; i--) {
+        stage->sorted[i] = stage->sorted[i - 1];
+    }
+    stage->sorted[i] = x;
+    stage->fill++;
+    return stage->sorted[(stage->fill - 1) / 2];
+}
+
+/**
+ * @brief acc holds y * 2^k, so acc += x - y is y += (x - y) / 2^k without losing the low bits. The
+ *  first reading primes the filter instead of ramping up from zero
+ */
+static sensor_value iir_push(filter_stage *stage, sensor_value x)
+{
+    uint8_t k = stage->config.param;
+
+    if (!stage->fill) {
+        stage->acc = (int64_t)x << k;
+        stage->fill = 1;
+    } else {
+        stage->acc += x - (stage->acc >> k);
+    }
+    return (sensor_value)((stage->acc + (k ? 1 << (k - 1) : 0)) >> k);
+}
+
+/**
+ * @brief Sums readings and emits their rounded mean every param readings. Averaging N readings of
+ *  uncorrelated noise keeps log2(N)/2 extra bits, which the fraction bits of sensor_value hold
+ */
+static bool decimate_push(filter_stage *stage, sensor_value *x)
+{
+    uint8_t n = stage->config.param;
+
+    stage->acc += *x;
+    if (++stage->fill < n) {
+        return false;
+    }
+    *x = (sensor_value)((stage->acc >= 0 ? stage->acc + n / 2 : stage->acc - n / 2) / n);
+    stage->acc = 0;
+    stage->fill = 0;
+    return true;
+}
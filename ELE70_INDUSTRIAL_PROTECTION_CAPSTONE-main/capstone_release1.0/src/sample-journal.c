@@ -0,0 +1,387 @@
+#include <string.h>
+#include <sys/param.h>
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "sample-journal.h"
+#include "time-sync.h"
+
+/*
+ * Flash layout: the partition is a circular log of 4 KB sectors. Slot 0 of each sector holds a
+ * header with an increasing sequence number, slots 1..JOURNAL_RECORDS_PER_SECTOR hold records.
+ * Sectors are filled in order and erased only when the log wraps onto them, so every sector
+ * sees the same number of erase cycles. Record state only ever clears bits:
+ *   0xFFFF erased -> 0x7FFF written -> 0x0000 drained (the whole record is zeroed)
+ */
+
+//Defines
+#define JOURNAL_MAGIC               0x334E524A //"JRN3", UTC stamped summaries. "JRNL" and "JRN2" sectors are ignored
+#define JOURNAL_SECTOR_SIZE         SPI_FLASH_SEC_SIZE
+#define JOURNAL_RECORD_SIZE         48
+#define JOURNAL_RECORDS_PER_SECTOR  (JOURNAL_SECTOR_SIZE / JOURNAL_RECORD_SIZE - 1)
+#define STATE_ERASED                0xFFFF
+#define STATE_WRITTEN               0x7FFF
+
+typedef struct {
+    int64_t timestamp;      //Monotonic, only meaningful during the boot that wrote it
+    int64_t utc_ms;         //The same instant in UTC, 0 if the clock wasn't synchronized yet
+    int32_t value;
+    uint32_t count;
+    int32_t min;
+    int32_t max;
+    int32_t mean;
+    int32_t stddev;
+    uint32_t flags;
+    uint16_t id;
+    uint16_t state;
+} journal_record;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t reserved[10];
+} journal_header;
+
+_Static_assert(sizeof(journal_record) == JOURNAL_RECORD_SIZE, "journal_record must fill one slot");
+_Static_assert(sizeof(journal_header) == JOURNAL_RECORD_SIZE, "journal_header must fill one slot");
+
+//Private Variables
+static const esp_partition_t *s_part;
+static uint32_t s_sectors;
+static uint32_t s_w_sector, s_w_slot, s_w_seq;  //Next slot to program
+static uint32_t s_r_sector, s_r_slot;           //Oldest undrained record
+static uint32_t s_pending;                      //Undrained records already in flash
+static journal_record s_chunk[JOURNAL_CHUNK_RECORDS];
+static int s_chunk_len;
+static journal_record s_io[JOURNAL_CHUNK_RECORDS];
+static journal_record s_zero[JOURNAL_CHUNK_RECORDS];
+static uint32_t s_appended, s_drained, s_dropped, s_erased;
+static int64_t s_drain_start, s_drain_last;
+static uint32_t s_drain_session;
+
+//Public Function Declarations
+esp_err_t sample_journal_init(void);
+esp_err_t sample_journal_append(const sensor_struct *sample);
+esp_err_t sample_journal_flush(void);
+int sample_journal_read(sensor_struct *samples, int max);
+esp_err_t sample_journal_consume(int count);
+uint32_t sample_journal_pending(void);
+void sample_journal_get_stats(sample_journal_stats *stats);
+
+//Private Function Declarations
+static size_t slot_offset(uint32_t sector, uint32_t slot);
+static esp_err_t start_sector(uint32_t sector, uint32_t seq);
+static esp_err_t advance_sector(void);
+static uint32_t scan_sector(uint32_t sector, uint32_t end_slot, bool find_first);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Finds the journal partition and recovers the write and drain positions from flash
+ */
+esp_err_t sample_journal_init(void)
+{
+    journal_header hdr;
+    bool found = false;
+    uint32_t newest = 0;
+
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, JOURNAL_PARTITION_LABEL);
+    if (s_part == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_chunk_len = 0;
+    s_sectors = s_part->size / JOURNAL_SECTOR_SIZE;
+    if (s_sectors < 2) {
+        s_part = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    //Newest sector carries the highest sequence number
+    for (uint32_t i = 0; i < s_sectors; i++) {
+        if (esp_partition_read(s_part, slot_offset(i, 0), &hdr, sizeof(hdr)) != ESP_OK) {
+            continue;
+        }
+        if (hdr.magic == JOURNAL_MAGIC && (!found || (int32_t)(hdr.seq - s_w_seq) > 0)) {
+            newest = i;
+            s_w_seq = hdr.seq;
+            found = true;
+        }
+    }
+    if (!found) {
+        s_pending = 0;
+        s_r_sector = 0;
+        s_r_slot = 1;
+        return start_sector(0, 1);
+    }
+    s_w_sector = newest;
+    s_w_slot = 1 + scan_sector(newest, JOURNAL_RECORDS_PER_SECTOR, false);
+
+    //Walk oldest to newest counting undrained records, the first one is where draining resumes
+    s_pending = 0;
+    s_r_sector = s_w_sector;
+    s_r_slot = s_w_slot;
+    for (uint32_t k = 1; k <= s_sectors; k++) {
+        uint32_t sector = (newest + k) % s_sectors;
+        if (esp_partition_read(s_part, slot_offset(sector, 0), &hdr, sizeof(hdr)) != ESP_OK || hdr.magic != JOURNAL_MAGIC) {
+            continue;
+        }
+        uint32_t end = (sector == newest) ? s_w_slot - 1 : JOURNAL_RECORDS_PER_SECTOR;
+        uint32_t first = scan_sector(sector, end, true);
+        if (first <= end) {
+            if (s_pending == 0) {
+                s_r_sector = sector;
+                s_r_slot = first;
+            }
+            s_pending += end + 1 - first;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Buffers a sample in RAM, programming flash a whole chunk at a time
+ */
+esp_err_t sample_journal_append(const sensor_struct *sample)
+{
+    if (s_part == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    journal_record *rec = &s_chunk[s_chunk_len++];
+    rec->timestamp = sample->timestamp;
+    rec->value = sample->value;
+    rec->count = sample->count;
+    rec->min = sample->min;
+    rec->max = sample->max;
+    rec->mean = sample->mean;
+    rec->stddev = sample->stddev;
+    rec->flags = sample->flags;
+    rec->utc_ms = time_sync_utc_us(sample->timestamp) / 1000;
+    rec->id = (uint16_t)sample->id;
+    rec->state = STATE_WRITTEN;
+    s_appended++;
+    if (s_chunk_len == JOURNAL_CHUNK_RECORDS) {
+        return sample_journal_flush();
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Programs the buffered records sequentially, wrapping to the next sector as needed
+ */
+esp_err_t sample_journal_flush(void)
+{
+    int written = 0;
+    esp_err_t err = ESP_OK;
+
+    if (s_part == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    while (written < s_chunk_len) {
+        if (s_w_slot > JOURNAL_RECORDS_PER_SECTOR && (err = advance_sector()) != ESP_OK) {
+            break;
+        }
+        uint32_t n = MIN((uint32_t)(s_chunk_len - written), JOURNAL_RECORDS_PER_SECTOR + 1 - s_w_slot);
+        err = esp_partition_write(s_part, slot_offset(s_w_sector, s_w_slot), &s_chunk[written], n * JOURNAL_RECORD_SIZE);
+        if (err != ESP_OK) {
+            break;
+        }
+        if (s_pending == 0) {
+            s_r_sector = s_w_sector;
+            s_r_slot = s_w_slot;
+        }
+        s_w_slot += n;
+        s_pending += n;
+        written += n;
+    }
+    s_chunk_len = 0;
+    return err;
+}
+
+/**
+ * @brief Copies up to max of the oldest undrained samples without consuming them. A sample stamped
+ *  in UTC gets its timestamp back on this boot's monotonic clock, negative if it predates the boot,
+ *  so it survives a reboot; one journaled before any sync keeps its raw timestamp
+ */
+int sample_journal_read(sensor_struct *samples, int max)
+{
+    uint32_t sector = s_r_sector, slot = s_r_slot;
+    int n = 0;
+
+    if (s_part == NULL || sample_journal_flush() != ESP_OK) {
+        return 0;
+    }
+    if (s_pending > 0 && s_drain_session == 0) {
+        s_drain_start = esp_timer_get_time();
+    }
+    while (n < max && (uint32_t)n < s_pending) {
+        if (slot > JOURNAL_RECORDS_PER_SECTOR) {
+            sector = (sector + 1) % s_sectors;
+            slot = 1;
+            continue;
+        }
+        uint32_t k = MIN(MIN((uint32_t)(max - n), s_pending - n), JOURNAL_RECORDS_PER_SECTOR + 1 - slot);
+        k = MIN(k, JOURNAL_CHUNK_RECORDS);
+        if (esp_partition_read(s_part, slot_offset(sector, slot), s_io, k * JOURNAL_RECORD_SIZE) != ESP_OK) {
+            break;
+        }
+        for (uint32_t i = 0; i < k; i++) {
+            samples[n].id = s_io[i].id;
+            samples[n].value = s_io[i].value;
+            samples[n].timestamp = (s_io[i].utc_ms != 0 && time_sync_valid()) ?
+                time_sync_mono_us(s_io[i].utc_ms * 1000) : s_io[i].timestamp;
+            samples[n].count = s_io[i].count;
+            samples[n].min = s_io[i].min;
+            samples[n].max = s_io[i].max;
+            samples[n].mean = s_io[i].mean;
+            samples[n].stddev = s_io[i].stddev;
+            samples[n].flags = s_io[i].flags;
+            n++;
+        }
+        slot += k;
+    }
+    return n;
+}
+
+/**
+ * @brief Marks the count oldest samples drained by zeroing them in place
+ */
+esp_err_t sample_journal_consume(int count)
+{
+    uint32_t left;
+
+    if (s_part == NULL || count < 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    left = MIN((uint32_t)count, s_pending);
+    while (left > 0) {
+        if (s_r_slot > JOURNAL_RECORDS_PER_SECTOR) {
+            s_r_sector = (s_r_sector + 1) % s_sectors;
+            s_r_slot = 1;
+            continue;
+        }
+        uint32_t k = MIN(MIN(left, JOURNAL_RECORDS_PER_SECTOR + 1 - s_r_slot), JOURNAL_CHUNK_RECORDS);
+        esp_err_t err = esp_partition_write(s_part, slot_offset(s_r_sector, s_r_slot), s_zero, k * JOURNAL_RECORD_SIZE);
+        if (err != ESP_OK) {
+            return err;
+        }
+        s_r_slot += k;
+        s_pending -= k;
+        s_drained += k;
+        s_drain_session += k;
+        left -= k;
+    }
+    s_drain_last = esp_timer_get_time();
+    if (s_pending == 0 && s_chunk_len == 0) {
+        s_drain_session = 0;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Samples waiting to be drained, including those still buffered in RAM
+ */
+uint32_t sample_journal_pending(void)
+{
+    return s_pending + s_chunk_len;
+}
+
+/**
+ * @brief Snapshot of flash usage and drain counters
+ */
+void sample_journal_get_stats(sample_journal_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (s_part == NULL) {
+        return;
+    }
+    stats->capacity_bytes = s_sectors * JOURNAL_RECORDS_PER_SECTOR * JOURNAL_RECORD_SIZE;
+    stats->pending = s_pending + s_chunk_len;
+    stats->used_bytes = stats->pending * JOURNAL_RECORD_SIZE;
+    stats->appended = s_appended;
+    stats->drained = s_drained;
+    stats->dropped = s_dropped;
+    stats->sectors_erased = s_erased;
+    if (s_drain_last > s_drain_start) {
+        stats->drain_samples_per_s = (uint32_t)((int64_t)s_drain_session * 1000000 / (s_drain_last - s_drain_start));
+    }
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+static size_t slot_offset(uint32_t sector, uint32_t slot)
+{
+    return (size_t)sector * JOURNAL_SECTOR_SIZE + (size_t)slot * JOURNAL_RECORD_SIZE;
+}
+
+/**
+ * @brief Erases a sector and stamps it with the next sequence number
+ */
+static esp_err_t start_sector(uint32_t sector, uint32_t seq)
+{
+    journal_header hdr = {
+        .magic = JOURNAL_MAGIC,
+        .seq = seq,
+    };
+    esp_err_t err = esp_partition_erase_range(s_part, slot_offset(sector, 0), JOURNAL_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_erased++;
+    err = esp_partition_write(s_part, slot_offset(sector, 0), &hdr, sizeof(hdr));
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_w_sector = sector;
+    s_w_slot = 1;
+    s_w_seq = seq;
+    return ESP_OK;
+}
+
+/**
+ * @brief Moves writing onto the next sector. If the log has wrapped onto undrained records the
+ *  oldest sector is sacrificed and its records counted as dropped
+ */
+static esp_err_t advance_sector(void)
+{
+    uint32_t next = (s_w_sector + 1) % s_sectors;
+
+    if (s_pending > 0 && s_r_sector == next) {
+        uint32_t lost = MIN(s_pending, JOURNAL_RECORDS_PER_SECTOR + 1 - s_r_slot);
+        s_pending -= lost;
+        s_dropped += lost;
+        s_r_sector = (next + 1) % s_sectors;
+        s_r_slot = 1;
+    }
+    esp_err_t err = start_sector(next, s_w_seq + 1);
+    if (s_pending == 0) {
+        s_r_sector = s_w_sector;
+        s_r_slot = s_w_slot;
+    }
+    return err;
+}
+
+/**
+ * @brief Scans slots 1..end_slot of a sector. With find_first, returns the first written record
+ *  (end_slot + 1 if none); otherwise returns the number of programmed slots before the first
+ *  erased one
+ */
+static uint32_t scan_sector(uint32_t sector, uint32_t end_slot, bool find_first)
+{
+    for (uint32_t slot = 1; slot <= end_slot; slot += JOURNAL_CHUNK_RECORDS) {
+        uint32_t k = MIN((uint32_t)JOURNAL_CHUNK_RECORDS, end_slot + 1 - slot);
+        if (esp_partition_read(s_part, slot_offset(sector, slot), s_io, k * JOURNAL_RECORD_SIZE) != ESP_OK) {
+            return find_first ? end_slot + 1 : slot - 1;
+        }
+        for (uint32_t i = 0; i < k; i++) {
+            if (find_first && s_io[i].state == STATE_WRITTEN) {
+                return slot + i;
+            }
+            if (!find_first && s_io[i].state == STATE_ERASED) {
+                return slot + i - 1;
+            }
+        }
+    }
+    return find_first ? end_slot + 1 : end_slot;
+}
@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sample-report.h"
+
+_Static_assert(SAMPLE_REPORT_CHANNELS <= 32, "changed masks are uint32_t");
+
+//Private Types
+typedef struct {
+    sample_deadband deadband;   //Sampler's copy of the settings
+    bool in_alarm;              //Last reading was outside the alarm limits
+    bool sent_once;
+    sensor_value last_value;    //Last value sent
+    int64_t last_us;            //Timestamp of the last sample sent
+    sample_report_stats stats;
+} report_channel;
+
+//Private Variables
+static report_channel s_channels[SAMPLE_REPORT_CHANNELS];     //Owned by the sampler
+static SemaphoreHandle_t s_lock;
+static sample_deadband s_config[SAMPLE_REPORT_CHANNELS];    //Latest settings, under s_lock
+static _Atomic uint32_t s_changed;
+
+//Public Function Declarations
+esp_err_t sample_report_configure(int channel, const sample_deadband *deadband);
+void sample_report_get_config(int channel, sample_deadband *deadband);
+bool sample_report_due(int channel, sensor_struct *sample);
+bool sample_report_alarm_crossed(int channel, sensor_value value);
+void sample_report_get_stats(int channel, sample_report_stats *stats);
+
+//Private Function Declarations
+static const sample_deadband *deadband_of(int channel);
+static bool outside(const sample_deadband *deadband, sensor_value reference, sensor_value value);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Sets a channel's deadband, heartbeat and alarm limits, all zero sends every window. Applied
+ *  by the sampler on its next decision for the channel. The reference value and heartbeat clock
+ *  carry over
+ */
+esp_err_t sample_report_configure(int channel, const sample_deadband *deadband)
+{
+    if (channel < 0 || channel >= SAMPLE_REPORT_CHANNELS || deadband->abs < 0 ||
+        (deadband->alarm && deadband->alarm_low > deadband->alarm_high)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutex();
+        if (s_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_config[channel] = *deadband;
+    xSemaphoreGive(s_lock);
+    atomic_fetch_or(&s_changed, 1u << channel);
+    return ESP_OK;
+}
+
+/**
+ * @brief Latest settings of a channel, all zero if it was never configured
+ */
+void sample_report_get_config(int channel, sample_deadband *deadband)
+{
+    if (s_lock == NULL || channel < 0 || channel >= SAMPLE_REPORT_CHANNELS) {
+        memset(deadband, 0, sizeof(*deadband));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *deadband = s_config[channel];
+    xSemaphoreGive(s_lock);
+}
+
+/**
+ * @brief Decides whether a closed window (or plain reading) is worth sending, flags it if it reached
+ *  an alarm limit, and counts the decision. A summary is checked on its last, min and max readings so
+ *  a short excursion inside the window is still reported
+ */
+bool sample_report_due(int channel, sensor_struct *sample)
+{
+    if (channel < 0 || channel >= SAMPLE_REPORT_CHANNELS) {
+        return true;
+    }
+    const sample_deadband *deadband = deadband_of(channel);
+    report_channel *ch = &s_channels[channel];
+    sensor_value ref = ch->last_value;
+    sensor_value low = sample->count > 0 ? sample->min : sample->value;
+    sensor_value high = sample->count > 0 ? sample->max : sample->value;
+
+    if (deadband->alarm && (low < deadband->alarm_low || high > deadband->alarm_high)) {
+        sample->flags |= SENSOR_FLAG_ALARM;
+        ch->stats.alarms++;
+    }
+    bool due = (sample->flags & SENSOR_FLAG_ALARM) || !ch->sent_once || (deadband->abs == 0 && deadband->permille == 0) ||
+        outside(deadband, ref, sample->value) || outside(deadband, ref, low) || outside(deadband, ref, high) ||
+        (deadband->heartbeat_ms > 0 && sample->timestamp - ch->last_us >= (int64_t)deadband->heartbeat_ms * 1000);
+
+    if (!due) {
+        ch->stats.suppressed++;
+        return false;
+    }
+    ch->sent_once = true;
+    ch->last_value = sample->value;
+    ch->last_us = sample->timestamp;
+    ch->stats.sent++;
+    return true;
+}
+
+/**
+ * @brief Checks one reading against the channel's alarm limits as soon as it is filtered. Returns true
+ *  only when the channel goes into alarm, so its window can be closed at once rather than at the end
+ *  of its transmit period; readings that stay outside are reported with the windows they fall in
+ */
+bool sample_report_alarm_crossed(int channel, sensor_value value)
+{
+    if (channel < 0 || channel >= SAMPLE_REPORT_CHANNELS) {
+        return false;
+    }
+    const sample_deadband *deadband = deadband_of(channel);
+    report_channel *ch = &s_channels[channel];
+    bool outside = deadband->alarm && (value < deadband->alarm_low || value > deadband->alarm_high);
+    bool crossed = outside && !ch->in_alarm;
+
+    ch->in_alarm = outside;
+    return crossed;
+}
+
+void sample_report_get_stats(int channel, sample_report_stats *stats)
+{
+    if (channel < 0 || channel >= SAMPLE_REPORT_CHANNELS) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    *stats = s_channels[channel].stats;
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+/**
+ * @brief The sampler's settings for a channel, first copying them in if they changed since
+ */
+static const sample_deadband *deadband_of(int channel)
+{
+    uint32_t bit = 1u << channel;
+
+    if (atomic_load(&s_changed) & bit) {
+        atomic_fetch_and(&s_changed, ~bit);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_channels[channel].deadband = s_config[channel];
+        xSemaphoreGive(s_lock);
+    }
+    return &s_channels[channel].deadband;
+}
+
+/**
+ * @brief True if value lies beyond either enabled threshold around reference
+ */
+static bool outside(const sample_deadband *deadband, sensor_value reference, sensor_value value)
+{
+    int64_t delta = llabs((int64_t)value - reference);
+
+    if (deadband->abs > 0 && delta > deadband->abs) {
+        return true;
+    }
+    return deadband->permille > 0 && delta * 1000 > (int64_t)deadband->permille * llabs((int64_t)reference);
+}
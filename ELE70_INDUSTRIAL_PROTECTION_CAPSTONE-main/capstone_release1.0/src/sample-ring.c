@@ -0,0 +1,145 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "sample-ring.h"
+
+//Defines
+#define RING_MASK (SAMPLE_RING_LEN - 1)
+
+_Static_assert((SAMPLE_RING_LEN & RING_MASK) == 0, "SAMPLE_RING_LEN must be a power of two");
+
+//Public Function Declarations
+void sample_ring_init(sample_ring *ring, ring_overflow_policy policy, TickType_t block_ticks);
+bool sample_ring_push(sample_ring *ring, const sensor_struct *sample);
+bool sample_ring_pop(sample_ring *ring, sensor_struct *sample, int64_t *queued_us);
+uint32_t sample_ring_count(sample_ring *ring);
+void sample_ring_get_stats(sample_ring *ring, sample_ring_stats *stats);
+
+//Private Function Declarations
+static bool make_room(sample_ring *ring, uint32_t head);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Empties the ring, clears its counters and sets the overflow policy
+ */
+void sample_ring_init(sample_ring *ring, ring_overflow_policy policy, TickType_t block_ticks)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->policy = policy;
+    ring->block_ticks = block_ticks;
+}
+
+/**
+ * @brief Producer side: copies sample into the next slot and publishes it.
+ *  Returns false if the sample was dropped because the ring was full
+ */
+bool sample_ring_push(sample_ring *ring, const sensor_struct *sample)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail == SAMPLE_RING_LEN && !make_room(ring, head)) {
+        atomic_fetch_add_explicit(&ring->dropped_newest, 1, memory_order_relaxed);
+        return false;
+    }
+
+    ring->slots[head & RING_MASK].sample = *sample;
+    ring->slots[head & RING_MASK].queued_us = esp_timer_get_time();
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    atomic_fetch_add_explicit(&ring->pushed, 1, memory_order_relaxed);
+
+    uint32_t used = head + 1 - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (used > atomic_load_explicit(&ring->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->high_water, used, memory_order_relaxed);
+    }
+    return true;
+}
+
+/**
+ * @brief Consumer side: copies out the oldest sample and, unless queued_us is NULL, when it was
+ *  pushed. The copy is only kept if tail could be claimed afterwards; losing that race means the
+ *  producer dropped the slot while it was being read, so the possibly torn copy is discarded and
+ *  the next slot is tried
+ */
+bool sample_ring_pop(sample_ring *ring, sensor_struct *sample, int64_t *queued_us)
+{
+    sample_ring_slot copy;
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    while (1) {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail == head) {
+            return false;
+        }
+        copy = ring->slots[tail & RING_MASK];
+        if (atomic_compare_exchange_weak_explicit(&ring->tail, &tail, tail + 1,
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            *sample = copy.sample;
+            if (queued_us != NULL) {
+                *queued_us = copy.queued_us;
+            }
+            atomic_fetch_add_explicit(&ring->popped, 1, memory_order_relaxed);
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief Number of samples waiting, exact from either side, a snapshot from anywhere else
+ */
+uint32_t sample_ring_count(sample_ring *ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return head - tail;
+}
+
+/**
+ * @brief Snapshot of the ring counters, safe to call from any task
+ */
+void sample_ring_get_stats(sample_ring *ring, sample_ring_stats *stats)
+{
+    stats->pushed = atomic_load_explicit(&ring->pushed, memory_order_relaxed);
+    stats->popped = atomic_load_explicit(&ring->popped, memory_order_relaxed);
+    stats->dropped_oldest = atomic_load_explicit(&ring->dropped_oldest, memory_order_relaxed);
+    stats->dropped_newest = atomic_load_explicit(&ring->dropped_newest, memory_order_relaxed);
+    stats->blocked = atomic_load_explicit(&ring->blocked, memory_order_relaxed);
+    stats->high_water = atomic_load_explicit(&ring->high_water, memory_order_relaxed);
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+/**
+ * @brief Applies the overflow policy to a full ring, returns true once a slot is free
+ */
+static bool make_room(sample_ring *ring, uint32_t head)
+{
+    uint32_t tail = head - SAMPLE_RING_LEN;
+
+    switch (ring->policy)
+    {
+        case RING_DROP_OLDEST:
+            //Failing the exchange means the consumer just freed the slot itself
+            if (atomic_compare_exchange_strong_explicit(&ring->tail, &tail, tail + 1,
+                                                        memory_order_acq_rel, memory_order_acquire)) {
+                atomic_fetch_add_explicit(&ring->dropped_oldest, 1, memory_order_relaxed);
+            }
+            return true;
+        case RING_BLOCK:
+            atomic_fetch_add_explicit(&ring->blocked, 1, memory_order_relaxed);
+            for (TickType_t waited = 0; waited < ring->block_ticks; waited++) {
+                vTaskDelay(1);
+                if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) < SAMPLE_RING_LEN) {
+                    return true;
+                }
+            }
+            return false;
+        case RING_DROP_NEWEST:
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,155 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "sample-sched.h"
+
+//Private Types
+typedef struct {
+    int64_t period_us;
+    int64_t next_us;            //Absolute deadline, esp_timer_get_time() time base
+    uint32_t releases;
+    uint32_t overruns;
+    latency_hist jitter;
+} sched_channel;
+
+//Private Variables
+static sched_channel s_channels[SAMPLE_SCHED_CHANNELS];
+static latency_hist s_read;
+static esp_timer_handle_t s_timer;
+static TaskHandle_t s_task;
+static int64_t s_epoch;
+
+//Public Function Declarations
+esp_err_t sample_sched_init(void);
+esp_err_t sample_sched_set_period(int channel, int64_t period_us);
+uint32_t sample_sched_wait(void);
+void sample_sched_read_done(uint32_t read_us);
+void sample_sched_get_stats(int channel, sample_sched_stats *stats);
+
+//Private Function Declarations
+static void sched_timer_callback(void *arg);
+static int64_t next_deadline(void);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Creates the wake-up timer and binds the scheduler to the calling task. Every channel
+ *  starts stopped, the epoch is now
+ */
+esp_err_t sample_sched_init(void)
+{
+    const esp_timer_create_args_t timer_args = {
+            .callback = &sched_timer_callback,
+            .name = "sample_sched"
+    };
+
+    memset(s_channels, 0, sizeof(s_channels));
+    latency_hist_reset(&s_read);
+    s_task = xTaskGetCurrentTaskHandle();
+    s_epoch = esp_timer_get_time();
+    return esp_timer_create(&timer_args, &s_timer);
+}
+
+/**
+ * @brief Sets a channel's period, 0 stops it. The first release is the next multiple of the
+ *  period after now, counted from the epoch. Must be called from the scheduler task
+ */
+esp_err_t sample_sched_set_period(int channel, int64_t period_us)
+{
+    if (channel < 0 || channel >= SAMPLE_SCHED_CHANNELS || period_us < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sched_channel *ch = &s_channels[channel];
+    ch->period_us = period_us;
+    if (period_us > 0) {
+        int64_t now = esp_timer_get_time();
+        ch->next_us = s_epoch + ((now - s_epoch) / period_us + 1) * period_us;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Sleeps until a channel is due or the task is notified, and returns the set that is due, which
+ *  is empty after an early notification. Each due channel's release jitter is recorded and its
+ *  deadline advanced by whole periods; deadlines already passed by the time it wakes are skipped
+ *  and counted as overruns rather than released late
+ */
+uint32_t sample_sched_wait(void)
+{
+    uint32_t due = 0;
+    int64_t deadline = next_deadline();
+    int64_t now = esp_timer_get_time();
+
+    if (deadline > now) {
+        esp_timer_stop(s_timer);
+        if (deadline != INT64_MAX) {
+            esp_timer_start_once(s_timer, deadline - now);
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);    //No channel running: sleeps until notified
+        now = esp_timer_get_time();
+    }
+
+    for (int i = 0; i < SAMPLE_SCHED_CHANNELS; i++) {
+        sched_channel *ch = &s_channels[i];
+        if (ch->period_us == 0 || ch->next_us > now) {
+            continue;
+        }
+        int64_t late = now - ch->next_us;
+        int64_t missed = late / ch->period_us;
+        latency_hist_record(&ch->jitter, late > UINT32_MAX ? UINT32_MAX : (uint32_t)late);
+        ch->releases++;
+        ch->overruns += (uint32_t)missed;
+        ch->next_us += (missed + 1) * ch->period_us;
+        due |= 1u << i;
+    }
+    return due;
+}
+
+/**
+ * @brief Records how long the bus session for the last release took
+ */
+void sample_sched_read_done(uint32_t read_us)
+{
+    latency_hist_record(&s_read, read_us);
+}
+
+/**
+ * @brief Copies out a channel's counters and histograms, may be called from any task
+ */
+void sample_sched_get_stats(int channel, sample_sched_stats *stats)
+{
+    if (channel < 0 || channel >= SAMPLE_SCHED_CHANNELS) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    sched_channel *ch = &s_channels[channel];
+    stats->period_us = ch->period_us;
+    stats->releases = ch->releases;
+    stats->overruns = ch->overruns;
+    latency_hist_snapshot_get(&ch->jitter, &stats->jitter);
+    latency_hist_snapshot_get(&s_read, &stats->read);
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+/**
+ * @brief Timer callback: wakes the sampler for the deadline it was armed for
+ */
+static void sched_timer_callback(void *arg)
+{
+    xTaskNotifyGive(s_task);
+}
+
+static int64_t next_deadline(void)
+{
+    int64_t deadline = INT64_MAX;
+    for (int i = 0; i < SAMPLE_SCHED_CHANNELS; i++) {
+        if (s_channels[i].period_us > 0 && s_channels[i].next_us < deadline) {
+            deadline = s_channels[i].next_us;
+        }
+    }
+    return deadline;
+}
@@ -0,0 +1,69 @@
+#include <math.h>
+#include <string.h>
+#include "sample-stats.h"
+
+//Public Function Declarations
+void sample_window_reset(sample_window *window);
+void sample_window_add(sample_window *window, const sensor_struct *sample);
+bool sample_window_close(sample_window *window, sensor_struct *summary);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Starts an empty window
+ */
+void sample_window_reset(sample_window *window)
+{
+    memset(window, 0, sizeof(*window));
+}
+
+/**
+ * @brief Folds one reading into the window
+ */
+void sample_window_add(sample_window *window, const sensor_struct *sample)
+{
+    float x = (float)sample->value;
+
+    if (window->count == 0) {
+        window->min = sample->value;
+        window->max = sample->value;
+    } else if (sample->value < window->min) {
+        window->min = sample->value;
+    } else if (sample->value > window->max) {
+        window->max = sample->value;
+    }
+    window->count++;
+    window->id = sample->id;
+    window->last = sample->value;
+    window->last_us = sample->timestamp;
+
+    float delta = x - window->mean;
+    window->mean += delta / (float)window->count;
+    window->m2 += delta * (x - window->mean);
+}
+
+/**
+ * @brief Writes the window's summary, stamped with its last reading, and starts a new window.
+ *  A window holding a single reading yields that plain reading (count 0). Returns false, writing
+ *  nothing, if the window is empty
+ */
+bool sample_window_close(sample_window *window, sensor_struct *summary)
+{
+    if (window->count == 0) {
+        return false;
+    }
+    memset(summary, 0, sizeof(*summary));
+    summary->id = window->id;
+    summary->value = window->last;
+    summary->timestamp = window->last_us;
+    if (window->count > 1) {
+        summary->count = window->count;
+        summary->min = window->min;
+        summary->max = window->max;
+        summary->mean = (sensor_value)lroundf(window->mean);
+        summary->stddev = (sensor_value)lroundf(sqrtf(fmaxf(window->m2, 0.0f) / (float)(window->count - 1)));
+    }
+    sample_window_reset(window);
+    return true;
+}
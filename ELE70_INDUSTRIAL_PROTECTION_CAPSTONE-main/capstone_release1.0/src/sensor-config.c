@@ -0,0 +1,388 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "sensor-registry.h"
+#include "sensor-config.h"
+
+//Defines
+#define RATE_KEY_LEN 16
+#define VALUE_SCALE_MAX 1000000 //At most 6 decimals, far finer than the fixed point step
+
+//Private Variables
+static SemaphoreHandle_t s_lock;
+static sensor_rate s_rates[SENSOR_REGISTRY_MAX];    //Per registry index
+static sample_deadband s_deadbands[SENSOR_REGISTRY_MAX];    //Per registry index, all zeros for defaults
+static _Atomic uint32_t s_changed;
+
+//Public Function Declarations
+esp_err_t sensor_config_load(void);
+esp_err_t sensor_config_set(int id, const sensor_rate *rate);
+void sensor_config_get(int index, sensor_rate *rate);
+esp_err_t sensor_config_set_deadband(int id, const sample_deadband *deadband);
+bool sensor_config_get_deadband(int index, sample_deadband *deadband);
+uint32_t sensor_config_take_changed(void);
+int sensor_config_parse(const char *text, size_t len, int *id, sensor_rate *rate);
+int sensor_config_parse_deadband(const char *text, size_t len, int *id, sample_deadband *deadband);
+
+//Private Function Declarations
+static int index_of(int id);
+static void rate_key(char *key, int id);
+static void deadband_key(char *key, int id);
+static bool deadband_is_default(const sample_deadband *deadband);
+static esp_err_t persist(const char *key, const void *blob, size_t len, bool erase);
+static int copy_line(char *line, const char *text, size_t len, const char *keyword);
+static int parse_u32(char **p, uint32_t *value);
+static int parse_value(char **p, sensor_value *value);
+static int parse_end(char *p);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Reads every registered sensor's stored rate and deadband, once the board table is complete
+ *  and before the sampler starts. Sensors without them keep their defaults
+ */
+esp_err_t sensor_config_load(void)
+{
+    nvs_handle_t nvs;
+    char key[RATE_KEY_LEN];
+
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutex();
+        if (s_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    memset(s_rates, 0, sizeof(s_rates));
+    memset(s_deadbands, 0, sizeof(s_deadbands));
+    if (nvs_open(SENSOR_CONFIG_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return ESP_OK; //Nothing stored yet
+    }
+    for (int i = 0; i < sensor_registry_count(); i++) {
+        sensor_rate rate;
+        sample_deadband deadband;
+        size_t len = sizeof(rate);
+        rate_key(key, sensor_registry_get(i)->id);
+        if (nvs_get_blob(nvs, key, &rate, &len) == ESP_OK && len == sizeof(rate)) {
+            s_rates[i] = rate;
+            atomic_fetch_or(&s_changed, 1u << i);
+        }
+        len = sizeof(deadband);
+        deadband_key(key, sensor_registry_get(i)->id);
+        if (nvs_get_blob(nvs, key, &deadband, &len) == ESP_OK && len == sizeof(deadband)) {
+            s_deadbands[i] = deadband;
+            atomic_fetch_or(&s_changed, 1u << i);
+        }
+    }
+    nvs_close(nvs);
+    return ESP_OK;
+}
+
+/**
+ * @brief Validates and stores a sensor's rate, then marks it changed for the sampler. Returns
+ *  ESP_ERR_NOT_FOUND for an id that isn't on the board
+ */
+esp_err_t sensor_config_set(int id, const sensor_rate *rate)
+{
+    char key[RATE_KEY_LEN];
+    int index = index_of(id);
+
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (index < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (rate->sample_ms > SENSOR_CONFIG_SAMPLE_MS_MAX || rate->tx_ms > SENSOR_CONFIG_TX_MS_MAX ||
+        rate->batch > SENSOR_CONFIG_BATCH_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    rate_key(key, id);
+    esp_err_t err = persist(key, rate, sizeof(*rate), rate->sample_ms == 0 && rate->tx_ms == 0 && rate->batch == 0);
+    if (err != ESP_OK) {
+        ESP_LOGW("sensor-config", "sensor %d rate not persisted: %s", id, esp_err_to_name(err));
+    }
+
+    //Applied either way, a flash failure only costs persistence
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_rates[index] = *rate;
+    xSemaphoreGive(s_lock);
+    atomic_fetch_or(&s_changed, 1u << index);
+    return ESP_OK;
+}
+
+/**
+ * @brief Current rate of a registry index, all zeros for defaults
+ */
+void sensor_config_get(int index, sensor_rate *rate)
+{
+    if (s_lock == NULL || index < 0 || index >= SENSOR_REGISTRY_MAX) {
+        memset(rate, 0, sizeof(*rate));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *rate = s_rates[index];
+    xSemaphoreGive(s_lock);
+}
+
+/**
+ * @brief Validates and stores a sensor's deadband, heartbeat and alarm limits (see
+ *  sample_report_configure()), then marks it changed for the sampler. All zeros without alarm limits
+ *  returns the sensor to its board default. Returns ESP_ERR_NOT_FOUND for an id that isn't on the
+ *  board
+ */
+esp_err_t sensor_config_set_deadband(int id, const sample_deadband *deadband)
+{
+    char key[RATE_KEY_LEN];
+    int index = index_of(id);
+
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (index < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (deadband->abs < 0 || deadband->heartbeat_ms > SENSOR_CONFIG_TX_MS_MAX ||
+        (deadband->alarm && deadband->alarm_low > deadband->alarm_high)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    deadband_key(key, id);
+    esp_err_t err = persist(key, deadband, sizeof(*deadband), deadband_is_default(deadband));
+    if (err != ESP_OK) {
+        ESP_LOGW("sensor-config", "sensor %d deadband not persisted: %s", id, esp_err_to_name(err));
+    }
+
+    //Applied either way, a flash failure only costs persistence
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_deadbands[index] = *deadband;
+    xSemaphoreGive(s_lock);
+    atomic_fetch_or(&s_changed, 1u << index);
+    return ESP_OK;
+}
+
+/**
+ * @brief Deadband the server set for a registry index. Returns false, deadband untouched, while
+ *  the sensor keeps its board default
+ */
+bool sensor_config_get_deadband(int index, sample_deadband *deadband)
+{
+    sample_deadband set;
+
+    if (s_lock == NULL || index < 0 || index >= SENSOR_REGISTRY_MAX) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    set = s_deadbands[index];
+    xSemaphoreGive(s_lock);
+    if (deadband_is_default(&set)) {
+        return false;
+    }
+    *deadband = set;
+    return true;
+}
+
+/**
+ * @brief Registry indices whose rate or deadband changed since the last call, for the sampler
+ */
+uint32_t sensor_config_take_changed(void)
+{
+    return atomic_exchange(&s_changed, 0);
+}
+
+/**
+ * @brief Parses "rate <sensor_id> <sample_ms> <tx_ms> <batch>". Returns 0, or -1 if text isn't one
+ */
+int sensor_config_parse(const char *text, size_t len, int *id, sensor_rate *rate)
+{
+    char line[SENSOR_CONFIG_LINE_MAX];
+    uint32_t v[4];
+    char *p = line;
+
+    if (copy_line(line, text, len, "rate ") != 0) {
+        return -1;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (parse_u32(&p, &v[i]) != 0) {
+            return -1;
+        }
+    }
+    if (parse_end(p) != 0 || v[0] > INT32_MAX) {
+        return -1;
+    }
+    *id = (int)v[0];
+    rate->sample_ms = v[1];
+    rate->tx_ms = v[2];
+    rate->batch = v[3];
+    return 0;
+}
+
+/**
+ * @brief Parses "deadband <sensor_id> <abs> <permille> <heartbeat_ms> [<alarm_low> <alarm_high>]",
+ *  abs and the limits as decimals. Returns 0, or -1 if text isn't one
+ */
+int sensor_config_parse_deadband(const char *text, size_t len, int *id, sample_deadband *deadband)
+{
+    char line[SENSOR_CONFIG_LINE_MAX];
+    sample_deadband parsed = { 0 };
+    uint32_t sensor_id;
+    char *p = line;
+
+    if (copy_line(line, text, len, "deadband ") != 0 || parse_u32(&p, &sensor_id) != 0 ||
+        parse_value(&p, &parsed.abs) != 0 || parse_u32(&p, &parsed.permille) != 0 ||
+        parse_u32(&p, &parsed.heartbeat_ms) != 0 || sensor_id > INT32_MAX) {
+        return -1;
+    }
+    if (parse_end(p) != 0) {
+        if (parse_value(&p, &parsed.alarm_low) != 0 || parse_value(&p, &parsed.alarm_high) != 0 ||
+            parse_end(p) != 0) {
+            return -1;
+        }
+        parsed.alarm = true;
+    }
+    *id = (int)sensor_id;
+    *deadband = parsed;
+    return 0;
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+static int index_of(int id)
+{
+    for (int i = 0; i < sensor_registry_count(); i++) {
+        if (sensor_registry_get(i)->id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void rate_key(char *key, int id)
+{
+    snprintf(key, RATE_KEY_LEN, "rate%d", id);
+}
+
+static void deadband_key(char *key, int id)
+{
+    snprintf(key, RATE_KEY_LEN, "db%d", id);
+}
+
+static bool deadband_is_default(const sample_deadband *deadband)
+{
+    return deadband->abs == 0 && deadband->permille == 0 && deadband->heartbeat_ms == 0 && !deadband->alarm;
+}
+
+/**
+ * @brief Stores a blob under key, or erases it so the default applies again
+ */
+static esp_err_t persist(const char *key, const void *blob, size_t len, bool erase)
+{
+    nvs_handle_t nvs;
+
+    esp_err_t err = nvs_open(SENSOR_CONFIG_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (erase) {
+        err = nvs_erase_key(nvs, key);
+        err = (err == ESP_ERR_NVS_NOT_FOUND) ? ESP_OK : err;
+    } else {
+        err = nvs_set_blob(nvs, key, blob, len);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+/**
+ * @brief Copies a line starting with keyword into line (SENSOR_CONFIG_LINE_MAX bytes) without the
+ *  keyword, terminated. Returns -1 if it doesn't start with keyword or is too long
+ */
+static int copy_line(char *line, const char *text, size_t len, const char *keyword)
+{
+    size_t skip = strlen(keyword);
+
+    if (len < skip || len - skip >= SENSOR_CONFIG_LINE_MAX || strncmp(text, keyword, skip) != 0) {
+        return -1;
+    }
+    memcpy(line, text + skip, len - skip);
+    line[len - skip] = '\0';
+    return 0;
+}
+
+/**
+ * @brief Parses an unsigned decimal after any spaces and advances *p past it
+ */
+static int parse_u32(char **p, uint32_t *value)
+{
+    char *end;
+
+    while (**p == ' ') {
+        (*p)++;
+    }
+    if (**p < '0' || **p > '9') {
+        return -1;
+    }
+    unsigned long v = strtoul(*p, &end, 10);
+    if (v > UINT32_MAX) {
+        return -1;
+    }
+    *value = (uint32_t)v;
+    *p = end;
+    return 0;
+}
+
+/**
+ * @brief Parses a signed decimal such as "-12.5" after any spaces into a fixed point sensor_value,
+ *  rounded to the nearest step, and advances *p past it
+ */
+static int parse_value(char **p, sensor_value *value)
+{
+    uint32_t whole;
+    uint64_t frac = 0, scale = 1;
+
+    while (**p == ' ') {
+        (*p)++;
+    }
+    bool negative = (**p == '-');
+    *p += negative;
+    if (**p == ' ' || parse_u32(p, &whole) != 0) {
+        return -1;
+    }
+    if (**p == '.') {
+        for ((*p)++; **p >= '0' && **p <= '9'; (*p)++) {
+            if (scale >= VALUE_SCALE_MAX) {
+                return -1;
+            }
+            frac = frac * 10 + (uint64_t)(**p - '0');
+            scale *= 10;
+        }
+    }
+    uint64_t fixed = ((uint64_t)whole << SENSOR_VALUE_FRAC_BITS) + (frac * SENSOR_VALUE_ONE + scale / 2) / scale;
+    if (fixed > INT32_MAX) {
+        return -1;
+    }
+    *value = negative ? -(sensor_value)fixed : (sensor_value)fixed;
+    return 0;
+}
+
+/**
+ * @brief Returns 0 if only spaces or a carriage return are left
+ */
+static int parse_end(char *p)
+{
+    while (*p == ' ' || *p == '\r') {
+        p++;
+    }
+    return (*p == '\0') ? 0 : -1;
+}
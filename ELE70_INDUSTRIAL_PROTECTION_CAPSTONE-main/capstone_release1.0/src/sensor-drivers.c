@@ -0,0 +1,109 @@
+#include <stdint.h>
+#include "sensor-registry.h"
+
+/*
+ * Drivers for the sensors on the capstone board, both are register reads on the shared I2C bus.
+ */
+
+//Defines
+#define VEML7700_REG_ALS_CONF   0x00
+#define VEML7700_REG_PSM        0x03
+#define VEML7700_REG_ALS        0x04
+#define NTC_REG_CODE            0x00
+#define VEML7700_IT_US          100000  //ALS integration time set by veml7700_init(), a new count is ready this often
+#define NTC_PERIOD_US           100000  //Oversampled, filtered down in the sampler
+
+//VEML7700 at gain 1/8, 100 ms: 1.8432 lux per count as Q16.15, so counts * scale fits 32 bits
+#define VEML7700_LUX_Q15        60398u
+
+/*
+ * NTCALUG02A103G curve, calibrated for the board's divider: T = 30 - (2560000/code - 18056)/443.7
+ * with code the 8-bit ADC result. The table holds T as a sensor_value at every 8-bit code and is
+ * evaluated entirely by the compiler; a 12-bit code interpolates between neighbouring entries.
+ * Codes reading below the thermistor's rated -40 C (an open or shorted divider) are invalid.
+ */
+#define NTC_T_MIN_C             -40.0
+#define NTC_INVALID             INT32_MIN
+#define NTC_LUT_SHIFT           4   //12-bit code to table index
+#define NTC_CELSIUS(code)       (30.0 - (2560000.0 / (code) - 18056.0) / 443.7)
+#define NTC_FIXED(c)            ((c) >= 0 ? (sensor_value)((c) * SENSOR_VALUE_ONE + 0.5) : \
+                                            (sensor_value)((c) * SENSOR_VALUE_ONE - 0.5))
+#define NTC_ENTRY(code)         ((code) == 0 || NTC_CELSIUS((code) ? (code) : 1) < NTC_T_MIN_C ? NTC_INVALID : \
+                                 NTC_FIXED(NTC_CELSIUS((code) ? (code) : 1)))
+#define NTC_ENTRY4(code)        NTC_ENTRY(code), NTC_ENTRY(code + 1), NTC_ENTRY(code + 2), NTC_ENTRY(code + 3)
+#define NTC_ENTRY16(code)       NTC_ENTRY4(code), NTC_ENTRY4(code + 4), NTC_ENTRY4(code + 8), NTC_ENTRY4(code + 12)
+#define NTC_ENTRY64(code)       NTC_ENTRY16(code), NTC_ENTRY16(code + 16), NTC_ENTRY16(code + 32), NTC_ENTRY16(code + 48)
+
+//Private Variables
+static const sensor_value s_ntc_lut[257] = {   //Entry 256 is only an interpolation end point
+    NTC_ENTRY64(0), NTC_ENTRY64(64), NTC_ENTRY64(128), NTC_ENTRY64(192), NTC_ENTRY(256)
+};
+
+//Private Function Declarations
+static esp_err_t veml7700_init(sensor_desc *sensor);
+static esp_err_t veml7700_convert(const sensor_desc *sensor, const uint8_t *raw, sensor_value *value);
+static esp_err_t ntc_adc_convert(const sensor_desc *sensor, const uint8_t *raw, sensor_value *value);
+
+//Public Variables
+const sensor_driver sensor_veml7700 = {
+    .name = "VEML7700",
+    .reg = VEML7700_REG_ALS,
+    .len = 2,
+    .period_us = VEML7700_IT_US,
+    .init = veml7700_init,
+    .convert = veml7700_convert,
+};
+
+const sensor_driver sensor_ntc_adc = {
+    .name = "NTCALUG02A103G",
+    .reg = NTC_REG_CODE,
+    .len = 2,
+    .period_us = NTC_PERIOD_US,
+    .convert = ntc_adc_convert,
+};
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+/**
+ * @brief ALS_CONF = 0x1300 (gain 1/8, 100 ms integration, powered on), thresholds and power saving cleared
+ */
+static esp_err_t veml7700_init(sensor_desc *sensor)
+{
+    uint8_t conf[2] = {0x00, 0x13};
+    esp_err_t ret = sensor_i2c_write(sensor->index, VEML7700_REG_ALS_CONF, conf, 2);
+    conf[1] = 0x00;
+    for (uint8_t reg = VEML7700_REG_ALS_CONF + 1; reg <= VEML7700_REG_PSM; reg++) {
+        esp_err_t err = sensor_i2c_write(sensor->index, reg, conf, 2);
+        ret = (ret == ESP_OK) ? err : ret;
+    }
+    return ret;
+}
+
+/**
+ * @brief VEML7700 ALS counts (little-endian) to lux, rounded to the nearest 1/256
+ */
+static esp_err_t veml7700_convert(const sensor_desc *sensor, const uint8_t *raw, sensor_value *value)
+{
+    uint32_t data = ((uint32_t)raw[1] << 8) | raw[0];
+    uint32_t lux_q15 = data * VEML7700_LUX_Q15;
+    *value = (sensor_value)((lux_q15 + (1u << (14 - SENSOR_VALUE_FRAC_BITS))) >> (15 - SENSOR_VALUE_FRAC_BITS));
+    return ESP_OK;
+}
+
+/**
+ * @brief NTC ADC result (D11..D0 across the two bytes, an 8-bit part leaves D3..D0 zero) to Celsius
+ */
+static esp_err_t ntc_adc_convert(const sensor_desc *sensor, const uint8_t *raw, sensor_value *value)
+{
+    uint32_t code = ((uint32_t)(raw[0] & 0xF) << 8) | raw[1];
+    uint32_t index = code >> NTC_LUT_SHIFT;
+    int32_t frac = (int32_t)(code & ((1u << NTC_LUT_SHIFT) - 1));
+    sensor_value lo = s_ntc_lut[index], hi = s_ntc_lut[index + 1];
+
+    if (lo == NTC_INVALID || (frac != 0 && hi == NTC_INVALID)) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    *value = lo + (((hi - lo) * frac + (1 << (NTC_LUT_SHIFT - 1))) >> NTC_LUT_SHIFT);
+    return ESP_OK;
+}
@@ -0,0 +1,163 @@
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "sensor-registry.h"
+#include "sensor-hotplug.h"
+#include "sample-sched.h"
+#include "sample-filter.h"
+
+//Defines
+#define EDGE_QUEUE_LEN 16
+#define HOTPLUG_TASK_STACK 2048
+
+//Private Variables
+static QueueHandle_t s_edges;
+static StaticQueue_t s_edges_buf;
+static uint8_t s_edges_storage[EDGE_QUEUE_LEN];
+static TaskHandle_t s_sampler;
+static _Atomic uint32_t s_wanted;       //Debounced presence, written by the worker
+static uint32_t s_attached;             //What the sampler has applied
+static _Atomic uint32_t s_edge_count, s_edges_lost, s_plugged, s_unplugged, s_bounces;
+
+//Public Function Declarations
+esp_err_t sensor_hotplug_start(void);
+void sensor_hotplug_apply(void);
+void sensor_hotplug_get_stats(sensor_hotplug_stats *stats);
+
+//Private Function Declarations
+static void hotplug_task(void *pvParameters);
+static uint32_t read_levels(void);
+static void IRAM_ATTR sensor_en_isr_handler(void*par);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Configures every registered sensor's enable pin and starts the debounce worker. Must be called
+ *  from the sampler task, which is the one woken when the set of sensors changes. Sensors already
+ *  plugged in are attached on the first sensor_hotplug_apply()
+ */
+esp_err_t sensor_hotplug_start(void)
+{
+    s_sampler = xTaskGetCurrentTaskHandle();
+    s_edges = xQueueCreateStatic(EDGE_QUEUE_LEN, sizeof(uint8_t), s_edges_storage, &s_edges_buf);
+    if (s_edges == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    gpio_install_isr_service (7);
+    for (int i = 0; i < sensor_registry_count(); i++){
+        sensor_desc *sensor = sensor_registry_get(i);
+        if (sensor->en_pin < 0){
+            continue;
+        }
+        gpio_reset_pin(sensor->en_pin);
+        gpio_set_direction(sensor->en_pin, GPIO_MODE_INPUT);
+        gpio_intr_enable(sensor->en_pin);
+        gpio_set_pull_mode(sensor->en_pin, GPIO_PULLDOWN_ONLY);
+        gpio_set_intr_type(sensor->en_pin, GPIO_INTR_ANYEDGE);
+        gpio_isr_handler_add(sensor->en_pin, sensor_en_isr_handler, (void *)(intptr_t)i);
+    }
+    atomic_store(&s_wanted, read_levels());
+
+    if (xTaskCreatePinnedToCore(hotplug_task, "sensor_hotplug", HOTPLUG_TASK_STACK, NULL, 4, NULL, 1) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Sampler side: attaches sensors that were plugged in (driver init, bus channel and filter reset,
+ *  scheduling started) and detaches the ones pulled out. Cheap when nothing changed
+ */
+void sensor_hotplug_apply(void)
+{
+    uint32_t wanted = atomic_load(&s_wanted);
+    uint32_t diff = wanted ^ s_attached;
+
+    for (int i = 0; diff != 0; i++, diff >>= 1){
+        if (!(diff & 1)){
+            continue;
+        }
+        sensor_desc *sensor = sensor_registry_get(i);
+        if (wanted & (1u << i)){
+            sensor_registry_attach(i);
+            sample_filter_reset(i);
+            sample_sched_set_period(i, sensor->period_us);
+            ESP_LOGI("sensor-hotplug", "sensor %d attached", sensor->id);
+        } else {
+            sensor_registry_detach(i);
+            sample_sched_set_period(i, 0);
+            ESP_LOGI("sensor-hotplug", "sensor %d detached", sensor->id);
+        }
+    }
+    s_attached = wanted;
+}
+
+void sensor_hotplug_get_stats(sensor_hotplug_stats *stats)
+{
+    stats->edges = atomic_load(&s_edge_count);
+    stats->edges_lost = atomic_load(&s_edges_lost);
+    stats->plugged = atomic_load(&s_plugged);
+    stats->unplugged = atomic_load(&s_unplugged);
+    stats->bounces = atomic_load(&s_bounces);
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+/**
+ * @brief Debounce worker: after an edge, waits until the pins have been quiet for SENSOR_HOTPLUG_DEBOUNCE_MS,
+ *  then re-reads every enable pin and wakes the sampler if the set of present sensors changed
+ */
+static void hotplug_task(void *pvParameters)
+{
+    uint8_t index;
+    while(1){
+        xQueueReceive(s_edges, &index, portMAX_DELAY);
+        while (xQueueReceive(s_edges, &index, pdMS_TO_TICKS(SENSOR_HOTPLUG_DEBOUNCE_MS)) == pdTRUE){
+        }
+
+        uint32_t levels = read_levels();
+        uint32_t previous = atomic_exchange(&s_wanted, levels);
+        if (levels == previous){
+            atomic_fetch_add(&s_bounces, 1);
+            continue;
+        }
+        atomic_fetch_add(&s_plugged, __builtin_popcount(levels & ~previous));
+        atomic_fetch_add(&s_unplugged, __builtin_popcount(previous & ~levels));
+        xTaskNotifyGive(s_sampler);
+    }
+}
+
+/**
+ * @brief Presence mask from the enable pins, sensors without a pin are always present
+ */
+static uint32_t read_levels(void)
+{
+    uint32_t levels = 0;
+    for (int i = 0; i < sensor_registry_count(); i++){
+        sensor_desc *sensor = sensor_registry_get(i);
+        if (sensor->en_pin < 0 || gpio_get_level(sensor->en_pin) == 1){
+            levels |= 1u << i;
+        }
+    }
+    return levels;
+}
+
+/**
+ * @brief ISR routine for a sensor enable pin edge trigger, only hands the registry index to the worker.
+ * par is the index
+ */
+static void IRAM_ATTR sensor_en_isr_handler(void*par){
+    uint8_t index = (uint8_t)(intptr_t)par;
+    BaseType_t woken = pdFALSE;
+    atomic_fetch_add(&s_edge_count, 1);
+    if (xQueueSendFromISR(s_edges, &index, &woken) != pdTRUE){
+        atomic_fetch_add(&s_edges_lost, 1);
+    }
+    portYIELD_FROM_ISR(woken);
+}
@@ -1,72 +1,205 @@
 #include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
 #include "driver/i2c.h"
+#include "driver/gpio.h"
+#include "sensor-i2c.h"
 
 //Defines
-#define SAMPLE_PERIOD_MS		200
-#define I2C_MASTER_SCL_IO		4	             
-#define I2C_MASTER_SDA_IO		0	             
-#define I2C_FREQ_HZ				100000           
-#define I2C_TX_BUF_DISABLE  	0                
-#define I2C_RX_BUF_DISABLE  	0                
+#define I2C_MASTER_SCL_IO		4
+#define I2C_MASTER_SDA_IO		0
+#define I2C_FREQ_HZ				100000
+#define I2C_TX_BUF_DISABLE  	0
+#define I2C_RX_BUF_DISABLE  	0
 #define ACK_CHECK_EN            0x1
-#define ACK_VAL                 0x0              
-#define NACK_VAL                0x1              
+#define ACK_VAL                 0x0
+#define NACK_VAL                0x1
+#define I2C_BATCH_MAX           8                                               //Reads chained into one bus session
+#define I2C_BATCH_GROUPS        ((SENSOR_I2C_CHANNELS + I2C_BATCH_MAX - 1) / I2C_BATCH_MAX)
+#define I2C_GROUP_MASK          ((1u << I2C_BATCH_MAX) - 1)
+#define I2C_WRITE_LINK_SIZE     I2C_LINK_RECOMMENDED_SIZE(1)
+#define I2C_READ_LINK_SIZE      I2C_LINK_RECOMMENDED_SIZE(2)                    //Register write + repeated start read
+#define I2C_BATCH_LINK_SIZE     I2C_LINK_RECOMMENDED_SIZE(2 * I2C_BATCH_MAX)
+#define I2C_TIMEOUT_MS          20                                              //A full batch takes ~4 ms at 100kHz
+#define I2C_TIMEOUT_TICKS       MAX(pdMS_TO_TICKS(I2C_TIMEOUT_MS), 1)
+#define I2C_CLEAR_PULSES        9                                               //Enough to clock out any byte a slave is stuck in
+#define I2C_CLEAR_HALF_US       5                                               //Half an SCL period at 100kHz
+#define I2C_QUARANTINE_AFTER    3                                               //Consecutive failures
+#define I2C_QUARANTINE_MIN_MS   1000
+#define I2C_QUARANTINE_MAX_MS   60000
+
+_Static_assert(SENSOR_I2C_CHANNELS <= 32, "channel masks are uint32_t");
+
+//Private Types
+/**
+ * Pre-built read of one sensor register. The command link lives in link[] and is replayed on every
+ * read, the received bytes land in rx[]
+ */
+typedef struct {
+    uint8_t addr;
+    uint8_t reg;
+    uint8_t len;
+    uint8_t rx[SENSOR_I2C_READ_MAX];
+    i2c_cmd_handle_t cmd;
+    uint8_t link[I2C_READ_LINK_SIZE];
+    sensor_i2c_health health;
+    uint32_t backoff_ms;
+    int64_t retry_at;       //esp_timer_get_time() after which a quarantined channel is probed
+} i2c_read_slot;
+
+/**
+ * Combined read of up to I2C_BATCH_MAX channels, group g covers channels [g * I2C_BATCH_MAX, (g + 1) * I2C_BATCH_MAX).
+ * The link is kept until a different subset of the group is requested
+ */
+typedef struct {
+    i2c_cmd_handle_t cmd;
+    uint32_t mask;
+    uint8_t link[I2C_BATCH_LINK_SIZE];
+} i2c_batch_group;
 
 //Private Variables
-static uint8_t aRxBuffer [2] = {0x00, 0x00};
-static uint8_t aTxBuffer [2] = {0x00, 0x13};
+static i2c_read_slot s_reads[SENSOR_I2C_CHANNELS];
+static i2c_batch_group s_groups[I2C_BATCH_GROUPS];
+static uint32_t s_recoveries;
 
 //Public Function Declarations
-void sensor_i2c_init(void);
-uint16_t light_read(void);
-uint16_t temp_read(void);
+esp_err_t sensor_i2c_init(void);
+esp_err_t sensor_i2c_add(int channel, uint8_t addr, uint8_t reg, size_t len);
+esp_err_t sensor_i2c_write(int channel, uint8_t reg, const uint8_t *data, size_t len);
+uint32_t sensor_i2c_read_batch(uint32_t mask);
+const uint8_t *sensor_i2c_raw(int channel);
+void sensor_i2c_get_health(int channel, sensor_i2c_health *health);
+uint32_t sensor_i2c_bus_recoveries(void);
 
 //Private Function Declarations
-static void i2c_master_init();
-static esp_err_t i2c_my_read(i2c_port_t i2c_num, uint8_t i2c_addr, uint8_t i2c_reg, uint8_t* data_rd, size_t size);
-static esp_err_t i2c_my_write(i2c_port_t i2c_num, uint8_t i2c_addr, uint8_t i2c_reg, uint8_t* data_wr, size_t size);
+static esp_err_t i2c_master_init();
+static void i2c_bus_recover(void);
+static uint32_t i2c_group_read(int group, uint32_t mask);
+static esp_err_t i2c_channel_read(i2c_read_slot *slot);
+static void i2c_health_update(i2c_read_slot *slot, esp_err_t ret);
+static i2c_cmd_handle_t i2c_batch_link(int group, uint32_t mask);
+static esp_err_t i2c_queue_read(i2c_cmd_handle_t cmd, uint8_t i2c_addr, uint8_t i2c_reg, uint8_t* data_rd, size_t size);
+static esp_err_t i2c_my_write(i2c_port_t i2c_num, uint8_t i2c_addr, uint8_t i2c_reg, const uint8_t* data_wr, size_t size);
 
 
 //****************************************************************************
 //Public Functions
 //****************************************************************************
 /**
- * @brief Initializes I2C driver, initializes light sensor settings
+ * @brief Initializes I2C driver, channels are added afterwards by the sensor drivers
  */
-void sensor_i2c_init(void)
+esp_err_t sensor_i2c_init(void)
 {
-    i2c_master_init();
+    return i2c_master_init();
+}
+
+/**
+ * @brief Claims a channel for reading len bytes from reg of the device at addr and builds its
+ *  static command link. Re-adding a channel replaces it and resets its health
+ */
+esp_err_t sensor_i2c_add(int channel, uint8_t addr, uint8_t reg, size_t len)
+{
+    if (channel < 0 || channel >= SENSOR_I2C_CHANNELS || len == 0 || len > SENSOR_I2C_READ_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_read_slot *slot = &s_reads[channel];
+    if (slot->cmd != NULL) {
+        i2c_cmd_link_delete_static(slot->cmd);
+    }
+    memset(slot, 0, sizeof(*slot));
+    slot->addr = addr;
+    slot->reg = reg;
+    slot->len = (uint8_t)len;
+    s_groups[channel / I2C_BATCH_MAX].mask = 0;    //Cached group link may point at the old rx[]
+
+    slot->cmd = i2c_cmd_link_create_static(slot->link, sizeof(slot->link));
+    if (slot->cmd == NULL ||
+        i2c_queue_read(slot->cmd, slot->addr, slot->reg, slot->rx, slot->len) != ESP_OK ||
+        i2c_master_stop(slot->cmd) != ESP_OK) {
+        ESP_LOGE("sensor-i2c", "read link for 0x%02x does not fit", slot->addr);
+        slot->cmd = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Writes a device register on a channel's device, counted against the channel's health.
+ *  Used by drivers to configure the device
+ */
+esp_err_t sensor_i2c_write(int channel, uint8_t reg, const uint8_t *data, size_t len)
+{
+    if (channel < 0 || channel >= SENSOR_I2C_CHANNELS || s_reads[channel].cmd == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_read_slot *slot = &s_reads[channel];
+    esp_err_t ret = i2c_my_write(I2C_NUM_0, slot->addr, reg, data, len);
+    i2c_health_update(slot, ret);
+    if (ret != ESP_OK) {
+        ESP_LOGW("sensor-i2c", "0x%02x write 0x%02x failed: %s", slot->addr, reg, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+/**
+ * @brief Reads every channel set in mask, up to I2C_BATCH_MAX per bus session chained with repeated
+ *  starts so the bus is only taken and released once per group. If a session fails the bus is
+ *  recovered and that group's channels are read one at a time to find the faulty one. Quarantined
+ *  channels are left out and probed alone once their backoff expires. The returned mask says
+ *  whose bytes in sensor_i2c_raw() are fresh
+ */
+uint32_t sensor_i2c_read_batch(uint32_t mask)
+{
+    uint32_t batch = 0, ok = 0;
+    int64_t now = esp_timer_get_time();
 
-    //VEML config
-    i2c_my_write(I2C_NUM_0, 0x10, 0x00, aTxBuffer, 2);
-    aTxBuffer[1]=0x00;
-    i2c_my_write(I2C_NUM_0, 0x10, 0x01, aTxBuffer, 2);
-    i2c_my_write(I2C_NUM_0, 0x10, 0x02, aTxBuffer, 2);
-    i2c_my_write(I2C_NUM_0, 0x10, 0x03, aTxBuffer, 2);
-    
+    for (int i = 0; i < SENSOR_I2C_CHANNELS; i++) {
+        if (!(mask & SENSOR_I2C_MASK(i)) || s_reads[i].cmd == NULL) {
+            continue;
+        }
+        if (!s_reads[i].health.quarantined) {
+            batch |= SENSOR_I2C_MASK(i);
+        } else if (now >= s_reads[i].retry_at && i2c_channel_read(&s_reads[i]) == ESP_OK) {
+            ok |= SENSOR_I2C_MASK(i);
+        }
+    }
+    for (int g = 0; g < I2C_BATCH_GROUPS; g++) {
+        uint32_t group = (batch >> (g * I2C_BATCH_MAX)) & I2C_GROUP_MASK;
+        if (group != 0) {
+            ok |= i2c_group_read(g, group) << (g * I2C_BATCH_MAX);
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief Bytes received by a channel's last read
+ */
+const uint8_t *sensor_i2c_raw(int channel)
+{
+    return s_reads[channel].rx;
 }
 
 /**
- * @brief Read from VEML7700, converts to Lux
+ * @brief Copies out the bus health counters of one channel
  */
-uint16_t light_read(void)
+void sensor_i2c_get_health(int channel, sensor_i2c_health *health)
 {
-    static uint16_t data;
-    i2c_my_read(I2C_NUM_0, 0x10, 0x04, aRxBuffer, 2);
-    data = (aRxBuffer[1]<<8) | aRxBuffer[0];
-    return (data * 1.8432);
+    if (channel >= 0 && channel < SENSOR_I2C_CHANNELS) {
+        *health = s_reads[channel].health;
+    }
 }
 
 /**
- * @brief Read from NTCALUG02A103G, converts to Celsius
+ * @brief Number of bus clears since boot
  */
-uint16_t temp_read(void)
+uint32_t sensor_i2c_bus_recoveries(void)
 {
-    static uint16_t data;
-    i2c_my_read(I2C_NUM_0, 0x50, 0x00, aRxBuffer, 2);
-    data = ((aRxBuffer[0] & 0xF) <<4) | ((aRxBuffer[1] & 0xF0)>>4);
-    return (30 - ((2560000/data - 18056)/443.7) );
+    return s_recoveries;
 }
 
 //****************************************************************************
@@ -75,72 +208,228 @@ uint16_t temp_read(void)
 /**
  * @brief Initialize I2C driver (Defines set to standard speed 100kHz)
  */
-static void i2c_master_init(){
+static esp_err_t i2c_master_init(){
     int i2c_master_port = I2C_NUM_0;
     i2c_config_t conf = {
         .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_MASTER_SDA_IO,         
+        .sda_io_num = I2C_MASTER_SDA_IO,
         .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_io_num = I2C_MASTER_SCL_IO,         
+        .scl_io_num = I2C_MASTER_SCL_IO,
         .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = I2C_FREQ_HZ,  
+        .master.clk_speed = I2C_FREQ_HZ,
     };
-    i2c_param_config(i2c_master_port, &conf);
-    i2c_driver_install(i2c_master_port, conf.mode, I2C_RX_BUF_DISABLE, I2C_TX_BUF_DISABLE, 0);
+    esp_err_t ret = i2c_param_config(i2c_master_port, &conf);
+    if (ret == ESP_OK) {
+        ret = i2c_driver_install(i2c_master_port, conf.mode, I2C_RX_BUF_DISABLE, I2C_TX_BUF_DISABLE, 0);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE("sensor-i2c", "driver init failed: %s", esp_err_to_name(ret));
+    }
+    return ret;
 }
 
 /**
- * @brief test code to read i2c slave device with registered interface
- * _______________________________________________________________________________________________________
- * | start | slave_addr + rd_bit +ack | register + ack | read n-1 bytes + ack | read 1 byte + nack | stop |
- * --------|--------------------------|----------------|----------------------|--------------------|------|
- *
+ * @brief Frees a slave holding SDA low: takes the pins from the driver, clocks I2C_CLEAR_PULSES on SCL
+ *  so the slave finishes whatever byte it is stuck in, issues a STOP and reinstalls the driver.
+ *  The pre-built command links don't depend on the driver and stay valid
  */
-static esp_err_t i2c_my_read(i2c_port_t i2c_num, uint8_t i2c_addr, uint8_t i2c_reg, uint8_t* data_rd, size_t size){
-    if (size == 0) {
-        return ESP_OK;
-    }
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();                                   //Step 1
-    i2c_master_start(cmd);                                                          //Step 2
-    i2c_master_write_byte(cmd, ( i2c_addr << 1 ), ACK_CHECK_EN);                    //Step 3 - Slave address, Write
+static void i2c_bus_recover(void)
+{
+    i2c_driver_delete(I2C_NUM_0);
 
-    i2c_master_write_byte(cmd, i2c_reg, ACK_CHECK_EN);                              //       - Register address
+    gpio_set_direction(I2C_MASTER_SDA_IO, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_direction(I2C_MASTER_SCL_IO, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_level(I2C_MASTER_SDA_IO, 1);
+    gpio_set_level(I2C_MASTER_SCL_IO, 1);
+    for (int i = 0; i < I2C_CLEAR_PULSES; i++) {
+        gpio_set_level(I2C_MASTER_SCL_IO, 0);
+        esp_rom_delay_us(I2C_CLEAR_HALF_US);
+        gpio_set_level(I2C_MASTER_SCL_IO, 1);
+        esp_rom_delay_us(I2C_CLEAR_HALF_US);
+    }
 
-    i2c_master_start(cmd);
- 
-    i2c_master_write_byte(cmd, ( i2c_addr << 1 ) | I2C_MASTER_READ, ACK_CHECK_EN);  //       - Slave address, Read
+    //STOP: SDA low to high while SCL is high
+    gpio_set_level(I2C_MASTER_SCL_IO, 0);
+    gpio_set_level(I2C_MASTER_SDA_IO, 0);
+    esp_rom_delay_us(I2C_CLEAR_HALF_US);
+    gpio_set_level(I2C_MASTER_SCL_IO, 1);
+    esp_rom_delay_us(I2C_CLEAR_HALF_US);
+    gpio_set_level(I2C_MASTER_SDA_IO, 1);
+    esp_rom_delay_us(I2C_CLEAR_HALF_US);
 
-    if (size > 1) {
-        i2c_master_read(cmd, data_rd, size - 1, ACK_VAL);                           //Step 4
+    if (gpio_get_level(I2C_MASTER_SDA_IO) == 0) {
+        ESP_LOGW("sensor-i2c", "SDA still held low after bus clear");
     }
-    i2c_master_read_byte(cmd, data_rd + size - 1, NACK_VAL);                        //Step 5
+    s_recoveries++;
+    i2c_master_init();
+}
 
-    i2c_master_stop(cmd);                                                           //Step 6
+/**
+ * @brief Runs one group's combined read. mask is relative to the group, so is the returned mask
+ */
+static uint32_t i2c_group_read(int group, uint32_t mask)
+{
+    uint32_t ok = 0;
+    int base = group * I2C_BATCH_MAX;
+    i2c_cmd_handle_t cmd = i2c_batch_link(group, mask);
+    esp_err_t ret = (cmd != NULL) ? i2c_master_cmd_begin(I2C_NUM_0, cmd, I2C_TIMEOUT_TICKS) : ESP_ERR_NO_MEM;
 
-    esp_err_t ret = i2c_master_cmd_begin(i2c_num, cmd, 0xffffffff);    //Step 7
-    i2c_cmd_link_delete(cmd);                                                       //Step 8
+    if (ret == ESP_ERR_TIMEOUT) {
+        i2c_bus_recover();
+    }
+    for (int i = 0; i < I2C_BATCH_MAX; i++) {
+        i2c_read_slot *slot = &s_reads[base + i];
+        if (!(mask & (1u << i))) {
+            continue;
+        }
+        if (ret == ESP_OK || (mask & (mask - 1)) == 0) {
+            i2c_health_update(slot, ret);    //Result belongs to this channel alone
+            if (ret == ESP_OK) {
+                ok |= 1u << i;
+            }
+        } else if (i2c_channel_read(slot) == ESP_OK) {
+            ok |= 1u << i;
+        }
+    }
+    return ok;
+}
 
+/**
+ * @brief Replays one channel's read link with a bounded timeout, clearing the bus if it times out
+ */
+static esp_err_t i2c_channel_read(i2c_read_slot *slot)
+{
+    esp_err_t ret = (slot->cmd != NULL) ? i2c_master_cmd_begin(I2C_NUM_0, slot->cmd, I2C_TIMEOUT_TICKS) : ESP_ERR_INVALID_STATE;
+    if (ret == ESP_ERR_TIMEOUT) {
+        i2c_bus_recover();
+    }
+    i2c_health_update(slot, ret);
     return ret;
 }
 
+/**
+ * @brief Counts a read result. I2C_QUARANTINE_AFTER failures in a row quarantine the channel, every
+ *  failed probe doubles its backoff up to I2C_QUARANTINE_MAX_MS, one good read releases it
+ */
+static void i2c_health_update(i2c_read_slot *slot, esp_err_t ret)
+{
+    sensor_i2c_health *health = &slot->health;
+
+    health->reads++;
+    if (ret == ESP_OK) {
+        if (health->quarantined) {
+            ESP_LOGI("sensor-i2c", "0x%02x back after %u failures", slot->addr, (unsigned)health->consecutive);
+        }
+        health->consecutive = 0;
+        health->quarantined = false;
+        slot->backoff_ms = 0;
+        return;
+    }
+
+    health->errors++;
+    if (ret == ESP_ERR_TIMEOUT) {
+        health->timeouts++;
+    }
+    if (++health->consecutive < I2C_QUARANTINE_AFTER) {
+        return;
+    }
+    if (!health->quarantined) {
+        ESP_LOGW("sensor-i2c", "0x%02x quarantined: %s", slot->addr, esp_err_to_name(ret));
+        health->quarantined = true;
+        health->quarantines++;
+        slot->backoff_ms = I2C_QUARANTINE_MIN_MS;
+    } else {
+        slot->backoff_ms = MIN(slot->backoff_ms * 2, I2C_QUARANTINE_MAX_MS);
+    }
+    slot->retry_at = esp_timer_get_time() + (int64_t)slot->backoff_ms * 1000;
+}
+
+/**
+ * @brief Returns a group's combined read link for mask, rebuilding it in place if the subset changed
+ */
+static i2c_cmd_handle_t i2c_batch_link(int group, uint32_t mask)
+{
+    i2c_batch_group *batch = &s_groups[group];
+    int base = group * I2C_BATCH_MAX;
+
+    if (batch->cmd != NULL && batch->mask == mask) {
+        return batch->cmd;
+    }
+    if (batch->cmd != NULL) {
+        i2c_cmd_link_delete_static(batch->cmd);
+    }
+    batch->mask = 0;
+    batch->cmd = i2c_cmd_link_create_static(batch->link, sizeof(batch->link));
+    if (batch->cmd == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < I2C_BATCH_MAX; i++) {
+        i2c_read_slot *slot = &s_reads[base + i];
+        if ((mask & (1u << i)) &&
+            i2c_queue_read(batch->cmd, slot->addr, slot->reg, slot->rx, slot->len) != ESP_OK) {
+            batch->cmd = NULL;
+            return NULL;
+        }
+    }
+    if (i2c_master_stop(batch->cmd) != ESP_OK) {
+        batch->cmd = NULL;
+        return NULL;
+    }
+    batch->mask = mask;
+    return batch->cmd;
+}
+
+/**
+ * @brief Queues a registered read of an i2c slave device onto cmd, without the closing stop so several
+ *  reads can share one transaction
+ * _________________________________________________________________________________________________________________________
+ * | start | slave_addr + wr_bit + ack | register + ack | start | slave_addr + rd_bit + ack | read n-1 bytes + ack | read 1 byte + nack |
+ * --------|---------------------------|----------------|-------|---------------------------|----------------------|--------------------|
+ *
+ */
+static esp_err_t i2c_queue_read(i2c_cmd_handle_t cmd, uint8_t i2c_addr, uint8_t i2c_reg, uint8_t* data_rd, size_t size){
+    esp_err_t ret = ESP_OK;
+    if (size == 0) {
+        return ESP_OK;
+    }
+    ret |= i2c_master_start(cmd);
+    ret |= i2c_master_write_byte(cmd, ( i2c_addr << 1 ), ACK_CHECK_EN);                     //Slave address, Write
+    ret |= i2c_master_write_byte(cmd, i2c_reg, ACK_CHECK_EN);                               //Register address
+    ret |= i2c_master_start(cmd);
+    ret |= i2c_master_write_byte(cmd, ( i2c_addr << 1 ) | I2C_MASTER_READ, ACK_CHECK_EN);   //Slave address, Read
+    if (size > 1) {
+        ret |= i2c_master_read(cmd, data_rd, size - 1, ACK_VAL);
+    }
+    ret |= i2c_master_read_byte(cmd, data_rd + size - 1, NACK_VAL);
+    return ret == ESP_OK ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
 /**
  * @brief Test code to write i2c slave device with registered interface
  *        Master device write data to slave(both esp32),
  *        the data will be stored in slave buffer.
  *        We can read them out from slave buffer.
+ *        The link is built in a stack buffer, nothing is allocated
  * ____________________________________________________________________________________
  * | start | slave_addr + wr_bit + ack | register + ack | write n bytes + ack  | stop |
  * --------|---------------------------|----------------|----------------------|------|
  *
  */
-static esp_err_t i2c_my_write(i2c_port_t i2c_num, uint8_t i2c_addr, uint8_t i2c_reg, uint8_t* data_wr, size_t size){
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+static esp_err_t i2c_my_write(i2c_port_t i2c_num, uint8_t i2c_addr, uint8_t i2c_reg, const uint8_t* data_wr, size_t size){
+    uint8_t link[I2C_WRITE_LINK_SIZE];
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(link, sizeof(link));
+    if (cmd == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
     i2c_master_start(cmd);
     i2c_master_write_byte(cmd, ( i2c_addr << 1 ) | I2C_MASTER_WRITE, ACK_CHECK_EN);
     i2c_master_write_byte(cmd, i2c_reg, ACK_CHECK_EN);
     i2c_master_write(cmd, data_wr, size, ACK_CHECK_EN);
     i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(i2c_num, cmd, 0xffffffff);
-    i2c_cmd_link_delete(cmd);
+    esp_err_t ret = i2c_master_cmd_begin(i2c_num, cmd, I2C_TIMEOUT_TICKS);
+    i2c_cmd_link_delete_static(cmd);
+    if (ret == ESP_ERR_TIMEOUT) {
+        i2c_bus_recover();
+    }
     return ret;
-}
\ No newline at end of file
+}
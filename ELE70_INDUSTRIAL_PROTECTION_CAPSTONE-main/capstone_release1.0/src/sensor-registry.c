@@ -0,0 +1,140 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sensor-registry.h"
+
+_Static_assert(SENSOR_REGISTRY_MAX <= SENSOR_I2C_CHANNELS, "every sensor needs a bus channel");
+
+//Private Variables
+static sensor_desc s_sensors[SENSOR_REGISTRY_MAX];
+static int s_count;
+
+//Public Function Declarations
+esp_err_t sensor_registry_add(const sensor_driver *driver, int id, uint8_t addr, int en_pin);
+esp_err_t sensor_registry_attach(int index);
+void sensor_registry_detach(int index);
+int sensor_registry_count(void);
+sensor_desc *sensor_registry_get(int index);
+uint32_t sensor_registry_read(uint32_t due, sensor_struct *samples);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Appends a sensor socket to the board table, before the sampler starts. en_pin < 0 means
+ *  always present
+ */
+esp_err_t sensor_registry_add(const sensor_driver *driver, int id, uint8_t addr, int en_pin)
+{
+    if (s_count == SENSOR_REGISTRY_MAX) {
+        return ESP_ERR_NO_MEM;
+    }
+    sensor_desc *sensor = &s_sensors[s_count];
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->driver = driver;
+    sensor->id = id;
+    sensor->index = s_count;
+    sensor->en_pin = en_pin;
+    sensor->addr = addr;
+    sensor->period_us = (driver != NULL) ? driver->period_us : 0;
+    s_count++;
+    return ESP_OK;
+}
+
+/**
+ * @brief Marks a plugged-in sensor present: claims its bus channel afresh and runs the driver's init, so
+ *  a re-plugged device is configured again. A sensor that fails to configure is still attached,
+ *  its channel's health quarantines it. Sampler task only
+ */
+esp_err_t sensor_registry_attach(int index)
+{
+    sensor_desc *sensor = sensor_registry_get(index);
+    esp_err_t err = ESP_OK;
+    if (sensor == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const sensor_driver *driver = sensor->driver;
+    if (driver != NULL && driver->read == NULL) {
+        err = sensor_i2c_add(index, sensor->addr, driver->reg, driver->len);
+    }
+    if (err == ESP_OK && driver != NULL && driver->init != NULL) {
+        err = driver->init(sensor);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW("sensor-registry", "%s (id %d) init failed: %s", driver->name, sensor->id, esp_err_to_name(err));
+    }
+    sensor->present = true;
+    return err;
+}
+
+/**
+ * @brief Stops sampling a sensor that was pulled out. Sampler task only
+ */
+void sensor_registry_detach(int index)
+{
+    sensor_desc *sensor = sensor_registry_get(index);
+    if (sensor != NULL) {
+        sensor->present = false;
+    }
+}
+
+int sensor_registry_count(void)
+{
+    return s_count;
+}
+
+sensor_desc *sensor_registry_get(int index)
+{
+    return (index >= 0 && index < s_count) ? &s_sensors[index] : NULL;
+}
+
+/**
+ * @brief Samples every present sensor whose bit is set in due: bus sensors in batched sessions first,
+ *  then the rest through their own read. Writes one timestamped sample per successful read and
+ *  conversion into samples[index] (room for SENSOR_REGISTRY_MAX) and returns the mask of indices written
+ */
+uint32_t sensor_registry_read(uint32_t due, sensor_struct *samples)
+{
+    uint32_t bus = 0, fresh = 0;
+
+    for (int i = 0; i < s_count; i++) {
+        const sensor_desc *sensor = &s_sensors[i];
+        if (!(due & (1u << i)) || !sensor->present || sensor->driver == NULL) {
+            due &= ~(1u << i);
+        } else if (sensor->driver->read == NULL) {
+            bus |= 1u << i;
+        }
+    }
+    uint32_t ok = bus ? sensor_i2c_read_batch(bus) : 0;
+    int64_t now = esp_timer_get_time();
+
+    for (int i = 0; i < s_count; i++) {
+        sensor_desc *sensor = &s_sensors[i];
+        uint8_t raw[SENSOR_I2C_READ_MAX];
+        const uint8_t *data;
+        if (!(due & (1u << i))) {
+            continue;
+        }
+        if (bus & (1u << i)) {
+            if (!(ok & (1u << i))) {
+                continue;
+            }
+            data = sensor_i2c_raw(i);
+        } else {
+            if (sensor->driver->read(sensor, raw) != ESP_OK) {
+                continue;
+            }
+            data = raw;
+            now = esp_timer_get_time();
+        }
+        if (sensor->driver->convert(sensor, data, &samples[i].value) != ESP_OK) {
+            continue;
+        }
+        samples[i].id = sensor->id;
+        samples[i].timestamp = now;
+        samples[i].count = 0;
+        samples[i].flags = 0;
+        fresh |= 1u << i;
+    }
+    return fresh;
+}
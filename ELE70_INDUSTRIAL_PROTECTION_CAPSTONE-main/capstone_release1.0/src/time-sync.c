@@ -0,0 +1,384 @@
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include <lwip/netdb.h>
+#include "time-sync.h"
+
+//Defines
+#define NTP_PACKET_LEN      48
+#define NTP_VERSION         4
+#define NTP_MODE_CLIENT     3
+#define NTP_MODE_SERVER     4
+#define NTP_LI_UNSYNCED     3
+#define NTP_UNIX_OFFSET_S   2208988800LL    //1900-01-01 to 1970-01-01
+#define NTP_ERA_S           4294967296LL    //Timestamps wrap in 2036, era 1 starts then
+#define NTP_OFF_ORIGINATE   24
+#define NTP_OFF_RECEIVE     32
+#define NTP_OFF_TRANSMIT    40
+#define TIME_SYNC_DRIFT_GAIN 4              //Each new drift measurement moves the estimate by 1/GAIN
+#define TIME_SYNC_TASK_STACK 3072
+#define TIME_SYNC_TASK_PRIORITY 4
+
+typedef struct {
+    int64_t offset_us;      //UTC minus local time at local_us
+    int64_t local_us;       //Local time in the middle of the round trip
+    uint32_t rtt_us;
+} ntp_sample;
+
+//Private Variables
+static time_sync_config s_config;
+static SemaphoreHandle_t s_lock;        //The model below and the stats
+static bool s_drift_valid;
+static ntp_sample s_last;               //Latest sync, the reference of the model
+static ntp_sample s_drift_ref;          //Sync the next drift measurement spans from
+static time_sync_stats s_stats;
+static uint8_t s_packet[NTP_PACKET_LEN];
+
+//Public Function Declarations
+esp_err_t time_sync_start(const time_sync_config *config);
+bool time_sync_valid(void);
+int64_t time_sync_utc_us(int64_t mono_us);
+int64_t time_sync_mono_us(int64_t utc_us);
+void time_sync_get_stats(time_sync_stats *stats);
+bool time_sync_encode_stats(payload_writer *w, int group);
+int64_t time_sync_model_utc_us(const time_sync_model *model, int64_t mono_us);
+int64_t time_sync_model_mono_us(const time_sync_model *model, int64_t utc_us);
+int64_t time_sync_ntp_to_utc_us(const uint8_t *ts);
+
+//Private Function Declarations
+static void sync_task(void *pvParameters);
+static bool sync_once(ntp_sample *best);
+static bool probe(int s, ntp_sample *sample);
+static void apply(const ntp_sample *sample);
+static int socket_open(void);
+static time_sync_model model(void);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Starts the sync task, which makes its first attempt right away
+ */
+esp_err_t time_sync_start(const time_sync_config *config)
+{
+    if (s_lock != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config->host == NULL || config->port == NULL || config->interval_s == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_config = *config;
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreatePinnedToCore(sync_task, "time_sync", TIME_SYNC_TASK_STACK, NULL, TIME_SYNC_TASK_PRIORITY, NULL, 0) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool time_sync_valid(void)
+{
+    bool synced = false;
+
+    if (s_lock != NULL) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        synced = s_stats.synced;
+        xSemaphoreGive(s_lock);
+    }
+    return synced;
+}
+
+/**
+ * @brief UTC in us since 1970 of a local esp_timer_get_time() instant, extrapolated with the drift
+ *  estimate from the last sync. 0 before the first sync
+ */
+int64_t time_sync_utc_us(int64_t mono_us)
+{
+    int64_t utc_us = 0;
+
+    if (s_lock == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_stats.synced) {
+        time_sync_model m = model();
+        utc_us = time_sync_model_utc_us(&m, mono_us);
+    }
+    xSemaphoreGive(s_lock);
+    return utc_us;
+}
+
+/**
+ * @brief Inverse of time_sync_utc_us(), for timestamps kept in UTC across a reboot. The result is
+ *  negative for an instant before this boot. 0 before the first sync
+ */
+int64_t time_sync_mono_us(int64_t utc_us)
+{
+    int64_t mono_us = 0;
+
+    if (s_lock == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_stats.synced) {
+        time_sync_model m = model();
+        mono_us = time_sync_model_mono_us(&m, utc_us);
+    }
+    xSemaphoreGive(s_lock);
+    return mono_us;
+}
+
+void time_sync_get_stats(time_sync_stats *stats)
+{
+    if (s_lock == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_lock);
+}
+
+/**
+ * @brief Stats source (network_stats_source) for the client, one group:
+ *   time=sntp&synced=<0|1>&syncs=<n>&failures=<n>&offset_us=<us>&drift_ppb=<ppb>&rtt_us=<us>
+ *   &since_sync_s=<s>
+ *  since_sync_s is 0 until the first sync
+ */
+bool time_sync_encode_stats(payload_writer *w, int group)
+{
+    time_sync_stats stats;
+
+    if (group > 0) {
+        return false;
+    }
+    time_sync_get_stats(&stats);
+    payload_append_str(w, "time=sntp");
+    payload_append_field(w, "synced", stats.synced);
+    payload_append_field(w, "syncs", stats.syncs);
+    payload_append_field(w, "failures", stats.failures);
+    payload_append_field(w, "offset_us", stats.offset_us);
+    payload_append_field(w, "drift_ppb", stats.drift_ppb);
+    payload_append_field(w, "rtt_us", stats.rtt_us);
+    payload_append_field(w, "since_sync_s", stats.synced ? (esp_timer_get_time() - stats.last_sync_us) / 1000000 : 0);
+    return true;
+}
+
+/**
+ * @brief UTC of a local instant under a model: the offset at local_us, plus drift_ppb of the time
+ *  elapsed since
+ */
+int64_t time_sync_model_utc_us(const time_sync_model *model, int64_t mono_us)
+{
+    int64_t since = mono_us - model->local_us;
+
+    return mono_us + model->offset_us + since * model->drift_ppb / 1000000000;
+}
+
+/**
+ * @brief Inverse of time_sync_model_utc_us(). UTC runs 1e9 + drift_ppb ns per 1e9 local ns, so the
+ *  UTC span since local_us is scaled back by that ratio, written so it can't overflow for any span
+ *  a drift within TIME_SYNC_DRIFT_MAX_PPB can reach
+ */
+int64_t time_sync_model_mono_us(const time_sync_model *model, int64_t utc_us)
+{
+    int64_t since = utc_us - model->offset_us - model->local_us;
+
+    return model->local_us + since - since * model->drift_ppb / (1000000000 + model->drift_ppb);
+}
+
+/**
+ * @brief 64-bit NTP timestamp (big endian seconds since 1900, 32-bit fraction) to us since 1970.
+ *  Seconds below 2^31 are taken as era 1, which starts on 2036-02-07, so the mapping covers 1968
+ *  to 2104
+ */
+int64_t time_sync_ntp_to_utc_us(const uint8_t *ts)
+{
+    uint32_t sec = (uint32_t)ts[0] << 24 | (uint32_t)ts[1] << 16 | (uint32_t)ts[2] << 8 | ts[3];
+    uint32_t frac = (uint32_t)ts[4] << 24 | (uint32_t)ts[5] << 16 | (uint32_t)ts[6] << 8 | ts[7];
+    int64_t s = (int64_t)sec + (sec < 0x80000000u ? NTP_ERA_S : 0); //Era 0 ends in 2036
+
+    return (s - NTP_UNIX_OFFSET_S) * 1000000 + (int64_t)(((uint64_t)frac * 1000000) >> 32);
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+/**
+ * @brief Syncs every interval_s. Until the first sync succeeds it retries on a backoff starting
+ *  at TIME_SYNC_RETRY_MIN_S, so a node booting before the network settles gets a time quickly
+ */
+static void sync_task(void *pvParameters)
+{
+    uint32_t retry_s = TIME_SYNC_RETRY_MIN_S;
+    ntp_sample sample;
+
+    while (1) {
+        uint32_t wait_s = s_config.interval_s;
+        if (sync_once(&sample)) {
+            apply(&sample);
+        } else {
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            s_stats.failures++;
+            bool synced = s_stats.synced;
+            xSemaphoreGive(s_lock);
+            if (!synced) {
+                wait_s = retry_s;
+                retry_s = (retry_s * 2 > s_config.interval_s) ? s_config.interval_s : retry_s * 2;
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(wait_s * 1000));
+    }
+}
+
+/**
+ * @brief Runs TIME_SYNC_PROBES round trips and keeps the one with the shortest round trip, whose
+ *  offset is the least disturbed by queuing on the way. False if none got a valid reply
+ */
+static bool sync_once(ntp_sample *best)
+{
+    ntp_sample sample;
+    bool found = false;
+    int s = socket_open();
+
+    if (s < 0) {
+        return false;
+    }
+    for (int i = 0; i < TIME_SYNC_PROBES; i++) {
+        if (probe(s, &sample) && (!found || sample.rtt_us < best->rtt_us)) {
+            *best = sample;
+            found = true;
+        }
+    }
+    close(s);
+    return found;
+}
+
+/**
+ * @brief One client request. The transmit timestamp carries a random nonce rather than the time,
+ *  the reply must echo it as its originate timestamp, which also drops late replies to an earlier
+ *  probe. Offset and round trip follow RFC 4330 5, with t1 and t4 in local time
+ */
+static bool probe(int s, ntp_sample *sample)
+{
+    uint32_t nonce[2] = { esp_random(), esp_random() };
+
+    memset(s_packet, 0, sizeof(s_packet));
+    s_packet[0] = (NTP_VERSION << 3) | NTP_MODE_CLIENT;
+    memcpy(&s_packet[NTP_OFF_TRANSMIT], nonce, sizeof(nonce));
+
+    int64_t t1 = esp_timer_get_time();
+    if (send(s, s_packet, sizeof(s_packet), 0) != sizeof(s_packet)) {
+        return false;
+    }
+    while (1) {
+        int r = recv(s, s_packet, sizeof(s_packet), 0);
+        int64_t t4 = esp_timer_get_time();
+        if (r < 0 || t4 - t1 > TIME_SYNC_TIMEOUT_MS * 1000) {
+            return false;
+        }
+        if (r < NTP_PACKET_LEN || memcmp(&s_packet[NTP_OFF_ORIGINATE], nonce, sizeof(nonce)) != 0) {
+            continue;
+        }
+        uint8_t stratum = s_packet[1];
+        if ((s_packet[0] & 0x07) != NTP_MODE_SERVER || (s_packet[0] >> 6) == NTP_LI_UNSYNCED ||
+            stratum == 0 || stratum > 15) {
+            return false; //Kiss-o'-death or an unsynchronized server
+        }
+        int64_t t2 = time_sync_ntp_to_utc_us(&s_packet[NTP_OFF_RECEIVE]);
+        int64_t t3 = time_sync_ntp_to_utc_us(&s_packet[NTP_OFF_TRANSMIT]);
+        int64_t rtt = (t4 - t1) - (t3 - t2);
+        sample->offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+        sample->local_us = t1 + (t4 - t1) / 2;
+        sample->rtt_us = rtt > 0 ? (uint32_t)rtt : 0;
+        return true;
+    }
+}
+
+/**
+ * @brief Makes a sync the new reference of the model. The drift is measured over at least
+ *  TIME_SYNC_DRIFT_MIN_S, so round trip noise stays small against the span. An implausible drift
+ *  means the server's clock stepped, the estimate then starts over
+ */
+static void apply(const ntp_sample *sample)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int64_t span = sample->local_us - s_drift_ref.local_us;
+    if (!s_stats.synced) {
+        s_drift_ref = *sample;
+    } else if (span >= (int64_t)TIME_SYNC_DRIFT_MIN_S * 1000000) {
+        int64_t ppb = (sample->offset_us - s_drift_ref.offset_us) * 1000000000 / span;
+        if (llabs(ppb) > TIME_SYNC_DRIFT_MAX_PPB) {
+            ESP_LOGW("time-sync", "clock stepped by %lld us", (long long)(sample->offset_us - s_last.offset_us));
+            s_drift_valid = false;
+            s_stats.drift_ppb = 0;
+        } else if (!s_drift_valid) {
+            s_drift_valid = true;
+            s_stats.drift_ppb = (int32_t)ppb;
+        } else {
+            s_stats.drift_ppb += (int32_t)((ppb - s_stats.drift_ppb) / TIME_SYNC_DRIFT_GAIN);
+        }
+        s_drift_ref = *sample;
+    }
+    s_last = *sample;
+    s_stats.synced = true;
+    s_stats.syncs++;
+    s_stats.offset_us = sample->offset_us;
+    s_stats.rtt_us = sample->rtt_us;
+    s_stats.last_sync_us = sample->local_us;
+    xSemaphoreGive(s_lock);
+}
+
+static int socket_open(void)
+{
+    const struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_DGRAM,
+    };
+    struct addrinfo *res;
+
+    if (getaddrinfo(s_config.host, s_config.port, &hints, &res) != 0 || res == NULL) {
+        return -1;
+    }
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+    int r = connect(s, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (r != 0) {
+        close(s);
+        return -1;
+    }
+
+    struct timeval timeout = {
+        .tv_sec = TIME_SYNC_TIMEOUT_MS / 1000,
+        .tv_usec = (TIME_SYNC_TIMEOUT_MS % 1000) * 1000,
+    };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return s;
+}
+
+/**
+ * @brief The model behind the conversions, taken with s_lock held
+ */
+static time_sync_model model(void)
+{
+    time_sync_model m = {
+        .offset_us = s_last.offset_us,
+        .local_us = s_last.local_us,
+        .drift_ppb = s_stats.drift_ppb,
+    };
+    return m;
+}
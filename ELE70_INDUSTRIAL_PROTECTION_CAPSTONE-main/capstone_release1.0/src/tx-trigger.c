@@ -0,0 +1,86 @@
+#include <stdatomic.h>
+#include "esp_timer.h"
+#include "tx-trigger.h"
+
+//Private Types
+typedef struct {
+    _Atomic int64_t pending_us;     //Oldest unserved event, 0 if none
+    _Atomic uint32_t triggers;
+    _Atomic uint32_t written;
+    _Atomic uint32_t journaled;
+    _Atomic uint32_t over_target;
+    latency_hist latency;
+} trigger_channel;
+
+//Private Variables
+static trigger_channel s_channels[TX_TRIGGER_KINDS];
+
+//Public Function Declarations
+void tx_trigger_mark(tx_trigger_kind kind);
+void tx_trigger_mark_at(tx_trigger_kind kind, int64_t at_us);
+void tx_trigger_served(int64_t write_us);
+void tx_trigger_get_stats(tx_trigger_kind kind, tx_trigger_stats *stats);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Records that an event of this kind is about to wake the transmitter, as of now
+ */
+void tx_trigger_mark(tx_trigger_kind kind)
+{
+    tx_trigger_mark_at(kind, esp_timer_get_time());
+}
+
+/**
+ * @brief Records an event that happened at at_us (esp_timer_get_time()) and is about to wake the
+ *  transmitter. The pending start is the earliest event of the kind still waiting for a write
+ */
+void tx_trigger_mark_at(tx_trigger_kind kind, int64_t at_us)
+{
+    trigger_channel *ch = &s_channels[kind];
+    int64_t pending = atomic_load(&ch->pending_us);
+
+    at_us = at_us > 0 ? at_us : 1;  //0 means none pending
+    while ((pending == 0 || at_us < pending) &&
+           !atomic_compare_exchange_weak(&ch->pending_us, &pending, at_us)) {
+    }
+    atomic_fetch_add_explicit(&ch->triggers, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Serves every pending event with the write that started at write_us, or with the journal
+ *  when write_us is negative. An event marked after the write started rode along with it and
+ *  counts as 0 us
+ */
+void tx_trigger_served(int64_t write_us)
+{
+    for (int i = 0; i < TX_TRIGGER_KINDS; i++) {
+        trigger_channel *ch = &s_channels[i];
+        int64_t start = atomic_exchange(&ch->pending_us, 0);
+        if (start == 0) {
+            continue;
+        }
+        if (write_us < 0) {
+            atomic_fetch_add_explicit(&ch->journaled, 1, memory_order_relaxed);
+            continue;
+        }
+        int64_t us = write_us > start ? write_us - start : 0;
+        latency_hist_record(&ch->latency, us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+        atomic_fetch_add_explicit(&ch->written, 1, memory_order_relaxed);
+        if (us > TX_TRIGGER_TARGET_US) {
+            atomic_fetch_add_explicit(&ch->over_target, 1, memory_order_relaxed);
+        }
+    }
+}
+
+void tx_trigger_get_stats(tx_trigger_kind kind, tx_trigger_stats *stats)
+{
+    trigger_channel *ch = &s_channels[kind];
+
+    stats->triggers = atomic_load_explicit(&ch->triggers, memory_order_relaxed);
+    stats->written = atomic_load_explicit(&ch->written, memory_order_relaxed);
+    stats->journaled = atomic_load_explicit(&ch->journaled, memory_order_relaxed);
+    stats->over_target = atomic_load_explicit(&ch->over_target, memory_order_relaxed);
+    latency_hist_snapshot_get(&ch->latency, &stats->latency);
+}
@@ -0,0 +1,481 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unity.h>
+#include "nvs_flash.h"
+#include "esp_netif.h"
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "network.h"
+#include "coap-client.h"
+
+/*
+ * The CoAP transport (pio test -e native_coap) against a UDP stand-in for the server on
+ * 127.0.0.1:5683. The stand-in logs every datagram the client sends with its arrival time and
+ * answers confirmable ones with a piggybacked ACK. It can drop the next few datagrams it reads, or a
+ * set share of every datagram crossing it in either direction, ACKs included, and it can hold its
+ * ACKs for the test to send. The retransmit timers run on the real RFC 7252 parameters, so the
+ * backoff test takes a few seconds.
+ */
+
+#if NETWORK_TRANSPORT != 2
+#error "test_coap needs the CoAP transport, run it with: pio test -e native_coap"
+#endif
+
+//Defines
+#define SERVER_PORT 5683        //COAP_PORT
+#define ACK_TIMEOUT_MS 2000     //COAP_ACK_TIMEOUT_MS
+#define ACK_RANDOM_MS 1000      //COAP_ACK_RANDOM_MS
+#define TICK_MS 100             //COAP_TICK_MS, how late a timer may fire
+#define DATAGRAM_MAX 1280
+#define LOG_MAX 128
+#define WAIT_MS 2000
+#define LOSSY_WAIT_MS 40000     //Lost CONs wait out their timeouts one at a time
+#define LOSSY_BATCHES 12
+#define LOSSY_ALARMS 4          //The first batches carry one alarm each
+#define DROP_EVERY 4            //A quarter of all datagrams
+
+typedef struct {
+    int64_t at_us;
+    bool dropped;
+    size_t len;
+    uint8_t buf[DATAGRAM_MAX];
+} logged_datagram;
+
+typedef struct {
+    int type;
+    uint16_t mid;
+    size_t token_len;
+    const uint8_t *token;
+    char path[COAP_PATH_LEN + 1];
+    const char *payload;
+    size_t payload_len;
+} coap_message;
+
+//Private Variables
+static int s_server = -1;
+static struct sockaddr_in s_peer;               //The client's address, once it has sent something
+static _Atomic bool s_hold_acks;
+static _Atomic int s_drop_next;                 //Datagrams still to drop on arrival
+static _Atomic int s_drop_every;                //0, or drop every Nth datagram crossing
+static _Atomic uint32_t s_crossed;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static logged_datagram s_log[LOG_MAX];
+static int s_log_count;
+static char s_path_telemetry[COAP_PATH_LEN + 1];
+static char s_path_alarm[COAP_PATH_LEN + 1];
+
+//Private Function Declarations
+static void *server_loop(void *arg);
+static bool crossing_dropped(void);
+static void server_ack(uint16_t mid, const uint8_t *token, size_t token_len);
+static void log_clear(void);
+static int log_count(void);
+static const logged_datagram *wait_logged(int index);
+static bool parse(const logged_datagram *d, coap_message *m);
+static coap_client_stats stats(void);
+static bool wait_acked(uint32_t acked, int wait_ms);
+static sensor_struct sample(int value, bool alarm);
+
+//****************************************************************************
+//Server
+//****************************************************************************
+
+/**
+ * @brief Logs every datagram, dropped or not, and ACKs the confirmable ones that got through with
+ *  2.04 Changed unless the test holds the ACKs. A duplicate whose first ACK was lost is ACKed again
+ */
+static void *server_loop(void *arg)
+{
+    uint8_t buf[DATAGRAM_MAX];
+    struct sockaddr_in from;
+
+    while (1) {
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(s_server, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+        if (n < 4) {
+            continue;
+        }
+        bool dropped = crossing_dropped();
+        if (atomic_load(&s_drop_next) > 0) {
+            atomic_fetch_sub(&s_drop_next, 1);
+            dropped = true;
+        }
+        pthread_mutex_lock(&s_lock);
+        s_peer = from;
+        if (s_log_count < LOG_MAX) {
+            logged_datagram *d = &s_log[s_log_count++];
+            d->at_us = esp_timer_get_time();
+            d->dropped = dropped;
+            d->len = (size_t)n;
+            memcpy(d->buf, buf, (size_t)n);
+        }
+        pthread_mutex_unlock(&s_lock);
+
+        if (!dropped && ((buf[0] >> 4) & 0x3) == 0 && !atomic_load(&s_hold_acks) && !crossing_dropped()) {
+            server_ack((uint16_t)(buf[2] << 8 | buf[3]), &buf[4], buf[0] & 0xF);
+        }
+    }
+    return NULL;
+}
+
+static bool crossing_dropped(void)
+{
+    int every = atomic_load(&s_drop_every);
+    return every > 0 && atomic_fetch_add(&s_crossed, 1) % every == every - 1;
+}
+
+static void server_ack(uint16_t mid, const uint8_t *token, size_t token_len)
+{
+    uint8_t ack[4 + 8] = {0x60 | (uint8_t)token_len, 0x44, (uint8_t)(mid >> 8), (uint8_t)mid};
+
+    memcpy(&ack[4], token, token_len);
+    pthread_mutex_lock(&s_lock);
+    struct sockaddr_in peer = s_peer;
+    pthread_mutex_unlock(&s_lock);
+    sendto(s_server, ack, 4 + token_len, 0, (struct sockaddr *)&peer, sizeof(peer));
+}
+
+//****************************************************************************
+//Helpers
+//****************************************************************************
+
+static void log_clear(void)
+{
+    pthread_mutex_lock(&s_lock);
+    s_log_count = 0;
+    pthread_mutex_unlock(&s_lock);
+}
+
+static int log_count(void)
+{
+    pthread_mutex_lock(&s_lock);
+    int count = s_log_count;
+    pthread_mutex_unlock(&s_lock);
+    return count;
+}
+
+/**
+ * @brief Waits up to WAIT_MS plus the longest second ACK timeout for datagram number index since the
+ *  last log_clear()
+ */
+static const logged_datagram *wait_logged(int index)
+{
+    for (int i = 0; i < WAIT_MS + 2 * (ACK_TIMEOUT_MS + ACK_RANDOM_MS); i++) {
+        if (log_count() > index) {
+            return &s_log[index];
+        }
+        usleep(1000);
+    }
+    TEST_FAIL_MESSAGE("server saw no such datagram");
+    return NULL;
+}
+
+/**
+ * @brief Header, token, the Uri-Path options joined with '/' and the payload; false if malformed
+ */
+static bool parse(const logged_datagram *d, coap_message *m)
+{
+    const uint8_t *buf = d->buf;
+    size_t p, path_len = 0;
+    unsigned number = 0;
+
+    memset(m, 0, sizeof(*m));
+    m->type = (buf[0] >> 4) & 0x3;
+    m->mid = (uint16_t)(buf[2] << 8 | buf[3]);
+    m->token_len = buf[0] & 0xF;
+    m->token = &buf[4];
+    for (p = 4 + m->token_len; p < d->len && buf[p] != 0xFF; ) {
+        unsigned delta = buf[p] >> 4;
+        size_t len = buf[p] & 0xF;
+        p++;
+        if (delta == 13) {
+            delta = 13 + buf[p++];
+        }
+        if (len == 13) {
+            len = 13 + buf[p++];
+        }
+        number += delta;
+        if (number == 11) {
+            if (path_len + len + 1 > sizeof(m->path)) {
+                return false;
+            }
+            if (path_len > 0) {
+                m->path[path_len++] = '/';
+            }
+            memcpy(&m->path[path_len], &buf[p], len);
+            path_len += len;
+        }
+        p += len;
+    }
+    if (p < d->len) {
+        m->payload = (const char *)&buf[p + 1];
+        m->payload_len = d->len - p - 1;
+    }
+    return p <= d->len;
+}
+
+static coap_client_stats stats(void)
+{
+    coap_client_stats s;
+    coap_client_get_stats(&s);
+    return s;
+}
+
+static bool wait_acked(uint32_t acked, int wait_ms)
+{
+    for (int i = 0; i < wait_ms && stats().acked < acked; i++) {
+        usleep(1000);
+    }
+    return stats().acked == acked;
+}
+
+static sensor_struct sample(int value, bool alarm)
+{
+    return (sensor_struct){
+        .id = 2,
+        .value = value * SENSOR_VALUE_ONE,
+        .timestamp = esp_timer_get_time(),
+        .flags = alarm ? SENSOR_FLAG_ALARM : 0,
+    };
+}
+
+/**
+ * @brief Every test starts with nothing in flight, no loss and the server ACKing
+ */
+void setUp(void)
+{
+    atomic_store(&s_hold_acks, false);
+    atomic_store(&s_drop_next, 0);
+    atomic_store(&s_drop_every, 0);
+    coap_client_stats s = stats();
+    TEST_ASSERT_TRUE(wait_acked(s.sent_con - s.lost - s.reset, WAIT_MS));
+    log_clear();
+}
+
+void tearDown(void)
+{
+}
+
+//****************************************************************************
+//Tests
+//****************************************************************************
+
+/**
+ * @brief A batch with an alarm in it sends the alarm alone as a confirmable POST to the alarm path and
+ *  the rest as one non-confirmable POST to the telemetry path. Both carry their message id as token
+ */
+static void test_alarm_con_telemetry_non(void)
+{
+    const sensor_struct samples[4] = { sample(1, false), sample(99, true), sample(3, false), sample(4, false) };
+    coap_client_stats before = stats();
+    coap_message alarm, telemetry;
+
+    TEST_ASSERT_EQUAL_INT(ESP_OK, network_transmit(samples, 4));
+
+    TEST_ASSERT_TRUE(parse(wait_logged(0), &alarm));
+    TEST_ASSERT_TRUE(parse(wait_logged(1), &telemetry));
+    if (alarm.type != 0) {      //The NON can overtake the CON, which is handed over first but sent by its slot
+        coap_message swap = alarm;
+        alarm = telemetry;
+        telemetry = swap;
+    }
+    TEST_ASSERT_EQUAL_INT(0, alarm.type);
+    TEST_ASSERT_EQUAL_STRING(s_path_alarm, alarm.path);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(alarm.payload, "count=1&", 8));
+    TEST_ASSERT_NOT_NULL(memmem(alarm.payload, alarm.payload_len, "&measurement=99.00&alarm=1", 26));
+
+    TEST_ASSERT_EQUAL_INT(1, telemetry.type);
+    TEST_ASSERT_EQUAL_STRING(s_path_telemetry, telemetry.path);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(telemetry.payload, "count=3&", 8));
+    TEST_ASSERT_NULL(memmem(telemetry.payload, telemetry.payload_len, "alarm", 5));
+
+    TEST_ASSERT_EQUAL_size_t(2, alarm.token_len);
+    TEST_ASSERT_EQUAL_HEX8(alarm.mid >> 8, alarm.token[0]);
+    TEST_ASSERT_EQUAL_HEX8(alarm.mid & 0xFF, alarm.token[1]);
+    TEST_ASSERT_NOT_EQUAL(alarm.mid, telemetry.mid);
+
+    TEST_ASSERT_TRUE(wait_acked(before.acked + 1, WAIT_MS));
+    TEST_ASSERT_EQUAL_UINT32(before.sent_con + 1, stats().sent_con);
+    TEST_ASSERT_EQUAL_UINT32(before.sent_non + 1, stats().sent_non);
+    TEST_ASSERT_EQUAL_UINT32(before.retransmitted, stats().retransmitted);
+}
+
+/**
+ * @brief With one confirmable message outstanding the next waits its turn. An ACK for any other
+ *  message id settles nothing and releases nothing; the matching one settles it and sends the next at
+ *  once, under a new id. A late duplicate ACK is ignored
+ */
+static void test_mid_matching(void)
+{
+    const sensor_struct alarms[2] = { sample(1, true), sample(2, true) };
+    uint32_t acked = stats().acked;
+    coap_message first, second;
+
+    atomic_store(&s_hold_acks, true);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, network_transmit(alarms, 2));
+    TEST_ASSERT_TRUE(parse(wait_logged(0), &first));
+    usleep(TICK_MS * 1000);
+    TEST_ASSERT_EQUAL_INT(1, log_count());     //NSTART 1
+
+    server_ack(first.mid + 1, first.token, first.token_len);
+    server_ack(first.mid ^ 0x8000, first.token, first.token_len);
+    usleep(2 * TICK_MS * 1000);
+    TEST_ASSERT_EQUAL_UINT32(acked, stats().acked);
+    TEST_ASSERT_EQUAL_INT(1, log_count());
+
+    server_ack(first.mid, first.token, first.token_len);
+    TEST_ASSERT_TRUE(parse(wait_logged(1), &second));
+    TEST_ASSERT_EQUAL_UINT32(acked + 1, stats().acked);
+    TEST_ASSERT_EQUAL_INT(0, second.type);
+    TEST_ASSERT_EQUAL_UINT16((uint16_t)(first.mid + 1), second.mid);
+    TEST_ASSERT_EQUAL_HEX8(second.mid >> 8, second.token[0]);
+    TEST_ASSERT_EQUAL_HEX8(second.mid & 0xFF, second.token[1]);
+    TEST_ASSERT_NOT_NULL(memmem(second.payload, second.payload_len, "&measurement=2.00", 17));
+
+    server_ack(first.mid, first.token, first.token_len);
+    usleep(2 * TICK_MS * 1000);
+    TEST_ASSERT_EQUAL_UINT32(acked + 1, stats().acked);
+    server_ack(second.mid, second.token, second.token_len);
+    TEST_ASSERT_TRUE(wait_acked(acked + 2, WAIT_MS));
+}
+
+/**
+ * @brief A confirmable message that gets no ACK is sent again, byte for byte, after its initial
+ *  timeout of ACK_TIMEOUT_MS to 1.5 times that, then after twice that timeout, until one gets through
+ */
+static void test_con_retransmitted_with_backoff(void)
+{
+    const sensor_struct alarm = sample(5, true);
+    coap_client_stats before = stats();
+    char msg[96];
+
+    atomic_store(&s_drop_next, 2);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, network_transmit(&alarm, 1));
+    const logged_datagram *sent[3];
+    for (int i = 0; i < 3; i++) {
+        sent[i] = wait_logged(i);
+    }
+    TEST_ASSERT_TRUE(wait_acked(before.acked + 1, WAIT_MS));
+
+    for (int i = 1; i < 3; i++) {
+        TEST_ASSERT_EQUAL_size_t(sent[0]->len, sent[i]->len);
+        TEST_ASSERT_EQUAL_MEMORY(sent[0]->buf, sent[i]->buf, sent[0]->len);
+    }
+    TEST_ASSERT_TRUE(sent[0]->dropped && sent[1]->dropped && !sent[2]->dropped);
+    int32_t first_ms = (int32_t)((sent[1]->at_us - sent[0]->at_us) / 1000);
+    int32_t second_ms = (int32_t)((sent[2]->at_us - sent[1]->at_us) / 1000);
+    snprintf(msg, sizeof(msg), "retransmitted after %d ms, then %d ms", (int)first_ms, (int)second_ms);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(ACK_TIMEOUT_MS, first_ms);
+    TEST_ASSERT_LESS_OR_EQUAL_INT(ACK_TIMEOUT_MS + ACK_RANDOM_MS + TICK_MS, first_ms);
+    TEST_ASSERT_INT_WITHIN(3 * TICK_MS, 2 * first_ms, second_ms);
+
+    TEST_ASSERT_EQUAL_UINT32(before.retransmitted + 2, stats().retransmitted);
+    TEST_ASSERT_EQUAL_UINT32(before.lost, stats().lost);
+    TEST_ASSERT_EQUAL_INT(3, log_count());
+}
+
+/**
+ * @brief A quarter of all datagrams lost, ACKs included. Every alarm still arrives, exactly once
+ *  once duplicates are told apart by message id, and none is given up. Telemetry is not retried: what
+ *  the server saw of it is what coap_client_get_stats() counted as sent less what was dropped
+ */
+static void test_lossy_link(void)
+{
+    coap_client_stats before = stats();
+    uint16_t mids[LOG_MAX];
+    int alarms = 0, non_received = 0, non_dropped = 0, con_dropped = 0;
+    bool seen_value[LOSSY_ALARMS] = { false };
+    char msg[160];
+
+    atomic_store(&s_drop_every, DROP_EVERY);
+    for (int b = 0; b < LOSSY_BATCHES; b++) {
+        sensor_struct batch[3] = { sample(b, false), sample(b, false), sample(100 + b, b < LOSSY_ALARMS) };
+        TEST_ASSERT_EQUAL_INT(ESP_OK, network_transmit(batch, 3));
+    }
+    TEST_ASSERT_TRUE(wait_acked(before.acked + LOSSY_ALARMS, LOSSY_WAIT_MS));
+
+    for (int i = 0; i < log_count(); i++) {
+        coap_message m;
+        TEST_ASSERT_TRUE(parse(&s_log[i], &m));
+        if (m.type == 1) {
+            non_dropped += s_log[i].dropped ? 1 : 0;
+            non_received += s_log[i].dropped ? 0 : 1;
+            continue;
+        }
+        bool duplicate = false;
+        for (int j = 0; j < alarms; j++) {
+            duplicate |= (mids[j] == m.mid);
+        }
+        con_dropped += s_log[i].dropped ? 1 : 0;
+        if (s_log[i].dropped || duplicate) {
+            continue;
+        }
+        mids[alarms++] = m.mid;
+        const char *v = memmem(m.payload, m.payload_len, "&measurement=", 13);
+        TEST_ASSERT_NOT_NULL(v);
+        int value = atoi(v + 13) - 100;
+        TEST_ASSERT_TRUE(value >= 0 && value < LOSSY_ALARMS && !seen_value[value]);
+        seen_value[value] = true;
+    }
+
+    coap_client_stats after = stats();
+    snprintf(msg, sizeof(msg), "1 in %d dropped: %d of %d NON lost, %d CON sends dropped, %u retransmissions",
+             DROP_EVERY, non_dropped, non_dropped + non_received, con_dropped,
+             (unsigned)(after.retransmitted - before.retransmitted));
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL_INT(LOSSY_ALARMS, alarms);
+    TEST_ASSERT_EQUAL_UINT32(before.sent_con + LOSSY_ALARMS, after.sent_con);
+    TEST_ASSERT_EQUAL_UINT32(before.lost, after.lost);
+    TEST_ASSERT_GREATER_THAN_UINT32(before.retransmitted, after.retransmitted);
+    TEST_ASSERT_EQUAL_UINT32(LOSSY_BATCHES, after.sent_non - before.sent_non);
+    TEST_ASSERT_GREATER_THAN_INT(0, non_dropped);
+    TEST_ASSERT_EQUAL_INT((int)(after.sent_non - before.sent_non) - non_dropped, non_received);
+}
+
+int main(void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(SERVER_PORT),
+    };
+    uint8_t mac[6];
+    char hex[13];
+    pthread_t t;
+
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    s_server = socket(AF_INET, SOCK_DGRAM, 0);
+    if (bind(s_server, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("server");
+        return 1;
+    }
+    pthread_create(&t, NULL, server_loop, NULL);
+
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    for (int i = 0; i < 6; i++) {
+        snprintf(&hex[2 * i], 3, "%02x", mac[i]);
+    }
+    snprintf(s_path_telemetry, sizeof(s_path_telemetry), "capstone/%s/telemetry", hex);
+    snprintf(s_path_alarm, sizeof(s_path_alarm), "capstone/%s/alarm", hex);
+
+    nvs_flash_init();
+    esp_netif_init();
+    esp_event_loop_create_default();
+    network_connect();
+    usleep(TICK_MS * 1000);     //The client task opens its socket in the background
+
+    UNITY_BEGIN();
+    RUN_TEST(test_alarm_con_telemetry_non);
+    RUN_TEST(test_mid_matching);
+    RUN_TEST(test_con_retransmitted_with_backoff);
+    RUN_TEST(test_lossy_link);
+    return UNITY_END();
+}
@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unity.h>
+#include "esp_timer.h"
+#include "config-stream.h"
+
+/*
+ * config-stream.c against a loopback stand-in for the collector's /config endpoint. The stand-in
+ * either accepts the GET with a chunked 200 and leaves the response open for the test to write into,
+ * or turns it away with a 404 whose body looks like config. Writes are paced so that each piece
+ * arrives as its own read, which is how a chunk boundary ends up in the middle of a line.
+ */
+
+//Defines
+#define STREAM_HOST "127.0.0.1"
+#define STREAM_PORT "18081"
+#define STREAM_PATH "/config?device=0123456789ab"
+#define IDLE_S 5
+#define BACKOFF_MIN_MS 1000     //STREAM_BACKOFF_MIN_MS
+#define PACE_MS 20              //Between writes that must arrive as separate reads
+#define WAIT_MS 3000
+#define LINES_MAX 32
+#define REQUEST_MAX 512
+
+//Private Variables
+static int s_listen = -1;
+static _Atomic int s_stream = -1;               //The stand-in's end of the open stream
+static _Atomic bool s_refuse;                   //Answer 404 instead of opening a stream
+static _Atomic uint32_t s_requests;
+static int64_t s_request_us[LINES_MAX];         //Arrival of every GET
+static char s_request[REQUEST_MAX];             //The last GET, headers included
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static char s_lines[LINES_MAX][CONFIG_STREAM_LINE_MAX + 1];
+static int s_line_count;
+
+//Private Function Declarations
+static void *server_accept(void *arg);
+static void on_line(const char *line, size_t len);
+static void push(const char *data);
+static void push_chunk(const char *data);
+static int lines(void);
+static void wait_lines(int count);
+static config_stream_stats stats(void);
+static int wait_stream(void);
+
+//****************************************************************************
+//Server
+//****************************************************************************
+
+/**
+ * @brief Reads each GET and answers it. An accepted stream stays open until the test closes it or
+ *  the next GET replaces it
+ */
+static void *server_accept(void *arg)
+{
+    while (1) {
+        int c = accept(s_listen, NULL, NULL);
+        if (c < 0) {
+            continue;
+        }
+        char buf[REQUEST_MAX];
+        size_t used = 0;
+        while (used + 1 < sizeof(buf)) {
+            ssize_t r = read(c, buf + used, sizeof(buf) - 1 - used);
+            if (r <= 0) {
+                break;
+            }
+            used += (size_t)r;
+            buf[used] = '\0';
+            if (strstr(buf, "\r\n\r\n") != NULL) {
+                break;
+            }
+        }
+        buf[used] = '\0';
+        pthread_mutex_lock(&s_lock);
+        uint32_t n = atomic_load(&s_requests);
+        if (n < LINES_MAX) {
+            s_request_us[n] = esp_timer_get_time();
+        }
+        memcpy(s_request, buf, used + 1);
+        pthread_mutex_unlock(&s_lock);
+
+        if (atomic_load(&s_refuse)) {
+            const char *reply = "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 8\r\n\r\n#9\nrate\n";
+            write(c, reply, strlen(reply));
+            close(c);
+        } else {
+            const char *reply = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nTransfer-Encoding: chunked\r\n\r\n";
+            write(c, reply, strlen(reply));
+            atomic_store(&s_stream, c);
+        }
+        atomic_fetch_add(&s_requests, 1);
+    }
+    return NULL;
+}
+
+//****************************************************************************
+//Helpers
+//****************************************************************************
+
+static void on_line(const char *line, size_t len)
+{
+    pthread_mutex_lock(&s_lock);
+    if (s_line_count < LINES_MAX) {
+        memcpy(s_lines[s_line_count], line, len);
+        s_lines[s_line_count][len] = '\0';
+        s_line_count++;
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+/**
+ * @brief Raw bytes on the open stream, followed by a pause so the next write is a separate read
+ */
+static void push(const char *data)
+{
+    int c = atomic_load(&s_stream);
+    TEST_ASSERT_TRUE(c >= 0);
+    TEST_ASSERT_EQUAL_INT((int)strlen(data), (int)write(c, data, strlen(data)));
+    usleep(PACE_MS * 1000);
+}
+
+/**
+ * @brief data as one chunk, written in a single piece
+ */
+static void push_chunk(const char *data)
+{
+    char chunk[256];
+    snprintf(chunk, sizeof(chunk), "%zx\r\n%s\r\n", strlen(data), data);
+    push(chunk);
+}
+
+static int lines(void)
+{
+    pthread_mutex_lock(&s_lock);
+    int count = s_line_count;
+    pthread_mutex_unlock(&s_lock);
+    return count;
+}
+
+static void wait_lines(int count)
+{
+    for (int i = 0; i < WAIT_MS && lines() < count; i++) {
+        usleep(1000);
+    }
+    TEST_ASSERT_EQUAL_INT(count, lines());
+}
+
+static config_stream_stats stats(void)
+{
+    config_stream_stats s;
+    config_stream_get_stats(&s);
+    return s;
+}
+
+/**
+ * @brief Waits for an open stream the client has seen accepted, returns the stand-in's end
+ */
+static int wait_stream(void)
+{
+    for (int i = 0; i < WAIT_MS && (atomic_load(&s_stream) < 0 || stats().connects < atomic_load(&s_requests)); i++) {
+        usleep(1000);
+    }
+    TEST_ASSERT_TRUE(atomic_load(&s_stream) >= 0);
+    return atomic_load(&s_stream);
+}
+
+void setUp(void)
+{
+    wait_stream();
+    pthread_mutex_lock(&s_lock);
+    s_line_count = 0;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void tearDown(void)
+{
+}
+
+//****************************************************************************
+//Tests
+//****************************************************************************
+
+/**
+ * @brief The stream is a GET for the configured path that asks for plain text. A line reaches
+ *  on_line once its newline arrives however the reads cut the chunk: in the chunk size, in the
+ *  chunk's CRLF, in the line and between its carriage return and newline
+ */
+static void test_chunk_split_across_reads(void)
+{
+    pthread_mutex_lock(&s_lock);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(s_request, "GET " STREAM_PATH " HTTP/1.1\r\n", strlen("GET " STREAM_PATH " HTTP/1.1\r\n")));
+    TEST_ASSERT_NOT_NULL(strstr(s_request, "\r\nHost: " STREAM_HOST ":" STREAM_PORT "\r\n"));
+    TEST_ASSERT_NOT_NULL(strstr(s_request, "\r\nAccept: text/plain\r\n"));
+    pthread_mutex_unlock(&s_lock);
+
+    push("1");
+    push("4\r");
+    push("\nrate 2 100");
+    push(" 5000 4\r");
+    TEST_ASSERT_EQUAL_INT(0, lines());
+    push("\n\r");
+    push("\n");
+    wait_lines(1);
+    TEST_ASSERT_EQUAL_STRING("rate 2 100 5000 4", s_lines[0]);
+
+    push_chunk("dead");                 //A line carried by two chunks
+    push_chunk("band 2 1 0 0\n");
+    wait_lines(2);
+    TEST_ASSERT_EQUAL_STRING("deadband 2 1 0 0", s_lines[1]);
+}
+
+/**
+ * @brief Several directives in one chunk are delivered one by one in order. Empty lines are the
+ *  heartbeat and deliver nothing, and a line longer than CONFIG_STREAM_LINE_MAX is dropped whole
+ *  without taking its neighbours with it
+ */
+static void test_several_directives_in_one_chunk(void)
+{
+    char chunk[CONFIG_STREAM_LINE_MAX + 64];
+    uint32_t delivered = stats().lines;
+
+    push_chunk("#3\nstats\n\n\r\nrate 1 50 1000 2\n");
+    wait_lines(3);
+    TEST_ASSERT_EQUAL_STRING("#3", s_lines[0]);
+    TEST_ASSERT_EQUAL_STRING("stats", s_lines[1]);
+    TEST_ASSERT_EQUAL_STRING("rate 1 50 1000 2", s_lines[2]);
+
+    memset(chunk, 'x', CONFIG_STREAM_LINE_MAX + 1);
+    strcpy(&chunk[CONFIG_STREAM_LINE_MAX + 1], "\n#4\n");
+    push_chunk(chunk);
+    wait_lines(4);
+    TEST_ASSERT_EQUAL_STRING("#4", s_lines[3]);
+    TEST_ASSERT_EQUAL_UINT32(delivered + 4, stats().lines);
+}
+
+/**
+ * @brief When the collector ends the stream the client counts a failure and opens a new one after the
+ *  shortest backoff, as the stream it lost had been accepted. Lines pushed on the new stream arrive
+ */
+static void test_reconnect_after_server_close(void)
+{
+    config_stream_stats before = stats();
+    uint32_t requests = atomic_load(&s_requests);
+
+    push("0\r\n\r\n");
+    close(atomic_exchange(&s_stream, -1));
+    for (int i = 0; i < BACKOFF_MIN_MS + WAIT_MS && atomic_load(&s_requests) == requests; i++) {
+        usleep(1000);
+    }
+    TEST_ASSERT_EQUAL_UINT32(requests + 1, atomic_load(&s_requests));
+    int64_t gap_us = s_request_us[requests] - s_request_us[requests - 1];
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(BACKOFF_MIN_MS, (int)(gap_us / 1000));
+
+    wait_stream();
+    TEST_ASSERT_EQUAL_UINT32(before.failures + 1, stats().failures);
+    TEST_ASSERT_EQUAL_UINT32(before.connects + 1, stats().connects);
+    push_chunk("#5\n");
+    wait_lines(1);
+    TEST_ASSERT_EQUAL_STRING("#5", s_lines[0]);
+}
+
+/**
+ * @brief A 404 is not a stream: its body is never parsed for config, it counts as a failure and not
+ *  a connect, and the retries back off, doubling from the shortest delay
+ */
+static void test_not_found_backs_off(void)
+{
+    config_stream_stats before = stats();
+    uint32_t requests = atomic_load(&s_requests);
+
+    atomic_store(&s_refuse, true);
+    close(atomic_exchange(&s_stream, -1));
+    for (int i = 0; i < 4 * BACKOFF_MIN_MS && atomic_load(&s_requests) < requests + 2; i++) {
+        usleep(1000);
+    }
+    TEST_ASSERT_EQUAL_UINT32(requests + 2, atomic_load(&s_requests));
+    int first_ms = (int)((s_request_us[requests] - s_request_us[requests - 1]) / 1000);
+    int second_ms = (int)((s_request_us[requests + 1] - s_request_us[requests]) / 1000);
+    TEST_ASSERT_INT_WITHIN(BACKOFF_MIN_MS / 4, BACKOFF_MIN_MS, first_ms);
+    TEST_ASSERT_INT_WITHIN(BACKOFF_MIN_MS / 4, 2 * BACKOFF_MIN_MS, second_ms);
+
+    usleep(PACE_MS * 1000);
+    TEST_ASSERT_EQUAL_INT(0, lines());
+    TEST_ASSERT_EQUAL_UINT32(before.connects, stats().connects);
+    TEST_ASSERT_EQUAL_UINT32(before.failures + 3, stats().failures);   //The closed stream, then both refusals
+    TEST_ASSERT_EQUAL_UINT32(before.lines, stats().lines);
+}
+
+int main(void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(atoi(STREAM_PORT)),
+    };
+    const config_stream_config config = {
+        .host = STREAM_HOST,
+        .port = STREAM_PORT,
+        .path = STREAM_PATH,
+        .idle_timeout_s = IDLE_S,
+        .on_line = on_line,
+    };
+    int on = 1;
+    pthread_t t;
+
+    signal(SIGPIPE, SIG_IGN);
+    inet_pton(AF_INET, STREAM_HOST, &addr.sin_addr);
+    s_listen = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(s_listen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(s_listen, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(s_listen, 8) != 0) {
+        perror("config server");
+        return 1;
+    }
+    pthread_create(&t, NULL, server_accept, NULL);
+    if (config_stream_start(&config) != ESP_OK) {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_chunk_split_across_reads);
+    RUN_TEST(test_several_directives_in_one_chunk);
+    RUN_TEST(test_reconnect_after_server_close);
+    RUN_TEST(test_not_found_backs_off);
+    return UNITY_END();
+}
@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unity.h>
+#include "nvs_flash.h"
+#include "esp_netif.h"
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "network.h"
+#include "pipeline-stats.h"
+
+/*
+ * http_transmit() against a loopback collector on WEB_SERVER:WEB_PORT. The collector either keeps
+ * the connection, closes it after every response without saying so (the keep-alive socket the
+ * transmitter holds is then dead, and the next request must be retried exactly once on a fresh
+ * one), or announces the close with "Connection: close". Every request carries one sample whose
+ * value is its sequence number, so a lost or doubled request shows up in the received sequence.
+ */
+
+//Defines
+#define REQUESTS 50
+#define BENCH_REQUESTS 200
+#define REQUEST_MAX 4096
+
+typedef enum {
+    COLLECTOR_KEEP,         //Keeps every connection open
+    COLLECTOR_DROP,         //Closes after each response, the client finds out on its next write
+    COLLECTOR_ANNOUNCE,     //Closes after each response it marked "Connection: close"
+} collector_mode;
+
+//Private Variables
+static int s_listen = -1;
+static _Atomic int s_mode;
+static _Atomic uint32_t s_post_connections;     //Connections that carried a POST
+static _Atomic uint32_t s_closed;               //Connections the collector closed after a response
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static int s_received[BENCH_REQUESTS * 2];      //Sample value of every POST, in arrival order
+static int s_received_count;
+
+//Private Function Declarations
+static void *collector_accept(void *arg);
+static void *collector_conn(void *arg);
+static int read_request(int c, char *buf, size_t size, size_t *used);
+static esp_err_t send_value(int value);
+static uint32_t writes(void);
+static void wait_closed(uint32_t count);
+static void check_sequence(int count);
+static int64_t run_requests(collector_mode mode, int count);
+
+//****************************************************************************
+//Collector
+//****************************************************************************
+
+static void *collector_accept(void *arg)
+{
+    while (1) {
+        int c = accept(s_listen, NULL, NULL);
+        if (c < 0) {
+            continue;
+        }
+        pthread_t t;
+        pthread_create(&t, NULL, collector_conn, (void *)(intptr_t)c);
+        pthread_detach(t);
+    }
+    return NULL;
+}
+
+/**
+ * @brief One connection: the config stream's GET is turned away, POSTs are logged and answered
+ *  with "#1" as the real collector does
+ */
+static void *collector_conn(void *arg)
+{
+    int c = (int)(intptr_t)arg;
+    char buf[REQUEST_MAX], request[REQUEST_MAX];
+    size_t used = 0;
+    bool counted = false;
+
+    while (1) {
+        int n = read_request(c, buf, sizeof(buf), &used);
+        if (n <= 0) {
+            break;
+        }
+        memcpy(request, buf, n);
+        request[n] = '\0';
+        memmove(buf, buf + n, used - n);
+        used -= n;
+        if (strncmp(request, "POST / ", 7) != 0) {
+            const char *reply = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            write(c, reply, strlen(reply));
+            break;
+        }
+        if (!counted) {
+            atomic_fetch_add(&s_post_connections, 1);
+            counted = true;
+        }
+        char *m = strstr(request, "&measurement=");
+        pthread_mutex_lock(&s_lock);
+        if (m != NULL && s_received_count < (int)(sizeof(s_received) / sizeof(s_received[0]))) {
+            s_received[s_received_count++] = atoi(m + 13);
+        }
+        pthread_mutex_unlock(&s_lock);
+
+        int mode = atomic_load(&s_mode);
+        const char *reply = (mode == COLLECTOR_ANNOUNCE) ?
+            "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\n#1" :
+            "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\n#1";
+        write(c, reply, strlen(reply));
+        if (mode != COLLECTOR_KEEP) {
+            close(c);
+            atomic_fetch_add(&s_closed, 1);
+            return NULL;
+        }
+    }
+    close(c);
+    return NULL;
+}
+
+/**
+ * @brief Reads until buf starts with one complete request. Returns its length, 0 on EOF or -1
+ */
+static int read_request(int c, char *buf, size_t size, size_t *used)
+{
+    while (1) {
+        buf[*used] = '\0';
+        char *end = strstr(buf, "\r\n\r\n");
+        if (end != NULL) {
+            char *cl = strstr(buf, "Content-Length: ");
+            size_t len = (cl != NULL && cl < end) ? strtoul(cl + 16, NULL, 10) : 0;
+            size_t total = (size_t)(end + 4 - buf) + len;
+            if (total >= size) {
+                return -1;
+            }
+            if (*used >= total) {
+                return (int)total;
+            }
+        }
+        if (*used + 1 >= size) {
+            return -1;
+        }
+        ssize_t r = read(c, buf + *used, size - 1 - *used);
+        if (r <= 0) {
+            return r == 0 ? 0 : -1;
+        }
+        *used += (size_t)r;
+    }
+}
+
+//****************************************************************************
+//Helpers
+//****************************************************************************
+
+static esp_err_t send_value(int value)
+{
+    sensor_struct sample = {
+        .id = 1,
+        .value = value * SENSOR_VALUE_ONE,
+        .timestamp = esp_timer_get_time(),
+    };
+    return http_transmit(&sample, 1);
+}
+
+static uint32_t writes(void)
+{
+    latency_hist_snapshot snap;
+    pipeline_stats_get(PIPELINE_WRITE, &snap);
+    return snap.count;
+}
+
+static void wait_closed(uint32_t count)
+{
+    for (int i = 0; i < 1000 && atomic_load(&s_closed) < count; i++) {
+        usleep(1000);
+    }
+}
+
+static void check_sequence(int count)
+{
+    pthread_mutex_lock(&s_lock);
+    int received = s_received_count;
+    pthread_mutex_unlock(&s_lock);
+    TEST_ASSERT_EQUAL_INT(count, received);
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_INT(i, s_received[i]);
+    }
+}
+
+static int64_t run_requests(collector_mode mode, int count)
+{
+    atomic_store(&s_mode, mode);
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_INT(ESP_OK, send_value(i));
+        if (mode != COLLECTOR_KEEP) {
+            wait_closed((uint32_t)i + 1);
+        }
+    }
+    return esp_timer_get_time() - start;
+}
+
+/**
+ * @brief Every test starts without a socket: an announced close makes the transmitter drop
+ *  whatever connection the previous test left it, dead or alive
+ */
+void setUp(void)
+{
+    atomic_store(&s_mode, COLLECTOR_ANNOUNCE);
+    atomic_store(&s_closed, 0);
+    send_value(-1);
+    wait_closed(1);
+    atomic_store(&s_post_connections, 0);
+    atomic_store(&s_closed, 0);
+    pthread_mutex_lock(&s_lock);
+    s_received_count = 0;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void tearDown(void)
+{
+}
+
+//****************************************************************************
+//Tests
+//****************************************************************************
+
+/**
+ * @brief A collector that keeps the connection sees every request on one socket, written once each
+ */
+static void test_keepalive_reuses_one_connection(void)
+{
+    uint32_t before = writes();
+
+    run_requests(COLLECTOR_KEEP, REQUESTS);
+    TEST_ASSERT_EQUAL_UINT32(1, atomic_load(&s_post_connections));
+    TEST_ASSERT_EQUAL_UINT32(REQUESTS, writes() - before);
+    check_sequence(REQUESTS);
+}
+
+/**
+ * @brief A silently dropped connection costs exactly one retry per request: the first request
+ *  connects fresh and is written once, every later one is written to the dead socket and then once
+ *  more on a new connection. Nothing is lost or delivered twice
+ */
+static void test_dropped_connection_retried_once(void)
+{
+    uint32_t before = writes();
+
+    run_requests(COLLECTOR_DROP, REQUESTS);
+    TEST_ASSERT_EQUAL_UINT32(REQUESTS, atomic_load(&s_post_connections));
+    TEST_ASSERT_EQUAL_UINT32(1 + 2 * (REQUESTS - 1), writes() - before);
+    check_sequence(REQUESTS);
+}
+
+/**
+ * @brief "Connection: close" makes the transmitter drop the socket itself, so no request is ever
+ *  written to a dead one
+ */
+static void test_announced_close_needs_no_retry(void)
+{
+    uint32_t before = writes();
+
+    run_requests(COLLECTOR_ANNOUNCE, REQUESTS);
+    TEST_ASSERT_EQUAL_UINT32(REQUESTS, atomic_load(&s_post_connections));
+    TEST_ASSERT_EQUAL_UINT32(REQUESTS, writes() - before);
+    check_sequence(REQUESTS);
+}
+
+/**
+ * @brief Round trip per request over one keep-alive connection against a connect per request
+ */
+static void test_bench_keepalive_vs_reconnect(void)
+{
+    char msg[128];
+
+    int64_t keep_us = run_requests(COLLECTOR_KEEP, BENCH_REQUESTS);
+    check_sequence(BENCH_REQUESTS);
+    setUp();
+    int64_t fresh_us = run_requests(COLLECTOR_ANNOUNCE, BENCH_REQUESTS);
+    check_sequence(BENCH_REQUESTS);
+
+    snprintf(msg, sizeof(msg), "keep-alive %lld us/request, reconnect %lld us/request",
+             (long long)(keep_us / BENCH_REQUESTS), (long long)(fresh_us / BENCH_REQUESTS));
+    TEST_MESSAGE(msg);
+}
+
+int main(void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(atoi(WEB_PORT)),
+    };
+    int on = 1;
+    pthread_t t;
+
+    signal(SIGPIPE, SIG_IGN);
+    inet_pton(AF_INET, WEB_SERVER, &addr.sin_addr);
+    s_listen = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(s_listen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(s_listen, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(s_listen, 8) != 0) {
+        perror("collector");
+        return 1;
+    }
+    pthread_create(&t, NULL, collector_accept, NULL);
+
+    nvs_flash_init();
+    esp_netif_init();
+    esp_event_loop_create_default();
+    network_connect();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_keepalive_reuses_one_connection);
+    RUN_TEST(test_dropped_connection_retried_once);
+    RUN_TEST(test_announced_close_needs_no_retry);
+    RUN_TEST(test_bench_keepalive_vs_reconnect);
+    return UNITY_END();
+}
@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unity.h>
+#include "http-response.h"
+
+/*
+ * The incremental response parser fed canned responses split at every byte boundary and one byte at
+ * a time: wherever a read happens to end, the status, the body bytes handed to on_body (framing
+ * removed), the profile directive and the done/error state must come out the same. Mutated and
+ * random input must never be read past its end and must not depend on the split either.
+ */
+
+//Defines
+#define BODY_MAX 512
+#define FUZZ_ROUNDS 3000
+#define FUZZ_LEN_MAX 160
+
+typedef enum {
+    END_DONE,           //Complete without EOF
+    END_EOF,            //Complete only once the server closes
+    END_ERROR,          //Rejected, by feed or at EOF
+} expected_end;
+
+typedef struct {
+    const char *name;
+    const char *raw;
+    expected_end end;
+    int status;
+    bool keep_alive;
+    const char *body;
+    int profile;
+    size_t trailing;    //Bytes after the response that feed must leave unconsumed
+} response_case;
+
+typedef struct {
+    http_resp_state state;
+    int status;
+    bool keep_alive;
+    int profile;
+    size_t consumed;
+    char body[BODY_MAX];
+    size_t body_len;
+} parse_result;
+
+//Private Variables
+static parse_result *s_current;     //on_body has no context pointer
+static const response_case s_cases[] = {
+    { "content-length", "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\n#1",
+      END_DONE, 200, true, "#1", 1, 0 },
+    { "content-length pipelined", "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 5\r\n\r\nok #2HTTP/1.1 200",
+      END_DONE, 200, true, "ok #2", 2, 12 },
+    { "content-length zero", "HTTP/1.1 200 OK\r\ncontent-length:0\r\n\r\n",
+      END_DONE, 200, true, "", -1, 0 },
+    { "chunked with extensions and trailers",
+      "HTTP/1.1 200 OK\r\nTransfer-Encoding: gzip, chunked\r\n\r\n4;ext=1\r\nab#1\r\n3\r\n2cd\r\nA \r\n0123456789\r\n0\r\nX-Checksum: 1\r\nX-More: 2\r\n\r\n",
+      END_DONE, 200, true, "ab#12cd0123456789", 12, 0 },
+    { "chunked before content-length", "HTTP/1.1 200 OK\r\nContent-Length: 99\r\nTransfer-Encoding: chunked\r\n\r\n2\r\n#4\r\n0\r\n\r\n",
+      END_DONE, 200, true, "#4", 4, 0 },
+    { "interim 100 and 103", "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 103 Early Hints\r\nLink: </a>\r\n\r\nHTTP/1.1 201 Created\r\nContent-Length: 3\r\n\r\n#5x",
+      END_DONE, 201, true, "#5x", 5, 0 },
+    { "204 ignores content-length", "HTTP/1.1 204 No Content\r\nContent-Length: 10\r\n\r\nHTTP",
+      END_DONE, 204, true, "", -1, 4 },
+    { "304", "HTTP/1.1 304 Not Modified\r\nTransfer-Encoding: chunked\r\n\r\n",
+      END_DONE, 304, true, "", -1, 0 },
+    { "eof delimited 1.0", "HTTP/1.0 200 OK\r\nServer: x\r\n\r\nhello #7 world",
+      END_EOF, 200, false, "hello #7 world", 7, 0 },
+    { "eof delimited 1.1 drops keep-alive", "HTTP/1.1 200 OK\r\n\r\n##12",
+      END_EOF, 200, false, "##12", 12, 0 },
+    { "connection close", "HTTP/1.1 500 Oops\r\nConnection: Close\r\nContent-Length: 1\r\n\r\nx",
+      END_DONE, 500, false, "x", -1, 0 },
+    { "1.0 keep-alive", "HTTP/1.0 200 OK\r\nConnection: keep-alive\r\nContent-Length: 2\r\n\r\n#0",
+      END_DONE, 200, true, "#0", 0, 0 },
+    { "bare LF line ends", "HTTP/1.1 200 OK\nContent-Length: 2\n\n#9",
+      END_DONE, 200, true, "#9", 9, 0 },
+    { "long header truncated", "HTTP/1.1 200 OK\r\nX-Long: aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\r\nContent-Length: 2\r\n\r\n#8",
+      END_DONE, 200, true, "#8", 8, 0 },
+    { "truncated headers", "HTTP/1.1 200 OK\r\nContent-Len",
+      END_ERROR, 200, true, "", -1, 0 },
+    { "truncated content-length body", "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n#1234",
+      END_ERROR, 200, true, "#1234", 1234, 0 },
+    { "truncated chunk", "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n8\r\nabc",
+      END_ERROR, 200, true, "abc", -1, 0 },
+    { "truncated trailers", "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n1\r\na\r\n0\r\nX-T: 1\r\n",
+      END_ERROR, 200, true, "a", -1, 0 },
+    { "empty", "",
+      END_ERROR, 0, false, "", -1, 0 },
+    { "garbage status", "GARBAGE\r\n\r\n",
+      END_ERROR, 0, false, "", -1, 0 },
+    { "non-digit status", "HTTP/1.1 2x0 OK\r\n\r\n",
+      END_ERROR, 0, false, "", -1, 0 },
+    { "bad content-length", "HTTP/1.1 200 OK\r\nContent-Length: 1x\r\n\r\n",
+      END_ERROR, 200, true, "", -1, 0 },
+    { "huge content-length", "HTTP/1.1 200 OK\r\nContent-Length: 99999999999999999999\r\n\r\n",
+      END_ERROR, 200, true, "", -1, 0 },
+    { "bad chunk size", "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n",
+      END_ERROR, 200, true, "", -1, 0 },
+    { "huge chunk size", "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nffffffffffffffff\r\n",
+      END_ERROR, 200, true, "", -1, 0 },
+    { "chunk data overrun", "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n2\r\n#3X\r\n0\r\n\r\n",
+      END_ERROR, 200, true, "#3", 3, 0 },
+};
+
+//Private Function Declarations
+static void on_body(const char *data, size_t len);
+static void parse(const char *raw, size_t len, const size_t *cuts, int ncuts, bool eof, parse_result *result);
+static void check_case(const response_case *c, const parse_result *result);
+static void check_same(const parse_result *expected, const parse_result *actual, const char *what);
+static uint32_t fuzz_next(uint32_t *state);
+
+//****************************************************************************
+//Helpers
+//****************************************************************************
+
+static void on_body(const char *data, size_t len)
+{
+    TEST_ASSERT_LESS_OR_EQUAL(BODY_MAX, s_current->body_len + len);
+    memcpy(s_current->body + s_current->body_len, data, len);
+    s_current->body_len += len;
+}
+
+/**
+ * @brief Feeds raw in pieces ending at each of cuts (then the rest) as a socket read loop would:
+ *  a piece is only offered while the parser wants more, and EOF is signalled if eof is set and the
+ *  response isn't complete by the end of the input
+ */
+static void parse(const char *raw, size_t len, const size_t *cuts, int ncuts, bool eof, parse_result *result)
+{
+    http_response resp;
+    size_t pos = 0;
+
+    memset(result, 0, sizeof(*result));
+    s_current = result;
+    http_response_init(&resp);
+    resp.on_body = on_body;
+    for (int k = 0; k <= ncuts && !http_response_done(&resp) && resp.state != HTTP_RESP_ERROR; k++) {
+        size_t stop = (k < ncuts) ? cuts[k] : len;
+        if (stop <= pos) {
+            continue;
+        }
+        int used = http_response_feed(&resp, raw + pos, stop - pos);
+        if (used < 0) {
+            break;
+        }
+        TEST_ASSERT_LESS_OR_EQUAL(stop - pos, (size_t)used);
+        pos += (size_t)used;
+        if (pos < stop) {
+            TEST_ASSERT_TRUE(http_response_done(&resp)); //Only a complete response leaves bytes behind
+            break;
+        }
+    }
+    if (eof && !http_response_done(&resp) && resp.state != HTTP_RESP_ERROR) {
+        http_response_finish(&resp);
+    }
+    result->state = resp.state;
+    result->status = resp.status;
+    result->keep_alive = resp.keep_alive;
+    result->profile = resp.profile;
+    result->consumed = pos;
+}
+
+static void check_case(const response_case *c, const parse_result *result)
+{
+    size_t len = strlen(c->raw);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c->end == END_ERROR ? HTTP_RESP_ERROR : HTTP_RESP_DONE, result->state, c->name);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c->status, result->status, c->name);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(strlen(c->body), result->body_len, c->name);
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(c->body, result->body, result->body_len, c->name);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c->profile, result->profile, c->name);
+    if (c->end != END_ERROR) {
+        TEST_ASSERT_EQUAL_INT_MESSAGE(c->keep_alive, result->keep_alive, c->name);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(len - c->trailing, result->consumed, c->name);
+    }
+}
+
+static void check_same(const parse_result *expected, const parse_result *actual, const char *what)
+{
+    TEST_ASSERT_EQUAL_INT_MESSAGE(expected->state, actual->state, what);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(expected->status, actual->status, what);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(expected->profile, actual->profile, what);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(expected->body_len, actual->body_len, what);
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expected->body, actual->body, actual->body_len, what);
+    if (expected->state == HTTP_RESP_DONE) {
+        TEST_ASSERT_EQUAL_INT_MESSAGE(expected->keep_alive, actual->keep_alive, what);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(expected->consumed, actual->consumed, what);
+    }
+}
+
+/**
+ * @brief xorshift32, fixed seed so a failure reproduces
+ */
+static uint32_t fuzz_next(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+//****************************************************************************
+//Tests
+//****************************************************************************
+
+static void test_whole(void)
+{
+    parse_result result;
+
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+        const response_case *c = &s_cases[i];
+        parse(c->raw, strlen(c->raw), NULL, 0, true, &result);
+        check_case(c, &result);
+    }
+}
+
+/**
+ * @brief Every case split into two reads at every byte boundary
+ */
+static void test_split_at_every_byte(void)
+{
+    parse_result result;
+
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+        const response_case *c = &s_cases[i];
+        size_t len = strlen(c->raw);
+        for (size_t cut = 0; cut <= len; cut++) {
+            parse(c->raw, len, &cut, 1, true, &result);
+            check_case(c, &result);
+        }
+    }
+}
+
+/**
+ * @brief Every case split into three reads at every pair of boundaries, and one byte per read
+ */
+static void test_split_three_ways_and_bytewise(void)
+{
+    static size_t cuts[FUZZ_LEN_MAX * 2];
+    parse_result result;
+
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+        const response_case *c = &s_cases[i];
+        size_t len = strlen(c->raw);
+        for (size_t a = 1; a < len; a++) {
+            for (size_t b = a + 1; b < len; b++) {
+                size_t pair[2] = { a, b };
+                parse(c->raw, len, pair, 2, true, &result);
+                check_case(c, &result);
+            }
+        }
+        TEST_ASSERT_LESS_OR_EQUAL(sizeof(cuts) / sizeof(cuts[0]), len);
+        for (size_t k = 0; k < len; k++) {
+            cuts[k] = k + 1;
+        }
+        parse(c->raw, len, cuts, (int)len, true, &result);
+        check_case(c, &result);
+    }
+}
+
+/**
+ * @brief Without EOF an identity body of unknown length is still open, not complete or failed
+ */
+static void test_eof_body_waits_for_close(void)
+{
+    parse_result result;
+    const char *raw = "HTTP/1.0 200 OK\r\n\r\n#3";
+
+    parse(raw, strlen(raw), NULL, 0, false, &result);
+    TEST_ASSERT_EQUAL_INT(HTTP_RESP_BODY, result.state);
+    TEST_ASSERT_EQUAL_INT(2, result.body_len);
+    TEST_ASSERT_EQUAL_INT(3, result.profile);
+}
+
+/**
+ * @brief Mutated cases and random bytes: no crash or overrun (run under a sanitizer to be sure),
+ *  and the outcome of one read is the outcome of any split of it
+ */
+static void test_fuzz_split_invariant(void)
+{
+    static const char alphabet[] = "HTP/1.0 2\r\n:;#ctenhdkvCLlx-0123456789abcdefAF";
+    uint32_t seed = 0x2545F491;
+    char raw[FUZZ_LEN_MAX];
+    size_t cuts[3];
+    parse_result whole, split;
+
+    for (int round = 0; round < FUZZ_ROUNDS; round++) {
+        size_t len;
+        if (round % 2 == 0) {
+            //A valid case with a few bytes replaced, inserted or cut off
+            const response_case *c = &s_cases[fuzz_next(&seed) % (sizeof(s_cases) / sizeof(s_cases[0]))];
+            len = strlen(c->raw);
+            len = len < sizeof(raw) ? len : sizeof(raw);
+            memcpy(raw, c->raw, len);
+            for (int m = fuzz_next(&seed) % 4; m >= 0 && len > 0; m--) {
+                size_t at = fuzz_next(&seed) % len;
+                switch (fuzz_next(&seed) % 3) {
+                    case 0:
+                        raw[at] = alphabet[fuzz_next(&seed) % (sizeof(alphabet) - 1)];
+                        break;
+                    case 1:
+                        raw[at] = (char)fuzz_next(&seed);
+                        break;
+                    default:
+                        len = at;
+                        break;
+                }
+            }
+        } else {
+            len = fuzz_next(&seed) % sizeof(raw);
+            for (size_t k = 0; k < len; k++) {
+                raw[k] = (fuzz_next(&seed) % 4 == 0) ? (char)fuzz_next(&seed) : alphabet[fuzz_next(&seed) % (sizeof(alphabet) - 1)];
+            }
+        }
+
+        parse(raw, len, NULL, 0, true, &whole);
+        TEST_ASSERT_LESS_OR_EQUAL(len, whole.body_len);
+        for (int k = 0; k < 3; k++) {
+            cuts[k] = len > 0 ? fuzz_next(&seed) % (len + 1) : 0;
+        }
+        for (int x = 0; x < 2; x++) {   //Sorted
+            for (int y = 0; y < 2 - x; y++) {
+                if (cuts[y] > cuts[y + 1]) {
+                    size_t t = cuts[y];
+                    cuts[y] = cuts[y + 1];
+                    cuts[y + 1] = t;
+                }
+            }
+        }
+        parse(raw, len, cuts, 3, true, &split);
+        check_same(&whole, &split, "fuzz");
+    }
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_whole);
+    RUN_TEST(test_split_at_every_byte);
+    RUN_TEST(test_split_three_ways_and_bytewise);
+    RUN_TEST(test_eof_body_waits_for_close);
+    RUN_TEST(test_fuzz_split_invariant);
+    return UNITY_END();
+}
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <unity.h>
+#include "sim.h"
+#include "sensor-i2c.h"
+
+/*
+ * Bus recovery in sensor-i2c.c against the simulated bus. A device that hangs holds SDA low once it
+ * is addressed and only lets go after 9 SCL pulses, one that is stuck never lets go. The GPIO output
+ * hook traces every level the bus clear bit-bangs, so the pulses and the STOP are checked edge by
+ * edge; the health counters then show how recovery and quarantine share the work.
+ */
+
+//Defines
+#define SCL_IO 4                //As wired in sensor-i2c.c
+#define SDA_IO 0
+#define ADDR_A 0x20
+#define ADDR_B 0x21
+#define CH_A 0
+#define CH_B 1
+#define QUARANTINE_AFTER 3      //I2C_QUARANTINE_AFTER
+#define QUARANTINE_MIN_MS 1000  //I2C_QUARANTINE_MIN_MS
+#define TRACE_MAX 1024
+
+typedef struct {
+    int pin;
+    int level;
+} line_event;
+
+typedef struct {
+    int pulses;     //SCL rising edges with SDA released
+    int stops;      //SDA rising while SCL is high
+    int starts;     //SDA falling while SCL is high, a bus clear must never send one
+    int scl;        //Line levels after the last event
+    int sda;
+} clear_trace;
+
+//Private Variables
+static sim_i2c_device_t s_dev_a = { .addr = ADDR_A, .name = "a" };
+static sim_i2c_device_t s_dev_b = { .addr = ADDR_B, .name = "b" };
+static line_event s_trace[TRACE_MAX];
+static size_t s_trace_len;
+
+//Private Function Declarations
+static uint8_t dev_read(sim_i2c_device_t *dev, uint8_t reg, size_t index);
+static void trace_line(int gpio_num, int level);
+static clear_trace trace_since(size_t from);
+static sensor_i2c_health health(int channel);
+
+//****************************************************************************
+//Helpers
+//****************************************************************************
+
+static uint8_t dev_read(sim_i2c_device_t *dev, uint8_t reg, size_t index)
+{
+    return (uint8_t)(dev->addr + reg + index);
+}
+
+static void trace_line(int gpio_num, int level)
+{
+    if ((gpio_num == SCL_IO || gpio_num == SDA_IO) && s_trace_len < TRACE_MAX) {
+        s_trace[s_trace_len++] = (line_event){ gpio_num, level };
+    }
+}
+
+/**
+ * @brief Replays the traced line levels from index from on, both lines idle high before it
+ */
+static clear_trace trace_since(size_t from)
+{
+    clear_trace t = { .scl = 1, .sda = 1 };
+
+    for (size_t i = from; i < s_trace_len; i++) {
+        if (s_trace[i].pin == SCL_IO) {
+            if (t.scl == 0 && s_trace[i].level == 1 && t.sda == 1) {
+                t.pulses++;
+            }
+            t.scl = s_trace[i].level;
+        } else {
+            if (t.scl == 1 && t.sda == 0 && s_trace[i].level == 1) {
+                t.stops++;
+            } else if (t.scl == 1 && t.sda == 1 && s_trace[i].level == 0) {
+                t.starts++;
+            }
+            t.sda = s_trace[i].level;
+        }
+    }
+    return t;
+}
+
+static sensor_i2c_health health(int channel)
+{
+    sensor_i2c_health h;
+    sensor_i2c_get_health(channel, &h);
+    return h;
+}
+
+/**
+ * @brief Both devices answer and the channels start healthy. sensor_i2c_add() resets a channel's
+ *  health and backoff
+ */
+void setUp(void)
+{
+    sim_i2c_set_hang(ADDR_A, false);
+    sim_i2c_set_stuck(ADDR_A, false);
+    sim_i2c_set_hang(ADDR_B, false);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, sensor_i2c_add(CH_A, ADDR_A, 0x04, 2));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, sensor_i2c_add(CH_B, ADDR_B, 0x08, 2));
+    s_trace_len = 0;
+}
+
+void tearDown(void)
+{
+}
+
+//****************************************************************************
+//Tests
+//****************************************************************************
+
+/**
+ * @brief A device that hangs mid-read times the read out; the bus clear clocks exactly 9 pulses
+ *  with SDA released, ends on a STOP with both lines high, and the reinstalled driver reads the
+ *  same device on the next call
+ */
+static void test_hang_cleared_by_nine_pulses_and_stop(void)
+{
+    uint32_t recoveries = sensor_i2c_bus_recoveries();
+    uint32_t clears = sim_i2c_bus_clear_count();
+
+    sim_i2c_set_hang(ADDR_A, true);
+    TEST_ASSERT_EQUAL_HEX32(0, sensor_i2c_read_batch(SENSOR_I2C_MASK(CH_A)));
+    sim_i2c_set_hang(ADDR_A, false);
+
+    clear_trace t = trace_since(0);
+    TEST_ASSERT_EQUAL_UINT32(recoveries + 1, sensor_i2c_bus_recoveries());
+    TEST_ASSERT_EQUAL_INT(9, t.pulses);
+    TEST_ASSERT_EQUAL_INT(1, t.stops);
+    TEST_ASSERT_EQUAL_INT(0, t.starts);
+    TEST_ASSERT_EQUAL_INT(1, t.scl);
+    TEST_ASSERT_EQUAL_INT(1, t.sda);
+    TEST_ASSERT_EQUAL_UINT32(clears + 1, sim_i2c_bus_clear_count());    //The device let go
+    TEST_ASSERT_EQUAL_INT(1, health(CH_A).timeouts);
+
+    TEST_ASSERT_EQUAL_HEX32(SENSOR_I2C_MASK(CH_A), sensor_i2c_read_batch(SENSOR_I2C_MASK(CH_A)));
+    TEST_ASSERT_EQUAL_HEX8(ADDR_A + 0x04, sensor_i2c_raw(CH_A)[0]);
+    TEST_ASSERT_EQUAL_HEX8(ADDR_A + 0x04 + 1, sensor_i2c_raw(CH_A)[1]);
+    TEST_ASSERT_EQUAL_INT(0, health(CH_A).consecutive);
+}
+
+/**
+ * @brief A failed batch is recovered and then split: the hung device is cleared again on its own
+ *  read, the healthy one is still read in the same call. Once the hung one is quarantined the batch
+ *  only holds the healthy one and no more bus clears happen
+ */
+static void test_quarantine_stops_repeated_clears(void)
+{
+    uint32_t both = SENSOR_I2C_MASK(CH_A) | SENSOR_I2C_MASK(CH_B);
+    uint32_t recoveries = sensor_i2c_bus_recoveries();
+
+    sim_i2c_set_hang(ADDR_A, true);
+    for (int i = 1; i <= QUARANTINE_AFTER; i++) {
+        TEST_ASSERT_EQUAL_HEX32(SENSOR_I2C_MASK(CH_B), sensor_i2c_read_batch(both));
+        TEST_ASSERT_EQUAL_UINT32(recoveries + 2 * i, sensor_i2c_bus_recoveries());  //Batch, then A alone
+        TEST_ASSERT_EQUAL_INT(i, health(CH_A).timeouts);
+    }
+    TEST_ASSERT_TRUE(health(CH_A).quarantined);
+    TEST_ASSERT_EQUAL_INT(1, health(CH_A).quarantines);
+    TEST_ASSERT_EQUAL_INT(9 * 2 * QUARANTINE_AFTER, trace_since(0).pulses);
+
+    size_t mark = s_trace_len;
+    uint32_t transactions = sim_i2c_transaction_count();
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL_HEX32(SENSOR_I2C_MASK(CH_B), sensor_i2c_read_batch(both));
+    }
+    TEST_ASSERT_EQUAL_UINT32(recoveries + 2 * QUARANTINE_AFTER, sensor_i2c_bus_recoveries());
+    TEST_ASSERT_EQUAL_UINT32(transactions + 5, sim_i2c_transaction_count());   //B alone each time
+    TEST_ASSERT_EQUAL_size_t(mark, s_trace_len);
+    TEST_ASSERT_FALSE(health(CH_B).quarantined);
+    TEST_ASSERT_EQUAL_INT(0, health(CH_B).errors);
+}
+
+/**
+ * @brief SDA held low for good: every clear still sends its 9 pulses and STOP but can't free the
+ *  bus. After the quarantine the channel costs nothing until its backoff expires, a failed probe
+ *  doubles the backoff and clears once more, and the first good probe after the bus comes back
+ *  releases the channel
+ */
+static void test_stuck_bus_backoff_and_release(void)
+{
+    uint32_t clears = sim_i2c_bus_clear_count();
+    uint32_t recoveries = sensor_i2c_bus_recoveries();
+
+    sim_i2c_set_stuck(ADDR_A, true);
+    for (int i = 0; i < QUARANTINE_AFTER; i++) {
+        TEST_ASSERT_EQUAL_HEX32(0, sensor_i2c_read_batch(SENSOR_I2C_MASK(CH_A)));
+    }
+    clear_trace t = trace_since(0);
+    TEST_ASSERT_EQUAL_INT(9 * QUARANTINE_AFTER, t.pulses);
+    TEST_ASSERT_EQUAL_INT(QUARANTINE_AFTER, t.stops);
+    TEST_ASSERT_EQUAL_INT(0, t.starts);
+    TEST_ASSERT_EQUAL_UINT32(clears, sim_i2c_bus_clear_count());
+    TEST_ASSERT_EQUAL_UINT32(recoveries + QUARANTINE_AFTER, sensor_i2c_bus_recoveries());
+    TEST_ASSERT_TRUE(health(CH_A).quarantined);
+
+    uint32_t transactions = sim_i2c_transaction_count();
+    TEST_ASSERT_EQUAL_HEX32(0, sensor_i2c_read_batch(SENSOR_I2C_MASK(CH_A)));
+    TEST_ASSERT_EQUAL_UINT32(transactions, sim_i2c_transaction_count());
+
+    usleep((QUARANTINE_MIN_MS + 50) * 1000);
+    TEST_ASSERT_EQUAL_HEX32(0, sensor_i2c_read_batch(SENSOR_I2C_MASK(CH_A)));  //Probe, fails
+    TEST_ASSERT_EQUAL_UINT32(transactions + 1, sim_i2c_transaction_count());
+    TEST_ASSERT_EQUAL_UINT32(recoveries + QUARANTINE_AFTER + 1, sensor_i2c_bus_recoveries());
+    TEST_ASSERT_EQUAL_INT(1, health(CH_A).quarantines);
+
+    sim_i2c_set_stuck(ADDR_A, false);
+    usleep((QUARANTINE_MIN_MS + 50) * 1000);
+    TEST_ASSERT_EQUAL_HEX32(0, sensor_i2c_read_batch(SENSOR_I2C_MASK(CH_A)));  //Backoff now 2 s
+    TEST_ASSERT_EQUAL_UINT32(transactions + 1, sim_i2c_transaction_count());
+
+    usleep((QUARANTINE_MIN_MS + 50) * 1000);
+    TEST_ASSERT_EQUAL_HEX32(SENSOR_I2C_MASK(CH_A), sensor_i2c_read_batch(SENSOR_I2C_MASK(CH_A)));
+    TEST_ASSERT_FALSE(health(CH_A).quarantined);
+    TEST_ASSERT_EQUAL_INT(0, health(CH_A).consecutive);
+    TEST_ASSERT_EQUAL_HEX32(SENSOR_I2C_MASK(CH_A), sensor_i2c_read_batch(SENSOR_I2C_MASK(CH_A)));
+}
+
+int main(void)
+{
+    s_dev_a.read_byte = dev_read;
+    s_dev_b.read_byte = dev_read;
+    sim_i2c_attach(&s_dev_a);
+    sim_i2c_attach(&s_dev_b);
+    sim_gpio_set_output_hook(trace_line);
+    sensor_i2c_init();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_hang_cleared_by_nine_pulses_and_stop);
+    RUN_TEST(test_quarantine_stops_repeated_clears);
+    RUN_TEST(test_stuck_bus_backoff_and_release);
+    return UNITY_END();
+}
@@ -0,0 +1,659 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unity.h>
+#include "nvs_flash.h"
+#include "esp_netif.h"
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "network.h"
+#include "mqtt-client.h"
+
+/*
+ * The MQTT transport (pio test -e native_mqtt) against a loopback broker stand-in on
+ * 127.0.0.1:1883. The broker logs every packet the client sends, byte for byte, answers CONNECT and
+ * SUBSCRIBE, and either acknowledges QoS 1 publishes at once or holds them for the test to
+ * acknowledge. Dropping its end of the connection makes the client reconnect, which is where the
+ * in-flight table's redelivery shows. The HTTP collector on WEB_SERVER:WEB_PORT is only there to
+ * time http_transmit() against the same batches.
+ */
+
+#if NETWORK_TRANSPORT != 1
+#error "test_mqtt needs the MQTT transport, run it with: pio test -e native_mqtt"
+#endif
+
+//Defines
+#define BROKER_PORT 1883        //MQTT_PORT
+#define KEEPALIVE_S 60          //MQTT_KEEPALIVE_S
+#define LOG_MAX 64
+#define WAIT_MS 2000
+#define SETTLE_MS 20            //The client counts as connected before the broker has read its SUBSCRIBE
+#define BENCH_BATCHES 200
+#define REQUEST_MAX 4096
+
+typedef struct {
+    uint8_t type;               //First byte of the fixed header, flags included
+    size_t len;                 //Remaining length
+    uint8_t body[MQTT_PACKET_MAX];
+} logged_packet;
+
+//Private Variables
+static int s_broker = -1;
+static int s_collector = -1;
+static _Atomic int s_client = -1;               //The broker's end of the current connection
+static _Atomic bool s_hold_acks;                //QoS 1 publishes wait for broker_ack()
+static _Atomic uint32_t s_telemetry;            //QoS 0 publishes
+static _Atomic uint32_t s_posts;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static logged_packet s_log[LOG_MAX];
+static int s_log_count;
+static char s_client_id[32];
+static char s_topic_telemetry[MQTT_TOPIC_LEN];
+static char s_topic_alarm[MQTT_TOPIC_LEN];
+static char s_topic_config[MQTT_TOPIC_LEN];
+
+//Private Function Declarations
+static void *broker_accept(void *arg);
+static void *broker_conn(void *arg);
+static int read_packet(int c, uint8_t *type, uint8_t *body, size_t *len);
+static void broker_send(const uint8_t *buf, size_t len);
+static void broker_ack(uint16_t id);
+static void broker_drop(void);
+static void *collector_accept(void *arg);
+static void *collector_conn(void *arg);
+static int listen_on(int port);
+static void log_clear(void);
+static const logged_packet *wait_logged(int index);
+static mqtt_client_stats stats(void);
+static void wait_acked(uint32_t acked);
+static sensor_struct sample(int value, bool alarm);
+static uint16_t publish_id(uint8_t type, const uint8_t *body);
+static const char *publish_payload(const logged_packet *p, size_t *len);
+static void assert_topic(const char *topic, const logged_packet *p);
+
+//****************************************************************************
+//Broker
+//****************************************************************************
+
+static void *broker_accept(void *arg)
+{
+    while (1) {
+        int c = accept(s_broker, NULL, NULL);
+        if (c < 0) {
+            continue;
+        }
+        pthread_t t;
+        pthread_create(&t, NULL, broker_conn, (void *)(intptr_t)c);
+        pthread_detach(t);
+    }
+    return NULL;
+}
+
+/**
+ * @brief One session: every packet is logged, CONNECT and SUBSCRIBE are accepted, QoS 1 publishes
+ *  are acknowledged unless s_hold_acks is set. The log stops at LOG_MAX, QoS 0 telemetry is also
+ *  counted so the benchmark can tell when its last batch arrived
+ */
+static void *broker_conn(void *arg)
+{
+    int c = (int)(intptr_t)arg;
+    uint8_t body[MQTT_PACKET_MAX];
+    uint8_t type;
+    size_t len;
+
+    atomic_store(&s_client, c);
+    while (read_packet(c, &type, body, &len) == 0) {
+        if (type == 0x30) {
+            atomic_fetch_add(&s_telemetry, 1);
+        }
+        pthread_mutex_lock(&s_lock);
+        if (s_log_count < LOG_MAX) {
+            s_log[s_log_count].type = type;
+            s_log[s_log_count].len = len;
+            memcpy(s_log[s_log_count].body, body, len);
+            s_log_count++;
+        }
+        pthread_mutex_unlock(&s_lock);
+
+        switch (type & 0xF0) {
+            case 0x10: {
+                const uint8_t connack[4] = {0x20, 2, 0, 0};
+                write(c, connack, sizeof(connack));
+                break;
+            }
+            case 0x80: {
+                const uint8_t suback[5] = {0x90, 3, body[0], body[1], 1};
+                write(c, suback, sizeof(suback));
+                break;
+            }
+            case 0x30:
+                if ((type & 0x06) != 0 && !atomic_load(&s_hold_acks)) {
+                    broker_ack(publish_id(type, body));
+                }
+                break;
+            case 0xC0: {
+                const uint8_t pingresp[2] = {0xD0, 0};
+                write(c, pingresp, sizeof(pingresp));
+                break;
+            }
+        }
+    }
+    int expected = c;
+    atomic_compare_exchange_strong(&s_client, &expected, -1);
+    close(c);
+    return NULL;
+}
+
+/**
+ * @brief Reads one packet into body. Returns 0, or -1 once the connection is gone
+ */
+static int read_packet(int c, uint8_t *type, uint8_t *body, size_t *len)
+{
+    uint8_t byte;
+
+    if (read(c, type, 1) != 1) {
+        return -1;
+    }
+    *len = 0;
+    for (int shift = 0; ; shift += 7) {
+        if (shift > 21 || read(c, &byte, 1) != 1) {
+            return -1;
+        }
+        *len |= (size_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    if (*len > MQTT_PACKET_MAX) {
+        return -1;
+    }
+    for (size_t got = 0; got < *len; ) {
+        ssize_t r = read(c, body + got, *len - got);
+        if (r <= 0) {
+            return -1;
+        }
+        got += (size_t)r;
+    }
+    return 0;
+}
+
+static void broker_send(const uint8_t *buf, size_t len)
+{
+    int c = atomic_load(&s_client);
+    TEST_ASSERT_TRUE(c >= 0);
+    TEST_ASSERT_EQUAL_INT((int)len, (int)write(c, buf, len));
+}
+
+static void broker_ack(uint16_t id)
+{
+    const uint8_t puback[4] = {0x40, 2, (uint8_t)(id >> 8), (uint8_t)id};
+    int c = atomic_load(&s_client);
+    if (c >= 0) {
+        write(c, puback, sizeof(puback));
+    }
+}
+
+/**
+ * @brief Closes the broker's end without a DISCONNECT, as a broker restart or a lost link would
+ */
+static void broker_drop(void)
+{
+    int c = atomic_exchange(&s_client, -1);
+    TEST_ASSERT_TRUE(c >= 0);
+    shutdown(c, SHUT_RDWR);
+}
+
+//****************************************************************************
+//Collector
+//****************************************************************************
+
+static void *collector_accept(void *arg)
+{
+    while (1) {
+        int c = accept(s_collector, NULL, NULL);
+        if (c < 0) {
+            continue;
+        }
+        pthread_t t;
+        pthread_create(&t, NULL, collector_conn, (void *)(intptr_t)c);
+        pthread_detach(t);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Keep-alive collector: answers every complete request with "#1" on the same connection
+ */
+static void *collector_conn(void *arg)
+{
+    int c = (int)(intptr_t)arg;
+    char buf[REQUEST_MAX];
+    size_t used = 0;
+
+    while (1) {
+        buf[used] = '\0';
+        char *end = strstr(buf, "\r\n\r\n");
+        if (end != NULL) {
+            char *cl = strstr(buf, "Content-Length: ");
+            size_t total = (size_t)(end + 4 - buf) + ((cl != NULL && cl < end) ? strtoul(cl + 16, NULL, 10) : 0);
+            if (used >= total) {
+                const char *reply = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\n#1";
+                atomic_fetch_add(&s_posts, 1);
+                memmove(buf, buf + total, used - total);
+                used -= total;
+                write(c, reply, strlen(reply));
+                continue;
+            }
+        }
+        ssize_t r = (used + 1 < sizeof(buf)) ? read(c, buf + used, sizeof(buf) - 1 - used) : -1;
+        if (r <= 0) {
+            break;
+        }
+        used += (size_t)r;
+    }
+    close(c);
+    return NULL;
+}
+
+static int listen_on(int port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    int on = 1;
+
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(s, 8) != 0) {
+        perror("listen");
+        return -1;
+    }
+    return s;
+}
+
+//****************************************************************************
+//Helpers
+//****************************************************************************
+
+static void log_clear(void)
+{
+    pthread_mutex_lock(&s_lock);
+    s_log_count = 0;
+    pthread_mutex_unlock(&s_lock);
+}
+
+/**
+ * @brief Waits up to WAIT_MS for packet number index since the last log_clear()
+ */
+static const logged_packet *wait_logged(int index)
+{
+    for (int i = 0; i < WAIT_MS; i++) {
+        pthread_mutex_lock(&s_lock);
+        int count = s_log_count;
+        pthread_mutex_unlock(&s_lock);
+        if (count > index) {
+            return &s_log[index];
+        }
+        usleep(1000);
+    }
+    TEST_FAIL_MESSAGE("broker saw no such packet");
+    return NULL;
+}
+
+static mqtt_client_stats stats(void)
+{
+    mqtt_client_stats s;
+    mqtt_client_get_stats(&s);
+    return s;
+}
+
+static void wait_acked(uint32_t acked)
+{
+    for (int i = 0; i < WAIT_MS && stats().acked < acked; i++) {
+        usleep(1000);
+    }
+    TEST_ASSERT_EQUAL_UINT32(acked, stats().acked);
+}
+
+static sensor_struct sample(int value, bool alarm)
+{
+    return (sensor_struct){
+        .id = 2,
+        .value = value * SENSOR_VALUE_ONE,
+        .timestamp = esp_timer_get_time(),
+        .flags = alarm ? SENSOR_FLAG_ALARM : 0,
+    };
+}
+
+/**
+ * @brief The packet id after a PUBLISH's topic, 0 for QoS 0 which has none
+ */
+static uint16_t publish_id(uint8_t type, const uint8_t *body)
+{
+    size_t topic_len = (size_t)(body[0] << 8 | body[1]);
+    if ((type & 0x06) == 0) {
+        return 0;
+    }
+    return (uint16_t)(body[2 + topic_len] << 8 | body[3 + topic_len]);
+}
+
+static const char *publish_payload(const logged_packet *p, size_t *len)
+{
+    size_t n = 2 + (size_t)(p->body[0] << 8 | p->body[1]) + ((p->type & 0x06) ? 2 : 0);
+    *len = p->len - n;
+    return (const char *)p->body + n;
+}
+
+static void assert_topic(const char *topic, const logged_packet *p)
+{
+    size_t len = strlen(topic);
+    TEST_ASSERT_EQUAL_HEX8(len >> 8, p->body[0]);
+    TEST_ASSERT_EQUAL_HEX8(len & 0xFF, p->body[1]);
+    TEST_ASSERT_EQUAL_MEMORY(topic, p->body + 2, len);
+}
+
+/**
+ * @brief Every test starts connected with nothing in flight and the broker acknowledging
+ */
+void setUp(void)
+{
+    atomic_store(&s_hold_acks, false);
+    for (int i = 0; i < WAIT_MS && !mqtt_client_connected(); i++) {
+        usleep(1000);
+    }
+    TEST_ASSERT_TRUE(mqtt_client_connected());
+    usleep(SETTLE_MS * 1000);
+    log_clear();
+}
+
+void tearDown(void)
+{
+}
+
+//****************************************************************************
+//Tests
+//****************************************************************************
+
+/**
+ * @brief A reconnect sends CONNECT for protocol "MQTT" level 4 with clean session off, the
+ *  keep-alive and the device's client id, then SUBSCRIBE to its config topic at QoS 1
+ */
+static void test_connect_and_subscribe_encoding(void)
+{
+    uint8_t connect[64], subscribe[MQTT_TOPIC_LEN + 8];
+    size_t id_len = strlen(s_client_id), topic_len = strlen(s_topic_config);
+    uint32_t connects = stats().connects;
+
+    broker_drop();
+    const logged_packet *p = wait_logged(0);
+    memcpy(connect, (const uint8_t[]){ 0, 4, 'M', 'Q', 'T', 'T', 4, 0x00, 0, KEEPALIVE_S, 0, (uint8_t)id_len }, 12);
+    memcpy(connect + 12, s_client_id, id_len);
+    TEST_ASSERT_EQUAL_HEX8(0x10, p->type);
+    TEST_ASSERT_EQUAL_size_t(12 + id_len, p->len);
+    TEST_ASSERT_EQUAL_MEMORY(connect, p->body, p->len);
+
+    p = wait_logged(1);
+    memcpy(subscribe, (const uint8_t[]){ 0, 1, 0, (uint8_t)topic_len }, 4);
+    memcpy(subscribe + 4, s_topic_config, topic_len);
+    subscribe[4 + topic_len] = 1;
+    TEST_ASSERT_EQUAL_HEX8(0x82, p->type);
+    TEST_ASSERT_EQUAL_size_t(5 + topic_len, p->len);
+    TEST_ASSERT_EQUAL_MEMORY(subscribe, p->body, p->len);
+
+    setUp();
+    TEST_ASSERT_EQUAL_UINT32(connects + 1, stats().connects);
+}
+
+/**
+ * @brief A batch with an alarm in it goes out as the alarm alone at QoS 1 on the alarm topic, with a
+ *  packet id, followed by the rest at QoS 0 on the telemetry topic, without one
+ */
+static void test_publish_encoding(void)
+{
+    const sensor_struct samples[3] = { sample(1, false), sample(99, true), sample(3, false) };
+    mqtt_client_stats before = stats();
+    size_t len;
+
+    TEST_ASSERT_EQUAL_INT(ESP_OK, network_transmit(samples, 3));
+
+    const logged_packet *alarm = wait_logged(0);
+    TEST_ASSERT_EQUAL_HEX8(0x32, alarm->type);
+    assert_topic(s_topic_alarm, alarm);
+    TEST_ASSERT_NOT_EQUAL(0, publish_id(alarm->type, alarm->body));
+    const char *payload = publish_payload(alarm, &len);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(payload, "count=1&", 8));
+    TEST_ASSERT_NOT_NULL(memmem(payload, len, "&measurement=99.00&alarm=1", 26));
+
+    const logged_packet *telemetry = wait_logged(1);
+    TEST_ASSERT_EQUAL_HEX8(0x30, telemetry->type);
+    assert_topic(s_topic_telemetry, telemetry);
+    payload = publish_payload(telemetry, &len);
+    TEST_ASSERT_EQUAL_size_t(2 + strlen(s_topic_telemetry) + len, telemetry->len);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(payload, "count=2&", 8));
+    TEST_ASSERT_NULL(memmem(payload, len, "alarm", 5));
+
+    wait_acked(before.acked + 1);
+    TEST_ASSERT_EQUAL_UINT32(before.published_qos0 + 1, stats().published_qos0);
+    TEST_ASSERT_EQUAL_UINT32(before.published_qos1 + 1, stats().published_qos1);
+}
+
+/**
+ * @brief A PUBACK frees only the publish with its packet id: one for an id never sent, or for one
+ *  already acknowledged, counts nothing. PUBACKs are handled in order, so waiting for a real one
+ *  shows the bogus ones before it were seen and ignored
+ */
+static void test_puback_matching(void)
+{
+    const sensor_struct alarms[3] = { sample(1, true), sample(2, true), sample(3, true) };
+    uint16_t ids[3];
+    uint32_t acked = stats().acked;
+
+    atomic_store(&s_hold_acks, true);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, network_transmit(alarms, 3));
+    for (int i = 0; i < 3; i++) {
+        ids[i] = publish_id(wait_logged(i)->type, s_log[i].body);
+    }
+    TEST_ASSERT_NOT_EQUAL(ids[0], ids[1]);
+    TEST_ASSERT_NOT_EQUAL(ids[1], ids[2]);
+
+    broker_ack(ids[2] + 100);
+    broker_ack(ids[1]);
+    wait_acked(acked + 1);
+    broker_ack(ids[1]);
+    broker_ack(ids[0]);
+    wait_acked(acked + 2);
+    broker_ack(ids[2]);
+    wait_acked(acked + 3);
+    usleep(50 * 1000);
+    TEST_ASSERT_EQUAL_UINT32(acked + 3, stats().acked);
+}
+
+/**
+ * @brief Unacknowledged alarms fill the MQTT_INFLIGHT_MAX slots, the next is refused rather than
+ *  dropping one of them, and a single PUBACK makes room for exactly one more
+ */
+static void test_inflight_table_full(void)
+{
+    const sensor_struct alarm = sample(1, true);
+    uint16_t ids[MQTT_INFLIGHT_MAX];
+    uint32_t acked = stats().acked;
+
+    atomic_store(&s_hold_acks, true);
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        TEST_ASSERT_EQUAL_INT(ESP_OK, network_transmit(&alarm, 1));
+        ids[i] = publish_id(wait_logged(i)->type, s_log[i].body);
+    }
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_NO_MEM, network_transmit(&alarm, 1));
+
+    broker_ack(ids[3]);
+    wait_acked(acked + 1);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, network_transmit(&alarm, 1));
+    uint16_t last = publish_id(wait_logged(MQTT_INFLIGHT_MAX)->type, s_log[MQTT_INFLIGHT_MAX].body);
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_NO_MEM, network_transmit(&alarm, 1));
+
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (i != 3) {
+            broker_ack(ids[i]);
+        }
+    }
+    broker_ack(last);
+    wait_acked(acked + MQTT_INFLIGHT_MAX + 1);
+}
+
+/**
+ * @brief Alarms the broker never acknowledged are sent again once the session is back: after CONNECT
+ *  and SUBSCRIBE, with DUP set, the same packet ids and the same payloads. Acknowledging the
+ *  redelivered copies empties the table
+ */
+static void test_qos1_redelivered_with_dup_after_reconnect(void)
+{
+    const sensor_struct alarms[3] = { sample(1, true), sample(2, true), sample(3, true) };
+    static logged_packet sent[3];
+    mqtt_client_stats before = stats();
+
+    atomic_store(&s_hold_acks, true);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, network_transmit(alarms, 3));
+    for (int i = 0; i < 3; i++) {
+        sent[i] = *wait_logged(i);
+        TEST_ASSERT_EQUAL_HEX8(0x32, sent[i].type);
+    }
+
+    log_clear();
+    broker_drop();
+    TEST_ASSERT_EQUAL_HEX8(0x10, wait_logged(0)->type);
+    TEST_ASSERT_EQUAL_HEX8(0x82, wait_logged(1)->type);
+    for (int i = 0; i < 3; i++) {
+        const logged_packet *p = wait_logged(2 + i);
+        TEST_ASSERT_EQUAL_HEX8(0x32 | 0x08, p->type);
+        TEST_ASSERT_EQUAL_size_t(sent[i].len, p->len);
+        TEST_ASSERT_EQUAL_MEMORY(sent[i].body, p->body, p->len);
+    }
+    TEST_ASSERT_EQUAL_UINT32(before.redelivered + 3, stats().redelivered);
+    TEST_ASSERT_EQUAL_UINT32(before.acked, stats().acked);
+
+    for (int i = 0; i < 3; i++) {
+        broker_ack(publish_id(sent[i].type, sent[i].body));
+    }
+    wait_acked(before.acked + 3);
+    TEST_ASSERT_EQUAL_UINT32(before.published_qos1 + 3, stats().published_qos1);
+}
+
+/**
+ * @brief A QoS 1 message on the config topic is acknowledged with its own packet id and its
+ *  profile reaches network_take_profile()
+ */
+static void test_config_message_acked_and_applied(void)
+{
+    uint8_t publish[4 + MQTT_TOPIC_LEN + 4];
+    size_t topic_len = strlen(s_topic_config);
+    uint32_t received = stats().received;
+    int profile = -1;
+
+    network_take_profile();
+    publish[0] = 0x32;
+    publish[1] = (uint8_t)(2 + topic_len + 2 + 2);
+    publish[2] = 0;
+    publish[3] = (uint8_t)topic_len;
+    memcpy(publish + 4, s_topic_config, topic_len);
+    memcpy(publish + 4 + topic_len, (const uint8_t[]){ 0x01, 0x07, '#', '7' }, 4);
+    broker_send(publish, 4 + topic_len + 4);
+
+    const logged_packet *p = wait_logged(0);
+    TEST_ASSERT_EQUAL_HEX8(0x40, p->type);
+    TEST_ASSERT_EQUAL_size_t(2, p->len);
+    TEST_ASSERT_EQUAL_HEX8(0x01, p->body[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x07, p->body[1]);
+    for (int i = 0; i < WAIT_MS && profile < 0; i++) {
+        profile = network_take_profile();
+        usleep(1000);
+    }
+    TEST_ASSERT_EQUAL_INT(7, profile);
+    TEST_ASSERT_EQUAL_UINT32(received + 1, stats().received);
+}
+
+/**
+ * @brief Full telemetry batches through network_transmit(), until the broker has read every one,
+ *  against the same batches through http_transmit() over a keep-alive connection. A QoS 0 publish
+ *  is handed to the socket and forgotten, a POST waits for its response
+ */
+static void test_bench_mqtt_vs_http(void)
+{
+    sensor_struct batch[TX_BATCH_MAX];
+    char msg[128];
+
+    for (int i = 0; i < TX_BATCH_MAX; i++) {
+        batch[i] = sample(i, false);
+    }
+    uint32_t telemetry = atomic_load(&s_telemetry);
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_BATCHES; i++) {
+        TEST_ASSERT_EQUAL_INT(ESP_OK, network_transmit(batch, TX_BATCH_MAX));
+    }
+    for (int i = 0; i < WAIT_MS && atomic_load(&s_telemetry) - telemetry < BENCH_BATCHES; i++) {
+        usleep(1000);
+    }
+    int64_t mqtt_us = esp_timer_get_time() - start;
+    TEST_ASSERT_EQUAL_UINT32(BENCH_BATCHES, atomic_load(&s_telemetry) - telemetry);
+
+    uint32_t posts = atomic_load(&s_posts);
+    start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_BATCHES; i++) {
+        TEST_ASSERT_EQUAL_INT(ESP_OK, http_transmit(batch, TX_BATCH_MAX));
+    }
+    int64_t http_us = esp_timer_get_time() - start;
+    TEST_ASSERT_EQUAL_UINT32(BENCH_BATCHES, atomic_load(&s_posts) - posts);
+
+    snprintf(msg, sizeof(msg), "%d-sample batches: MQTT QoS 0 %lld us/batch, HTTP keep-alive %lld us/batch",
+             TX_BATCH_MAX, (long long)(mqtt_us / BENCH_BATCHES), (long long)(http_us / BENCH_BATCHES));
+    TEST_MESSAGE(msg);
+}
+
+int main(void)
+{
+    uint8_t mac[6];
+    char hex[13];
+    pthread_t t;
+
+    signal(SIGPIPE, SIG_IGN);
+    s_broker = listen_on(BROKER_PORT);
+    s_collector = listen_on(atoi(WEB_PORT));
+    if (s_broker < 0 || s_collector < 0) {
+        return 1;
+    }
+    pthread_create(&t, NULL, broker_accept, NULL);
+    pthread_create(&t, NULL, collector_accept, NULL);
+
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    for (int i = 0; i < 6; i++) {
+        snprintf(&hex[2 * i], 3, "%02x", mac[i]);
+    }
+    snprintf(s_client_id, sizeof(s_client_id), "capstone-%s", hex);
+    snprintf(s_topic_telemetry, sizeof(s_topic_telemetry), "capstone/%s/telemetry", hex);
+    snprintf(s_topic_alarm, sizeof(s_topic_alarm), "capstone/%s/alarm", hex);
+    snprintf(s_topic_config, sizeof(s_topic_config), "capstone/%s/config", hex);
+
+    nvs_flash_init();
+    esp_netif_init();
+    esp_event_loop_create_default();
+    network_connect();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_connect_and_subscribe_encoding);
+    RUN_TEST(test_publish_encoding);
+    RUN_TEST(test_puback_matching);
+    RUN_TEST(test_inflight_table_full);
+    RUN_TEST(test_qos1_redelivered_with_dup_after_reconnect);
+    RUN_TEST(test_config_message_acked_and_applied);
+    RUN_TEST(test_bench_mqtt_vs_http);
+    return UNITY_END();
+}
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unity.h>
+#include "esp_timer.h"
+#include "payload.h"
+
+/*
+ * Payload writer and decimal formatters, then the cost of serializing a form body for one sample
+ * and for a full TX_BATCH_MAX batch. The body is laid out as network.c's construct_body() writes
+ * it, window summaries included, so the numbers track what the transmitter pays per request.
+ */
+
+//Defines
+#define BATCH 16            //TX_BATCH_MAX
+#define BENCH_ROUNDS 200000
+#define BODY_LEN 4096
+
+//Private Variables
+static char s_buf[BODY_LEN];
+static sensor_struct s_samples[BATCH];
+
+//Private Function Declarations
+static void form_body(payload_writer *w, const sensor_struct *samples, int count);
+static const char *written(const payload_writer *w);
+static uint32_t bench_ns(int count);
+
+//****************************************************************************
+//Helpers
+//****************************************************************************
+
+/**
+ * @brief Same appends as the form branch of construct_body() in network.c
+ */
+static void form_body(payload_writer *w, const sensor_struct *samples, int count)
+{
+    int64_t base_ms = samples[0].timestamp / 1000;
+
+    payload_append_str(w, "count=");
+    payload_append_int(w, count);
+    payload_append_str(w, "&base_ms=");
+    payload_append_int(w, base_ms);
+    payload_append_str(w, "&utc_ms=");
+    payload_append_int(w, 1760000000000LL);
+    for (int i = 0; i < count; i++) {
+        payload_append_str(w, "&sensor_id=");
+        payload_append_int(w, samples[i].id);
+        payload_append_str(w, "&dt_ms=");
+        payload_append_int(w, samples[i].timestamp / 1000 - base_ms);
+        payload_append_str(w, "&measurement=");
+        payload_append_fixed(w, samples[i].value, SENSOR_VALUE_FRAC_BITS, 2);
+        payload_append_str(w, "&n=");
+        payload_append_int(w, samples[i].count);
+        payload_append_str(w, "&min=");
+        payload_append_fixed(w, samples[i].min, SENSOR_VALUE_FRAC_BITS, 2);
+        payload_append_str(w, "&max=");
+        payload_append_fixed(w, samples[i].max, SENSOR_VALUE_FRAC_BITS, 2);
+        payload_append_str(w, "&mean=");
+        payload_append_fixed(w, samples[i].mean, SENSOR_VALUE_FRAC_BITS, 2);
+        payload_append_str(w, "&std=");
+        payload_append_fixed(w, samples[i].stddev, SENSOR_VALUE_FRAC_BITS, 2);
+    }
+}
+
+/**
+ * @brief The writer's contents as a string, for comparisons
+ */
+static const char *written(const payload_writer *w)
+{
+    static char text[BODY_LEN + 1];
+    memcpy(text, w->buf, w->len);
+    text[w->len] = '\0';
+    return text;
+}
+
+/**
+ * @brief Mean ns to serialize a body of count samples
+ */
+static uint32_t bench_ns(int count)
+{
+    payload_writer w;
+    size_t total = 0;
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        payload_init(&w, s_buf, sizeof(s_buf));
+        form_body(&w, s_samples, count);
+        total += w.len;
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    TEST_ASSERT_GREATER_THAN(0, total); //Keeps the loop from being optimized away
+    return (uint32_t)(elapsed * 1000 / BENCH_ROUNDS);
+}
+
+void setUp(void)
+{
+    for (int i = 0; i < BATCH; i++) {
+        s_samples[i] = (sensor_struct){
+            .id = 1 + i % 3,
+            .value = 5123 + 97 * i,
+            .timestamp = 123456789000LL + 1000000LL * i,
+            .count = 10,
+            .min = -2000 + i,
+            .max = 30000 + i,
+            .mean = 12345 - i,
+            .stddev = 77 + i,
+        };
+    }
+}
+
+void tearDown(void)
+{
+}
+
+//****************************************************************************
+//Tests
+//****************************************************************************
+
+static void test_format_int_extremes(void)
+{
+    char out[PAYLOAD_INT_MAX_DIGITS];
+
+    TEST_ASSERT_EQUAL_STRING_LEN("0", out, payload_format_int(out, 0));
+    TEST_ASSERT_EQUAL_INT(1, payload_format_int(out, 0));
+    TEST_ASSERT_EQUAL_INT(2, payload_format_int(out, -7));
+    TEST_ASSERT_EQUAL_STRING_LEN("-7", out, 2);
+    TEST_ASSERT_EQUAL_INT(20, payload_format_int(out, INT64_MIN));
+    TEST_ASSERT_EQUAL_STRING_LEN("-9223372036854775808", out, 20);
+    TEST_ASSERT_EQUAL_INT(19, payload_format_int(out, INT64_MAX));
+    TEST_ASSERT_EQUAL_STRING_LEN("9223372036854775807", out, 19);
+}
+
+/**
+ * @brief Rounds half away from zero at the last place, and never prints "-0.00"
+ */
+static void test_append_fixed_rounding(void)
+{
+    payload_writer w;
+
+    payload_init(&w, s_buf, sizeof(s_buf));
+    payload_append_fixed(&w, -896, 8, 2);
+    payload_append_str(&w, " ");
+    payload_append_fixed(&w, 1, 8, 2);          //0.0039 -> 0.00
+    payload_append_str(&w, " ");
+    payload_append_fixed(&w, -1, 8, 2);
+    payload_append_str(&w, " ");
+    payload_append_fixed(&w, 2, 8, 2);          //0.0078 -> 0.01
+    payload_append_str(&w, " ");
+    payload_append_fixed(&w, 256 * 40, 8, 0);
+    payload_append_str(&w, " ");
+    payload_append_fixed(&w, INT32_MIN, 8, 2);
+    TEST_ASSERT_FALSE(w.overflow);
+    TEST_ASSERT_EQUAL_STRING("-3.50 0.00 0.00 0.01 40 -8388608.00", written(&w));
+}
+
+/**
+ * @brief An append that doesn't fit is dropped whole and the overflow flag sticks
+ */
+static void test_overflow_is_sticky(void)
+{
+    payload_writer w;
+
+    payload_init(&w, s_buf, 8);
+    payload_append_str(&w, "count=");
+    payload_append_int(&w, 123);
+    TEST_ASSERT_TRUE(w.overflow);
+    TEST_ASSERT_EQUAL_INT(6, w.len);
+    payload_append_str(&w, "1");
+    TEST_ASSERT_TRUE(w.overflow);
+    TEST_ASSERT_EQUAL_INT(6, w.len);
+}
+
+/**
+ * @brief A group of fields that overflows is undone back to its mark, and the writer takes appends
+ *  again afterwards
+ */
+static void test_rewind_undoes_group(void)
+{
+    payload_writer w;
+
+    payload_init(&w, s_buf, 24);
+    payload_append_str(&w, "ring=live");
+    payload_append_field(&w, "pushed", 12);
+    size_t mark = w.len;
+    payload_append_field(&w, "dropped_oldest", 3);
+    TEST_ASSERT_TRUE(w.overflow);
+    payload_rewind(&w, mark);
+    TEST_ASSERT_FALSE(w.overflow);
+    payload_append_field(&w, "n", -1);
+    TEST_ASSERT_FALSE(w.overflow);
+    TEST_ASSERT_EQUAL_STRING("ring=live&pushed=12&n=-1", written(&w));
+}
+
+static void test_form_body_layout(void)
+{
+    payload_writer w;
+
+    payload_init(&w, s_buf, sizeof(s_buf));
+    form_body(&w, s_samples, 1);
+    TEST_ASSERT_FALSE(w.overflow);
+    TEST_ASSERT_EQUAL_STRING("count=1&base_ms=123456789&utc_ms=1760000000000&sensor_id=1&dt_ms=0"
+                             "&measurement=20.01&n=10&min=-7.81&max=117.19&mean=48.22&std=0.30", written(&w));
+}
+
+/**
+ * @brief ns per body for one sample and for a full batch, reported rather than asserted as the
+ *  host varies; the bound only catches something pathological such as a quadratic rescan
+ */
+static void test_bench_form_body(void)
+{
+    char msg[128];
+
+    uint32_t one = bench_ns(1);
+    uint32_t full = bench_ns(BATCH);
+    snprintf(msg, sizeof(msg), "form body: 1 sample %u ns, %d samples %u ns", (unsigned)one, BATCH, (unsigned)full);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_LESS_THAN_UINT32(one * BATCH * 2, full);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_format_int_extremes);
+    RUN_TEST(test_append_fixed_rounding);
+    RUN_TEST(test_overflow_is_sticky);
+    RUN_TEST(test_rewind_undoes_group);
+    RUN_TEST(test_form_body_layout);
+    RUN_TEST(test_bench_form_body);
+    return UNITY_END();
+}
@@ -0,0 +1,158 @@
+#include <string.h>
+#include "cbor-decode.h"
+
+//Defines
+#define CBOR_UINT   0
+#define CBOR_NINT   1
+#define CBOR_BYTES  2
+#define CBOR_ARRAY  4
+
+//Public Function Declarations
+int cbor_decode_batch(const uint8_t *buf, size_t len, uint8_t *device_id, int64_t *utc_ms, sensor_struct *samples, int max);
+
+//Private Function Declarations
+static bool cbor_read_head(const uint8_t **p, const uint8_t *end, uint8_t *major, uint64_t *value);
+static bool cbor_read_int(const uint8_t **p, const uint8_t *end, int64_t *value);
+static bool fits_ms(int64_t ms);
+static bool fits_int32(int64_t value);
+
+//****************************************************************************
+//Public Functions
+//****************************************************************************
+/**
+ * @brief Decodes a batch written by payload_cbor_encode_batch(). Timestamps come back monotonic, in us
+ *  at ms resolution; a sample's UTC is *utc_ms plus its offset from the first sample. Returns the
+ *  number of samples in the batch (at most max are stored), or -1 if the buffer is malformed, out of
+ *  range or a different version
+ */
+int cbor_decode_batch(const uint8_t *buf, size_t len, uint8_t *device_id, int64_t *utc_ms, sensor_struct *samples, int max)
+{
+    const uint8_t *p = buf, *end = buf + len;
+    uint8_t major;
+    uint64_t n, count;
+    int64_t base_ms, id, dt_ms, value, extra[6], stats[5];
+
+    if (!cbor_read_head(&p, end, &major, &n) || major != CBOR_ARRAY || n != 5) {
+        return -1;
+    }
+    if (!cbor_read_head(&p, end, &major, &n) || major != CBOR_UINT || n != PAYLOAD_CBOR_VERSION) {
+        return -1;
+    }
+    if (!cbor_read_head(&p, end, &major, &n) || major != CBOR_BYTES || n != PAYLOAD_DEVICE_ID_LEN ||
+        (size_t)(end - p) < n) {
+        return -1;
+    }
+    memcpy(device_id, p, PAYLOAD_DEVICE_ID_LEN);
+    p += PAYLOAD_DEVICE_ID_LEN;
+    if (!cbor_read_int(&p, end, &base_ms) || !cbor_read_int(&p, end, utc_ms) || !fits_ms(base_ms)) {
+        return -1;
+    }
+    if (!cbor_read_head(&p, end, &major, &count) || major != CBOR_ARRAY || count > (uint64_t)(end - p) ||
+        count > INT32_MAX) {
+        return -1;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        if (!cbor_read_head(&p, end, &major, &n) || major != CBOR_ARRAY || (n != 3 && n != 4 && n != 8 && n != 9) ||
+            !cbor_read_int(&p, end, &id) || !cbor_read_int(&p, end, &dt_ms) || !cbor_read_int(&p, end, &value)) {
+            return -1;
+        }
+        //Both under CBOR_DECODE_MS_MAX, so the sum in us can't overflow
+        if (!fits_int32(id) || !fits_ms(dt_ms) || !fits_int32(value)) {
+            return -1;
+        }
+        memset(extra, 0, sizeof(extra));
+        for (uint64_t k = 3; k < n; k++) {
+            if (!cbor_read_int(&p, end, &extra[k - 3])) {
+                return -1;
+            }
+        }
+        memset(stats, 0, sizeof(stats));
+        if (n >= 8) {
+            memcpy(stats, extra, sizeof(stats));
+        }
+        int64_t flags = (n == 4 || n == 9) ? extra[n - 4] : 0;
+        if (stats[0] < 0 || stats[0] > UINT32_MAX || flags < 0 || flags > UINT32_MAX ||
+            !fits_int32(stats[1]) || !fits_int32(stats[2]) || !fits_int32(stats[3]) || !fits_int32(stats[4])) {
+            return -1;
+        }
+        if (i < (uint64_t)max) {
+            samples[i].id = (int)id;
+            samples[i].value = (sensor_value)value;
+            samples[i].timestamp = (base_ms + dt_ms) * 1000;
+            samples[i].count = (uint32_t)stats[0];
+            samples[i].min = (sensor_value)stats[1];
+            samples[i].max = (sensor_value)stats[2];
+            samples[i].mean = (sensor_value)stats[3];
+            samples[i].stddev = (sensor_value)stats[4];
+            samples[i].flags = (uint32_t)flags;
+        }
+    }
+    return p == end ? (int)count : -1;
+}
+
+//****************************************************************************
+//Private Functions
+//****************************************************************************
+
+/**
+ * @brief Reads a CBOR item head, only definite lengths are accepted
+ */
+static bool cbor_read_head(const uint8_t **p, const uint8_t *end, uint8_t *major, uint64_t *value)
+{
+    size_t n;
+
+    if (*p >= end) {
+        return false;
+    }
+    *major = **p >> 5;
+    uint8_t info = **p & 0x1F;
+    (*p)++;
+    if (info < 24) {
+        *value = info;
+        return true;
+    }
+    if (info > 27) {
+        return false;
+    }
+    n = (size_t)1 << (info - 24);
+    if ((size_t)(end - *p) < n) {
+        return false;
+    }
+    *value = 0;
+    for (size_t i = 0; i < n; i++) {
+        *value = *value << 8 | (*p)[i];
+    }
+    *p += n;
+    return true;
+}
+
+/**
+ * @brief Reads a CBOR integer of either sign that fits in int64_t
+ */
+static bool cbor_read_int(const uint8_t **p, const uint8_t *end, int64_t *value)
+{
+    uint8_t major;
+    uint64_t raw;
+
+    if (!cbor_read_head(p, end, &major, &raw) || raw > INT64_MAX) {
+        return false;
+    }
+    if (major == CBOR_UINT) {
+        *value = (int64_t)raw;
+    } else if (major == CBOR_NINT) {
+        *value = -1 - (int64_t)raw;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool fits_ms(int64_t ms)
+{
+    return ms >= -CBOR_DECODE_MS_MAX && ms <= CBOR_DECODE_MS_MAX;
+}
+
+static bool fits_int32(int64_t value)
+{
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "payload.h"
+
+#define CBOR_DECODE_MS_MAX (INT64_MAX / 1000 / 2) //base_ms and dt_ms beyond this can't be a timestamp in us
+
+/*
+ * Reference decoder of the CBOR batch (see payload.h) for the collector. Host side only: the node
+ * never decodes its own batches, so this is built with the tests and not into the firmware image.
+ * Input is untrusted, anything out of range is rejected rather than truncated.
+ */
+int cbor_decode_batch(const uint8_t *buf, size_t len, uint8_t *device_id, int64_t *utc_ms, sensor_struct *samples, int max);
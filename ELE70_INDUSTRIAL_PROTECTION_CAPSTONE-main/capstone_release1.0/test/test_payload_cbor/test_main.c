@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unity.h>
+#include "payload.h"
+#include "cbor-decode.h"
+
+/*
+ * payload_cbor_encode_batch() against the collector's reference decoder: every field survives the
+ * round trip, a typical sample stays within the 6-8 bytes payload.h promises, and hostile input,
+ * truncated or out of range, is rejected instead of decoded.
+ */
+
+//Defines
+#define BATCH 16
+#define BUF_LEN 1024
+
+//Private Variables
+static const uint8_t s_device[PAYLOAD_DEVICE_ID_LEN] = { 0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01 };
+static uint8_t s_buf[BUF_LEN];
+static sensor_struct s_in[BATCH], s_out[BATCH];
+
+//Private Function Declarations
+static size_t encode(const sensor_struct *samples, int count, int64_t utc_ms);
+static void check_equal(const sensor_struct *expected, const sensor_struct *actual);
+
+//****************************************************************************
+//Helpers
+//****************************************************************************
+
+static size_t encode(const sensor_struct *samples, int count, int64_t utc_ms)
+{
+    payload_writer w;
+
+    payload_init(&w, (char *)s_buf, sizeof(s_buf));
+    payload_cbor_encode_batch(&w, s_device, utc_ms, samples, count);
+    TEST_ASSERT_FALSE(w.overflow);
+    return w.len;
+}
+
+/**
+ * @brief Timestamps travel at ms resolution, everything else exactly
+ */
+static void check_equal(const sensor_struct *expected, const sensor_struct *actual)
+{
+    TEST_ASSERT_EQUAL_INT(expected->id, actual->id);
+    TEST_ASSERT_EQUAL_INT32(expected->value, actual->value);
+    TEST_ASSERT_EQUAL_INT64(expected->timestamp / 1000 * 1000, actual->timestamp);
+    TEST_ASSERT_EQUAL_UINT32(expected->count, actual->count);
+    TEST_ASSERT_EQUAL_UINT32(expected->flags, actual->flags);
+    if (expected->count > 0) {
+        TEST_ASSERT_EQUAL_INT32(expected->min, actual->min);
+        TEST_ASSERT_EQUAL_INT32(expected->max, actual->max);
+        TEST_ASSERT_EQUAL_INT32(expected->mean, actual->mean);
+        TEST_ASSERT_EQUAL_INT32(expected->stddev, actual->stddev);
+    }
+}
+
+void setUp(void)
+{
+    memset(s_in, 0, sizeof(s_in));
+    memset(s_out, 0, sizeof(s_out));
+}
+
+void tearDown(void)
+{
+}
+
+//****************************************************************************
+//Tests
+//****************************************************************************
+
+/**
+ * @brief Plain readings, window summaries and flagged samples of either sign in one batch
+ */
+static void test_round_trip(void)
+{
+    uint8_t device[PAYLOAD_DEVICE_ID_LEN];
+    int64_t utc_ms = 0;
+
+    for (int i = 0; i < BATCH; i++) {
+        s_in[i].id = 1 + i % 3;
+        s_in[i].value = (i % 2 ? -1 : 1) * (i * 1000 + 7);
+        s_in[i].timestamp = 5000000000LL + 250123LL * i;
+        if (i % 4 == 1) {
+            s_in[i].count = 10 + i;
+            s_in[i].min = INT32_MIN;
+            s_in[i].max = INT32_MAX;
+            s_in[i].mean = -i;
+            s_in[i].stddev = 3 * i;
+        }
+        if (i % 5 == 2) {
+            s_in[i].flags = SENSOR_FLAG_ALARM;
+        }
+    }
+    size_t len = encode(s_in, BATCH, 1760000000123LL);
+
+    TEST_ASSERT_EQUAL_INT(BATCH, cbor_decode_batch(s_buf, len, device, &utc_ms, s_out, BATCH));
+    TEST_ASSERT_EQUAL_MEMORY(s_device, device, PAYLOAD_DEVICE_ID_LEN);
+    TEST_ASSERT_EQUAL_INT64(1760000000123LL, utc_ms);
+    for (int i = 0; i < BATCH; i++) {
+        check_equal(&s_in[i], &s_out[i]);
+    }
+}
+
+/**
+ * @brief A journaled sample from before this boot has a negative timestamp, an unsynced node sends
+ *  utc_ms 0; neither is special to the format
+ */
+static void test_round_trip_before_boot_unsynced(void)
+{
+    uint8_t device[PAYLOAD_DEVICE_ID_LEN];
+    int64_t utc_ms = -1;
+
+    s_in[0] = (sensor_struct){ .id = 2, .value = 10 * SENSOR_VALUE_ONE, .timestamp = -8514000 };
+    s_in[1] = (sensor_struct){ .id = 2, .value = 11 * SENSOR_VALUE_ONE, .timestamp = 2000000 };
+    size_t len = encode(s_in, 2, 0);
+
+    TEST_ASSERT_EQUAL_INT(2, cbor_decode_batch(s_buf, len, device, &utc_ms, s_out, BATCH));
+    TEST_ASSERT_EQUAL_INT64(0, utc_ms);
+    check_equal(&s_in[0], &s_out[0]);
+    check_equal(&s_in[1], &s_out[1]);
+}
+
+/**
+ * @brief Only max samples are stored, the count still reports the whole batch
+ */
+static void test_decode_caps_at_max(void)
+{
+    uint8_t device[PAYLOAD_DEVICE_ID_LEN];
+    int64_t utc_ms;
+
+    for (int i = 0; i < BATCH; i++) {
+        s_in[i] = (sensor_struct){ .id = 1, .value = i, .timestamp = 1000LL * i };
+    }
+    s_out[4].id = -1;
+    size_t len = encode(s_in, BATCH, 0);
+
+    TEST_ASSERT_EQUAL_INT(BATCH, cbor_decode_batch(s_buf, len, device, &utc_ms, s_out, 4));
+    check_equal(&s_in[3], &s_out[3]);
+    TEST_ASSERT_EQUAL_INT(-1, s_out[4].id);
+}
+
+/**
+ * @brief What each sample adds to a full batch a second apart, the batch header (array, version,
+ *  device id, base_ms, utc_ms) aside: a temperature reading fits the 6-8 bytes of payload.h, a
+ *  light reading above 256 lux takes a 32-bit integer
+ */
+static void test_bytes_per_sample(void)
+{
+    char msg[96];
+
+    for (int i = 0; i < BATCH; i++) {
+        s_in[i] = (sensor_struct){ .id = 2, .value = 2150 + 37 * i, .timestamp = 123456789000LL + 1000000LL * i };
+    }
+    size_t header = encode(s_in, 1, 1760000000123LL) - 6;   //The first sample is 6 bytes at dt_ms 0
+    size_t temp = (encode(s_in, BATCH, 1760000000123LL) - header + BATCH - 1) / BATCH;
+    for (int i = 0; i < BATCH; i++) {
+        s_in[i].id = 1;
+        s_in[i].value = 312 * SENSOR_VALUE_ONE + 37 * i;
+    }
+    size_t light = (encode(s_in, BATCH, 1760000000123LL) - header + BATCH - 1) / BATCH;
+
+    snprintf(msg, sizeof(msg), "header %u bytes, temperature %u bytes/sample, light %u bytes/sample",
+             (unsigned)header, (unsigned)temp, (unsigned)light);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_LESS_OR_EQUAL(8, temp);
+    TEST_ASSERT_LESS_OR_EQUAL(10, light);
+}
+
+/**
+ * @brief Every proper prefix of a valid batch is rejected, as are trailing bytes
+ */
+static void test_truncated_and_trailing_rejected(void)
+{
+    uint8_t device[PAYLOAD_DEVICE_ID_LEN];
+    int64_t utc_ms;
+
+    for (int i = 0; i < 4; i++) {
+        s_in[i] = (sensor_struct){ .id = 1, .value = -i, .timestamp = 1000LL * i, .count = (uint32_t)i, .flags = (uint32_t)(i & 1) };
+    }
+    size_t len = encode(s_in, 4, 1760000000123LL);
+
+    for (size_t cut = 0; cut < len; cut++) {
+        TEST_ASSERT_EQUAL_INT(-1, cbor_decode_batch(s_buf, cut, device, &utc_ms, s_out, BATCH));
+    }
+    s_buf[len] = 0x00;
+    TEST_ASSERT_EQUAL_INT(-1, cbor_decode_batch(s_buf, len + 1, device, &utc_ms, s_out, BATCH));
+}
+
+/**
+ * @brief Hand-built batches whose base_ms and dt_ms would overflow a timestamp in us, and values
+ *  that don't fit a sensor_value, are rejected before any arithmetic on them
+ */
+static void test_out_of_range_rejected(void)
+{
+    uint8_t device[PAYLOAD_DEVICE_ID_LEN];
+    int64_t utc_ms;
+    const int64_t cases[][3] = {
+        { INT64_MAX, 0, 1 },                        //base_ms
+        { INT64_MIN, 0, 1 },
+        { 0, INT64_MAX / 1000, 1 },                 //dt_ms
+        { CBOR_DECODE_MS_MAX, -CBOR_DECODE_MS_MAX - 1, 1 },
+        { 0, 0, (int64_t)INT32_MAX + 1 },           //value
+        { 0, 0, (int64_t)INT32_MIN - 1 },
+    };
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        payload_writer w;
+        payload_init(&w, (char *)s_buf, sizeof(s_buf));
+        payload_cbor_array(&w, 5);
+        payload_cbor_uint(&w, PAYLOAD_CBOR_VERSION);
+        payload_cbor_bytes(&w, s_device, PAYLOAD_DEVICE_ID_LEN);
+        payload_cbor_int(&w, cases[c][0]);
+        payload_cbor_int(&w, 0);
+        payload_cbor_array(&w, 1);
+        payload_cbor_array(&w, 3);
+        payload_cbor_int(&w, 1);
+        payload_cbor_int(&w, cases[c][1]);
+        payload_cbor_int(&w, cases[c][2]);
+        TEST_ASSERT_EQUAL_INT(-1, cbor_decode_batch(s_buf, w.len, device, &utc_ms, s_out, BATCH));
+    }
+}
+
+/**
+ * @brief The largest accepted base_ms and dt_ms still decode to an exact timestamp
+ */
+static void test_range_limits_accepted(void)
+{
+    uint8_t device[PAYLOAD_DEVICE_ID_LEN];
+    int64_t utc_ms;
+    payload_writer w;
+
+    payload_init(&w, (char *)s_buf, sizeof(s_buf));
+    payload_cbor_array(&w, 5);
+    payload_cbor_uint(&w, PAYLOAD_CBOR_VERSION);
+    payload_cbor_bytes(&w, s_device, PAYLOAD_DEVICE_ID_LEN);
+    payload_cbor_int(&w, CBOR_DECODE_MS_MAX);
+    payload_cbor_int(&w, 0);
+    payload_cbor_array(&w, 1);
+    payload_cbor_array(&w, 3);
+    payload_cbor_int(&w, 1);
+    payload_cbor_int(&w, CBOR_DECODE_MS_MAX);
+    payload_cbor_int(&w, 0);
+
+    TEST_ASSERT_EQUAL_INT(1, cbor_decode_batch(s_buf, w.len, device, &utc_ms, s_out, BATCH));
+    TEST_ASSERT_EQUAL_INT64(2 * CBOR_DECODE_MS_MAX * 1000, s_out[0].timestamp);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_round_trip_before_boot_unsynced);
+    RUN_TEST(test_decode_caps_at_max);
+    RUN_TEST(test_bytes_per_sample);
+    RUN_TEST(test_truncated_and_trailing_rejected);
+    RUN_TEST(test_out_of_range_rejected);
+    RUN_TEST(test_range_limits_accepted);
+    return UNITY_END();
+}
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include "nvs_flash.h"
+#include "sensor-registry.h"
+#include "sensor-config.h"
+
+/*
+ * The server's per-sensor config lines as sensor-config.c parses and stores them. Rates and deadbands
+ * are parsed from the text a config push carries, decimals are converted to the readings' fixed point,
+ * and a stored setting reaches the sampler only through the changed mask, keyed by registry index and
+ * persisted across a reload. All zeros hands a sensor back to its board default.
+ */
+
+//Defines
+#define ID_LIGHT 1          //Registry index 0
+#define ID_TEMP 2           //Registry index 1
+#define INDEX_TEMP 1
+#define LINE(text) text, strlen(text)
+
+//Private Function Declarations
+static void reset_deadbands(void);
+static void assert_deadband(const sample_deadband *expected, const sample_deadband *actual);
+
+//****************************************************************************
+//Helpers
+//****************************************************************************
+
+/**
+ * @brief Returns every sensor to its board default and clears the changed mask
+ */
+static void reset_deadbands(void)
+{
+    const sample_deadband none = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(ESP_OK, sensor_config_set_deadband(ID_LIGHT, &none));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, sensor_config_set_deadband(ID_TEMP, &none));
+    sensor_config_take_changed();
+}
+
+/**
+ * @brief Field by field, struct padding isn't part of a setting
+ */
+static void assert_deadband(const sample_deadband *expected, const sample_deadband *actual)
+{
+    TEST_ASSERT_EQUAL_INT32(expected->abs, actual->abs);
+    TEST_ASSERT_EQUAL_UINT32(expected->permille, actual->permille);
+    TEST_ASSERT_EQUAL_UINT32(expected->heartbeat_ms, actual->heartbeat_ms);
+    TEST_ASSERT_EQUAL(expected->alarm, actual->alarm);
+    TEST_ASSERT_EQUAL_INT32(expected->alarm_low, actual->alarm_low);
+    TEST_ASSERT_EQUAL_INT32(expected->alarm_high, actual->alarm_high);
+}
+
+void setUp(void)
+{
+    reset_deadbands();
+}
+
+void tearDown(void)
+{
+}
+
+//****************************************************************************
+//Tests
+//****************************************************************************
+
+/**
+ * @brief The rate line keeps its format: four unsigned fields, trailing spaces and a carriage return
+ *  tolerated, anything else after them refused
+ */
+static void test_parse_rate(void)
+{
+    sensor_rate rate;
+    int id;
+
+    TEST_ASSERT_EQUAL_INT(0, sensor_config_parse(LINE("rate 2 100 5000 4 \r"), &id, &rate));
+    TEST_ASSERT_EQUAL_INT(2, id);
+    TEST_ASSERT_EQUAL_UINT32(100, rate.sample_ms);
+    TEST_ASSERT_EQUAL_UINT32(5000, rate.tx_ms);
+    TEST_ASSERT_EQUAL_UINT32(4, rate.batch);
+    TEST_ASSERT_EQUAL_INT(-1, sensor_config_parse(LINE("rate 2 100 5000"), &id, &rate));
+    TEST_ASSERT_EQUAL_INT(-1, sensor_config_parse(LINE("rate 2 100 5000 4 1"), &id, &rate));
+    TEST_ASSERT_EQUAL_INT(-1, sensor_config_parse(LINE("rate 2 -100 5000 4"), &id, &rate));
+    TEST_ASSERT_EQUAL_INT(-1, sensor_config_parse(LINE("rate 2 4294967296 5000 4"), &id, &rate));
+    TEST_ASSERT_EQUAL_INT(-1, sensor_config_parse(LINE("deadband 2 1 0 60000"), &id, &rate));
+}
+
+/**
+ * @brief abs and the alarm limits are decimals in the sensor's unit, rounded to the nearest 1/256;
+ *  without limits the alarm is off, with only one the line is refused
+ */
+static void test_parse_deadband(void)
+{
+    sample_deadband deadband;
+    int id;
+
+    TEST_ASSERT_EQUAL_INT(0, sensor_config_parse_deadband(LINE("deadband 2 0.5 0 60000 -10.25 40"), &id, &deadband));
+    TEST_ASSERT_EQUAL_INT(2, id);
+    TEST_ASSERT_EQUAL_INT32(SENSOR_VALUE_ONE / 2, deadband.abs);
+    TEST_ASSERT_EQUAL_UINT32(0, deadband.permille);
+    TEST_ASSERT_EQUAL_UINT32(60000, deadband.heartbeat_ms);
+    TEST_ASSERT_TRUE(deadband.alarm);
+    TEST_ASSERT_EQUAL_INT32(-10 * SENSOR_VALUE_ONE - SENSOR_VALUE_ONE / 4, deadband.alarm_low);
+    TEST_ASSERT_EQUAL_INT32(40 * SENSOR_VALUE_ONE, deadband.alarm_high);
+
+    TEST_ASSERT_EQUAL_INT(0, sensor_config_parse_deadband(LINE("deadband 1 0 50 1000\r"), &id, &deadband));
+    TEST_ASSERT_EQUAL_INT(1, id);
+    TEST_ASSERT_EQUAL_INT32(0, deadband.abs);
+    TEST_ASSERT_EQUAL_UINT32(50, deadband.permille);
+    TEST_ASSERT_FALSE(deadband.alarm);
+
+    TEST_ASSERT_EQUAL_INT(0, sensor_config_parse_deadband(LINE("deadband 1 0.003 0 0"), &id, &deadband));
+    TEST_ASSERT_EQUAL_INT32(1, deadband.abs);   //0.768 steps
+    TEST_ASSERT_EQUAL_INT(0, sensor_config_parse_deadband(LINE("deadband 1 0.001 0 0"), &id, &deadband));
+    TEST_ASSERT_EQUAL_INT32(0, deadband.abs);
+
+    TEST_ASSERT_EQUAL_INT(-1, sensor_config_parse_deadband(LINE("deadband 2 1 0 60000 0"), &id, &deadband));
+    TEST_ASSERT_EQUAL_INT(-1, sensor_config_parse_deadband(LINE("deadband 2 1 0"), &id, &deadband));
+    TEST_ASSERT_EQUAL_INT(-1, sensor_config_parse_deadband(LINE("deadband 2 - 1 0 60000"), &id, &deadband));
+    TEST_ASSERT_EQUAL_INT(-1, sensor_config_parse_deadband(LINE("deadband 2 1.2345678 0 60000"), &id, &deadband));
+    TEST_ASSERT_EQUAL_INT(-1, sensor_config_parse_deadband(LINE("deadband 2 8388608 0 60000"), &id, &deadband));
+    TEST_ASSERT_EQUAL_INT(-1, sensor_config_parse_deadband(LINE("deadband 2 1 0 60000 0 40 x"), &id, &deadband));
+    TEST_ASSERT_EQUAL_INT(-1, sensor_config_parse_deadband(LINE("deadband2 1 0 60000"), &id, &deadband));
+}
+
+/**
+ * @brief A stored deadband marks only its sensor changed and reads back by registry index; all zeros
+ *  reads as the board default again
+ */
+static void test_deadband_handed_to_sampler(void)
+{
+    sample_deadband deadband = { .abs = SENSOR_VALUE_ONE, .heartbeat_ms = 1000, .alarm = true,
+                                 .alarm_low = 0, .alarm_high = 30 * SENSOR_VALUE_ONE };
+    sample_deadband got = { .permille = 77 };
+
+    TEST_ASSERT_FALSE(sensor_config_get_deadband(INDEX_TEMP, &got));
+    TEST_ASSERT_EQUAL_UINT32(77, got.permille);     //Untouched, the caller's default stays
+
+    TEST_ASSERT_EQUAL_INT(ESP_OK, sensor_config_set_deadband(ID_TEMP, &deadband));
+    TEST_ASSERT_EQUAL_HEX32(1u << INDEX_TEMP, sensor_config_take_changed());
+    TEST_ASSERT_EQUAL_HEX32(0, sensor_config_take_changed());
+    TEST_ASSERT_TRUE(sensor_config_get_deadband(INDEX_TEMP, &got));
+    assert_deadband(&deadband, &got);
+
+    TEST_ASSERT_EQUAL_INT(ESP_OK, sensor_config_set_deadband(ID_TEMP, &(const sample_deadband){ 0 }));
+    TEST_ASSERT_EQUAL_HEX32(1u << INDEX_TEMP, sensor_config_take_changed());
+    TEST_ASSERT_FALSE(sensor_config_get_deadband(INDEX_TEMP, &got));
+}
+
+/**
+ * @brief Unknown sensors and inconsistent settings are refused before anything is stored
+ */
+static void test_deadband_rejected(void)
+{
+    sample_deadband got;
+
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_NOT_FOUND, sensor_config_set_deadband(9, &(const sample_deadband){ .permille = 10 }));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, sensor_config_set_deadband(ID_TEMP, &(const sample_deadband){
+        .alarm = true, .alarm_low = SENSOR_VALUE_ONE, .alarm_high = 0 }));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, sensor_config_set_deadband(ID_TEMP, &(const sample_deadband){
+        .abs = -SENSOR_VALUE_ONE }));
+    TEST_ASSERT_EQUAL_HEX32(0, sensor_config_take_changed());
+    TEST_ASSERT_FALSE(sensor_config_get_deadband(INDEX_TEMP, &got));
+}
+
+/**
+ * @brief A deadband survives a reboot: the reload finds it in NVS and marks the sensor changed so the
+ *  sampler applies it on start
+ */
+static void test_deadband_persisted(void)
+{
+    sample_deadband deadband = { .permille = 20, .heartbeat_ms = 5000 };
+    sample_deadband got;
+
+    TEST_ASSERT_EQUAL_INT(ESP_OK, sensor_config_set_deadband(ID_LIGHT, &deadband));
+    sensor_config_take_changed();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, sensor_config_load());
+    TEST_ASSERT_EQUAL_HEX32(1u << 0, sensor_config_take_changed());
+    TEST_ASSERT_TRUE(sensor_config_get_deadband(0, &got));
+    assert_deadband(&deadband, &got);
+}
+
+int main(void)
+{
+    nvs_flash_init();
+    sensor_registry_add(NULL, ID_LIGHT, 0x10, 25);
+    sensor_registry_add(NULL, ID_TEMP, 0x50, 26);
+    sensor_config_load();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_rate);
+    RUN_TEST(test_parse_deadband);
+    RUN_TEST(test_deadband_handed_to_sampler);
+    RUN_TEST(test_deadband_rejected);
+    RUN_TEST(test_deadband_persisted);
+    return UNITY_END();
+}
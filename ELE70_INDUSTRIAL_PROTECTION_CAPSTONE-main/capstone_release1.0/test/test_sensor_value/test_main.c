@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <unity.h>
+#include "esp_timer.h"
+#include "sensor-registry.h"
+
+/*
+ * The drivers' fixed point conversions against the floating point formulas they replace: the NTC
+ * table at every 8-bit code, its interpolation at every 12-bit code, the codes it refuses, and the
+ * VEML7700 Q15 scale at every count. Errors are compared in millionths of a degree or lux, then the
+ * cost of a conversion is reported next to the float formula's.
+ */
+
+//Defines
+#define NTC_REF_C(code)     (30.0 - (2560000.0 / (code) - 18056.0) / 443.7)    //Board calibration, sensor-drivers.c
+#define NTC_LAST_INVALID    52          //Highest 8-bit code that reads below the rated -40 C
+#define VEML_LUX_PER_COUNT  1.8432
+#define HALF_LSB_U          1954        //Half of 1/256 in millionths, rounding alone
+#define NTC_INTERP_MAX_U    12000       //Chord error of 16-code segments on the steep cold end
+#define VEML_MAX_U          50000       //Q15 scale error at full scale plus rounding
+#define BENCH_ROUNDS        200
+#define NTC_FIRST_12BIT     ((NTC_LAST_INVALID + 1) << 4)
+
+//Private Variables
+static volatile sensor_value s_sink;
+
+//Private Function Declarations
+static esp_err_t ntc_12bit(uint32_t code, sensor_value *value);
+static esp_err_t ntc_8bit(uint32_t code, sensor_value *value);
+static esp_err_t veml(uint32_t counts, sensor_value *value);
+static uint32_t error_u(sensor_value value, double expected);
+
+//****************************************************************************
+//Helpers
+//****************************************************************************
+
+/**
+ * @brief D11..D8 in the low nibble of the first byte, D7..D0 in the second
+ */
+static esp_err_t ntc_12bit(uint32_t code, sensor_value *value)
+{
+    const uint8_t raw[2] = { (uint8_t)(code >> 8), (uint8_t)code };
+    return sensor_ntc_adc.convert(NULL, raw, value);
+}
+
+/**
+ * @brief An 8-bit part shifts its result up into D11..D4 and leaves D3..D0 zero
+ */
+static esp_err_t ntc_8bit(uint32_t code, sensor_value *value)
+{
+    return ntc_12bit(code << 4, value);
+}
+
+static esp_err_t veml(uint32_t counts, sensor_value *value)
+{
+    const uint8_t raw[2] = { (uint8_t)counts, (uint8_t)(counts >> 8) };
+    return sensor_veml7700.convert(NULL, raw, value);
+}
+
+/**
+ * @brief |value - expected| in millionths of the unit
+ */
+static uint32_t error_u(sensor_value value, double expected)
+{
+    return (uint32_t)(fabs((double)value / SENSOR_VALUE_ONE - expected) * 1e6 + 0.5);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+//****************************************************************************
+//Tests
+//****************************************************************************
+
+/**
+ * @brief Every valid 8-bit code reads its table entry, which is the curve rounded to 1/256
+ */
+static void test_ntc_table_matches_curve(void)
+{
+    for (uint32_t code = NTC_LAST_INVALID + 1; code < 256; code++) {
+        sensor_value value;
+        TEST_ASSERT_EQUAL_INT(ESP_OK, ntc_8bit(code, &value));
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(HALF_LSB_U, error_u(value, NTC_REF_C(code)));
+    }
+}
+
+/**
+ * @brief A 12-bit code interpolates between its two 8-bit neighbours. The chord sits off the curve
+ *  most at the cold end, where the curve bends hardest
+ */
+static void test_ntc_interpolation_error(void)
+{
+    uint32_t worst = 0, worst_code = 0;
+    char msg[96];
+
+    for (uint32_t code = NTC_FIRST_12BIT; code < 4096; code++) {
+        sensor_value value;
+        TEST_ASSERT_EQUAL_INT(ESP_OK, ntc_12bit(code, &value));
+        uint32_t err = error_u(value, NTC_REF_C(code / 16.0));
+        if (err > worst) {
+            worst = err;
+            worst_code = code;
+        }
+    }
+    snprintf(msg, sizeof(msg), "12-bit NTC: worst error %u micro-C at code %u", (unsigned)worst, (unsigned)worst_code);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(NTC_INTERP_MAX_U, worst);
+}
+
+/**
+ * @brief Code 0 and every code up to NTC_LAST_INVALID reads colder than the thermistor is rated
+ *  for, an open or shorted divider, and is rejected without touching the value. So is every 12-bit
+ *  code that would interpolate from one of them. The first valid code reads within the rating
+ */
+static void test_ntc_low_codes_invalid(void)
+{
+    sensor_value value = 12345;
+
+    TEST_ASSERT_TRUE(NTC_REF_C(NTC_LAST_INVALID) < -40.0);
+    TEST_ASSERT_TRUE(NTC_REF_C(NTC_LAST_INVALID + 1) >= -40.0);
+    for (uint32_t code = 0; code <= NTC_LAST_INVALID; code++) {
+        TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_RESPONSE, ntc_8bit(code, &value));
+    }
+    for (uint32_t code = 0; code < NTC_FIRST_12BIT; code++) {
+        TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_RESPONSE, ntc_12bit(code, &value));
+    }
+    TEST_ASSERT_EQUAL_INT32(12345, value);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, ntc_8bit(NTC_LAST_INVALID + 1, &value));
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(-40 * SENSOR_VALUE_ONE, value);
+}
+
+/**
+ * @brief An 8-bit result and a 12-bit one land on the same table index: 8-bit code c reads exactly
+ *  what 12-bit code 16c does, and the 15 codes above it read between entries c and c+1. Across the
+ *  whole 12-bit range the reading never decreases as the code rises. The top nibble of the first
+ *  byte is ignored
+ */
+static void test_ntc_8bit_and_12bit_agree(void)
+{
+    sensor_value prev = INT32_MIN;
+
+    for (uint32_t code = NTC_LAST_INVALID + 1; code < 256; code++) {
+        sensor_value v8, v12, next = INT32_MAX;    //Entry 256 is only reached by interpolation
+        TEST_ASSERT_EQUAL_INT(ESP_OK, ntc_8bit(code, &v8));
+        TEST_ASSERT_EQUAL_INT(ESP_OK, ntc_12bit(code << 4, &v12));
+        TEST_ASSERT_EQUAL_INT32(v8, v12);
+        if (code < 255) {
+            TEST_ASSERT_EQUAL_INT(ESP_OK, ntc_8bit(code + 1, &next));
+        }
+        for (uint32_t low = 0; low < 16; low++) {
+            sensor_value v;
+            TEST_ASSERT_EQUAL_INT(ESP_OK, ntc_12bit((code << 4) | low, &v));
+            TEST_ASSERT_GREATER_OR_EQUAL(prev, v);
+            TEST_ASSERT_GREATER_OR_EQUAL(v8, v);
+            TEST_ASSERT_LESS_OR_EQUAL(next, v);
+            prev = v;
+        }
+    }
+
+    const uint8_t noisy[2] = { 0xF8, 0x40 };
+    sensor_value v, clean;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, sensor_ntc_adc.convert(NULL, noisy, &v));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, ntc_12bit(0x840, &clean));
+    TEST_ASSERT_EQUAL_INT32(clean, v);
+}
+
+/**
+ * @brief Every 16-bit count within VEML_MAX_U of counts * 1.8432 lux, without wrapping at full scale
+ */
+static void test_veml_q15_error(void)
+{
+    uint32_t worst = 0;
+    char msg[96];
+
+    for (uint32_t counts = 0; counts <= UINT16_MAX; counts++) {
+        sensor_value value;
+        TEST_ASSERT_EQUAL_INT(ESP_OK, veml(counts, &value));
+        uint32_t err = error_u(value, counts * VEML_LUX_PER_COUNT);
+        worst = err > worst ? err : worst;
+    }
+    snprintf(msg, sizeof(msg), "VEML7700: worst error %u micro-lux", (unsigned)worst);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(VEML_MAX_U, worst);
+    sensor_value top;
+    veml(UINT16_MAX, &top);
+    TEST_ASSERT_GREATER_THAN(120000 * SENSOR_VALUE_ONE, top);
+}
+
+/**
+ * @brief ns per conversion for both drivers and for the float formula the NTC table replaces,
+ *  reported rather than asserted as the host's FPU says little about the ESP32's soft-float doubles;
+ *  the bound only catches something pathological
+ */
+static void test_bench_convert(void)
+{
+    char msg[160];
+    sensor_value value;
+    double sum = 0;
+
+    int64_t start = esp_timer_get_time();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (uint32_t code = NTC_FIRST_12BIT; code < 4096; code++) {
+            ntc_12bit(code, &value);
+            s_sink = value;
+        }
+    }
+    int64_t ntc_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (uint32_t code = NTC_FIRST_12BIT; code < 4096; code++) {
+            sum += NTC_REF_C(code / 16.0);
+        }
+    }
+    int64_t float_us = esp_timer_get_time() - start;
+    s_sink = (sensor_value)sum;
+
+    start = esp_timer_get_time();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (uint32_t counts = NTC_FIRST_12BIT; counts < 4096; counts++) {
+            veml(counts, &value);
+            s_sink = value;
+        }
+    }
+    int64_t veml_us = esp_timer_get_time() - start;
+
+    uint32_t conversions = BENCH_ROUNDS * (4096 - NTC_FIRST_12BIT);
+    uint32_t ntc_ns = (uint32_t)(ntc_us * 1000 / conversions);
+    snprintf(msg, sizeof(msg), "NTC table %u ns, NTC float %u ns, VEML Q15 %u ns per conversion", (unsigned)ntc_ns,
+             (unsigned)(float_us * 1000 / conversions), (unsigned)(veml_us * 1000 / conversions));
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_LESS_THAN_UINT32(1000, ntc_ns);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ntc_table_matches_curve);
+    RUN_TEST(test_ntc_interpolation_error);
+    RUN_TEST(test_ntc_low_codes_invalid);
+    RUN_TEST(test_ntc_8bit_and_12bit_agree);
+    RUN_TEST(test_veml_q15_error);
+    RUN_TEST(test_bench_convert);
+    return UNITY_END();
+}
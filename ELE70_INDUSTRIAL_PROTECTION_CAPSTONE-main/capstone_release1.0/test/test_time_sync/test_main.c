@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unity.h>
+#include "time-sync.h"
+
+/*
+ * The arithmetic under time-sync.c, without a server: NTP timestamps to UTC on both sides of the
+ * 2036 era rollover, and the mapping between esp_timer time and UTC under a drifting model, which
+ * must invert itself to the microsecond over any span a sync interval can stretch to. Before the
+ * client starts, its stats group reports an unsynced clock.
+ */
+
+//Defines
+#define NTP_UNIX_OFFSET_S 2208988800u       //1900-01-01 to 1970-01-01
+#define DAY_US (86400LL * 1000000)
+#define STATS_LEN 256
+
+//Private Variables
+static char s_buf[STATS_LEN + 1];
+
+//Private Function Declarations
+static int64_t ntp(uint32_t sec, uint32_t frac);
+
+//****************************************************************************
+//Helpers
+//****************************************************************************
+
+/**
+ * @brief time_sync_ntp_to_utc_us() of a timestamp laid out as on the wire
+ */
+static int64_t ntp(uint32_t sec, uint32_t frac)
+{
+    const uint8_t ts[8] = {
+        sec >> 24, sec >> 16, sec >> 8, sec,
+        frac >> 24, frac >> 16, frac >> 8, frac,
+    };
+    return time_sync_ntp_to_utc_us(ts);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+//****************************************************************************
+//Tests
+//****************************************************************************
+
+/**
+ * @brief Era 0: the Unix epoch is 0, the fraction is 2^-32 s rounded down to the microsecond
+ */
+static void test_ntp_era0(void)
+{
+    TEST_ASSERT_EQUAL_INT64(0, ntp(NTP_UNIX_OFFSET_S, 0));
+    TEST_ASSERT_EQUAL_INT64(500000, ntp(NTP_UNIX_OFFSET_S, 0x80000000u));
+    TEST_ASSERT_EQUAL_INT64(999999, ntp(NTP_UNIX_OFFSET_S, 0xFFFFFFFFu));
+    TEST_ASSERT_EQUAL_INT64(1700000000LL * 1000000 + 250000, ntp(NTP_UNIX_OFFSET_S + 1700000000u, 0x40000000u));
+}
+
+/**
+ * @brief The seconds field wraps on 2036-02-07 06:28:16 UTC; the next second is era 1 and time keeps
+ *  counting up instead of jumping back to 1900
+ */
+static void test_ntp_era_rollover(void)
+{
+    const int64_t rollover_us = 2085978496LL * 1000000;     //2^32 - NTP_UNIX_OFFSET_S
+
+    TEST_ASSERT_EQUAL_INT64(rollover_us - 1000000, ntp(0xFFFFFFFFu, 0));
+    TEST_ASSERT_EQUAL_INT64(rollover_us - 1, ntp(0xFFFFFFFFu, 0xFFFFFFFFu));
+    TEST_ASSERT_EQUAL_INT64(rollover_us, ntp(0, 0));
+    TEST_ASSERT_EQUAL_INT64(rollover_us + 500000, ntp(0, 0x80000000u));
+    TEST_ASSERT_EQUAL_INT64(2208988800LL * 1000000, ntp(123010304u, 0));      //2040-01-01
+    TEST_ASSERT_GREATER_THAN_INT64(ntp(0xFFFFFFFFu, 0xFFFFFFFFu), ntp(0x7FFFFFFFu, 0));
+}
+
+/**
+ * @brief At the sync instant UTC is local time plus the offset; a day later a 20 ppm slow oscillator
+ *  has fallen 1.728 s behind, a fast one as far ahead
+ */
+static void test_model_drift(void)
+{
+    time_sync_model model = { .offset_us = 1700000000LL * 1000000, .local_us = 5000000, .drift_ppb = 20000 };
+
+    TEST_ASSERT_EQUAL_INT64(model.local_us + model.offset_us, time_sync_model_utc_us(&model, model.local_us));
+    TEST_ASSERT_EQUAL_INT64(model.local_us + DAY_US + model.offset_us + 1728000,
+                            time_sync_model_utc_us(&model, model.local_us + DAY_US));
+    model.drift_ppb = -20000;
+    TEST_ASSERT_EQUAL_INT64(model.local_us + DAY_US + model.offset_us - 1728000,
+                            time_sync_model_utc_us(&model, model.local_us + DAY_US));
+}
+
+/**
+ * @brief esp_timer to UTC and back, and UTC to esp_timer and back, land within a microsecond for
+ *  drifts up to TIME_SYNC_DRIFT_MAX_PPB either way and instants a month before or after the sync,
+ *  the far past being journaled samples from an earlier boot
+ */
+static void test_model_round_trip(void)
+{
+    const int32_t drifts[] = { TIME_SYNC_DRIFT_MAX_PPB, 12345, 1, -777, -TIME_SYNC_DRIFT_MAX_PPB };
+    const int64_t spans[] = { -30 * DAY_US, -1000001, -1, 0, 1, 3600LL * 1000000 + 7, 30 * DAY_US };
+
+    for (size_t d = 0; d < sizeof(drifts) / sizeof(drifts[0]); d++) {
+        time_sync_model model = { .offset_us = 1760000000LL * 1000000 + 123, .local_us = 42000000,
+                                  .drift_ppb = drifts[d] };
+        for (size_t s = 0; s < sizeof(spans) / sizeof(spans[0]); s++) {
+            int64_t mono_us = model.local_us + spans[s];
+            int64_t utc_us = time_sync_model_utc_us(&model, mono_us);
+            TEST_ASSERT_INT64_WITHIN(1, mono_us, time_sync_model_mono_us(&model, utc_us));
+
+            utc_us = model.local_us + model.offset_us + spans[s];
+            TEST_ASSERT_INT64_WITHIN(1, utc_us, time_sync_model_utc_us(&model, time_sync_model_mono_us(&model, utc_us)));
+        }
+    }
+}
+
+/**
+ * @brief Before the client runs, the stats group is all zeros and a second group is refused
+ */
+static void test_stats_unsynced(void)
+{
+    payload_writer w;
+
+    payload_init(&w, s_buf, STATS_LEN);
+    TEST_ASSERT_TRUE(time_sync_encode_stats(&w, 0));
+    TEST_ASSERT_FALSE(w.overflow);
+    s_buf[w.len] = '\0';
+    TEST_ASSERT_EQUAL_STRING("time=sntp&synced=0&syncs=0&failures=0&offset_us=0&drift_ppb=0&rtt_us=0"
+                             "&since_sync_s=0", s_buf);
+
+    size_t len = w.len;
+    TEST_ASSERT_FALSE(time_sync_encode_stats(&w, 1));
+    TEST_ASSERT_EQUAL_size_t(len, w.len);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ntp_era0);
+    RUN_TEST(test_ntp_era_rollover);
+    RUN_TEST(test_model_drift);
+    RUN_TEST(test_model_round_trip);
+    RUN_TEST(test_stats_unsynced);
+    return UNITY_END();
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <unity.h>
+#include "tx-trigger.h"
+
+/*
+ * tx-trigger.c on made-up timestamps: an event is marked at a known time, the write that serves it
+ * starts a known number of microseconds later, and the latency must land in the log2 bucket that
+ * covers the difference. over_target only moves past TX_TRIGGER_TARGET_US. Kinds are counted apart,
+ * several events before one write are measured from the earliest, and a journaled batch records no
+ * latency at all.
+ */
+
+//Defines
+#define T0_US 1000000LL
+
+//Private Function Declarations
+static tx_trigger_stats stats(tx_trigger_kind kind);
+static void assert_one_sample(const tx_trigger_stats *before, const tx_trigger_stats *after, int bucket);
+
+//****************************************************************************
+//Helpers
+//****************************************************************************
+
+/**
+ * @brief Snapshot of one kind, tests compare before and after since the counters never reset
+ */
+static tx_trigger_stats stats(tx_trigger_kind kind)
+{
+    tx_trigger_stats s;
+    tx_trigger_get_stats(kind, &s);
+    return s;
+}
+
+/**
+ * @brief Exactly one latency recorded between the two snapshots, in bucket
+ */
+static void assert_one_sample(const tx_trigger_stats *before, const tx_trigger_stats *after, int bucket)
+{
+    TEST_ASSERT_EQUAL_UINT32(before->latency.count + 1, after->latency.count);
+    for (int b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+        TEST_ASSERT_EQUAL_UINT32(before->latency.buckets[b] + (b == bucket ? 1 : 0), after->latency.buckets[b]);
+    }
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+//****************************************************************************
+//Tests
+//****************************************************************************
+
+/**
+ * @brief A window served 3000 us after it was marked is one write in bucket 12, [2048, 4096) us,
+ *  and within the target
+ */
+static void test_served_latency_bucket(void)
+{
+    tx_trigger_stats before = stats(TX_TRIGGER_WINDOW);
+
+    tx_trigger_mark_at(TX_TRIGGER_WINDOW, T0_US);
+    tx_trigger_served(T0_US + 3000);
+
+    tx_trigger_stats after = stats(TX_TRIGGER_WINDOW);
+    TEST_ASSERT_EQUAL_UINT32(before.triggers + 1, after.triggers);
+    TEST_ASSERT_EQUAL_UINT32(before.written + 1, after.written);
+    TEST_ASSERT_EQUAL_UINT32(before.journaled, after.journaled);
+    TEST_ASSERT_EQUAL_UINT32(before.over_target, after.over_target);
+    assert_one_sample(&before, &after, 12);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(3000, after.latency.max_us);
+}
+
+/**
+ * @brief Exactly TX_TRIGGER_TARGET_US is still on target, one microsecond more is over it
+ */
+static void test_over_target(void)
+{
+    tx_trigger_stats before = stats(TX_TRIGGER_ALARM);
+
+    tx_trigger_mark_at(TX_TRIGGER_ALARM, T0_US);
+    tx_trigger_served(T0_US + TX_TRIGGER_TARGET_US);
+    TEST_ASSERT_EQUAL_UINT32(before.over_target, stats(TX_TRIGGER_ALARM).over_target);
+
+    tx_trigger_mark_at(TX_TRIGGER_ALARM, T0_US);
+    tx_trigger_served(T0_US + TX_TRIGGER_TARGET_US + 1);
+    tx_trigger_stats after = stats(TX_TRIGGER_ALARM);
+    TEST_ASSERT_EQUAL_UINT32(before.over_target + 1, after.over_target);
+    TEST_ASSERT_EQUAL_UINT32(before.written + 2, after.written);
+    TEST_ASSERT_EQUAL_UINT32(TX_TRIGGER_TARGET_US + 1, after.latency.max_us);
+}
+
+/**
+ * @brief Two profile changes before one write count as two triggers but one write, measured from the
+ *  earlier; an event marked after the write started rode along and counts as 0 us. The other kinds,
+ *  with nothing pending, are untouched
+ */
+static void test_earliest_mark_and_ride_along(void)
+{
+    tx_trigger_stats before = stats(TX_TRIGGER_PROFILE);
+    tx_trigger_stats window = stats(TX_TRIGGER_WINDOW);
+
+    tx_trigger_mark_at(TX_TRIGGER_PROFILE, T0_US + 500);
+    tx_trigger_mark_at(TX_TRIGGER_PROFILE, T0_US);
+    tx_trigger_served(T0_US + 1000);
+    tx_trigger_stats after = stats(TX_TRIGGER_PROFILE);
+    TEST_ASSERT_EQUAL_UINT32(before.triggers + 2, after.triggers);
+    TEST_ASSERT_EQUAL_UINT32(before.written + 1, after.written);
+    assert_one_sample(&before, &after, 10);      //1000 us, [512, 1024)
+
+    before = after;
+    tx_trigger_mark_at(TX_TRIGGER_PROFILE, T0_US + 20);
+    tx_trigger_served(T0_US);
+    after = stats(TX_TRIGGER_PROFILE);
+    assert_one_sample(&before, &after, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(window.written, stats(TX_TRIGGER_WINDOW).written);
+    TEST_ASSERT_EQUAL_UINT32(window.latency.count, stats(TX_TRIGGER_WINDOW).latency.count);
+}
+
+/**
+ * @brief A batch that went to the journal serves its events without a latency, and a later write
+ *  has nothing left to serve
+ */
+static void test_journaled(void)
+{
+    tx_trigger_stats before = stats(TX_TRIGGER_WINDOW);
+
+    tx_trigger_mark_at(TX_TRIGGER_WINDOW, T0_US);
+    tx_trigger_served(-1);
+    tx_trigger_served(T0_US + 100);
+
+    tx_trigger_stats after = stats(TX_TRIGGER_WINDOW);
+    TEST_ASSERT_EQUAL_UINT32(before.journaled + 1, after.journaled);
+    TEST_ASSERT_EQUAL_UINT32(before.written, after.written);
+    TEST_ASSERT_EQUAL_UINT32(before.latency.count, after.latency.count);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_served_latency_bucket);
+    RUN_TEST(test_over_target);
+    RUN_TEST(test_earliest_mark_and_ride_along);
+    RUN_TEST(test_journaled);
+    return UNITY_END();
+}